@@ -0,0 +1,118 @@
+// Copyright (C) 2024-2025 Vladislav Nepogodin
+//
+// This file is part of CachyOS kernel manager.
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+#ifndef SCHEDEXT_CLIENT_HPP_
+#define SCHEDEXT_CLIENT_HPP_
+
+#include "schedext-export.hpp"
+
+#include <cstdint>
+#include <optional>
+
+#if defined(__clang__)
+#pragma clang diagnostic push
+#pragma clang diagnostic ignored "-Wsign-conversion"
+#pragma clang diagnostic ignored "-Wshorten-64-to-32"
+#elif defined(__GNUC__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wuseless-cast"
+#pragma GCC diagnostic ignored "-Wsign-conversion"
+#pragma GCC diagnostic ignored "-Wconversion"
+#pragma GCC diagnostic ignored "-Wsuggest-final-methods"
+#pragma GCC diagnostic ignored "-Wsuggest-attribute=pure"
+#endif
+
+#include <QtCore/QFuture>
+#include <QtCore/QObject>
+#include <QtCore/QString>
+#include <QtCore/QStringList>
+
+#if defined(__clang__)
+#pragma clang diagnostic pop
+#elif defined(__GNUC__)
+#pragma GCC diagnostic pop
+#endif
+
+namespace scxctl {
+
+namespace impl {
+    class SchedExtClient;
+}  // namespace impl
+
+/// Mode of the scheduler, values match the ones of scx_loader
+enum class SchedMode : std::uint8_t {
+    Auto       = 0,
+    Gaming     = 1,
+    PowerSave  = 2,
+    LowLatency = 3,
+    Server     = 4,
+};
+
+/// Scheduler run by scx_loader
+struct SchedulerState {
+    /// Empty if no scheduler is running
+    QString scheduler;
+    SchedMode mode{SchedMode::Auto};
+
+    auto operator==(const SchedulerState&) const -> bool = default;
+};
+
+/// Client of scx_loader and its config, without any widgets.
+///
+/// All calls return immediately, the work runs on a thread owned by the client,
+/// one call at a time in the order of the calls. Results are delivered through
+/// QFuture, e.g `client.current_state().then(this, [](auto state) { ... })`,
+/// failed calls yield nullopt or false. Destroying the client waits for the
+/// calls in flight.
+class SCHEDEXT_EXPORT SchedExtClient final : public QObject {
+    Q_OBJECT
+    Q_DISABLE_COPY_MOVE(SchedExtClient)
+ public:
+    /// Uses the default scx_loader config, /etc/scx_loader.toml
+    explicit SchedExtClient(QObject* parent = nullptr);
+    SchedExtClient(const QString& config_path, QObject* parent);
+    ~SchedExtClient() override;
+
+    /// Schedulers supported by scx_loader
+    auto supported_schedulers() -> QFuture<std::optional<QStringList>>;
+    /// Running scheduler and its mode
+    auto current_state() -> QFuture<std::optional<SchedulerState>>;
+    /// Flags passed to the scheduler in the mode, as set in the config
+    auto scheduler_flags(const QString& scheduler, SchedMode mode) -> QFuture<std::optional<QStringList>>;
+
+    /// Switches to the scheduler and persists it in the config, which asks for root permissions.
+    ///
+    /// Empty args run the scheduler with the flags of the mode. Fails without persisting
+    /// the scheduler, if scx_loader didn't switch to it.
+    auto apply(const QString& scheduler, SchedMode mode, const QStringList& extra_args = {}) -> QFuture<bool>;
+    /// Stops the scheduler and disables its start on boot.
+    auto disable() -> QFuture<bool>;
+
+ signals:
+    /// Emitted when scx_loader reports a change of the scheduler or its mode
+    void scheduler_changed(const scxctl::SchedulerState& state);
+
+ private:
+    void on_loader_event() noexcept;
+
+    impl::SchedExtClient* m_impl = nullptr;
+};
+
+}  // namespace scxctl
+
+#endif  // SCHEDEXT_CLIENT_HPP_
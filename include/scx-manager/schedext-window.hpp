@@ -19,36 +19,7 @@
 #ifndef SCHEDEXT_WINDOW_HPP_
 #define SCHEDEXT_WINDOW_HPP_
 
-#if defined(__clang__)
-#pragma clang diagnostic push
-#pragma clang diagnostic ignored "-Wsign-conversion"
-#pragma clang diagnostic ignored "-Wfloat-conversion"
-#pragma clang diagnostic ignored "-Wdouble-promotion"
-#pragma clang diagnostic ignored "-Wimplicit-int-float-conversion"
-#pragma clang diagnostic ignored "-Wdeprecated-enum-enum-conversion"
-#pragma clang diagnostic ignored "-Wshorten-64-to-32"
-#elif defined(__GNUC__)
-#pragma GCC diagnostic push
-#pragma GCC diagnostic ignored "-Wuseless-cast"
-#pragma GCC diagnostic ignored "-Wsign-conversion"
-#pragma GCC diagnostic ignored "-Wconversion"
-#pragma GCC diagnostic ignored "-Wdeprecated-enum-enum-conversion"
-#pragma GCC diagnostic ignored "-Wsuggest-final-methods"
-#pragma GCC diagnostic ignored "-Wsuggest-attribute=pure"
-#endif
-
-#include <QtCore/QtGlobal>
-
-#if defined(__clang__)
-#pragma clang diagnostic pop
-#elif defined(__GNUC__)
-#pragma GCC diagnostic pop
-#endif
-#if defined(SCHEDEXT_LIB)
-#define SCHEDEXT_EXPORT Q_DECL_EXPORT
-#else
-#define SCHEDEXT_EXPORT Q_DECL_IMPORT
-#endif
+#include "schedext-export.hpp"
 
 class QWidget;
 
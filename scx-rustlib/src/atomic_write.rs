@@ -0,0 +1,163 @@
+// SPDX-License-Identifier: GPL-2.0
+//
+// Copyright (c) 2024-2025 Vladislav Nepogodin <vnepogodin@cachyos.org>
+
+// This software may be used and distributed according to the terms of the
+// GNU General Public License version 2.
+
+use std::ffi::CString;
+use std::fs::{self, File, OpenOptions, Permissions};
+use std::io::{self, Write};
+use std::os::fd::AsRawFd;
+use std::os::unix::ffi::OsStrExt;
+use std::os::unix::fs::{OpenOptionsExt, PermissionsExt};
+use std::path::{Path, PathBuf};
+
+/// Replaces the file with the content, readers see either the old or the new file.
+///
+/// The content is written into an unnamed `O_TMPFILE` in the same directory and synced, before
+/// it gets a name and is renamed over the target. The directory is synced afterwards, so the
+/// rename survives a crash as well. Falls back to a named temp file on filesystems without
+/// `O_TMPFILE` support.
+pub fn write_file_atomically(path: &Path, content: &[u8], mode: u32) -> io::Result<()> {
+    let dir = parent_dir(path);
+    let tmp_path = temp_path(path)?;
+
+    match OpenOptions::new().write(true).mode(mode).custom_flags(libc::O_TMPFILE).open(dir) {
+        Ok(mut file) => {
+            write_synced(&mut file, content, mode)?;
+            link_unnamed(&file, &tmp_path)?;
+        },
+        Err(err) if is_tmpfile_unsupported(&err) => {
+            let _ = fs::remove_file(&tmp_path);
+            let mut file =
+                OpenOptions::new().write(true).create_new(true).mode(mode).open(&tmp_path)?;
+            if let Err(err) = write_synced(&mut file, content, mode) {
+                let _ = fs::remove_file(&tmp_path);
+                return Err(err);
+            }
+        },
+        Err(err) => return Err(err),
+    }
+
+    if let Err(err) = fs::rename(&tmp_path, path) {
+        let _ = fs::remove_file(&tmp_path);
+        return Err(err);
+    }
+    File::open(dir)?.sync_all()
+}
+
+/// Whether the file can be replaced by the current user, without the privileged helper.
+pub fn is_replaceable(path: &Path) -> bool {
+    let Ok(dir) = CString::new(parent_dir(path).as_os_str().as_bytes()) else {
+        return false;
+    };
+    // SAFETY: dir is a valid NUL-terminated string
+    unsafe { libc::access(dir.as_ptr(), libc::W_OK) == 0 }
+}
+
+fn parent_dir(path: &Path) -> &Path {
+    match path.parent() {
+        Some(dir) if !dir.as_os_str().is_empty() => dir,
+        _ => Path::new("."),
+    }
+}
+
+/// Temp name next to the target, unique per process.
+fn temp_path(path: &Path) -> io::Result<PathBuf> {
+    let file_name = path.file_name().ok_or_else(|| {
+        io::Error::new(io::ErrorKind::InvalidInput, format!("{} is not a file", path.display()))
+    })?;
+    let mut tmp_name = std::ffi::OsString::from(".");
+    tmp_name.push(file_name);
+    tmp_name.push(format!(".{}.tmp", std::process::id()));
+    Ok(parent_dir(path).join(tmp_name))
+}
+
+fn write_synced(file: &mut File, content: &[u8], mode: u32) -> io::Result<()> {
+    file.write_all(content)?;
+    // the mode passed to open is masked by umask
+    file.set_permissions(Permissions::from_mode(mode))?;
+    file.sync_all()
+}
+
+/// Gives a name to the `O_TMPFILE` file.
+fn link_unnamed(file: &File, tmp_path: &Path) -> io::Result<()> {
+    let _ = fs::remove_file(tmp_path);
+
+    let fd_path = CString::new(format!("/proc/self/fd/{}", file.as_raw_fd()))?;
+    let tmp_path_c = CString::new(tmp_path.as_os_str().as_bytes())?;
+    // SAFETY: both paths are valid NUL-terminated strings
+    let ret = unsafe {
+        libc::linkat(
+            libc::AT_FDCWD,
+            fd_path.as_ptr(),
+            libc::AT_FDCWD,
+            tmp_path_c.as_ptr(),
+            libc::AT_SYMLINK_FOLLOW,
+        )
+    };
+    if ret != 0 {
+        return Err(io::Error::last_os_error());
+    }
+    Ok(())
+}
+
+fn is_tmpfile_unsupported(err: &io::Error) -> bool {
+    // older kernels report EISDIR, as O_TMPFILE includes O_DIRECTORY
+    matches!(err.raw_os_error(), Some(libc::EOPNOTSUPP | libc::EISDIR | libc::EINVAL))
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    fn test_dir(name: &str) -> PathBuf {
+        let dir =
+            std::env::temp_dir().join(format!("scx-atomic-write-{}-{name}", std::process::id()));
+        let _ = fs::remove_dir_all(&dir);
+        fs::create_dir_all(&dir).unwrap();
+        dir
+    }
+
+    #[test]
+    fn test_write_and_replace() {
+        let dir = test_dir("replace");
+        let path = dir.join("scx_loader.toml");
+
+        write_file_atomically(&path, b"default_mode = \"Auto\"\n", 0o644).unwrap();
+        assert_eq!(fs::read(&path).unwrap(), b"default_mode = \"Auto\"\n");
+
+        write_file_atomically(&path, b"default_mode = \"Gaming\"\n", 0o600).unwrap();
+        assert_eq!(fs::read(&path).unwrap(), b"default_mode = \"Gaming\"\n");
+        assert_eq!(fs::metadata(&path).unwrap().permissions().mode() & 0o777, 0o600);
+
+        // only the target is left in the directory
+        let entries: Vec<_> = fs::read_dir(&dir).unwrap().map(|e| e.unwrap().file_name()).collect();
+        assert_eq!(entries, ["scx_loader.toml"]);
+
+        fs::remove_dir_all(&dir).unwrap();
+    }
+
+    #[test]
+    fn test_missing_directory() {
+        let dir = test_dir("missing");
+        let path = dir.join("not_existing").join("scx_loader.toml");
+
+        assert!(write_file_atomically(&path, b"", 0o644).is_err());
+        assert!(!is_replaceable(&path));
+        assert!(is_replaceable(&dir.join("scx_loader.toml")));
+
+        fs::remove_dir_all(&dir).unwrap();
+    }
+
+    #[test]
+    fn test_temp_path() {
+        let tmp_path = temp_path(Path::new("/etc/scx_loader.toml")).unwrap();
+        assert_eq!(tmp_path.parent().unwrap(), Path::new("/etc"));
+        assert!(tmp_path.file_name().unwrap().to_str().unwrap().starts_with(".scx_loader.toml."));
+
+        assert_eq!(parent_dir(Path::new("scx_loader.toml")), Path::new("."));
+        assert!(temp_path(Path::new("/")).is_err());
+    }
+}
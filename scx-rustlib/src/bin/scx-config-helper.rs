@@ -0,0 +1,140 @@
+// SPDX-License-Identifier: GPL-2.0
+//
+// Copyright (c) 2024-2025 Vladislav Nepogodin <vnepogodin@cachyos.org>
+
+// This software may be used and distributed according to the terms of the
+// GNU General Public License version 2.
+
+//! Privileged helper of scx-manager, activated on the system bus.
+//!
+//! Receives the serialized scx_loader config in memory and atomically replaces the config file.
+//! Exits after being idle for a while, the bus activates it again on the next call.
+
+#[allow(dead_code)]
+#[path = "../atomic_write.rs"]
+mod atomic_write;
+#[allow(dead_code)]
+#[path = "../config_helper.rs"]
+mod config_helper;
+
+use config_helper::{HELPER_PATH, HELPER_SERVICE, WRITE_CONFIG_ACTION};
+
+use std::collections::{HashMap, HashSet};
+use std::path::Path;
+use std::sync::{Arc, Mutex};
+use std::time::{Duration, Instant};
+
+use anyhow::Result;
+use zbus::message::Header;
+use zbus::zvariant::Value;
+use zbus::{fdo, Connection};
+
+const IDLE_TIMEOUT: Duration = Duration::from_secs(600);
+const IDLE_CHECK_INTERVAL: Duration = Duration::from_secs(30);
+
+/// CheckAuthorization flag, lets polkit ask the user for the password.
+const ALLOW_USER_INTERACTION: u32 = 1;
+
+#[zbus::proxy(
+    interface = "org.freedesktop.PolicyKit1.Authority",
+    default_service = "org.freedesktop.PolicyKit1",
+    default_path = "/org/freedesktop/PolicyKit1/Authority",
+    gen_blocking = false
+)]
+trait Authority {
+    fn check_authorization(
+        &self,
+        subject: &(&str, HashMap<&str, Value<'_>>),
+        action_id: &str,
+        details: HashMap<&str, &str>,
+        flags: u32,
+        cancellation_id: &str,
+    ) -> zbus::Result<(bool, bool, HashMap<String, String>)>;
+}
+
+struct ConfigHelper {
+    /// Unique bus names authorized already. Names are never reused by the bus, so the
+    /// authorization lasts exactly as long as the client's connection.
+    authorized_senders: Mutex<HashSet<String>>,
+    last_activity: Arc<Mutex<Instant>>,
+}
+
+impl ConfigHelper {
+    fn touch(&self) {
+        *self.last_activity.lock().unwrap() = Instant::now();
+    }
+
+    async fn authorize(&self, connection: &Connection, sender: &str) -> fdo::Result<()> {
+        if self.authorized_senders.lock().unwrap().contains(sender) {
+            return Ok(());
+        }
+
+        let authority = AuthorityProxy::new(connection).await?;
+        let subject = ("system-bus-name", HashMap::from([("name", Value::from(sender))]));
+        let (is_authorized, ..) = authority
+            .check_authorization(
+                &subject,
+                WRITE_CONFIG_ACTION,
+                HashMap::new(),
+                ALLOW_USER_INTERACTION,
+                "",
+            )
+            .await?;
+        if !is_authorized {
+            return Err(fdo::Error::AccessDenied(format!("{sender} is not authorized")));
+        }
+
+        self.authorized_senders.lock().unwrap().insert(sender.to_owned());
+        Ok(())
+    }
+}
+
+#[zbus::interface(name = "org.cachyos.ScxManager.ConfigHelper1")]
+impl ConfigHelper {
+    async fn write_config(
+        &self,
+        #[zbus(header)] header: Header<'_>,
+        #[zbus(connection)] connection: &Connection,
+        config_path: String,
+        content: String,
+    ) -> fdo::Result<()> {
+        self.touch();
+
+        let sender = header
+            .sender()
+            .ok_or_else(|| fdo::Error::AccessDenied("Unknown sender".to_owned()))?
+            .to_string();
+        config_helper::validate_request(&config_path, &content).map_err(fdo::Error::InvalidArgs)?;
+        self.authorize(connection, &sender).await?;
+
+        atomic_write::write_file_atomically(Path::new(&config_path), content.as_bytes(), 0o644)
+            .map_err(|err| fdo::Error::IOError(format!("Failed to write {config_path}: {err}")))?;
+
+        // the prompt may have taken a while
+        self.touch();
+        Ok(())
+    }
+}
+
+#[tokio::main(flavor = "current_thread")]
+async fn main() -> Result<()> {
+    let last_activity = Arc::new(Mutex::new(Instant::now()));
+    let helper = ConfigHelper {
+        authorized_senders: Mutex::new(HashSet::new()),
+        last_activity: Arc::clone(&last_activity),
+    };
+
+    let _connection = zbus::connection::Builder::system()?
+        .name(HELPER_SERVICE)?
+        .serve_at(HELPER_PATH, helper)?
+        .build()
+        .await?;
+
+    loop {
+        tokio::time::sleep(IDLE_CHECK_INTERVAL).await;
+        if last_activity.lock().unwrap().elapsed() >= IDLE_TIMEOUT {
+            break;
+        }
+    }
+    Ok(())
+}
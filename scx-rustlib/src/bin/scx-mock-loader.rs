@@ -0,0 +1,81 @@
+// SPDX-License-Identifier: GPL-2.0
+//
+// Copyright (c) 2024-2025 Vladislav Nepogodin <vnepogodin@cachyos.org>
+
+// This software may be used and distributed according to the terms of the
+// GNU General Public License version 2.
+
+//! Stand-in of scx_loader and the systemd manager for benchmarks.
+//!
+//! Owns `org.scx.Loader` and `org.freedesktop.systemd1` on a private bus, e.g a dbus-daemon
+//! started with `--session`, never on the system bus. Prints "ready" once the names are owned.
+
+#[allow(dead_code)]
+#[path = "../mock.rs"]
+mod mock;
+
+use mock::{LoaderFaults, MockLoader};
+
+use std::io::Write;
+use std::time::Duration;
+
+use anyhow::{bail, Context, Result};
+
+const USAGE: &str = "Usage: scx-mock-loader --address <bus address> [--latency-us <us>] \
+                     [--fail-every <n>] [--scheds <sched,...>]";
+
+const DEFAULT_SCHEDS: &str = "scx_bpfland,scx_cosmos,scx_flash,scx_lavd,scx_p2dq,scx_rusty,scx_tickless";
+
+struct Args {
+    address: String,
+    faults: LoaderFaults,
+    scheds: Vec<String>,
+}
+
+fn parse_args() -> Result<Args> {
+    let mut address = std::env::var("DBUS_SESSION_BUS_ADDRESS").unwrap_or_default();
+    let mut faults = LoaderFaults::default();
+    let mut scheds = DEFAULT_SCHEDS.to_owned();
+
+    let mut args = std::env::args().skip(1);
+    while let Some(arg) = args.next() {
+        let mut value = || args.next().with_context(|| format!("Missing value of {arg}"));
+        match arg.as_str() {
+            "--address" => address = value()?,
+            "--latency-us" => {
+                let latency_us = value()?.parse().context("Invalid --latency-us")?;
+                faults.latency = Duration::from_micros(latency_us);
+            },
+            "--fail-every" => faults.fail_every = value()?.parse().context("Invalid --fail-every")?,
+            "--scheds" => scheds = value()?,
+            _ => bail!("Unknown argument: {arg}\n{USAGE}"),
+        }
+    }
+    if address.is_empty() {
+        bail!("No bus address given\n{USAGE}");
+    }
+
+    let scheds = scheds.split(',').filter(|sched| !sched.is_empty()).map(str::to_owned).collect();
+    Ok(Args { address, faults, scheds })
+}
+
+#[tokio::main]
+async fn main() -> Result<()> {
+    let args = parse_args()?;
+
+    // scx.service is disabled and scx_loader.service enabled, so the apply doesn't change units
+    let systemd = mock::shared_state(&[
+        ("scx.service", "disabled", "inactive"),
+        ("scx_loader.service", "enabled", "active"),
+    ]);
+    let builder = zbus::connection::Builder::address(args.address.as_str())?;
+    let _connection = mock::serve(builder, MockLoader::new(args.scheds, args.faults), &systemd, true)
+        .await
+        .with_context(|| format!("Failed to serve on {}", args.address))?;
+
+    println!("ready");
+    std::io::stdout().flush()?;
+
+    std::future::pending::<()>().await;
+    Ok(())
+}
@@ -0,0 +1,62 @@
+// SPDX-License-Identifier: GPL-2.0
+//
+// Copyright (c) 2024-2025 Vladislav Nepogodin <vnepogodin@cachyos.org>
+
+// This software may be used and distributed according to the terms of the
+// GNU General Public License version 2.
+
+//! Interface of the privileged helper, which writes scx_loader config on behalf of the user.
+//!
+//! The helper is activated on the system bus on first use and checks the polkit action once per
+//! client connection, so repeated writes of the same session don't prompt again.
+
+pub const HELPER_SERVICE: &str = "org.cachyos.ScxManager.ConfigHelper";
+pub const HELPER_PATH: &str = "/org/cachyos/ScxManager/ConfigHelper";
+
+/// Polkit action checked before the first write.
+pub const WRITE_CONFIG_ACTION: &str = "org.cachyos.scx-manager.write-config";
+
+/// Configs read by scx_loader, the helper refuses to write anything else.
+pub const ALLOWED_CONFIG_PATHS: [&str; 2] = ["/etc/scx_loader.toml", "/etc/scx_loader/config.toml"];
+
+pub const MAX_CONFIG_SIZE: usize = 1 << 20;
+
+#[zbus::proxy(
+    interface = "org.cachyos.ScxManager.ConfigHelper1",
+    default_service = "org.cachyos.ScxManager.ConfigHelper",
+    default_path = "/org/cachyos/ScxManager/ConfigHelper",
+    gen_blocking = false
+)]
+pub trait ConfigHelper {
+    /// Atomically replaces the config with the serialized content.
+    fn write_config(&self, config_path: &str, content: &str) -> zbus::Result<()>;
+}
+
+/// Checks the request before asking polkit, so that invalid ones don't prompt the user.
+pub fn validate_request(config_path: &str, content: &str) -> Result<(), String> {
+    if !ALLOWED_CONFIG_PATHS.contains(&config_path) {
+        return Err(format!("{config_path} is not a scx_loader config"));
+    }
+    if content.len() > MAX_CONFIG_SIZE {
+        return Err(format!("Config is larger than {MAX_CONFIG_SIZE} bytes"));
+    }
+    content.parse::<toml::Table>().map_err(|err| format!("Config is not valid TOML: {err}"))?;
+    Ok(())
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    #[test]
+    fn test_validate_request() {
+        let config = "default_mode = \"Auto\"\n\n[scheds.scx_lavd]\nauto_mode = []\n";
+        assert!(validate_request("/etc/scx_loader.toml", config).is_ok());
+        assert!(validate_request("/etc/scx_loader/config.toml", config).is_ok());
+
+        assert!(validate_request("/etc/passwd", config).is_err());
+        assert!(validate_request("/etc/../etc/scx_loader.toml", config).is_err());
+        assert!(validate_request("/etc/scx_loader.toml", "default_mode = ").is_err());
+        assert!(validate_request("/etc/scx_loader.toml", &"#".repeat(MAX_CONFIG_SIZE + 1)).is_err());
+    }
+}
@@ -14,22 +14,96 @@
 // with this program; if not, write to the Free Software Foundation, Inc.,
 // 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
 
+pub mod atomic_write;
+pub mod config_helper;
+#[cfg(test)]
+#[allow(dead_code)]
+mod mock;
+pub mod plan;
+pub mod session;
+pub mod systemd;
 pub mod utils;
 
-use scx_loader::dbus::LoaderClientProxy;
+use plan::{PlanRequest, PlanState};
 use scx_loader::*;
+use session::{LoaderMethod, LoaderProperties, LoaderSession};
 
-use std::fs;
-use std::io::Write;
+use std::os::fd::IntoRawFd;
 use std::path::Path;
-use std::process::Command;
+use std::sync::Mutex;
 
 use anyhow::{Context, Result};
-use tokio::runtime::Runtime;
-use zbus::Connection;
 
 #[cxx::bridge(namespace = "scx_loader")]
 mod ffi {
+    /// Mode of the scheduler, values match the ones of scx_loader.
+    #[repr(u8)]
+    enum SchedMode {
+        /// Default values for the scheduler
+        Auto = 0,
+        /// Applies flags for better gaming experience
+        Gaming = 1,
+        /// Applies flags for lower power usage
+        PowerSave = 2,
+        /// Starts scheduler in low latency mode
+        LowLatency = 3,
+        /// Starts scheduler in server-oriented mode
+        Server = 4,
+    }
+
+    /// What was done to 'scx.service' to get it out of the way of scx_loader.
+    enum ScxServiceAction {
+        /// The service was neither enabled nor running
+        None,
+        /// The service was disabled and stopped
+        Disabled,
+        /// The service was stopped
+        Stopped,
+    }
+
+    /// Latency counters of a single scx_loader method.
+    struct LoaderCallStats {
+        method: String,
+        calls: u64,
+        failures: u64,
+        reconnects: u64,
+        total_ns: u64,
+        max_ns: u64,
+    }
+
+    /// Flags of the scheduler for a single mode.
+    struct SchedModeFlags {
+        sched: String,
+        mode: SchedMode,
+        flags: Vec<String>,
+    }
+
+    /// Properties of scx_loader, fetched together.
+    struct LoaderSnapshot {
+        supported_scheds: Vec<String>,
+        current_sched: String,
+        current_mode: SchedMode,
+    }
+
+    /// Scheduler started by scx_loader on boot, read from the config.
+    struct DefaultSched {
+        /// Empty if no scheduler is started on boot
+        sched: String,
+        mode: SchedMode,
+        args: Vec<String>,
+    }
+
+    /// Steps of the scheduler change which are needed to reach the requested state.
+    struct ChangePlan {
+        stop_scx_service: bool,
+        switch_scheduler: bool,
+        enable_loader_service: bool,
+        stop_scheduler: bool,
+        write_config: bool,
+        /// Why the steps are needed, or why they are skipped
+        reasons: Vec<String>,
+    }
+
     extern "Rust" {
         type Config;
 
@@ -41,128 +115,195 @@ mod ffi {
         fn get_scx_flags_for_mode(
             &self,
             supported_sched: &str,
-            sched_mode: u32,
+            sched_mode: SchedMode,
         ) -> Result<Vec<String>>;
 
-        /// Applies the scx scheduler with arguments/mode
+        /// Get the scx flags of each mode for all given schedulers at once. Unknown schedulers are
+        /// skipped.
+        fn get_scx_flags_matrix(&self, scheds: Vec<String>) -> Vec<SchedModeFlags>;
+
+        /// Get the default scheduler of the config with its mode and args.
+        fn get_default_sched(&self) -> DefaultSched;
+
+        /// Re-reads the config from the file, e.g after it was changed by other tool.
+        fn reload_config(&self, config_path: &str) -> Result<()>;
+
+        /// Applies the scx scheduler with arguments/mode. Fails without persisting it, if
+        /// scx_loader didn't switch the scheduler.
         fn apply_scheduler_change(
-            &mut self,
+            &self,
             scx_name: &str,
-            scx_mode: u32,
-            extra_flags: &str,
+            scx_mode: SchedMode,
+            extra_args: &Vec<String>,
             config_path: &str,
         ) -> Result<()>;
 
         /// Disables auto start of scheduler, and stops current scheduler
-        fn disable_scheduler(&mut self, config_path: &str) -> Result<()>;
+        fn disable_scheduler(&self, config_path: &str) -> Result<()>;
+
+        /// Plans the apply against the state of scx_loader, the units and the config on disk.
+        /// Only the steps which change something are planned.
+        fn plan_scheduler_change(
+            &self,
+            scx_name: &str,
+            scx_mode: SchedMode,
+            extra_args: &Vec<String>,
+            persist: bool,
+            config_path: &str,
+        ) -> Result<ChangePlan>;
+
+        /// Plans the disable the same way as the apply.
+        fn plan_disable(&self, persist: bool, config_path: &str) -> Result<ChangePlan>;
+
+        /// Stops/disables 'scx.service' if it's running/enabled, otherwise it will conflict.
+        /// First stage of the apply. Returns what was done, to be undone with 'restore_scx_service'.
+        fn stop_scx_service(&self) -> ScxServiceAction;
+
+        /// Brings 'scx.service' back to the state it was in before 'stop_scx_service'.
+        fn restore_scx_service(&self, action: ScxServiceAction) -> Result<()>;
+
+        /// Switches the running scheduler via scx_loader. Second stage of the apply.
+        fn switch_scheduler(
+            &self,
+            scx_name: &str,
+            scx_mode: SchedMode,
+            extra_args: &Vec<String>,
+        ) -> Result<()>;
+
+        /// Enables scx_loader service if not enabled yet. Third stage of the apply.
+        fn enable_loader_service(&self);
+
+        /// Persists the scheduler with arguments/mode as default to the config on disk.
+        /// Last stage of the apply, which requires root permissions.
+        fn write_scheduler_config(
+            &self,
+            scx_name: &str,
+            scx_mode: SchedMode,
+            extra_args: &Vec<String>,
+            config_path: &str,
+        ) -> Result<()>;
+
+        /// Stops current scheduler. First stage of the disable.
+        fn stop_scheduler(&self) -> Result<()>;
+
+        /// Persists the config on disk without default scheduler.
+        /// Last stage of the disable, which requires root permissions.
+        fn write_disabled_config(&self, config_path: &str) -> Result<()>;
 
         /// Returns a list of the schedulers currently supported by the Scheduler Loader.
-        fn get_supported_scheds() -> Result<Vec<String>>;
+        fn get_supported_scheds(&self) -> Result<Vec<String>>;
 
         /// Returns currently running scheduler.
         fn get_current_sched(&self) -> Result<String>;
 
         /// Returns currently running scheduler mode.
-        fn get_current_mode(&self) -> Result<u8>;
+        fn get_current_mode(&self) -> Result<SchedMode>;
+
+        /// Returns supported schedulers, current scheduler and mode in one call.
+        fn get_loader_snapshot(&self) -> Result<LoaderSnapshot>;
+
+        /// Returns latency counters of the calls made to scx_loader.
+        fn get_call_stats(&self) -> Vec<LoaderCallStats>;
+
+        /// Subscribes to scheduler/mode changes of scx_loader. Returns eventfd owned by the caller,
+        /// which becomes readable on each change.
+        fn watch_loader_state(&self) -> Result<i32>;
     }
 }
 
 pub struct Config {
-    config: scx_loader::config::Config,
+    config: Mutex<scx_loader::config::Config>,
+    session: LoaderSession,
+    /// State of scx_loader.service read by the first stage of the apply, reused by the third one
+    loader_unit_state: Mutex<Option<systemd::UnitState>>,
+    /// Scheduler, mode and args of the last switch made through this config
+    last_switch: Mutex<Option<(String, u32, Vec<String>)>>,
 }
 
 fn init_config_file(config_path: &str) -> Result<Box<Config>> {
+    let session = LoaderSession::new().context("Failed to initialize scx_loader session")?;
+    // loader properties are fetched while the config is parsed
+    session.prefetch_properties();
+
     let config = init_config(config_path).context("Failed to initialize config")?;
-    Ok(Box::new(Config { config }))
+    Ok(Box::new(Config {
+        config: Mutex::new(config),
+        session,
+        loader_unit_state: Mutex::new(None),
+        last_switch: Mutex::new(None),
+    }))
 }
 
 impl Config {
-    /// Write the config to the file.
-    fn write_config_file(&self, filepath: &str) -> Result<()> {
-        let toml_content = toml::to_string(&self.config)?;
-
-        let mut file_obj = fs::File::create(filepath)?;
-        file_obj.write_all(toml_content.as_bytes())?;
+    /// Atomically replaces the config file with the serialized config.
+    ///
+    /// Goes through the privileged helper, unless the user can replace the file on its own.
+    fn write_config_file(&self, toml_content: &str, filepath: &str) -> Result<()> {
+        let path = Path::new(filepath);
+        if atomic_write::is_replaceable(path) {
+            return atomic_write::write_file_atomically(path, toml_content.as_bytes(), 0o644)
+                .with_context(|| format!("Failed to write {filepath}"));
+        }
 
-        Ok(())
+        self.session
+            .call_bus(LoaderMethod::WriteConfig, |bus| async move {
+                bus.config_helper.write_config(filepath, toml_content).await
+            })
+            .context("Config helper failed to write the config")
     }
 
     fn get_scx_flags_for_mode(
         &self,
         supported_sched: &str,
-        sched_mode: u32,
+        sched_mode: ffi::SchedMode,
     ) -> Result<Vec<String>> {
         let scx_sched = get_scx_from_str(supported_sched)?;
-        let sched_mode = convert_from_raw_mode(sched_mode)?;
-        let args = config::get_scx_flags_for_mode(&self.config, &scx_sched, sched_mode);
+        let sched_mode = to_loader_mode(sched_mode)?;
+        let config = self.config.lock().unwrap();
+        let args = config::get_scx_flags_for_mode(&config, &scx_sched, sched_mode);
         Ok(args)
     }
 
-    /// Set the default scheduler with default mode
-    fn set_scx_sched_with_mode(&mut self, scx_sched: SupportedSched, sched_mode: SchedMode) {
-        self.config.default_sched = Some(scx_sched);
-        self.config.default_mode = Some(sched_mode);
+    fn get_scx_flags_matrix(&self, scheds: Vec<String>) -> Vec<ffi::SchedModeFlags> {
+        let config = self.config.lock().unwrap();
+        flags_matrix(&config, &scheds)
     }
 
-    /// Set args for the scheduler with mode
-    fn set_scx_args(
-        &mut self,
-        scx_sched: SupportedSched,
-        sched_mode: SchedMode,
-        sched_args: Vec<String>,
-    ) {
-        let scx_name: &str = scx_sched.into();
-        let sched = self.config.scheds.entry(scx_name.into()).or_default();
-
-        let args_to_set = match sched_mode {
-            SchedMode::Gaming => &mut sched.gaming_mode,
-            SchedMode::LowLatency => &mut sched.lowlatency_mode,
-            SchedMode::PowerSave => &mut sched.powersave_mode,
-            SchedMode::Server => &mut sched.server_mode,
-            SchedMode::Auto => &mut sched.auto_mode,
-        };
-
-        *args_to_set = Some(sched_args);
+    fn get_default_sched(&self) -> ffi::DefaultSched {
+        let config = self.config.lock().unwrap();
+        default_sched_of(&config)
     }
 
-    /// Disables auto start of scheduler, and stops current scheduler
-    fn disable_scx_sched(&mut self, config_path: &str) -> Result<()> {
-        // for us to correctly disable it:
-        // 1. set `default_sched` to None
-        // 2. edit config file
-        // 3. call method to stop current scheduler
-
-        // 1.
-        self.config.default_sched = None;
-
-        // 2.
-        self.write_config_file(config_path).context("Failed to edit config file")?;
-
-        // 3.
-        let rt = Runtime::new().context("Failed to initialize tokio runtime")?;
-        rt.block_on(async move {
-            let connection = Connection::system().await?;
-            let loader_client = LoaderClientProxy::new(&connection).await?;
-            loader_client.stop_scheduler().await?;
-
-            anyhow::Ok(())
-        })?;
-
+    fn reload_config(&self, config_path: &str) -> Result<()> {
+        let config = init_config(config_path).context("Failed to reload config")?;
+        *self.config.lock().unwrap() = config;
         Ok(())
     }
 
+    /// Returns scheduler args from the extra args, and whether they match the default args of
+    /// the mode.
+    fn get_sched_args(
+        &self,
+        scx_name: &str,
+        scx_mode: ffi::SchedMode,
+        extra_args: &[String],
+    ) -> Result<(Vec<String>, bool)> {
+        let default_args = self.get_scx_flags_for_mode(scx_name, scx_mode)?;
+
+        // args are already split by the caller, quoted ones stay intact
+        let sched_args = extra_args.to_vec();
+        let is_default = sched_args == default_args;
+        Ok((sched_args, is_default))
+    }
+
     fn switch_scheduler_with_args(
         &self,
         scx_sched: SupportedSched,
         scx_args: &[String],
     ) -> Result<()> {
-        let rt = Runtime::new().context("Failed to initialize tokio runtime")?;
-        rt.block_on(async move {
-            let connection = Connection::system().await?;
-            let loader_client = LoaderClientProxy::new(&connection).await?;
-            loader_client.switch_scheduler_with_args(scx_sched, scx_args).await?;
-
-            anyhow::Ok(())
+        self.session.call(LoaderMethod::SwitchSchedulerWithArgs, |loader| {
+            let scx_sched = scx_sched.clone();
+            async move { loader.switch_scheduler_with_args(scx_sched, scx_args).await }
         })?;
 
         Ok(())
@@ -173,125 +314,288 @@ impl Config {
         scx_sched: SupportedSched,
         scx_mode: SchedMode,
     ) -> Result<()> {
-        let rt = Runtime::new().context("Failed to initialize tokio runtime")?;
-        rt.block_on(async move {
-            let connection = Connection::system().await?;
-            let loader_client = LoaderClientProxy::new(&connection).await?;
-            loader_client.switch_scheduler(scx_sched, scx_mode).await?;
-
-            anyhow::Ok(())
+        self.session.call(LoaderMethod::SwitchScheduler, |loader| {
+            let (scx_sched, scx_mode) = (scx_sched.clone(), scx_mode.clone());
+            async move { loader.switch_scheduler(scx_sched, scx_mode).await }
         })?;
 
         Ok(())
     }
 
-    fn apply_scheduler_change(
-        &mut self,
+    fn stop_scx_service(&self) -> ffi::ScxServiceAction {
+        // both units are looked up together, before anything is changed
+        let result = self.session.call_bus(LoaderMethod::ManageUnits, |bus| async move {
+            let units = [systemd::SCX_UNIT, systemd::LOADER_UNIT];
+            let mut states = systemd::unit_states(&bus.systemd, &units).await?;
+            let action = systemd::stop_scx_service(&bus.systemd, &states[0]).await?;
+            Ok((action, states.swap_remove(1)))
+        });
+
+        match result {
+            Ok((action, loader_state)) => {
+                *self.loader_unit_state.lock().unwrap() = Some(loader_state);
+                match action {
+                    systemd::ScxServiceAction::Disabled => {
+                        eprintln!("Disabled scx service");
+                        ffi::ScxServiceAction::Disabled
+                    },
+                    systemd::ScxServiceAction::Stopped => {
+                        eprintln!("Stopped scx service");
+                        ffi::ScxServiceAction::Stopped
+                    },
+                    systemd::ScxServiceAction::None => ffi::ScxServiceAction::None,
+                }
+            },
+            Err(err) => {
+                eprintln!("Failed to stop scx service: {err:#}");
+                ffi::ScxServiceAction::None
+            },
+        }
+    }
+
+    fn restore_scx_service(&self, action: ffi::ScxServiceAction) -> Result<()> {
+        let action = match action {
+            ffi::ScxServiceAction::Disabled => systemd::ScxServiceAction::Disabled,
+            ffi::ScxServiceAction::Stopped => systemd::ScxServiceAction::Stopped,
+            _ => return Ok(()),
+        };
+        self.session
+            .call_bus(LoaderMethod::ManageUnits, |bus| async move {
+                systemd::restore_scx_service(&bus.systemd, action).await
+            })
+            .context("Failed to restore scx service")
+    }
+
+    fn switch_scheduler(
+        &self,
         scx_name: &str,
-        scx_mode: u32,
-        extra_flags: &str,
-        config_path: &str,
+        scx_mode: ffi::SchedMode,
+        extra_args: &Vec<String>,
     ) -> Result<()> {
-        // stop/disable 'scx.service' if its running/enabled on the system,
-        // otherwise it will conflict
-        disable_scx_service();
-
-        let default_args = self.get_scx_flags_for_mode(&scx_name, scx_mode)?;
+        let (sched_args, is_default) = self.get_sched_args(scx_name, scx_mode, extra_args)?;
         let scx_sched = get_scx_from_str(scx_name)?;
-        let scx_mode = convert_from_raw_mode(scx_mode)?;
-
-        let mut sched_args: Vec<String> = vec![];
-        if !extra_flags.is_empty() {
-            // NOTE: should be Vec instead of str
-            let mut extra_args: Vec<_> = extra_flags.split(' ').map(String::from).collect();
-            sched_args.append(&mut extra_args);
-        }
-
-        if sched_args == default_args {
-            println!("Applying scx '{scx_name}' with mode {scx_mode:?}");
-            if let Err(scx_err) =
-                self.switch_scheduler_with_mode(scx_sched.clone(), scx_mode.clone())
-            {
-                println!("Failed to switch '{scx_name}' with mode {scx_mode:?}: {scx_err}");
-            }
+        let loader_mode = to_loader_mode(scx_mode)?;
+
+        // scx_loader doesn't report the args of the running scheduler, the planner needs them
+        self.last_switch.lock().unwrap().take();
+        if is_default {
+            eprintln!("Applying scx '{scx_name}' with mode {loader_mode:?}");
+            self.switch_scheduler_with_mode(scx_sched, loader_mode.clone()).with_context(|| {
+                format!("Failed to switch '{scx_name}' with mode {loader_mode:?}")
+            })?;
         } else {
-            println!("Applying scx '{scx_name}' with args: {}", sched_args.join(" ").to_owned());
-            if let Err(scx_err) = self.switch_scheduler_with_args(scx_sched.clone(), &sched_args) {
-                println!("Failed to switch '{scx_name}' with args: {sched_args:?}: {scx_err}");
-            }
+            eprintln!("Applying scx '{scx_name}' with args: {}", sched_args.join(" "));
+            self.switch_scheduler_with_args(scx_sched, &sched_args).with_context(|| {
+                format!("Failed to switch '{scx_name}' with args: {sched_args:?}")
+            })?;
         }
+        *self.last_switch.lock().unwrap() =
+            Some((scx_name.to_owned(), loader_mode as u32, sched_args));
+        Ok(())
+    }
+
+    fn enable_loader_service(&self) {
+        let loader_state = self.loader_unit_state.lock().unwrap().take();
 
         // enable scx_loader service if not enabled yet, it fully replaces scx.service
-        if !is_scx_loader_service_enabled() {
-            println!("Enabling scx_loader service");
-            spawn_child_process("/usr/bin/systemctl", &["enable", "-f", "scx_loader"]);
+        let result = self.session.call_bus(LoaderMethod::ManageUnits, |bus| {
+            let loader_state = loader_state.clone();
+            async move {
+                let loader_state = match loader_state {
+                    Some(loader_state) => loader_state,
+                    None => {
+                        systemd::unit_states(&bus.systemd, &[systemd::LOADER_UNIT]).await?.remove(0)
+                    },
+                };
+                if loader_state.is_enabled() {
+                    return Ok(false);
+                }
+                systemd::enable_unit(&bus.systemd, systemd::LOADER_UNIT).await?;
+                Ok(true)
+            }
+        });
+
+        match result {
+            Ok(true) => eprintln!("Enabled scx_loader service"),
+            Ok(false) => {},
+            Err(err) => eprintln!("Failed to enable scx_loader service: {err:#}"),
         }
+    }
+
+    fn write_scheduler_config(
+        &self,
+        scx_name: &str,
+        scx_mode: ffi::SchedMode,
+        extra_args: &Vec<String>,
+        config_path: &str,
+    ) -> Result<()> {
+        let scx_sched = get_scx_from_str(scx_name)?;
+        let scx_mode = to_loader_mode(scx_mode)?;
+
+        // the change is made to the config on disk, the same one the plan was made against
+        let mut config = init_config(config_path).context("Failed to read config")?;
+        let mode_args = config::get_scx_flags_for_mode(&config, &scx_sched, scx_mode.clone());
 
         // change default scheduler and default scheduler mode
-        self.set_scx_sched_with_mode(scx_sched.clone(), scx_mode.clone());
+        set_scx_sched_with_mode(&mut config, scx_sched.clone(), scx_mode.clone());
 
         // change args for the scheduler with mode
         // only if sched is not default for the mode
-        if sched_args != default_args {
-            self.set_scx_args(scx_sched, scx_mode, sched_args);
+        if *extra_args != mode_args {
+            set_scx_args(&mut config, scx_sched, scx_mode, extra_args.clone());
         }
 
-        // write scx_loader configuration to the temp file
-        let tmp_config_path = "/tmp/scx_loader.toml";
-        self.write_config_file(tmp_config_path)
+        self.write_config_file(&toml::to_string(&config)?, config_path)
             .context("Cannot write scx_loader config to file")?;
+        *self.config.lock().unwrap() = config;
+        Ok(())
+    }
+
+    fn apply_scheduler_change(
+        &self,
+        scx_name: &str,
+        scx_mode: ffi::SchedMode,
+        extra_args: &Vec<String>,
+        config_path: &str,
+    ) -> Result<()> {
+        self.stop_scx_service();
 
-        // copy scx_loader configuration from the temp file to the actual path with root permissions
-        spawn_child_process("/usr/bin/pkexec", &["/usr/bin/cp", tmp_config_path, config_path]);
+        // the scheduler which didn't start isn't persisted either, same as in the CLI
+        self.switch_scheduler(scx_name, scx_mode, extra_args)?;
 
-        Ok(())
+        self.enable_loader_service();
+        self.write_scheduler_config(scx_name, scx_mode, extra_args, config_path)
     }
 
-    fn disable_scheduler(&mut self, config_path: &str) -> Result<()> {
-        // write scx_loader configuration to the temp file
-        let tmp_config_path = "/tmp/scx_loader.toml";
-        self.disable_scx_sched(tmp_config_path).context("Cannot disable scx_loader")?;
+    fn stop_scheduler(&self) -> Result<()> {
+        self.last_switch.lock().unwrap().take();
+        self.session.call(LoaderMethod::StopScheduler, |loader| async move {
+            loader.stop_scheduler().await
+        })
+    }
 
-        // copy scx_loader configuration from the temp file to the actual path with root permissions
-        spawn_child_process("/usr/bin/pkexec", &["/usr/bin/cp", tmp_config_path, config_path]);
+    fn write_disabled_config(&self, config_path: &str) -> Result<()> {
+        let mut config = init_config(config_path).context("Failed to read config")?;
+        // setting `default_sched` to None disables auto start of scheduler
+        config.default_sched = None;
 
+        self.write_config_file(&toml::to_string(&config)?, config_path)
+            .context("Failed to edit config file")?;
+        *self.config.lock().unwrap() = config;
         Ok(())
     }
 
+    /// Reads the state the change is planned against. The parts which cannot be read are
+    /// left unknown, so that the plan falls back to running their steps.
+    fn plan_state(&self, with_units: bool) -> PlanState {
+        let loader = match self.session.properties() {
+            Ok(properties) => Some(properties),
+            Err(err) => {
+                eprintln!("Failed to read scx_loader state: {err:#}");
+                None
+            },
+        };
+        // known only if the scheduler wasn't switched by someone else since
+        let running_args = match (&loader, &*self.last_switch.lock().unwrap()) {
+            (Some(loader), Some((scx_name, sched_mode, args)))
+                if loader.current_sched == *scx_name && loader.current_mode == *sched_mode =>
+            {
+                Some(args.clone())
+            },
+            _ => None,
+        };
+        if !with_units {
+            return PlanState { loader, running_args, units: None };
+        }
+
+        let units = self.session.call_bus(LoaderMethod::ManageUnits, |bus| async move {
+            let units = [systemd::SCX_UNIT, systemd::LOADER_UNIT];
+            let mut states = systemd::unit_states(&bus.systemd, &units).await?;
+            let loader_state = states.swap_remove(1);
+            Ok((states.swap_remove(0), loader_state))
+        });
+        match units {
+            Ok(units) => PlanState { loader, running_args, units: Some(units) },
+            Err(err) => {
+                eprintln!("Failed to read unit states: {err:#}");
+                PlanState { loader, running_args, units: None }
+            },
+        }
+    }
+
+    fn plan_scheduler_change(
+        &self,
+        scx_name: &str,
+        scx_mode: ffi::SchedMode,
+        extra_args: &Vec<String>,
+        persist: bool,
+        config_path: &str,
+    ) -> Result<ffi::ChangePlan> {
+        let request = PlanRequest {
+            scx_name,
+            scx_sched: get_scx_from_str(scx_name)?,
+            sched_mode: to_loader_mode(scx_mode)?,
+            extra_args,
+            persist,
+        };
+        // a copy, the dry run doesn't change the config in use
+        let config = init_config(config_path).context("Failed to read config")?;
+        plan::plan_apply(&self.plan_state(true), &config, &request)
+    }
+
+    fn plan_disable(&self, persist: bool, config_path: &str) -> Result<ffi::ChangePlan> {
+        let config = init_config(config_path).context("Failed to read config")?;
+        Ok(plan::plan_disable(&self.plan_state(false), &config, persist))
+    }
+
+    fn disable_scheduler(&self, config_path: &str) -> Result<()> {
+        self.stop_scheduler().context("Cannot disable scx_loader")?;
+        self.write_disabled_config(config_path)
+    }
+
     fn get_current_sched(&self) -> Result<String> {
-        let rt = Runtime::new().context("Failed to initialize tokio runtime")?;
-        let current_sched = rt.block_on(async move {
-            let connection = Connection::system().await?;
-            let loader_client = LoaderClientProxy::new(&connection).await?;
-            let current_sched = loader_client.current_scheduler().await?;
+        self.session.call(LoaderMethod::CurrentScheduler, |loader| async move {
+            loader.current_scheduler().await
+        })
+    }
 
-            anyhow::Ok(current_sched)
+    fn get_current_mode(&self) -> Result<ffi::SchedMode> {
+        let current_mode = self.session.call(LoaderMethod::SchedulerMode, |loader| async move {
+            loader.scheduler_mode().await
         })?;
 
-        Ok(current_sched)
+        Ok(from_loader_mode(current_mode))
     }
 
-    fn get_current_mode(&self) -> Result<u8> {
-        let rt = Runtime::new().context("Failed to initialize tokio runtime")?;
-        let current_mode = rt.block_on(async move {
-            let connection = Connection::system().await?;
-            let loader_client = LoaderClientProxy::new(&connection).await?;
-            let current_mode = loader_client.scheduler_mode().await?;
+    fn get_supported_scheds(&self) -> Result<Vec<String>> {
+        self.session.call(LoaderMethod::SupportedSchedulers, |loader| async move {
+            loader.supported_schedulers().await
+        })
+    }
 
-            anyhow::Ok(current_mode as u8)
-        })?;
+    fn get_loader_snapshot(&self) -> Result<ffi::LoaderSnapshot> {
+        snapshot_from_properties(self.session.properties()?)
+    }
 
-        Ok(current_mode)
+    fn watch_loader_state(&self) -> Result<i32> {
+        let notify_fd = self.session.watch_properties()?;
+        Ok(notify_fd.into_raw_fd())
     }
-}
 
-pub fn get_supported_scheds() -> Result<Vec<String>> {
-    let rt = Runtime::new().context("Failed to initialize tokio runtime")?;
-    return rt.block_on(async move {
-        let connection = Connection::system().await?;
-        let loader_client = LoaderClientProxy::new(&connection).await?;
-        anyhow::Ok(loader_client.supported_schedulers().await?)
-    });
+    fn get_call_stats(&self) -> Vec<ffi::LoaderCallStats> {
+        self.session
+            .counters()
+            .into_iter()
+            .map(|(method, counter)| ffi::LoaderCallStats {
+                method: method.name().into(),
+                calls: counter.calls,
+                failures: counter.failures,
+                reconnects: counter.reconnects,
+                total_ns: counter.total_ns,
+                max_ns: counter.max_ns,
+            })
+            .collect()
+    }
 }
 
 /// Initialize config from first found config path, otherwise fallback to default config
@@ -303,48 +607,407 @@ pub fn init_config(config_path: &str) -> Result<scx_loader::config::Config> {
     }
 }
 
+/// Computes flags of every mode for the schedulers
+fn flags_matrix(
+    config: &scx_loader::config::Config,
+    scheds: &[String],
+) -> Vec<ffi::SchedModeFlags> {
+    const ALL_MODES: [SchedMode; 5] = [
+        SchedMode::Auto,
+        SchedMode::Gaming,
+        SchedMode::PowerSave,
+        SchedMode::LowLatency,
+        SchedMode::Server,
+    ];
+
+    let mut matrix = Vec::with_capacity(scheds.len() * ALL_MODES.len());
+    for sched in scheds {
+        let Ok(scx_sched) = get_scx_from_str(sched) else {
+            continue;
+        };
+        for sched_mode in ALL_MODES {
+            matrix.push(ffi::SchedModeFlags {
+                sched: sched.clone(),
+                mode: from_loader_mode(sched_mode.clone()),
+                flags: config::get_scx_flags_for_mode(config, &scx_sched, sched_mode),
+            });
+        }
+    }
+    matrix
+}
+
+/// Reads the default scheduler with the args of its default mode
+fn default_sched_of(config: &scx_loader::config::Config) -> ffi::DefaultSched {
+    let Some(scx_sched) = config.default_sched.clone() else {
+        return ffi::DefaultSched {
+            sched: String::new(),
+            mode: ffi::SchedMode::Auto,
+            args: vec![],
+        };
+    };
+    let sched_mode = config.default_mode.clone().unwrap_or(SchedMode::Auto);
+    let args = config::get_scx_flags_for_mode(config, &scx_sched, sched_mode.clone());
+    let scx_name: &str = scx_sched.into();
+    ffi::DefaultSched { sched: scx_name.to_owned(), mode: from_loader_mode(sched_mode), args }
+}
+
 /// Get the scx trait from the given scx name or return error if the given scx name is not supported
 fn get_scx_from_str(scx_name: &str) -> Result<SupportedSched> {
     scx_name.parse()
 }
 
-fn convert_from_raw_mode(raw_mode: u32) -> Result<SchedMode> {
-    match raw_mode {
-        0 => Ok(SchedMode::Auto),
-        1 => Ok(SchedMode::Gaming),
-        2 => Ok(SchedMode::PowerSave),
-        3 => Ok(SchedMode::LowLatency),
-        4 => Ok(SchedMode::Server),
-        _ => anyhow::bail!("SchedMode with such value doesn't exist"),
-    }
+/// Set the default scheduler with default mode
+fn set_scx_sched_with_mode(
+    config: &mut scx_loader::config::Config,
+    scx_sched: SupportedSched,
+    sched_mode: SchedMode,
+) {
+    config.default_sched = Some(scx_sched);
+    config.default_mode = Some(sched_mode);
 }
 
-fn spawn_child_process(cmd: &str, args: &[&str]) {
-    let status = Command::new(cmd).args(args).status().expect("failed to execute child process");
+/// Set args for the scheduler with mode
+fn set_scx_args(
+    config: &mut scx_loader::config::Config,
+    scx_sched: SupportedSched,
+    sched_mode: SchedMode,
+    sched_args: Vec<String>,
+) {
+    let scx_name: &str = scx_sched.into();
+    let sched = config.scheds.entry(scx_name.into()).or_default();
+
+    let args_to_set = match sched_mode {
+        SchedMode::Gaming => &mut sched.gaming_mode,
+        SchedMode::LowLatency => &mut sched.lowlatency_mode,
+        SchedMode::PowerSave => &mut sched.powersave_mode,
+        SchedMode::Server => &mut sched.server_mode,
+        SchedMode::Auto => &mut sched.auto_mode,
+    };
+
+    *args_to_set = Some(sched_args);
+}
 
-    if !status.success() {
-        println!("child process failed with exit code: {status:?}");
+fn to_loader_mode(sched_mode: ffi::SchedMode) -> Result<SchedMode> {
+    match sched_mode {
+        ffi::SchedMode::Auto => Ok(SchedMode::Auto),
+        ffi::SchedMode::Gaming => Ok(SchedMode::Gaming),
+        ffi::SchedMode::PowerSave => Ok(SchedMode::PowerSave),
+        ffi::SchedMode::LowLatency => Ok(SchedMode::LowLatency),
+        ffi::SchedMode::Server => Ok(SchedMode::Server),
+        _ => anyhow::bail!("SchedMode with such value doesn't exist"),
     }
 }
 
-fn is_scx_loader_service_enabled() -> bool {
-    return utils::exec("systemctl is-enabled scx_loader") == "enabled";
+fn from_loader_mode(sched_mode: SchedMode) -> ffi::SchedMode {
+    match sched_mode {
+        SchedMode::Auto => ffi::SchedMode::Auto,
+        SchedMode::Gaming => ffi::SchedMode::Gaming,
+        SchedMode::PowerSave => ffi::SchedMode::PowerSave,
+        SchedMode::LowLatency => ffi::SchedMode::LowLatency,
+        SchedMode::Server => ffi::SchedMode::Server,
+    }
 }
 
-fn is_scx_service_enabled() -> bool {
-    return utils::exec("systemctl is-enabled scx") == "enabled";
+/// Moves fetched properties into the snapshot, strings are handed over as is.
+fn snapshot_from_properties(properties: LoaderProperties) -> Result<ffi::LoaderSnapshot> {
+    Ok(ffi::LoaderSnapshot {
+        supported_scheds: properties.supported_scheds,
+        current_sched: properties.current_sched,
+        current_mode: raw_to_sched_mode(properties.current_mode)?,
+    })
 }
 
-fn is_scx_service_active() -> bool {
-    return utils::exec("systemctl is-active scx") == "active";
+/// Converts the raw mode reported over D-Bus.
+fn raw_to_sched_mode(raw_mode: u32) -> Result<ffi::SchedMode> {
+    let sched_mode = ffi::SchedMode { repr: u8::try_from(raw_mode)? };
+    // rejects values, which don't name any mode
+    to_loader_mode(sched_mode)?;
+    Ok(sched_mode)
 }
 
-fn disable_scx_service() {
-    if is_scx_service_enabled() {
-        spawn_child_process("/usr/bin/systemctl", &["disable", "--now", "-f", "scx"]);
-        println!("Disabling scx service");
-    } else if is_scx_service_active() {
-        spawn_child_process("/usr/bin/systemctl", &["stop", "-f", "scx"]);
-        println!("Stopping scx service");
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    use crate::mock;
+
+    use std::alloc::{GlobalAlloc, Layout, System};
+    use std::cell::Cell;
+
+    /// Counts allocations made by the current thread, so tests running in parallel don't
+    /// interfere.
+    struct CountingAllocator;
+
+    thread_local! {
+        static ALLOCATIONS: Cell<usize> = const { Cell::new(0) };
+    }
+
+    fn note_allocation() {
+        // TLS may already be gone while the thread exits
+        let _ = ALLOCATIONS.try_with(|count| count.set(count.get() + 1));
+    }
+
+    unsafe impl GlobalAlloc for CountingAllocator {
+        unsafe fn alloc(&self, layout: Layout) -> *mut u8 {
+            note_allocation();
+            unsafe { System.alloc(layout) }
+        }
+
+        unsafe fn dealloc(&self, ptr: *mut u8, layout: Layout) {
+            unsafe { System.dealloc(ptr, layout) }
+        }
+
+        unsafe fn realloc(&self, ptr: *mut u8, layout: Layout, new_size: usize) -> *mut u8 {
+            note_allocation();
+            unsafe { System.realloc(ptr, layout, new_size) }
+        }
+    }
+
+    #[global_allocator]
+    static ALLOCATOR: CountingAllocator = CountingAllocator;
+
+    fn count_allocations<T>(f: impl FnOnce() -> T) -> (T, usize) {
+        let before = ALLOCATIONS.with(Cell::get);
+        let result = f();
+        (result, ALLOCATIONS.with(Cell::get) - before)
+    }
+
+    /// Fewest allocations of the call over a few runs. Waiting for a reply which isn't there
+    /// yet allocates too, such runs are not counted.
+    fn min_allocations<T>(mut f: impl FnMut() -> T) -> usize {
+        (0..8).map(|_| count_allocations(&mut f).1).min().unwrap()
+    }
+
+    /// Config with the default flags, talking to the loader mock instead of scx_loader.
+    struct MockConfig {
+        // dropped before the config, while the session runtime still drives it
+        _server: zbus::Connection,
+        config: Config,
+    }
+
+    impl MockConfig {
+        fn new() -> Self {
+            let (session, server) =
+                LoaderSession::with_mock_loader(mock::LoaderFaults::default()).unwrap();
+            let config = Config {
+                config: Mutex::new(scx_loader::config::get_default_config()),
+                session,
+                loader_unit_state: Mutex::new(None),
+                last_switch: Mutex::new(None),
+            };
+            Self { _server: server, config }
+        }
+    }
+
+    // The replies are deserialized by zbus with one allocation per string, the queries over D-Bus
+    // must hand them over as is.
+
+    #[test]
+    fn test_get_supported_scheds_allocations() {
+        let mock = MockConfig::new();
+        let config = &mock.config;
+
+        let scheds = config.get_supported_scheds().unwrap();
+        assert_eq!(scheds, ["scx_bpfland", "scx_lavd"]);
+
+        let reply = min_allocations(|| {
+            config
+                .session
+                .call(LoaderMethod::SupportedSchedulers, |loader| async move {
+                    loader.supported_schedulers().await
+                })
+                .unwrap()
+        });
+        let query = min_allocations(|| config.get_supported_scheds().unwrap());
+        assert!(query <= reply, "{query} allocations, the reply alone needs {reply}");
+    }
+
+    #[test]
+    fn test_get_current_sched_and_mode_allocations() {
+        let mock = MockConfig::new();
+        let config = &mock.config;
+        // flags of the mode, so that the scheduler is switched with the mode
+        let flags = config.get_scx_flags_for_mode("scx_lavd", ffi::SchedMode::Gaming).unwrap();
+        config.switch_scheduler("scx_lavd", ffi::SchedMode::Gaming, &flags).unwrap();
+
+        assert_eq!(config.get_current_sched().unwrap(), "scx_lavd");
+        let reply = min_allocations(|| {
+            config
+                .session
+                .call(LoaderMethod::CurrentScheduler, |loader| async move {
+                    loader.current_scheduler().await
+                })
+                .unwrap()
+        });
+        let query = min_allocations(|| config.get_current_sched().unwrap());
+        assert!(query <= reply, "{query} allocations, the reply alone needs {reply}");
+
+        assert!(config.get_current_mode().unwrap() == ffi::SchedMode::Gaming);
+        let reply = min_allocations(|| {
+            config
+                .session
+                .call(
+                    LoaderMethod::SchedulerMode,
+                    |loader| async move { loader.scheduler_mode().await },
+                )
+                .unwrap()
+        });
+        let query = min_allocations(|| config.get_current_mode().unwrap());
+        assert!(query <= reply, "{query} allocations, the reply alone needs {reply}");
+    }
+
+    #[test]
+    fn test_get_loader_snapshot_allocations() {
+        let mock = MockConfig::new();
+        let config = &mock.config;
+
+        let snapshot = config.get_loader_snapshot().unwrap();
+        assert_eq!(snapshot.supported_scheds, ["scx_bpfland", "scx_lavd"]);
+        assert_eq!(snapshot.current_sched, "unknown");
+
+        let reply = min_allocations(|| config.session.properties().unwrap());
+        let query = min_allocations(|| config.get_loader_snapshot().unwrap());
+        assert!(query <= reply, "{query} allocations, the reply alone needs {reply}");
+    }
+
+    // Flags are read from the config, each returned string is allocated once, plus the vector
+    // holding them.
+
+    #[test]
+    fn test_get_scx_flags_for_mode_allocations() {
+        let mock = MockConfig::new();
+        let config = &mock.config;
+
+        for sched_mode in [ffi::SchedMode::Auto, ffi::SchedMode::Gaming, ffi::SchedMode::LowLatency]
+        {
+            let (flags, allocations) = count_allocations(|| {
+                config.get_scx_flags_for_mode("scx_lavd", sched_mode).unwrap()
+            });
+            assert!(
+                allocations <= flags.len() + 1,
+                "{allocations} allocations for {} flags",
+                flags.len()
+            );
+        }
+    }
+
+    #[test]
+    fn test_get_scx_flags_matrix_allocations() {
+        let mock = MockConfig::new();
+        let config = &mock.config;
+        let scheds = vec!["scx_bpfland".to_owned(), "scx_lavd".to_owned()];
+
+        let (matrix, allocations) = count_allocations(|| config.get_scx_flags_matrix(scheds));
+        assert_eq!(matrix.len(), 10);
+        // the sched name and the flags of each entry, plus the flags vectors and the matrix
+        let strings: usize = matrix.iter().map(|entry| 1 + entry.flags.len()).sum();
+        assert!(
+            allocations <= strings + matrix.len() + 1,
+            "{allocations} allocations for {strings} strings"
+        );
+    }
+
+    #[test]
+    fn test_get_default_sched_allocations() {
+        let mock = MockConfig::new();
+        let config = &mock.config;
+        let scx_sched = get_scx_from_str("scx_lavd").unwrap();
+        set_scx_sched_with_mode(&mut config.config.lock().unwrap(), scx_sched, SchedMode::Gaming);
+
+        let (default_sched, allocations) = count_allocations(|| config.get_default_sched());
+        assert_eq!(default_sched.sched, "scx_lavd");
+        let strings = 1 + default_sched.args.len();
+        assert!(allocations <= strings + 1, "{allocations} allocations for {strings} strings");
+    }
+
+    #[test]
+    fn test_snapshot_from_properties_does_not_allocate() {
+        let properties = LoaderProperties {
+            supported_scheds: vec!["scx_bpfland".to_owned(), "scx_lavd".to_owned()],
+            current_sched: "scx_lavd".to_owned(),
+            current_mode: 3,
+        };
+
+        let (snapshot, allocations) = count_allocations(|| snapshot_from_properties(properties));
+        let snapshot = snapshot.unwrap();
+        assert_eq!(allocations, 0);
+        assert_eq!(snapshot.supported_scheds, ["scx_bpfland", "scx_lavd"]);
+        assert_eq!(snapshot.current_sched, "scx_lavd");
+        assert!(snapshot.current_mode == ffi::SchedMode::LowLatency);
+    }
+
+    #[test]
+    fn test_raw_to_sched_mode() {
+        assert!(raw_to_sched_mode(0).unwrap() == ffi::SchedMode::Auto);
+        assert!(raw_to_sched_mode(4).unwrap() == ffi::SchedMode::Server);
+        assert!(raw_to_sched_mode(5).is_err());
+        assert!(raw_to_sched_mode(256).is_err());
+    }
+
+    #[test]
+    fn test_flags_matrix_matches_single_lookup() {
+        let config = scx_loader::config::get_default_config();
+        let scheds = vec!["scx_lavd".to_owned(), "scx_not_existing".to_owned()];
+
+        let matrix = flags_matrix(&config, &scheds);
+        assert_eq!(matrix.len(), 5);
+        for entry in &matrix {
+            assert_eq!(entry.sched, "scx_lavd");
+            let sched_mode = to_loader_mode(entry.mode).unwrap();
+            let scx_sched = get_scx_from_str(&entry.sched).unwrap();
+            assert_eq!(
+                entry.flags,
+                config::get_scx_flags_for_mode(&config, &scx_sched, sched_mode)
+            );
+        }
+    }
+
+    #[test]
+    fn test_write_after_plan_keeps_config_on_disk() {
+        let dir = std::env::temp_dir().join(format!("scx-rustlib-plan-{}", std::process::id()));
+        let _ = std::fs::remove_dir_all(&dir);
+        std::fs::create_dir_all(&dir).unwrap();
+        let path = dir.join("scx_loader.toml");
+        let config_path = path.to_str().unwrap();
+
+        let mock = MockConfig::new();
+        let config = &mock.config;
+
+        // changed on disk after the config was parsed
+        let mut on_disk = scx_loader::config::get_default_config();
+        let scx_sched = get_scx_from_str("scx_bpfland").unwrap();
+        set_scx_sched_with_mode(&mut on_disk, scx_sched.clone(), SchedMode::Gaming);
+        set_scx_args(&mut on_disk, scx_sched.clone(), SchedMode::Gaming, vec!["-k".into()]);
+        std::fs::write(&path, toml::to_string(&on_disk).unwrap()).unwrap();
+
+        let default_sched = config.get_default_sched().sched;
+        let plan = config.plan_disable(true, config_path).unwrap();
+        assert!(plan.write_config);
+        // the dry run leaves the config in use as it is
+        assert_eq!(config.get_default_sched().sched, default_sched);
+        config.write_disabled_config(config_path).unwrap();
+
+        let written = init_config(config_path).unwrap();
+        assert!(written.default_sched.is_none());
+        assert_eq!(config::get_scx_flags_for_mode(&written, &scx_sched, SchedMode::Gaming), ["-k"]);
+
+        std::fs::remove_dir_all(&dir).unwrap();
+    }
+
+    #[test]
+    fn test_default_sched_of() {
+        let mut config = scx_loader::config::get_default_config();
+        config.default_sched = None;
+        assert!(default_sched_of(&config).sched.is_empty());
+
+        let scx_sched = get_scx_from_str("scx_lavd").unwrap();
+        set_scx_sched_with_mode(&mut config, scx_sched.clone(), SchedMode::PowerSave);
+        let default_sched = default_sched_of(&config);
+        assert_eq!(default_sched.sched, "scx_lavd");
+        assert!(default_sched.mode == ffi::SchedMode::PowerSave);
+        assert_eq!(
+            default_sched.args,
+            config::get_scx_flags_for_mode(&config, &scx_sched, SchedMode::PowerSave)
+        );
     }
 }
@@ -0,0 +1,339 @@
+// SPDX-License-Identifier: GPL-2.0
+//
+// Copyright (c) 2024-2025 Vladislav Nepogodin <vnepogodin@cachyos.org>
+
+// This software may be used and distributed according to the terms of the
+// GNU General Public License version 2.
+
+//! Stand-ins of scx_loader and the systemd manager, served on a private bus.
+//!
+//! Used by the tests and by `scx-mock-loader`, which the benchmarks run on a private
+//! dbus-daemon instead of the system bus.
+
+use std::collections::HashMap;
+use std::sync::atomic::{AtomicU64, Ordering};
+use std::sync::{Arc, Mutex};
+use std::time::Duration;
+
+use zbus::object_server::SignalEmitter;
+use zbus::zvariant::{ObjectPath, OwnedObjectPath};
+use zbus::{fdo, Connection};
+
+pub const LOADER_SERVICE: &str = "org.scx.Loader";
+pub const LOADER_PATH: &str = "/org/scx/Loader";
+pub const SYSTEMD_SERVICE: &str = "org.freedesktop.systemd1";
+pub const MANAGER_PATH: &str = "/org/freedesktop/systemd1";
+
+/// Highest mode known to scx_loader, server.
+const MAX_SCHED_MODE: u32 = 4;
+
+#[derive(Default)]
+pub struct MockState {
+    /// unit -> (unit file state, active state)
+    pub units: HashMap<String, (String, String)>,
+    pub calls: Vec<String>,
+}
+
+pub type SharedState = Arc<Mutex<MockState>>;
+
+/// Creates the state of the mocked systemd from (unit, unit file state, active state).
+pub fn shared_state(units: &[(&str, &str, &str)]) -> SharedState {
+    let units = units
+        .iter()
+        .map(|(unit, file_state, active_state)| {
+            (unit.to_string(), (file_state.to_string(), active_state.to_string()))
+        })
+        .collect();
+    Arc::new(Mutex::new(MockState { units, calls: vec![] }))
+}
+
+pub fn unit_path(unit: &str) -> String {
+    format!("{MANAGER_PATH}/unit/{}", unit.replace('.', "_2e"))
+}
+
+pub struct MockManager {
+    pub state: SharedState,
+}
+
+#[zbus::interface(name = "org.freedesktop.systemd1.Manager")]
+impl MockManager {
+    fn get_unit_file_state(&self, file: &str) -> fdo::Result<String> {
+        let state = self.state.lock().unwrap();
+        let (unit_file_state, _) = state
+            .units
+            .get(file)
+            .ok_or_else(|| fdo::Error::FileNotFound(format!("No such file: {file}")))?;
+        Ok(unit_file_state.clone())
+    }
+
+    fn load_unit(&self, name: &str) -> OwnedObjectPath {
+        OwnedObjectPath::try_from(unit_path(name)).unwrap()
+    }
+
+    async fn start_unit(
+        &self,
+        #[zbus(signal_emitter)] emitter: SignalEmitter<'_>,
+        name: &str,
+        _mode: &str,
+    ) -> fdo::Result<OwnedObjectPath> {
+        {
+            let mut state = self.state.lock().unwrap();
+            state.calls.push(format!("StartUnit {name}"));
+            if let Some((_, active_state)) = state.units.get_mut(name) {
+                *active_state = "active".to_owned();
+            }
+        }
+        let job = OwnedObjectPath::try_from(format!("{MANAGER_PATH}/job/1")).unwrap();
+        Self::job_removed(&emitter, 1, job.as_ref(), name, "done").await?;
+        Ok(job)
+    }
+
+    async fn stop_unit(
+        &self,
+        #[zbus(signal_emitter)] emitter: SignalEmitter<'_>,
+        name: &str,
+        _mode: &str,
+    ) -> fdo::Result<OwnedObjectPath> {
+        {
+            let mut state = self.state.lock().unwrap();
+            state.calls.push(format!("StopUnit {name}"));
+            if let Some((_, active_state)) = state.units.get_mut(name) {
+                *active_state = "inactive".to_owned();
+            }
+        }
+        let job = OwnedObjectPath::try_from(format!("{MANAGER_PATH}/job/1")).unwrap();
+        // emitted before the reply, as systemd may do for fast jobs
+        Self::job_removed(&emitter, 1, job.as_ref(), name, "done").await?;
+        Ok(job)
+    }
+
+    fn enable_unit_files(
+        &self,
+        files: Vec<String>,
+        _runtime: bool,
+        force: bool,
+    ) -> (bool, Vec<(String, String, String)>) {
+        let mut state = self.state.lock().unwrap();
+        for file in &files {
+            state.calls.push(format!("EnableUnitFiles {file} force={force}"));
+            if let Some((unit_file_state, _)) = state.units.get_mut(file) {
+                *unit_file_state = "enabled".to_owned();
+            }
+        }
+        (true, vec![])
+    }
+
+    fn disable_unit_files(
+        &self,
+        files: Vec<String>,
+        _runtime: bool,
+    ) -> Vec<(String, String, String)> {
+        let mut state = self.state.lock().unwrap();
+        for file in &files {
+            state.calls.push(format!("DisableUnitFiles {file}"));
+            if let Some((unit_file_state, _)) = state.units.get_mut(file) {
+                *unit_file_state = "disabled".to_owned();
+            }
+        }
+        vec![]
+    }
+
+    fn reload(&self) {
+        self.state.lock().unwrap().calls.push("Reload".to_owned());
+    }
+
+    fn subscribe(&self) {}
+
+    #[zbus(signal)]
+    async fn job_removed(
+        emitter: &SignalEmitter<'_>,
+        id: u32,
+        job: ObjectPath<'_>,
+        unit: &str,
+        result: &str,
+    ) -> zbus::Result<()>;
+}
+
+pub struct MockUnit {
+    pub unit: String,
+    pub state: SharedState,
+}
+
+#[zbus::interface(name = "org.freedesktop.systemd1.Unit")]
+impl MockUnit {
+    #[zbus(property)]
+    fn active_state(&self) -> String {
+        let state = self.state.lock().unwrap();
+        state.units.get(&self.unit).map_or_else(|| "inactive".to_owned(), |unit| unit.1.clone())
+    }
+}
+
+/// Faults injected into each call of the mocked loader.
+#[derive(Debug, Default, Clone, Copy)]
+pub struct LoaderFaults {
+    /// Delay before each reply
+    pub latency: Duration,
+    /// Every Nth call fails, 0 disables the failures
+    pub fail_every: u64,
+}
+
+/// Stand-in of scx_loader, switches schedulers only in its own state.
+pub struct MockLoader {
+    supported_scheds: Vec<String>,
+    current_sched: Mutex<String>,
+    current_mode: Mutex<u32>,
+    faults: LoaderFaults,
+    calls: AtomicU64,
+}
+
+impl MockLoader {
+    pub fn new(supported_scheds: Vec<String>, faults: LoaderFaults) -> Self {
+        Self {
+            supported_scheds,
+            current_sched: Mutex::new(String::new()),
+            current_mode: Mutex::new(0),
+            faults,
+            calls: AtomicU64::new(0),
+        }
+    }
+
+    /// Number of calls served, including the failed ones.
+    pub fn calls(&self) -> u64 {
+        self.calls.load(Ordering::Relaxed)
+    }
+
+    async fn inject_faults(&self) -> fdo::Result<()> {
+        let call = self.calls.fetch_add(1, Ordering::Relaxed) + 1;
+        if !self.faults.latency.is_zero() {
+            tokio::time::sleep(self.faults.latency).await;
+        }
+        if self.faults.fail_every != 0 && call % self.faults.fail_every == 0 {
+            return Err(fdo::Error::Failed(format!("Injected failure of call {call}")));
+        }
+        Ok(())
+    }
+
+    fn check_sched(&self, scx_name: &str) -> fdo::Result<()> {
+        if !self.supported_scheds.iter().any(|sched| sched == scx_name) {
+            return Err(fdo::Error::InvalidArgs(format!("Unsupported scheduler: {scx_name}")));
+        }
+        Ok(())
+    }
+
+    async fn set_running(
+        &self,
+        emitter: &SignalEmitter<'_>,
+        scx_name: &str,
+        sched_mode: u32,
+    ) -> fdo::Result<()> {
+        if sched_mode > MAX_SCHED_MODE {
+            return Err(fdo::Error::InvalidArgs(format!("Unknown scheduler mode: {sched_mode}")));
+        }
+        *self.current_sched.lock().unwrap() = scx_name.to_owned();
+        *self.current_mode.lock().unwrap() = sched_mode;
+        self.current_scheduler_changed(emitter).await?;
+        self.scheduler_mode_changed(emitter).await?;
+        Ok(())
+    }
+}
+
+#[zbus::interface(name = "org.scx.Loader")]
+impl MockLoader {
+    async fn start_scheduler(
+        &self,
+        #[zbus(signal_emitter)] emitter: SignalEmitter<'_>,
+        scx_name: String,
+        sched_mode: u32,
+    ) -> fdo::Result<()> {
+        self.inject_faults().await?;
+        self.check_sched(&scx_name)?;
+        self.set_running(&emitter, &scx_name, sched_mode).await
+    }
+
+    async fn start_scheduler_with_args(
+        &self,
+        #[zbus(signal_emitter)] emitter: SignalEmitter<'_>,
+        scx_name: String,
+        _scx_args: Vec<String>,
+    ) -> fdo::Result<()> {
+        self.inject_faults().await?;
+        self.check_sched(&scx_name)?;
+        self.set_running(&emitter, &scx_name, 0).await
+    }
+
+    async fn switch_scheduler(
+        &self,
+        #[zbus(signal_emitter)] emitter: SignalEmitter<'_>,
+        scx_name: String,
+        sched_mode: u32,
+    ) -> fdo::Result<()> {
+        self.inject_faults().await?;
+        self.check_sched(&scx_name)?;
+        self.set_running(&emitter, &scx_name, sched_mode).await
+    }
+
+    async fn switch_scheduler_with_args(
+        &self,
+        #[zbus(signal_emitter)] emitter: SignalEmitter<'_>,
+        scx_name: String,
+        _scx_args: Vec<String>,
+    ) -> fdo::Result<()> {
+        self.inject_faults().await?;
+        self.check_sched(&scx_name)?;
+        self.set_running(&emitter, &scx_name, 0).await
+    }
+
+    async fn stop_scheduler(
+        &self,
+        #[zbus(signal_emitter)] emitter: SignalEmitter<'_>,
+    ) -> fdo::Result<()> {
+        self.inject_faults().await?;
+        self.current_sched.lock().unwrap().clear();
+        self.current_scheduler_changed(&emitter).await?;
+        Ok(())
+    }
+
+    #[zbus(property)]
+    async fn supported_schedulers(&self) -> fdo::Result<Vec<String>> {
+        self.inject_faults().await?;
+        Ok(self.supported_scheds.clone())
+    }
+
+    #[zbus(property)]
+    async fn current_scheduler(&self) -> fdo::Result<String> {
+        self.inject_faults().await?;
+        let current_sched = self.current_sched.lock().unwrap();
+        Ok(if current_sched.is_empty() { "unknown".to_owned() } else { current_sched.clone() })
+    }
+
+    #[zbus(property)]
+    async fn scheduler_mode(&self) -> fdo::Result<u32> {
+        self.inject_faults().await?;
+        Ok(*self.current_mode.lock().unwrap())
+    }
+}
+
+/// Serves the loader and systemd mocks on the connection being built.
+///
+/// Well-known names are requested only when `request_names` is set, p2p connections have no bus
+/// to request them from.
+pub async fn serve(
+    builder: zbus::connection::Builder<'_>,
+    loader: MockLoader,
+    systemd: &SharedState,
+    request_names: bool,
+) -> zbus::Result<Connection> {
+    let mut builder = builder
+        .serve_at(LOADER_PATH, loader)?
+        .serve_at(MANAGER_PATH, MockManager { state: Arc::clone(systemd) })?;
+
+    let units: Vec<String> = systemd.lock().unwrap().units.keys().cloned().collect();
+    for unit in units {
+        let path = unit_path(&unit);
+        builder = builder.serve_at(path, MockUnit { unit, state: Arc::clone(systemd) })?;
+    }
+    if request_names {
+        builder = builder.name(LOADER_SERVICE)?.name(SYSTEMD_SERVICE)?;
+    }
+    builder.build().await
+}
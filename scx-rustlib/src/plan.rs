@@ -0,0 +1,372 @@
+// SPDX-License-Identifier: GPL-2.0
+//
+// Copyright (c) 2024-2025 Vladislav Nepogodin <vnepogodin@cachyos.org>
+
+// This software may be used and distributed according to the terms of the
+// GNU General Public License version 2.
+
+//! Planner of the scheduler changes.
+//!
+//! Diffs the requested scheduler against the state of scx_loader, the units and the config on
+//! disk, so that only the steps which change something are run.
+
+use crate::ffi::ChangePlan;
+use crate::session::LoaderProperties;
+use crate::systemd::{UnitState, LOADER_UNIT, SCX_UNIT};
+use crate::{set_scx_args, set_scx_sched_with_mode};
+
+use scx_loader::config::{self, Config};
+use scx_loader::{SchedMode, SupportedSched};
+
+use anyhow::Result;
+
+/// State the change is planned against, the parts which couldn't be read are None.
+pub struct PlanState {
+    pub loader: Option<LoaderProperties>,
+    /// Args the running scheduler was switched with, scx_loader doesn't report them
+    pub running_args: Option<Vec<String>>,
+    /// States of scx.service and scx_loader.service
+    pub units: Option<(UnitState, UnitState)>,
+}
+
+/// Scheduler requested by the user.
+pub struct PlanRequest<'a> {
+    pub scx_name: &'a str,
+    pub scx_sched: SupportedSched,
+    pub sched_mode: SchedMode,
+    pub extra_args: &'a [String],
+    pub persist: bool,
+}
+
+fn empty_plan() -> ChangePlan {
+    ChangePlan {
+        stop_scx_service: false,
+        switch_scheduler: false,
+        enable_loader_service: false,
+        stop_scheduler: false,
+        write_config: false,
+        reasons: vec![],
+    }
+}
+
+fn mode_name(sched_mode: &SchedMode) -> String {
+    format!("{sched_mode:?}").to_lowercase()
+}
+
+fn is_running(loader: &LoaderProperties) -> bool {
+    !loader.current_sched.is_empty() && loader.current_sched != "unknown"
+}
+
+/// Plans the apply of the scheduler.
+pub fn plan_apply(
+    state: &PlanState,
+    config: &Config,
+    request: &PlanRequest<'_>,
+) -> Result<ChangePlan> {
+    let mut plan = empty_plan();
+    let scx_name = request.scx_name;
+    let mode_name = mode_name(&request.sched_mode);
+
+    match &state.units {
+        // the units decide what runs on boot, so only the persisted changes touch them
+        _ if !request.persist => {
+            plan.reasons.push("Units are left as they are, the change isn't persisted".to_owned());
+        },
+        Some((scx_state, loader_state)) => {
+            if scx_state.is_enabled() || scx_state.is_active() {
+                plan.stop_scx_service = true;
+                plan.reasons.push(format!("{SCX_UNIT} conflicts with scx_loader, it is stopped"));
+            }
+            if !loader_state.is_enabled() {
+                plan.enable_loader_service = true;
+                plan.reasons.push(format!("{LOADER_UNIT} is enabled to start {scx_name} on boot"));
+            }
+        },
+        None => {
+            plan.stop_scx_service = true;
+            plan.enable_loader_service = true;
+            plan.reasons.push("States of the units are unknown, both are checked".to_owned());
+        },
+    }
+
+    // the args which scx_loader uses for the mode, with the overrides of the config
+    let mode_args =
+        config::get_scx_flags_for_mode(config, &request.scx_sched, request.sched_mode.clone());
+    let is_default = request.extra_args == mode_args.as_slice();
+
+    match &state.loader {
+        _ if plan.stop_scx_service => {
+            plan.switch_scheduler = true;
+            plan.reasons.push(format!("{scx_name} replaces the scheduler of {SCX_UNIT}"));
+        },
+        None => {
+            plan.switch_scheduler = true;
+            plan.reasons
+                .push("State of scx_loader is unknown, the scheduler is switched".to_owned());
+        },
+        Some(loader)
+            if loader.current_sched == scx_name
+                && loader.current_mode == request.sched_mode.clone() as u32 =>
+        {
+            match &state.running_args {
+                Some(running_args) if running_args.as_slice() == request.extra_args => {
+                    plan.reasons.push(format!("{scx_name} already runs in {mode_name} mode"));
+                },
+                Some(_) => {
+                    plan.switch_scheduler = true;
+                    plan.reasons.push(format!("{scx_name} is restarted with the requested args"));
+                },
+                // e.g started on boot or by another client, with args of its own
+                None => {
+                    plan.switch_scheduler = true;
+                    plan.reasons.push(format!(
+                        "Args of the running {scx_name} are unknown, it is restarted"
+                    ));
+                },
+            }
+        },
+        Some(loader) if is_running(loader) => {
+            plan.switch_scheduler = true;
+            plan.reasons.push(format!(
+                "{} is switched to {scx_name} in {mode_name} mode",
+                loader.current_sched
+            ));
+        },
+        Some(_) => {
+            plan.switch_scheduler = true;
+            plan.reasons.push(format!("{scx_name} is started in {mode_name} mode"));
+        },
+    }
+
+    if request.persist {
+        // the config is written exactly as the last stage of the apply would write it
+        let current_toml = toml::to_string(config)?;
+        let mut desired: Config = toml::from_str(&current_toml)?;
+        set_scx_sched_with_mode(
+            &mut desired,
+            request.scx_sched.clone(),
+            request.sched_mode.clone(),
+        );
+        if !is_default {
+            set_scx_args(
+                &mut desired,
+                request.scx_sched.clone(),
+                request.sched_mode.clone(),
+                request.extra_args.to_vec(),
+            );
+        }
+
+        if toml::to_string(&desired)? != current_toml {
+            plan.write_config = true;
+            plan.reasons.push(format!("Config is changed to start {scx_name} in {mode_name} mode"));
+        } else {
+            plan.reasons.push(format!("Config already starts {scx_name} in {mode_name} mode"));
+        }
+        if is_default && !request.extra_args.is_empty() {
+            plan.reasons.push("Args match the ones of the mode, no override is written".to_owned());
+        }
+    }
+    Ok(plan)
+}
+
+/// Plans the disable of the running scheduler.
+pub fn plan_disable(state: &PlanState, config: &Config, persist: bool) -> ChangePlan {
+    let mut plan = empty_plan();
+    match &state.loader {
+        Some(loader) if !is_running(loader) => {
+            plan.reasons.push("No scheduler is running".to_owned());
+        },
+        Some(loader) => {
+            plan.stop_scheduler = true;
+            plan.reasons.push(format!("{} is stopped", loader.current_sched));
+        },
+        None => {
+            plan.stop_scheduler = true;
+            plan.reasons
+                .push("State of scx_loader is unknown, the scheduler is stopped".to_owned());
+        },
+    }
+
+    if persist {
+        if config.default_sched.is_some() {
+            plan.write_config = true;
+            plan.reasons.push("Config is changed to start no scheduler on boot".to_owned());
+        } else {
+            plan.reasons.push("Config already starts no scheduler on boot".to_owned());
+        }
+    }
+    plan
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    fn unit(unit_file_state: &str, active_state: &str) -> UnitState {
+        UnitState {
+            unit_file_state: unit_file_state.to_owned(),
+            active_state: active_state.to_owned(),
+        }
+    }
+
+    /// scx.service is off and scx_loader.service enabled, running the scheduler in the mode.
+    fn loader_state(current_sched: &str, sched_mode: SchedMode) -> PlanState {
+        PlanState {
+            loader: Some(LoaderProperties {
+                supported_scheds: vec!["scx_bpfland".to_owned(), "scx_lavd".to_owned()],
+                current_sched: current_sched.to_owned(),
+                current_mode: sched_mode as u32,
+            }),
+            running_args: None,
+            units: Some((unit("disabled", "inactive"), unit("enabled", "active"))),
+        }
+    }
+
+    fn persisted_config(scx_sched: &SupportedSched, sched_mode: SchedMode) -> Config {
+        let mut config = config::get_default_config();
+        set_scx_sched_with_mode(&mut config, scx_sched.clone(), sched_mode);
+        config
+    }
+
+    fn request<'a>(
+        scx_sched: &SupportedSched,
+        sched_mode: SchedMode,
+        extra_args: &'a [String],
+    ) -> PlanRequest<'a> {
+        PlanRequest {
+            scx_name: "scx_lavd",
+            scx_sched: scx_sched.clone(),
+            sched_mode,
+            extra_args,
+            persist: true,
+        }
+    }
+
+    #[test]
+    fn test_already_running_is_noop() {
+        let scx_sched: SupportedSched = "scx_lavd".parse().unwrap();
+        let config = persisted_config(&scx_sched, SchedMode::Gaming);
+        let mode_args = config::get_scx_flags_for_mode(&config, &scx_sched, SchedMode::Gaming);
+
+        let mut state = loader_state("scx_lavd", SchedMode::Gaming);
+        state.running_args = Some(mode_args.clone());
+        let plan = plan_apply(&state, &config, &request(&scx_sched, SchedMode::Gaming, &mode_args))
+            .unwrap();
+        assert!(!plan.stop_scx_service && !plan.switch_scheduler && !plan.enable_loader_service);
+        assert!(!plan.write_config);
+    }
+
+    #[test]
+    fn test_running_args_decide_the_restart() {
+        let scx_sched: SupportedSched = "scx_lavd".parse().unwrap();
+        let config = persisted_config(&scx_sched, SchedMode::Gaming);
+        let mode_args = config::get_scx_flags_for_mode(&config, &scx_sched, SchedMode::Gaming);
+        let custom_args = vec!["--custom".to_owned()];
+        let mut profile_request = request(&scx_sched, SchedMode::Gaming, &mode_args);
+        profile_request.persist = false;
+
+        // not switched by us, the running instance may have custom args
+        let mut state = loader_state("scx_lavd", SchedMode::Gaming);
+        assert!(plan_apply(&state, &config, &profile_request).unwrap().switch_scheduler);
+
+        state.running_args = Some(custom_args.clone());
+        assert!(plan_apply(&state, &config, &profile_request).unwrap().switch_scheduler);
+
+        profile_request.extra_args = &custom_args;
+        assert!(!plan_apply(&state, &config, &profile_request).unwrap().switch_scheduler);
+    }
+
+    #[test]
+    fn test_mode_only_change() {
+        let scx_sched: SupportedSched = "scx_lavd".parse().unwrap();
+        let config = persisted_config(&scx_sched, SchedMode::Auto);
+        let mode_args = config::get_scx_flags_for_mode(&config, &scx_sched, SchedMode::PowerSave);
+
+        let state = loader_state("scx_lavd", SchedMode::Auto);
+        let mut mode_request = request(&scx_sched, SchedMode::PowerSave, &mode_args);
+        mode_request.persist = false;
+        let plan = plan_apply(&state, &config, &mode_request).unwrap();
+        assert!(plan.switch_scheduler);
+        assert!(!plan.stop_scx_service && !plan.enable_loader_service && !plan.write_config);
+    }
+
+    #[test]
+    fn test_default_args_are_not_persisted() {
+        let scx_sched: SupportedSched = "scx_lavd".parse().unwrap();
+        let config = persisted_config(&scx_sched, SchedMode::Auto);
+        let mode_args = config::get_scx_flags_for_mode(&config, &scx_sched, SchedMode::Gaming);
+
+        let state = loader_state("scx_lavd", SchedMode::Auto);
+        let plan = plan_apply(&state, &config, &request(&scx_sched, SchedMode::Gaming, &mode_args))
+            .unwrap();
+        assert!(plan.switch_scheduler && plan.write_config);
+
+        // once persisted, the config holds only the scheduler and the mode, args of the mode
+        // are not written as its override
+        let persisted = persisted_config(&scx_sched, SchedMode::Gaming);
+        let mut state = loader_state("scx_lavd", SchedMode::Gaming);
+        state.running_args = Some(mode_args.clone());
+        let plan =
+            plan_apply(&state, &persisted, &request(&scx_sched, SchedMode::Gaming, &mode_args))
+                .unwrap();
+        assert!(!plan.switch_scheduler && !plan.write_config);
+
+        let custom_args = vec!["--custom".to_owned()];
+        let plan =
+            plan_apply(&state, &persisted, &request(&scx_sched, SchedMode::Gaming, &custom_args))
+                .unwrap();
+        assert!(plan.switch_scheduler && plan.write_config);
+    }
+
+    #[test]
+    fn test_conflicting_and_unknown_state() {
+        let scx_sched: SupportedSched = "scx_lavd".parse().unwrap();
+        let config = persisted_config(&scx_sched, SchedMode::Auto);
+        let mode_args = config::get_scx_flags_for_mode(&config, &scx_sched, SchedMode::Auto);
+
+        let mut state = loader_state("scx_lavd", SchedMode::Auto);
+        state.units = Some((unit("enabled", "active"), unit("disabled", "inactive")));
+        let plan =
+            plan_apply(&state, &config, &request(&scx_sched, SchedMode::Auto, &mode_args)).unwrap();
+        assert!(plan.stop_scx_service && plan.switch_scheduler && plan.enable_loader_service);
+        assert!(!plan.write_config);
+
+        let state = PlanState { loader: None, running_args: None, units: None };
+        let plan =
+            plan_apply(&state, &config, &request(&scx_sched, SchedMode::Auto, &mode_args)).unwrap();
+        assert!(plan.stop_scx_service && plan.switch_scheduler && plan.enable_loader_service);
+    }
+
+    #[test]
+    fn test_units_are_kept_without_persist() {
+        let scx_sched: SupportedSched = "scx_lavd".parse().unwrap();
+        let config = persisted_config(&scx_sched, SchedMode::Auto);
+        let mode_args = config::get_scx_flags_for_mode(&config, &scx_sched, SchedMode::Gaming);
+
+        let mut state = loader_state("scx_bpfland", SchedMode::Auto);
+        state.units = Some((unit("enabled", "active"), unit("disabled", "inactive")));
+        let mut profile_request = request(&scx_sched, SchedMode::Gaming, &mode_args);
+        profile_request.persist = false;
+        let plan = plan_apply(&state, &config, &profile_request).unwrap();
+        assert!(plan.switch_scheduler);
+        assert!(!plan.stop_scx_service && !plan.enable_loader_service && !plan.write_config);
+
+        let state = PlanState { loader: None, running_args: None, units: None };
+        let plan = plan_apply(&state, &config, &profile_request).unwrap();
+        assert!(plan.switch_scheduler);
+        assert!(!plan.stop_scx_service && !plan.enable_loader_service);
+    }
+
+    #[test]
+    fn test_plan_disable() {
+        let scx_sched: SupportedSched = "scx_lavd".parse().unwrap();
+        let mut config = persisted_config(&scx_sched, SchedMode::Auto);
+
+        let plan = plan_disable(&loader_state("scx_lavd", SchedMode::Auto), &config, true);
+        assert!(plan.stop_scheduler && plan.write_config);
+
+        config.default_sched = None;
+        let plan = plan_disable(&loader_state("unknown", SchedMode::Auto), &config, true);
+        assert!(!plan.stop_scheduler && !plan.write_config);
+    }
+}
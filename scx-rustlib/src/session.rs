@@ -0,0 +1,556 @@
+// SPDX-License-Identifier: GPL-2.0
+//
+// Copyright (c) 2024-2025 Vladislav Nepogodin <vnepogodin@cachyos.org>
+
+// This software may be used and distributed according to the terms of the
+// GNU General Public License version 2.
+
+use crate::config_helper::ConfigHelperProxy;
+use crate::systemd::{self, ManagerProxy};
+
+use scx_loader::dbus::LoaderClientProxy;
+
+use std::collections::HashMap;
+use std::fs::File;
+use std::future::Future;
+use std::io::Write;
+use std::os::fd::{FromRawFd, OwnedFd};
+use std::sync::{Arc, Mutex};
+use std::time::{Duration, Instant};
+
+use anyhow::{Context, Result};
+use futures_util::StreamExt;
+use tokio::runtime::Runtime;
+use tokio::task::JoinHandle;
+use zbus::fdo::{PropertiesChangedStream, PropertiesProxy};
+use zbus::names::InterfaceName;
+use zbus::proxy::CacheProperties;
+use zbus::zvariant::OwnedValue;
+use zbus::Connection;
+
+const LOADER_SERVICE: &str = "org.scx.Loader";
+const LOADER_PATH: &str = "/org/scx/Loader";
+const LOADER_INTERFACE: &str = "org.scx.Loader";
+
+/// Properties reported by `LoaderSession::watch_properties`, others are of no interest.
+const WATCHED_PROPERTIES: [&str; 2] = ["CurrentScheduler", "SchedulerMode"];
+
+/// How long to wait before subscribing again, while the bus is unreachable.
+const WATCH_RETRY_INTERVAL: Duration = Duration::from_secs(1);
+
+/// Address of the bus to use instead of the system one, e.g a private dbus-daemon running
+/// `scx-mock-loader`.
+pub const BUS_ADDRESS_ENV: &str = "SCX_MANAGER_BUS_ADDRESS";
+
+/// Calls made through the session, used to index latency counters.
+#[derive(Debug, Clone, Copy, PartialEq, Eq)]
+pub enum LoaderMethod {
+    SupportedSchedulers = 0,
+    CurrentScheduler,
+    SchedulerMode,
+    SwitchScheduler,
+    SwitchSchedulerWithArgs,
+    StopScheduler,
+    GetAllProperties,
+    /// Write of the config by the privileged helper, not a loader method
+    WriteConfig,
+    /// Unit lookups and changes done through the systemd manager
+    ManageUnits,
+}
+
+impl LoaderMethod {
+    pub const ALL: [LoaderMethod; 9] = [
+        LoaderMethod::SupportedSchedulers,
+        LoaderMethod::CurrentScheduler,
+        LoaderMethod::SchedulerMode,
+        LoaderMethod::SwitchScheduler,
+        LoaderMethod::SwitchSchedulerWithArgs,
+        LoaderMethod::StopScheduler,
+        LoaderMethod::GetAllProperties,
+        LoaderMethod::WriteConfig,
+        LoaderMethod::ManageUnits,
+    ];
+
+    pub fn name(self) -> &'static str {
+        match self {
+            LoaderMethod::SupportedSchedulers => "SupportedSchedulers",
+            LoaderMethod::CurrentScheduler => "CurrentScheduler",
+            LoaderMethod::SchedulerMode => "SchedulerMode",
+            LoaderMethod::SwitchScheduler => "SwitchScheduler",
+            LoaderMethod::SwitchSchedulerWithArgs => "SwitchSchedulerWithArgs",
+            LoaderMethod::StopScheduler => "StopScheduler",
+            LoaderMethod::GetAllProperties => "GetAll",
+            LoaderMethod::WriteConfig => "WriteConfig",
+            LoaderMethod::ManageUnits => "systemd1",
+        }
+    }
+}
+
+/// Latency counters of a single loader method.
+#[derive(Debug, Default, Clone, Copy)]
+pub struct CallCounter {
+    pub calls: u64,
+    pub failures: u64,
+    pub reconnects: u64,
+    pub total_ns: u64,
+    pub max_ns: u64,
+}
+
+impl CallCounter {
+    fn record(&mut self, elapsed: Duration, succeeded: bool, reconnected: bool) {
+        let elapsed_ns = u64::try_from(elapsed.as_nanos()).unwrap_or(u64::MAX);
+        self.calls += 1;
+        self.total_ns = self.total_ns.saturating_add(elapsed_ns);
+        self.max_ns = self.max_ns.max(elapsed_ns);
+        if !succeeded {
+            self.failures += 1;
+        }
+        if reconnected {
+            self.reconnects += 1;
+        }
+    }
+}
+
+/// Properties of scx_loader, read together.
+#[derive(Debug, Clone, Default, PartialEq)]
+pub struct LoaderProperties {
+    pub supported_scheds: Vec<String>,
+    pub current_sched: String,
+    pub current_mode: u32,
+}
+
+/// Connection to the system bus together with cached proxies on it.
+#[derive(Clone)]
+pub struct BusHandle {
+    pub connection: Connection,
+    pub loader: LoaderClientProxy<'static>,
+    pub config_helper: ConfigHelperProxy<'static>,
+    pub systemd: ManagerProxy<'static>,
+}
+
+/// Long-lived session to scx_loader.
+///
+/// Holds one small tokio runtime, one system bus connection and one cached loader proxy for the
+/// lifetime of the owner. The connection is established lazily on first use and re-established
+/// transparently if the bus drops it.
+pub struct LoaderSession {
+    runtime: Runtime,
+    bus: Arc<Mutex<Option<BusHandle>>>,
+    counters: Mutex<[CallCounter; LoaderMethod::ALL.len()]>,
+    prefetch: Mutex<Option<(Instant, JoinHandle<zbus::Result<LoaderProperties>>)>>,
+}
+
+impl LoaderSession {
+    pub fn new() -> Result<Self> {
+        // The single worker keeps the connection's socket reader running in the background,
+        // without spawning a worker per CPU core.
+        let runtime = tokio::runtime::Builder::new_multi_thread()
+            .worker_threads(1)
+            .thread_name("scx-loader-rt")
+            .enable_all()
+            .build()
+            .context("Failed to initialize tokio runtime")?;
+
+        Ok(Self {
+            runtime,
+            bus: Arc::new(Mutex::new(None)),
+            counters: Mutex::new([CallCounter::default(); LoaderMethod::ALL.len()]),
+            prefetch: Mutex::new(None),
+        })
+    }
+
+    /// Session talking to the loader mock over a socket pair, instead of the system bus.
+    ///
+    /// The server end of the pair is returned too, it has to outlive the session.
+    #[cfg(test)]
+    pub(crate) fn with_mock_loader(
+        faults: crate::mock::LoaderFaults,
+    ) -> Result<(Self, Connection)> {
+        let session = Self::new()?;
+        let (bus, server) = session.runtime.block_on(mock_bus(faults));
+        *session.bus.lock().unwrap() = Some(bus);
+        Ok((session, server))
+    }
+
+    /// Returns the runtime driving the connection.
+    pub fn runtime(&self) -> &Runtime {
+        &self.runtime
+    }
+
+    /// Returns the cached bus handle, connecting to the system bus if needed.
+    pub async fn bus(&self) -> zbus::Result<BusHandle> {
+        cached_bus(&self.bus).await
+    }
+
+    /// Drops the cached connection, next call will reconnect.
+    pub fn invalidate(&self) {
+        self.bus.lock().unwrap().take();
+    }
+
+    /// Calls the loader method on the cached proxy, reconnecting once if the connection was lost.
+    pub fn call<T, F, Fut>(&self, method: LoaderMethod, func: F) -> Result<T>
+    where
+        F: Fn(LoaderClientProxy<'static>) -> Fut,
+        Fut: Future<Output = zbus::Result<T>>,
+    {
+        self.call_bus(method, |bus| func(bus.loader))
+    }
+
+    /// Same as `call`, but gives access to the whole bus handle.
+    pub fn call_bus<T, F, Fut>(&self, method: LoaderMethod, func: F) -> Result<T>
+    where
+        F: Fn(BusHandle) -> Fut,
+        Fut: Future<Output = zbus::Result<T>>,
+    {
+        let started = Instant::now();
+        let mut reconnected = false;
+
+        let result = self.runtime.block_on(async {
+            let bus = self.bus().await?;
+            match func(bus).await {
+                Err(err) if is_disconnected(&err) => {
+                    self.invalidate();
+                    reconnected = true;
+
+                    let bus = self.bus().await?;
+                    func(bus).await
+                },
+                result => result,
+            }
+        });
+
+        self.record(method, started.elapsed(), result.is_ok(), reconnected);
+        Ok(result?)
+    }
+
+    /// Starts reading the loader properties in the background, so that the caller can do
+    /// something else meanwhile. The result is picked up by the next `properties` call.
+    pub fn prefetch_properties(&self) {
+        let bus_cache = Arc::clone(&self.bus);
+        let handle = self.runtime.spawn(async move {
+            let bus = cached_bus(&bus_cache).await?;
+            fetch_properties(bus).await
+        });
+        *self.prefetch.lock().unwrap() = Some((Instant::now(), handle));
+    }
+
+    /// Returns all loader properties, preferring the prefetched ones.
+    pub fn properties(&self) -> Result<LoaderProperties> {
+        let prefetched = self.prefetch.lock().unwrap().take();
+        if let Some((started, handle)) = prefetched {
+            let result = self.runtime.block_on(handle).context("Properties prefetch panicked")?;
+            self.record(LoaderMethod::GetAllProperties, started.elapsed(), result.is_ok(), false);
+            match result {
+                Ok(properties) => return Ok(properties),
+                // the connection may have been dropped meanwhile, let the call retry it
+                Err(err) if is_disconnected(&err) => self.invalidate(),
+                Err(err) => return Err(err.into()),
+            }
+        }
+        self.call_bus(LoaderMethod::GetAllProperties, fetch_properties)
+    }
+
+    /// Subscribes to property changes of scx_loader.
+    ///
+    /// The returned eventfd becomes readable each time CurrentScheduler or SchedulerMode
+    /// changes, so the caller can wait for it in its own event loop. The subscription is made
+    /// again when the connection is re-established, the eventfd is signaled then too, as
+    /// changes made meanwhile were missed.
+    pub fn watch_properties(&self) -> Result<OwnedFd> {
+        let notify_fd = create_eventfd()?;
+        let caller_fd = notify_fd.try_clone().context("Failed to duplicate eventfd")?;
+
+        let bus_cache = Arc::clone(&self.bus);
+        let (mut connection, mut changes) =
+            self.runtime.block_on(subscribe_properties(&bus_cache))?;
+
+        self.runtime.spawn(async move {
+            let mut notify_file = File::from(notify_fd);
+            let mut notify = move || {
+                // EAGAIN means the counter is saturated, the reader is woken up anyway
+                let _ = notify_file.write(&1u64.to_ne_bytes());
+            };
+            loop {
+                while let Some(signal) = changes.next().await {
+                    let Ok(args) = signal.args() else {
+                        continue;
+                    };
+                    if args.interface_name().as_str() != LOADER_INTERFACE {
+                        continue;
+                    }
+                    let changed = args.changed_properties().keys().copied();
+                    if touches_watched_properties(
+                        changed.chain(args.invalidated_properties().iter().copied()),
+                    ) {
+                        notify();
+                    }
+                }
+
+                // the stream ends together with the connection
+                invalidate_connection(&bus_cache, &connection);
+                (connection, changes) = loop {
+                    match subscribe_properties(&bus_cache).await {
+                        Ok(subscription) => break subscription,
+                        Err(err) => {
+                            if is_disconnected(&err) {
+                                bus_cache.lock().unwrap().take();
+                            }
+                            tokio::time::sleep(WATCH_RETRY_INTERVAL).await;
+                        },
+                    }
+                };
+                notify();
+            }
+        });
+
+        Ok(caller_fd)
+    }
+
+    fn record(&self, method: LoaderMethod, elapsed: Duration, succeeded: bool, reconnected: bool) {
+        self.counters.lock().unwrap()[method as usize].record(elapsed, succeeded, reconnected);
+    }
+
+    /// Returns a snapshot of the per-method latency counters.
+    pub fn counters(&self) -> Vec<(LoaderMethod, CallCounter)> {
+        let counters = self.counters.lock().unwrap();
+        LoaderMethod::ALL.iter().map(|method| (*method, counters[*method as usize])).collect()
+    }
+}
+
+/// Returns the cached bus handle, connecting to the system bus if needed.
+async fn cached_bus(cache: &Mutex<Option<BusHandle>>) -> zbus::Result<BusHandle> {
+    if let Some(bus) = cache.lock().unwrap().as_ref() {
+        return Ok(bus.clone());
+    }
+
+    let bus = bus_handle(connect_bus().await?).await?;
+    *cache.lock().unwrap() = Some(bus.clone());
+    Ok(bus)
+}
+
+/// Drops the cached bus handle if it's still on the connection, which was found to be lost.
+fn invalidate_connection(cache: &Mutex<Option<BusHandle>>, connection: &Connection) {
+    let mut cache = cache.lock().unwrap();
+    if cache.as_ref().is_some_and(|bus| bus.connection.unique_name() == connection.unique_name()) {
+        cache.take();
+    }
+}
+
+/// Connects to the bus set by `BUS_ADDRESS_ENV`, or to the system bus.
+async fn connect_bus() -> zbus::Result<Connection> {
+    match std::env::var(BUS_ADDRESS_ENV) {
+        Ok(address) if !address.is_empty() => {
+            zbus::connection::Builder::address(address.as_str())?.build().await
+        },
+        _ => Connection::system().await,
+    }
+}
+
+/// Builds the proxies used by the session on the connection.
+async fn bus_handle(connection: Connection) -> zbus::Result<BusHandle> {
+    // Properties are read on demand, otherwise the cache could serve stale values
+    let loader = LoaderClientProxy::builder(&connection)
+        .cache_properties(CacheProperties::No)
+        .build()
+        .await?;
+    // the helper is activated by the first call, not by building the proxy
+    let config_helper = ConfigHelperProxy::builder(&connection)
+        .cache_properties(CacheProperties::No)
+        .build()
+        .await?;
+
+    let systemd = systemd::manager(&connection).await?;
+
+    Ok(BusHandle { connection, loader, config_helper, systemd })
+}
+
+async fn properties_proxy(connection: &Connection) -> zbus::Result<PropertiesProxy<'static>> {
+    PropertiesProxy::builder(connection)
+        .destination(LOADER_SERVICE)?
+        .path(LOADER_PATH)?
+        .build()
+        .await
+}
+
+/// Subscribes to PropertiesChanged of the loader on the cached connection, which is returned too.
+async fn subscribe_properties(
+    cache: &Mutex<Option<BusHandle>>,
+) -> zbus::Result<(Connection, PropertiesChangedStream)> {
+    let bus = cached_bus(cache).await?;
+    let properties = properties_proxy(&bus.connection).await?;
+    let changes = properties.receive_properties_changed().await?;
+    Ok((bus.connection, changes))
+}
+
+fn touches_watched_properties<'a>(mut names: impl Iterator<Item = &'a str>) -> bool {
+    names.any(|name| WATCHED_PROPERTIES.contains(&name))
+}
+
+/// Reads all loader properties with one GetAll call.
+async fn fetch_properties(bus: BusHandle) -> zbus::Result<LoaderProperties> {
+    let properties = properties_proxy(&bus.connection).await?;
+    let interface = InterfaceName::from_static_str_unchecked(LOADER_INTERFACE);
+    match properties.get_all(interface.into()).await {
+        Ok(values) => properties_from_map(values),
+        // older loaders may not implement it, the separate requests are at least sent together
+        Err(_) => {
+            let (supported_scheds, current_sched, current_mode) = tokio::try_join!(
+                bus.loader.supported_schedulers(),
+                bus.loader.current_scheduler(),
+                bus.loader.scheduler_mode(),
+            )?;
+            Ok(LoaderProperties {
+                supported_scheds,
+                current_sched,
+                current_mode: current_mode as u32,
+            })
+        },
+    }
+}
+
+fn properties_from_map(mut values: HashMap<String, OwnedValue>) -> zbus::Result<LoaderProperties> {
+    Ok(LoaderProperties {
+        supported_scheds: take_property(&mut values, "SupportedSchedulers")?,
+        current_sched: take_property(&mut values, "CurrentScheduler")?,
+        current_mode: take_property(&mut values, "SchedulerMode")?,
+    })
+}
+
+fn take_property<T>(values: &mut HashMap<String, OwnedValue>, name: &str) -> zbus::Result<T>
+where
+    T: TryFrom<OwnedValue>,
+    T::Error: Into<zbus::Error>,
+{
+    let value = values
+        .remove(name)
+        .ok_or_else(|| zbus::Error::Failure(format!("scx_loader has no {name} property")))?;
+    T::try_from(value).map_err(Into::into)
+}
+
+fn create_eventfd() -> Result<OwnedFd> {
+    // SAFETY: eventfd has no memory safety preconditions, the result is checked below
+    let fd = unsafe { libc::eventfd(0, libc::EFD_CLOEXEC | libc::EFD_NONBLOCK) };
+    if fd < 0 {
+        return Err(std::io::Error::last_os_error()).context("Failed to create eventfd");
+    }
+    // SAFETY: fd is a freshly created descriptor owned by nobody else
+    Ok(unsafe { OwnedFd::from_raw_fd(fd) })
+}
+
+/// Whether the error means that the connection itself is gone, rather than the call has failed.
+fn is_disconnected(err: &zbus::Error) -> bool {
+    matches!(err, zbus::Error::InputOutput(_))
+}
+
+/// Serves the loader mock on one end of a socket pair, returns handle of the client end.
+#[cfg(test)]
+async fn mock_bus(faults: crate::mock::LoaderFaults) -> (BusHandle, Connection) {
+    use crate::mock;
+
+    let (client_socket, server_socket) = tokio::net::UnixStream::pair().unwrap();
+
+    let scheds = vec!["scx_bpfland".to_owned(), "scx_lavd".to_owned()];
+    let server_builder = zbus::connection::Builder::unix_stream(server_socket)
+        .server(zbus::Guid::generate())
+        .unwrap()
+        .p2p();
+    let server = mock::serve(
+        server_builder,
+        mock::MockLoader::new(scheds, faults),
+        &mock::shared_state(&[]),
+        false,
+    );
+    let client = zbus::connection::Builder::unix_stream(client_socket).p2p().build();
+
+    let (client, server) = tokio::try_join!(client, server).unwrap();
+    (bus_handle(client).await.unwrap(), server)
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    use crate::mock;
+
+    use scx_loader::{SchedMode, SupportedSched};
+
+    #[test]
+    fn test_call_counter_record() {
+        let mut counter = CallCounter::default();
+        counter.record(Duration::from_nanos(300), true, false);
+        counter.record(Duration::from_nanos(100), false, true);
+
+        assert_eq!(counter.calls, 2);
+        assert_eq!(counter.failures, 1);
+        assert_eq!(counter.reconnects, 1);
+        assert_eq!(counter.total_ns, 400);
+        assert_eq!(counter.max_ns, 300);
+    }
+
+    #[test]
+    fn test_properties_from_map() {
+        use zbus::zvariant::Value;
+
+        let loader_values = || {
+            let to_owned = |value: Value<'static>| OwnedValue::try_from(value).unwrap();
+            HashMap::from([
+                (
+                    "SupportedSchedulers".to_owned(),
+                    to_owned(Value::from(vec!["scx_bpfland".to_owned(), "scx_lavd".to_owned()])),
+                ),
+                ("CurrentScheduler".to_owned(), to_owned(Value::from("scx_lavd"))),
+                ("SchedulerMode".to_owned(), to_owned(Value::from(1u32))),
+            ])
+        };
+
+        let properties = properties_from_map(loader_values()).unwrap();
+        assert_eq!(properties.supported_scheds, ["scx_bpfland", "scx_lavd"]);
+        assert_eq!(properties.current_sched, "scx_lavd");
+        assert_eq!(properties.current_mode, 1);
+
+        let mut values = loader_values();
+        values.remove("SchedulerMode");
+        assert!(properties_from_map(values).is_err());
+    }
+
+    #[tokio::test]
+    async fn test_fetch_properties_after_switch() {
+        let (bus, _server) = mock_bus(mock::LoaderFaults::default()).await;
+
+        let properties = fetch_properties(bus.clone()).await.unwrap();
+        assert_eq!(properties.supported_scheds, ["scx_bpfland", "scx_lavd"]);
+        assert_eq!(properties.current_sched, "unknown");
+
+        let scx_sched: SupportedSched = "scx_lavd".parse().unwrap();
+        bus.loader.switch_scheduler(scx_sched, SchedMode::Gaming).await.unwrap();
+        let properties = fetch_properties(bus).await.unwrap();
+        assert_eq!(properties.current_sched, "scx_lavd");
+        assert_eq!(properties.current_mode, SchedMode::Gaming as u32);
+    }
+
+    #[tokio::test]
+    async fn test_injected_failures() {
+        let faults = mock::LoaderFaults { latency: Duration::ZERO, fail_every: 2 };
+        let (bus, _server) = mock_bus(faults).await;
+
+        let scx_sched: SupportedSched = "scx_lavd".parse().unwrap();
+        assert!(bus.loader.switch_scheduler(scx_sched.clone(), SchedMode::Auto).await.is_ok());
+        assert!(bus.loader.switch_scheduler(scx_sched, SchedMode::Auto).await.is_err());
+        assert!(bus.loader.stop_scheduler().await.is_ok());
+    }
+
+    #[test]
+    fn test_touches_watched_properties() {
+        assert!(touches_watched_properties(["CurrentScheduler"].into_iter()));
+        assert!(touches_watched_properties(["SupportedSchedulers", "SchedulerMode"].into_iter()));
+        assert!(!touches_watched_properties(["SupportedSchedulers"].into_iter()));
+        assert!(!touches_watched_properties(std::iter::empty()));
+    }
+
+    #[test]
+    fn test_method_index_matches_order() {
+        for (idx, method) in LoaderMethod::ALL.iter().enumerate() {
+            assert_eq!(*method as usize, idx);
+        }
+    }
+}
@@ -0,0 +1,343 @@
+// SPDX-License-Identifier: GPL-2.0
+//
+// Copyright (c) 2024-2025 Vladislav Nepogodin <vnepogodin@cachyos.org>
+
+// This software may be used and distributed according to the terms of the
+// GNU General Public License version 2.
+
+//! Client of the systemd manager, used instead of running `systemctl`.
+
+use std::future::Future;
+use std::time::Duration;
+
+use futures_util::future::try_join_all;
+use futures_util::StreamExt;
+use zbus::proxy::CacheProperties;
+use zbus::zvariant::{ObjectPath, OwnedObjectPath};
+use zbus::Connection;
+
+pub const SCX_UNIT: &str = "scx.service";
+pub const LOADER_UNIT: &str = "scx_loader.service";
+
+/// How long to wait for the start or stop job to finish, same as `systemctl` does.
+const JOB_TIMEOUT: Duration = Duration::from_secs(90);
+
+#[zbus::proxy(
+    interface = "org.freedesktop.systemd1.Manager",
+    default_service = "org.freedesktop.systemd1",
+    default_path = "/org/freedesktop/systemd1",
+    gen_blocking = false
+)]
+pub trait Manager {
+    fn get_unit_file_state(&self, file: &str) -> zbus::Result<String>;
+
+    fn load_unit(&self, name: &str) -> zbus::Result<OwnedObjectPath>;
+
+    #[zbus(allow_interactive_auth)]
+    fn start_unit(&self, name: &str, mode: &str) -> zbus::Result<OwnedObjectPath>;
+
+    #[zbus(allow_interactive_auth)]
+    fn stop_unit(&self, name: &str, mode: &str) -> zbus::Result<OwnedObjectPath>;
+
+    #[zbus(allow_interactive_auth)]
+    fn enable_unit_files(
+        &self,
+        files: &[&str],
+        runtime: bool,
+        force: bool,
+    ) -> zbus::Result<(bool, Vec<(String, String, String)>)>;
+
+    #[zbus(allow_interactive_auth)]
+    fn disable_unit_files(
+        &self,
+        files: &[&str],
+        runtime: bool,
+    ) -> zbus::Result<Vec<(String, String, String)>>;
+
+    #[zbus(allow_interactive_auth)]
+    fn reload(&self) -> zbus::Result<()>;
+
+    /// Enables emission of the job signals to this client.
+    fn subscribe(&self) -> zbus::Result<()>;
+
+    #[zbus(signal)]
+    fn job_removed(
+        &self,
+        id: u32,
+        job: ObjectPath<'_>,
+        unit: &str,
+        result: &str,
+    ) -> zbus::Result<()>;
+}
+
+#[zbus::proxy(
+    interface = "org.freedesktop.systemd1.Unit",
+    default_service = "org.freedesktop.systemd1",
+    gen_blocking = false
+)]
+pub trait Unit {
+    #[zbus(property)]
+    fn active_state(&self) -> zbus::Result<String>;
+}
+
+/// State of the unit, as reported by `systemctl is-enabled` and `systemctl is-active`.
+#[derive(Debug, Clone, Default, PartialEq, Eq)]
+pub struct UnitState {
+    /// Empty if the unit file doesn't exist
+    pub unit_file_state: String,
+    pub active_state: String,
+}
+
+impl UnitState {
+    pub fn is_enabled(&self) -> bool {
+        self.unit_file_state == "enabled"
+    }
+
+    pub fn is_active(&self) -> bool {
+        self.active_state == "active"
+    }
+}
+
+/// What had to be done to get `scx.service` out of the way.
+#[derive(Debug, Clone, Copy, PartialEq, Eq)]
+pub enum ScxServiceAction {
+    None,
+    Disabled,
+    Stopped,
+}
+
+pub async fn manager(connection: &Connection) -> zbus::Result<ManagerProxy<'static>> {
+    ManagerProxy::builder(connection).cache_properties(CacheProperties::No).build().await
+}
+
+/// Reads states of all the units at once, all requests are in flight together.
+pub async fn unit_states(
+    manager: &ManagerProxy<'static>,
+    units: &[&str],
+) -> zbus::Result<Vec<UnitState>> {
+    try_join_all(units.iter().map(|unit| unit_state(manager, unit))).await
+}
+
+async fn unit_state(manager: &ManagerProxy<'static>, unit: &str) -> zbus::Result<UnitState> {
+    let (unit_file_state, active_state) =
+        tokio::try_join!(unit_file_state(manager, unit), active_state(manager, unit))?;
+    Ok(UnitState { unit_file_state, active_state })
+}
+
+async fn unit_file_state(manager: &ManagerProxy<'static>, unit: &str) -> zbus::Result<String> {
+    match manager.get_unit_file_state(unit).await {
+        Ok(state) => Ok(state),
+        // no such unit file, `systemctl is-enabled` fails the same way
+        Err(zbus::Error::MethodError(..)) => Ok(String::new()),
+        Err(err) => Err(err),
+    }
+}
+
+async fn active_state(manager: &ManagerProxy<'static>, unit: &str) -> zbus::Result<String> {
+    // units are loaded on demand, not existing ones are reported as inactive
+    let unit_path = manager.load_unit(unit).await?;
+    let unit_proxy = UnitProxy::builder(manager.inner().connection())
+        .path(unit_path)?
+        .cache_properties(CacheProperties::No)
+        .build()
+        .await?;
+    unit_proxy.active_state().await
+}
+
+/// Stops the unit and waits for the stop job to finish.
+pub async fn stop_unit(manager: &ManagerProxy<'static>, unit: &str) -> zbus::Result<()> {
+    wait_unit_job(manager, unit, "stop", manager.stop_unit(unit, "replace")).await
+}
+
+/// Starts the unit and waits for the start job to finish.
+pub async fn start_unit(manager: &ManagerProxy<'static>, unit: &str) -> zbus::Result<()> {
+    wait_unit_job(manager, unit, "start", manager.start_unit(unit, "replace")).await
+}
+
+/// Queues the job with `call` and waits for it to be removed, the call is only sent
+/// once the signals are subscribed to.
+async fn wait_unit_job(
+    manager: &ManagerProxy<'static>,
+    unit: &str,
+    verb: &str,
+    call: impl Future<Output = zbus::Result<OwnedObjectPath>>,
+) -> zbus::Result<()> {
+    manager.subscribe().await?;
+    // subscribe before the call, the job may finish before the reply arrives
+    let mut removed_jobs = manager.receive_job_removed().await?;
+
+    let job = call.await?;
+    let wait_job = async {
+        while let Some(signal) = removed_jobs.next().await {
+            let Ok(args) = signal.args() else {
+                continue;
+            };
+            if args.job().as_str() == job.as_str() {
+                return Ok(());
+            }
+        }
+        Err(zbus::Error::Failure(format!("Lost the {verb} job of {unit}")))
+    };
+    tokio::time::timeout(JOB_TIMEOUT, wait_job)
+        .await
+        .map_err(|_| zbus::Error::Failure(format!("Timed out trying to {verb} {unit}")))?
+}
+
+/// Enables the unit, replacing conflicting symlinks like `systemctl enable -f`.
+pub async fn enable_unit(manager: &ManagerProxy<'static>, unit: &str) -> zbus::Result<()> {
+    manager.enable_unit_files(&[unit], false, true).await?;
+    manager.reload().await
+}
+
+/// Disables the unit and stops it, like `systemctl disable --now`.
+pub async fn disable_unit(manager: &ManagerProxy<'static>, unit: &str) -> zbus::Result<()> {
+    manager.disable_unit_files(&[unit], false).await?;
+    manager.reload().await?;
+    stop_unit(manager, unit).await
+}
+
+/// Disables or stops `scx.service`, which would otherwise conflict with scx_loader.
+pub async fn stop_scx_service(
+    manager: &ManagerProxy<'static>,
+    scx_state: &UnitState,
+) -> zbus::Result<ScxServiceAction> {
+    if scx_state.is_enabled() {
+        disable_unit(manager, SCX_UNIT).await?;
+        Ok(ScxServiceAction::Disabled)
+    } else if scx_state.is_active() {
+        stop_unit(manager, SCX_UNIT).await?;
+        Ok(ScxServiceAction::Stopped)
+    } else {
+        Ok(ScxServiceAction::None)
+    }
+}
+
+/// Undoes what `stop_scx_service` did, `scx.service` is brought back the way it was.
+pub async fn restore_scx_service(
+    manager: &ManagerProxy<'static>,
+    action: ScxServiceAction,
+) -> zbus::Result<()> {
+    match action {
+        ScxServiceAction::None => Ok(()),
+        ScxServiceAction::Disabled => {
+            enable_unit(manager, SCX_UNIT).await?;
+            start_unit(manager, SCX_UNIT).await
+        },
+        ScxServiceAction::Stopped => start_unit(manager, SCX_UNIT).await,
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    use crate::mock::{shared_state, unit_path, MockManager, MockUnit, SharedState, MANAGER_PATH};
+
+    use std::sync::Arc;
+
+    use zbus::Guid;
+
+    /// Serves the mock on one end of a socket pair, returns the client end.
+    async fn mock_systemd(state: &SharedState) -> (Connection, Connection) {
+        let (client_socket, server_socket) = tokio::net::UnixStream::pair().unwrap();
+
+        let mut server = zbus::connection::Builder::unix_stream(server_socket)
+            .server(Guid::generate())
+            .unwrap()
+            .p2p()
+            .serve_at(MANAGER_PATH, MockManager { state: Arc::clone(state) })
+            .unwrap();
+        for unit in [SCX_UNIT, LOADER_UNIT] {
+            let mock_unit = MockUnit { unit: unit.to_owned(), state: Arc::clone(state) };
+            server = server.serve_at(unit_path(unit), mock_unit).unwrap();
+        }
+        let client = zbus::connection::Builder::unix_stream(client_socket).p2p();
+
+        tokio::try_join!(client.build(), server.build()).unwrap()
+    }
+
+    #[tokio::test]
+    async fn test_unit_states() {
+        let state = shared_state(&[(SCX_UNIT, "enabled", "active")]);
+        let (client, _server) = mock_systemd(&state).await;
+        let manager = manager(&client).await.unwrap();
+
+        let states = unit_states(&manager, &[SCX_UNIT, LOADER_UNIT]).await.unwrap();
+        assert!(states[0].is_enabled() && states[0].is_active());
+        // not installed unit
+        assert_eq!(
+            states[1],
+            UnitState { unit_file_state: String::new(), active_state: "inactive".to_owned() }
+        );
+        assert!(state.lock().unwrap().calls.is_empty());
+    }
+
+    #[tokio::test]
+    async fn test_stop_enabled_scx_service() {
+        let state = shared_state(&[(SCX_UNIT, "enabled", "active")]);
+        let (client, _server) = mock_systemd(&state).await;
+        let manager = manager(&client).await.unwrap();
+
+        let scx_state = unit_states(&manager, &[SCX_UNIT]).await.unwrap().remove(0);
+        let action = stop_scx_service(&manager, &scx_state).await.unwrap();
+        assert_eq!(action, ScxServiceAction::Disabled);
+        assert_eq!(
+            state.lock().unwrap().calls,
+            ["DisableUnitFiles scx.service", "Reload", "StopUnit scx.service"]
+        );
+
+        let scx_state = unit_states(&manager, &[SCX_UNIT]).await.unwrap().remove(0);
+        assert!(!scx_state.is_enabled() && !scx_state.is_active());
+        assert_eq!(stop_scx_service(&manager, &scx_state).await.unwrap(), ScxServiceAction::None);
+    }
+
+    #[tokio::test]
+    async fn test_stop_active_scx_service() {
+        let state = shared_state(&[(SCX_UNIT, "disabled", "active")]);
+        let (client, _server) = mock_systemd(&state).await;
+        let manager = manager(&client).await.unwrap();
+
+        let scx_state = unit_states(&manager, &[SCX_UNIT]).await.unwrap().remove(0);
+        assert_eq!(
+            stop_scx_service(&manager, &scx_state).await.unwrap(),
+            ScxServiceAction::Stopped
+        );
+        assert_eq!(state.lock().unwrap().calls, ["StopUnit scx.service"]);
+    }
+
+    #[tokio::test]
+    async fn test_restore_scx_service() {
+        let state = shared_state(&[(SCX_UNIT, "enabled", "active")]);
+        let (client, _server) = mock_systemd(&state).await;
+        let manager = manager(&client).await.unwrap();
+
+        let scx_state = unit_states(&manager, &[SCX_UNIT]).await.unwrap().remove(0);
+        let action = stop_scx_service(&manager, &scx_state).await.unwrap();
+        state.lock().unwrap().calls.clear();
+
+        restore_scx_service(&manager, action).await.unwrap();
+        assert_eq!(
+            state.lock().unwrap().calls,
+            ["EnableUnitFiles scx.service force=true", "Reload", "StartUnit scx.service"]
+        );
+        let scx_state = unit_states(&manager, &[SCX_UNIT]).await.unwrap().remove(0);
+        assert!(scx_state.is_enabled() && scx_state.is_active());
+
+        restore_scx_service(&manager, ScxServiceAction::None).await.unwrap();
+        assert_eq!(state.lock().unwrap().calls.len(), 3);
+    }
+
+    #[tokio::test]
+    async fn test_enable_unit() {
+        let state = shared_state(&[(LOADER_UNIT, "disabled", "inactive")]);
+        let (client, _server) = mock_systemd(&state).await;
+        let manager = manager(&client).await.unwrap();
+
+        enable_unit(&manager, LOADER_UNIT).await.unwrap();
+        assert_eq!(
+            state.lock().unwrap().calls,
+            ["EnableUnitFiles scx_loader.service force=true", "Reload"]
+        );
+        assert!(unit_states(&manager, &[LOADER_UNIT]).await.unwrap()[0].is_enabled());
+    }
+}
@@ -0,0 +1,165 @@
+// Copyright (C) 2024-2025 Vladislav Nepogodin
+//
+// This file is part of CachyOS kernel manager.
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+
+// NOLINTBEGIN(bugprone-unhandled-exception-at-new)
+
+#include "history-panel.hpp"
+
+#include <array>   // for array
+#include <chrono>  // for seconds
+
+#if defined(__clang__)
+#pragma clang diagnostic push
+#pragma clang diagnostic ignored "-Wold-style-cast"
+#pragma clang diagnostic ignored "-Wfloat-conversion"
+#pragma clang diagnostic ignored "-Wdouble-promotion"
+#elif defined(__GNUC__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wnull-dereference"
+#pragma GCC diagnostic ignored "-Wuseless-cast"
+#pragma GCC diagnostic ignored "-Wold-style-cast"
+#pragma GCC diagnostic ignored "-Wsuggest-final-types"
+#pragma GCC diagnostic ignored "-Wsuggest-attribute=pure"
+#pragma GCC diagnostic ignored "-Wconversion"
+#endif
+
+#include <QCheckBox>
+#include <QDateTime>
+#include <QHeaderView>
+#include <QLabel>
+#include <QStringList>
+#include <QTableWidget>
+#include <QTimer>
+#include <QVBoxLayout>
+
+#if defined(__clang__)
+#pragma clang diagnostic pop
+#elif defined(__GNUC__)
+#pragma GCC diagnostic pop
+#endif
+
+namespace {
+
+using namespace std::chrono_literals;  // NOLINT
+
+constexpr auto kRefreshInterval = 2s;
+
+auto to_qstring(std::string_view str) noexcept -> QString {
+    return QString::fromUtf8(str.data(), static_cast<qsizetype>(str.size()));
+}
+
+auto format_details(const scx::history::Record& record) noexcept -> QString {
+    if (record.kind != scx::history::RecordKind::MetricSample) {
+        return to_qstring(record.text_view());
+    }
+    QStringList metric_texts;
+    for (std::size_t metric_idx = 0; metric_idx < scx::history::kMetricCount; ++metric_idx) {
+        const auto metric = static_cast<scx::history::Metric>(metric_idx);
+        if (const auto value = record.metric(metric); value) {
+            metric_texts << QStringLiteral("%1=%2").arg(to_qstring(scx::history::metric_name(metric))).arg(*value, 0, 'f', 2);
+        }
+    }
+    return metric_texts.join(QStringLiteral(", "));
+}
+
+}  // namespace
+
+namespace scxctl::impl {
+
+HistoryPanel::HistoryPanel(const scx::history::HistoryLog& history, QWidget* parent)
+  : QWidget(parent), m_history(history) {
+    auto* main_layout = new QVBoxLayout(this);
+    main_layout->setContentsMargins(0, 0, 0, 0);
+
+    if (!m_history.is_open()) {
+        main_layout->addWidget(new QLabel(tr("History file cannot be opened, see the log"), this));
+        return;
+    }
+
+    m_samples_check_box = new QCheckBox(tr("Show metric samples"), this);
+    main_layout->addWidget(m_samples_check_box);
+
+    m_table = new QTableWidget(0, 6, this);
+    m_table->setHorizontalHeaderLabels({tr("Time"), tr("Event"), tr("Source"), tr("Scheduler"), tr("Mode"), tr("Details")});
+    m_table->horizontalHeader()->setSectionResizeMode(QHeaderView::ResizeToContents);
+    m_table->horizontalHeader()->setStretchLastSection(true);
+    m_table->verticalHeader()->setVisible(false);
+    m_table->setEditTriggers(QAbstractItemView::NoEditTriggers);
+    main_layout->addWidget(m_table);
+
+    m_refresh_timer = new QTimer(this);
+    m_refresh_timer->setInterval(kRefreshInterval);
+    connect(m_refresh_timer, &QTimer::timeout, this, [this] { update_table(); });
+    connect(m_samples_check_box, &QCheckBox::toggled, this, [this] { update_table(true); });
+}
+
+HistoryPanel::~HistoryPanel() = default;
+
+void HistoryPanel::showEvent(QShowEvent* event) {
+    QWidget::showEvent(event);
+    if (m_refresh_timer != nullptr) {
+        update_table();
+        m_refresh_timer->start();
+    }
+}
+
+void HistoryPanel::hideEvent(QHideEvent* event) {
+    if (m_refresh_timer != nullptr) {
+        m_refresh_timer->stop();
+    }
+    QWidget::hideEvent(event);
+}
+
+void HistoryPanel::update_table(bool force) noexcept {
+    const auto written = m_history.written();
+    if (written == m_last_written && !force) {
+        return;
+    }
+    m_last_written = written;
+
+    const bool show_samples = m_samples_check_box->isChecked();
+    const auto records      = m_history.records();
+    int row{};
+    m_table->setRowCount(0);
+    for (auto record_it = records.rbegin(); record_it != records.rend() && row < kMaxRows; ++record_it) {
+        const auto& record = *record_it;
+        if (record.kind == scx::history::RecordKind::MetricSample && !show_samples) {
+            continue;
+        }
+        const auto sched_mode = record.mode();
+        const auto timestamp  = QDateTime::fromMSecsSinceEpoch(record.timestamp_ns / 1'000'000);
+        const std::array columns{
+            timestamp.toString(QStringLiteral("yyyy-MM-dd hh:mm:ss.zzz")),
+            to_qstring(scx::history::record_kind_name(record.kind)),
+            to_qstring(scx::history::source_name(record.source)),
+            to_qstring(record.scheduler_name()),
+            sched_mode ? to_qstring(scx::sched_mode_name(*sched_mode)) : QString{},
+            format_details(record),
+        };
+        m_table->insertRow(row);
+        for (std::size_t column = 0; column < columns.size(); ++column) {
+            m_table->setItem(row, static_cast<int>(column), new QTableWidgetItem(columns[column]));
+        }
+        ++row;
+    }
+}
+
+}  // namespace scxctl::impl
+
+// NOLINTEND(bugprone-unhandled-exception-at-new)
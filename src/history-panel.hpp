@@ -0,0 +1,84 @@
+// Copyright (C) 2024-2025 Vladislav Nepogodin
+//
+// This file is part of CachyOS kernel manager.
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+
+#ifndef HISTORY_PANEL_HPP_
+#define HISTORY_PANEL_HPP_
+
+#include "scx_history.hpp"
+
+#include <cstdint>
+
+#if defined(__clang__)
+#pragma clang diagnostic push
+#pragma clang diagnostic ignored "-Wsign-conversion"
+#elif defined(__GNUC__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wuseless-cast"
+#pragma GCC diagnostic ignored "-Wsign-conversion"
+#pragma GCC diagnostic ignored "-Wsuggest-final-methods"
+#pragma GCC diagnostic ignored "-Wsuggest-attribute=pure"
+#endif
+
+#include <QWidget>
+
+#if defined(__clang__)
+#pragma clang diagnostic pop
+#elif defined(__GNUC__)
+#pragma GCC diagnostic pop
+#endif
+
+class QCheckBox;
+class QTableWidget;
+class QTimer;
+
+namespace scxctl::impl {
+
+/// @brief Timeline of the history file, the newest records first.
+///
+/// Shows the records of the CLI and the policy daemon too, as they append to
+/// the same file. The file is polled only while the panel is visible, and the
+/// table is rebuilt only once new records were appended.
+class HistoryPanel final : public QWidget {
+    Q_OBJECT
+    Q_DISABLE_COPY_MOVE(HistoryPanel)
+ public:
+    explicit HistoryPanel(const scx::history::HistoryLog& history, QWidget* parent = nullptr);
+    ~HistoryPanel() override;
+
+ protected:
+    void showEvent(QShowEvent* event) override;
+    void hideEvent(QHideEvent* event) override;
+
+ private:
+    /// Older records are left for scx-manager-cli --history
+    static constexpr int kMaxRows = 500;
+
+    void update_table(bool force = false) noexcept;
+
+    const scx::history::HistoryLog& m_history;
+    std::uint64_t m_last_written{};
+
+    QCheckBox* m_samples_check_box{};
+    QTableWidget* m_table{};
+    QTimer* m_refresh_timer{};
+};
+
+}  // namespace scxctl::impl
+
+#endif  // HISTORY_PANEL_HPP_
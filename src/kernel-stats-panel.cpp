@@ -0,0 +1,212 @@
+// Copyright (C) 2024-2025 Vladislav Nepogodin
+//
+// This file is part of CachyOS kernel manager.
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+// NOLINTBEGIN(bugprone-unhandled-exception-at-new)
+
+#include "kernel-stats-panel.hpp"
+
+#include <algorithm>  // for minmax_element
+#include <chrono>     // for milliseconds
+
+#if defined(__clang__)
+#pragma clang diagnostic push
+#pragma clang diagnostic ignored "-Wold-style-cast"
+#pragma clang diagnostic ignored "-Wfloat-conversion"
+#pragma clang diagnostic ignored "-Wdouble-promotion"
+#elif defined(__GNUC__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wnull-dereference"
+#pragma GCC diagnostic ignored "-Wuseless-cast"
+#pragma GCC diagnostic ignored "-Wold-style-cast"
+#pragma GCC diagnostic ignored "-Wsuggest-final-types"
+#pragma GCC diagnostic ignored "-Wsuggest-attribute=pure"
+#pragma GCC diagnostic ignored "-Wconversion"
+#endif
+
+#include <QGridLayout>
+#include <QHBoxLayout>
+#include <QLabel>
+#include <QPainter>
+#include <QPainterPath>
+#include <QSpinBox>
+#include <QTimer>
+#include <QVBoxLayout>
+
+#if defined(__clang__)
+#pragma clang diagnostic pop
+#elif defined(__GNUC__)
+#pragma GCC diagnostic pop
+#endif
+
+namespace {
+
+constexpr int kDefaultIntervalMs = 1000;
+
+auto format_rate(double rate) noexcept -> QString {
+    return QStringLiteral("%1/s").arg(rate, 0, 'f', rate < 10. ? 2 : 0);
+}
+
+}  // namespace
+
+namespace scxctl::impl {
+
+SparklineWidget::SparklineWidget(QWidget* parent)
+  : QWidget(parent) {
+    setSizePolicy(QSizePolicy::Expanding, QSizePolicy::Fixed);
+}
+
+void SparklineWidget::set_values(std::vector<double>&& values) noexcept {
+    m_values = std::move(values);
+    update();
+}
+
+auto SparklineWidget::sizeHint() const -> QSize {
+    return {120, 18};
+}
+
+void SparklineWidget::paintEvent(QPaintEvent* /*event*/) {
+    if (m_values.size() < 2) {
+        return;
+    }
+
+    const auto [min_it, max_it] = std::ranges::minmax_element(m_values);
+    const double min_value      = *min_it;
+    const double value_range    = std::max(*max_it - min_value, 1e-9);
+
+    const auto draw_rect = QRectF(rect()).adjusted(1, 1, -1, -1);
+    const double x_step  = draw_rect.width() / static_cast<double>(m_values.size() - 1);
+
+    QPainterPath path;
+    for (std::size_t idx = 0; idx < m_values.size(); ++idx) {
+        const double x = draw_rect.left() + x_step * static_cast<double>(idx);
+        const double y = draw_rect.bottom() - (m_values[idx] - min_value) / value_range * draw_rect.height();
+        if (idx == 0) {
+            path.moveTo(x, y);
+        } else {
+            path.lineTo(x, y);
+        }
+    }
+
+    QPainter painter(this);
+    painter.setRenderHint(QPainter::Antialiasing);
+    painter.setPen(QPen(palette().color(QPalette::Highlight), 1.5));
+    painter.drawPath(path);
+}
+
+KernelStatsPanel::KernelStatsPanel(QWidget* parent)
+  : QWidget(parent), m_history(std::make_unique<scx::RingBuffer<scx::KernelStatsSample, kHistorySize>>()), m_sample_timer(new QTimer(this)) {
+    auto* main_layout = new QVBoxLayout(this);
+    main_layout->setContentsMargins(0, 0, 0, 0);
+
+    auto* interval_layout = new QHBoxLayout();
+    interval_layout->addWidget(new QLabel(tr("Sampling interval:"), this));
+    m_interval_spin_box = new QSpinBox(this);
+    m_interval_spin_box->setRange(100, 10000);
+    m_interval_spin_box->setSingleStep(100);
+    m_interval_spin_box->setSuffix(QStringLiteral(" ms"));
+    m_interval_spin_box->setValue(kDefaultIntervalMs);
+    interval_layout->addWidget(m_interval_spin_box);
+    main_layout->addLayout(interval_layout);
+
+    m_rows_layout = new QGridLayout();
+    m_rows_layout->setColumnStretch(2, 1);
+    main_layout->addLayout(m_rows_layout);
+    main_layout->addStretch();
+
+    m_sample_timer->setInterval(kDefaultIntervalMs);
+    connect(m_sample_timer, &QTimer::timeout, this, &KernelStatsPanel::on_sample);
+    connect(m_interval_spin_box, QOverload<int>::of(&QSpinBox::valueChanged), this, [this](int interval_ms) {
+        // rates are computed between neighbouring samples, mixed intervals are fine
+        m_sample_timer->setInterval(interval_ms);
+    });
+
+    on_sample();
+}
+
+KernelStatsPanel::~KernelStatsPanel() = default;
+
+void KernelStatsPanel::showEvent(QShowEvent* event) {
+    QWidget::showEvent(event);
+    m_sample_timer->start();
+}
+
+void KernelStatsPanel::hideEvent(QHideEvent* event) {
+    m_sample_timer->stop();
+    QWidget::hideEvent(event);
+}
+
+void KernelStatsPanel::on_sample() noexcept {
+    if (!m_sampler.sample(m_history->push())) {
+        return;
+    }
+    sync_rows();
+    update_rows();
+}
+
+void KernelStatsPanel::sync_rows() noexcept {
+    const auto& counters = m_sampler.counters();
+    // new events are discovered once scheduler is attached
+    while (m_rows.size() < counters.size()) {
+        const auto row_idx = static_cast<int>(m_rows.size());
+        const auto& name   = counters[m_rows.size()].name;
+
+        CounterRow row{
+            .name_label  = new QLabel(QString::fromStdString(name), this),
+            .value_label = new QLabel(this),
+            .sparkline   = new SparklineWidget(this),
+        };
+        row.value_label->setAlignment(Qt::AlignRight | Qt::AlignVCenter);
+        m_rows_layout->addWidget(row.name_label, row_idx, 0);
+        m_rows_layout->addWidget(row.value_label, row_idx, 1);
+        m_rows_layout->addWidget(row.sparkline, row_idx, 2);
+        m_rows.emplace_back(row);
+    }
+}
+
+void KernelStatsPanel::update_rows() noexcept {
+    const auto& counters = m_sampler.counters();
+    const auto& history  = *m_history;
+    const auto& latest   = history.back();
+
+    for (std::size_t counter_idx = 0; counter_idx < m_rows.size(); ++counter_idx) {
+        auto& row = m_rows[counter_idx];
+        if (!latest.valid.test(counter_idx)) {
+            row.value_label->setText(QStringLiteral("-"));
+            continue;
+        }
+
+        std::vector<double> values;
+        values.reserve(history.size());
+        if (counters[counter_idx].kind == scx::KernelCounterKind::Gauge) {
+            for (std::size_t idx = 0; idx < history.size(); ++idx) {
+                values.emplace_back(static_cast<double>(history[idx].values[counter_idx]));
+            }
+            row.value_label->setText(QString::number(latest.values[counter_idx]));
+        } else {
+            for (std::size_t idx = 1; idx < history.size(); ++idx) {
+                values.emplace_back(scx::KernelStatsSampler::rate(history[idx - 1], history[idx], counter_idx));
+            }
+            row.value_label->setText(values.empty() ? QString::number(latest.values[counter_idx]) : format_rate(values.back()));
+        }
+        row.sparkline->set_values(std::move(values));
+    }
+}
+
+}  // namespace scxctl::impl
+
+// NOLINTEND(bugprone-unhandled-exception-at-new)
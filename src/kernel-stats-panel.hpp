@@ -0,0 +1,117 @@
+// Copyright (C) 2024-2025 Vladislav Nepogodin
+//
+// This file is part of CachyOS kernel manager.
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+#ifndef KERNEL_STATS_PANEL_HPP_
+#define KERNEL_STATS_PANEL_HPP_
+
+#include "scx_kernel_stats.hpp"
+#include "scx_ring_buffer.hpp"
+
+#include <array>
+#include <memory>
+#include <vector>
+
+#if defined(__clang__)
+#pragma clang diagnostic push
+#pragma clang diagnostic ignored "-Wsign-conversion"
+#pragma clang diagnostic ignored "-Wfloat-conversion"
+#pragma clang diagnostic ignored "-Wdouble-promotion"
+#pragma clang diagnostic ignored "-Wimplicit-int-float-conversion"
+#pragma clang diagnostic ignored "-Wshorten-64-to-32"
+#elif defined(__GNUC__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wuseless-cast"
+#pragma GCC diagnostic ignored "-Wsign-conversion"
+#pragma GCC diagnostic ignored "-Wconversion"
+#pragma GCC diagnostic ignored "-Wsuggest-final-methods"
+#pragma GCC diagnostic ignored "-Wsuggest-attribute=pure"
+#endif
+
+#include <QWidget>
+
+#if defined(__clang__)
+#pragma clang diagnostic pop
+#elif defined(__GNUC__)
+#pragma GCC diagnostic pop
+#endif
+
+class QGridLayout;
+class QLabel;
+class QSpinBox;
+class QTimer;
+
+namespace scxctl::impl {
+
+/// @brief Draws history of the values as a line.
+class SparklineWidget final : public QWidget {
+    Q_OBJECT
+    Q_DISABLE_COPY_MOVE(SparklineWidget)
+ public:
+    explicit SparklineWidget(QWidget* parent = nullptr);
+    ~SparklineWidget() override = default;
+
+    void set_values(std::vector<double>&& values) noexcept;
+
+    [[nodiscard]] auto sizeHint() const -> QSize override;
+
+ protected:
+    void paintEvent(QPaintEvent* event) override;
+
+ private:
+    std::vector<double> m_values{};
+};
+
+/// @brief Shows sched_ext health counters as rates, sampled at configurable interval.
+///
+/// Sampling only runs while the panel is visible.
+class KernelStatsPanel final : public QWidget {
+    Q_OBJECT
+    Q_DISABLE_COPY_MOVE(KernelStatsPanel)
+ public:
+    explicit KernelStatsPanel(QWidget* parent = nullptr);
+    ~KernelStatsPanel() override;
+
+ protected:
+    void showEvent(QShowEvent* event) override;
+    void hideEvent(QHideEvent* event) override;
+
+ private:
+    static constexpr std::size_t kHistorySize = 120;
+
+    struct CounterRow {
+        QLabel* name_label{};
+        QLabel* value_label{};
+        SparklineWidget* sparkline{};
+    };
+
+    void on_sample() noexcept;
+    void sync_rows() noexcept;
+    void update_rows() noexcept;
+
+    scx::KernelStatsSampler m_sampler{};
+    std::unique_ptr<scx::RingBuffer<scx::KernelStatsSample, kHistorySize>> m_history;
+    std::vector<CounterRow> m_rows{};
+
+    QGridLayout* m_rows_layout{};
+    QSpinBox* m_interval_spin_box{};
+    QTimer* m_sample_timer{};
+};
+
+}  // namespace scxctl::impl
+
+#endif  // KERNEL_STATS_PANEL_HPP_
@@ -0,0 +1,249 @@
+// Copyright (C) 2024-2025 Vladislav Nepogodin
+//
+// This file is part of CachyOS kernel manager.
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+// NOLINTBEGIN(bugprone-unhandled-exception-at-new)
+
+#include "latency-probe-panel.hpp"
+
+#include <array>   // for array
+#include <chrono>  // for microseconds
+
+#if defined(__clang__)
+#pragma clang diagnostic push
+#pragma clang diagnostic ignored "-Wold-style-cast"
+#pragma clang diagnostic ignored "-Wfloat-conversion"
+#pragma clang diagnostic ignored "-Wdouble-promotion"
+#elif defined(__GNUC__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wnull-dereference"
+#pragma GCC diagnostic ignored "-Wuseless-cast"
+#pragma GCC diagnostic ignored "-Wold-style-cast"
+#pragma GCC diagnostic ignored "-Wsuggest-final-types"
+#pragma GCC diagnostic ignored "-Wsuggest-attribute=pure"
+#pragma GCC diagnostic ignored "-Wconversion"
+#endif
+
+#include <QComboBox>
+#include <QFile>
+#include <QFileDialog>
+#include <QHBoxLayout>
+#include <QHeaderView>
+#include <QLabel>
+#include <QLineEdit>
+#include <QMessageBox>
+#include <QPushButton>
+#include <QSpinBox>
+#include <QTableWidget>
+#include <QTimer>
+#include <QVBoxLayout>
+
+#if defined(__clang__)
+#pragma clang diagnostic pop
+#elif defined(__GNUC__)
+#pragma GCC diagnostic pop
+#endif
+
+namespace {
+
+using namespace std::chrono_literals;  // NOLINT
+
+constexpr auto kRefreshInterval = 500ms;
+
+auto format_micros(std::chrono::nanoseconds duration) noexcept -> QString {
+    return QString::number(std::chrono::duration<double, std::micro>(duration).count(), 'f', 1);
+}
+
+auto find_all_cpus_summary(const std::vector<scx::CpuLatencySummary>& summaries) noexcept -> const scx::CpuLatencySummary* {
+    // summary of all CPUs goes last
+    return summaries.empty() ? nullptr : &summaries.back();
+}
+
+}  // namespace
+
+namespace scxctl::impl {
+
+LatencyProbePanel::LatencyProbePanel(QWidget* parent)
+  : QWidget(parent), m_refresh_timer(new QTimer(this)) {
+    auto* main_layout = new QVBoxLayout(this);
+    main_layout->setContentsMargins(0, 0, 0, 0);
+
+    auto* controls_layout = new QHBoxLayout();
+    controls_layout->addWidget(new QLabel(tr("CPUs:"), this));
+    m_cpus_edit = new QLineEdit(this);
+    m_cpus_edit->setPlaceholderText(tr("all, or e.g 0-3,8"));
+    controls_layout->addWidget(m_cpus_edit);
+
+    controls_layout->addWidget(new QLabel(tr("Interval:"), this));
+    m_interval_spin_box = new QSpinBox(this);
+    m_interval_spin_box->setRange(100, 100000);
+    m_interval_spin_box->setSingleStep(100);
+    m_interval_spin_box->setSuffix(QStringLiteral(" us"));
+    m_interval_spin_box->setValue(static_cast<int>(m_options.interval.count()));
+    controls_layout->addWidget(m_interval_spin_box);
+
+    controls_layout->addWidget(new QLabel(tr("Background load:"), this));
+    m_load_combo_box = new QComboBox(this);
+    m_load_combo_box->addItem(tr("None"), -1);
+    for (std::size_t idx = 0; idx < scx::bench::kAllWorkloads.size(); ++idx) {
+        const auto name = scx::bench::workload_name(scx::bench::kAllWorkloads[idx]);
+        m_load_combo_box->addItem(QString::fromUtf8(name.data(), static_cast<qsizetype>(name.size())), static_cast<int>(idx));
+    }
+    controls_layout->addWidget(m_load_combo_box);
+
+    m_start_button = new QPushButton(tr("Start"), this);
+    controls_layout->addWidget(m_start_button);
+    m_export_button = new QPushButton(tr("Export..."), this);
+    m_export_button->setEnabled(false);
+    controls_layout->addWidget(m_export_button);
+    main_layout->addLayout(controls_layout);
+
+    m_table = new QTableWidget(0, 6, this);
+    m_table->setHorizontalHeaderLabels({tr("CPU"), tr("Samples"), tr("p50, us"), tr("p99, us"), tr("p99.9, us"), tr("Max, us")});
+    m_table->horizontalHeader()->setSectionResizeMode(QHeaderView::Stretch);
+    m_table->verticalHeader()->setVisible(false);
+    m_table->setEditTriggers(QAbstractItemView::NoEditTriggers);
+    main_layout->addWidget(m_table);
+
+    m_previous_run_label = new QLabel(this);
+    m_previous_run_label->setVisible(false);
+    main_layout->addWidget(m_previous_run_label);
+
+    m_refresh_timer->setInterval(kRefreshInterval);
+    connect(m_refresh_timer, &QTimer::timeout, this, &LatencyProbePanel::update_table);
+    connect(m_start_button, &QPushButton::clicked, this, &LatencyProbePanel::on_start_stop);
+    connect(m_export_button, &QPushButton::clicked, this, &LatencyProbePanel::on_export);
+}
+
+LatencyProbePanel::~LatencyProbePanel() = default;
+
+void LatencyProbePanel::set_scheduler_label(const QString& label) noexcept {
+    if (label == m_scheduler_label) {
+        return;
+    }
+    if (m_probe.is_running()) {
+        // results must not mix two schedulers
+        restart_probe();
+    }
+    m_scheduler_label = label;
+}
+
+void LatencyProbePanel::on_start_stop() noexcept {
+    if (m_probe.is_running()) {
+        m_probe.stop();
+        m_refresh_timer->stop();
+        update_table();
+        m_start_button->setText(tr("Start"));
+        return;
+    }
+
+    const auto cpus_text = m_cpus_edit->text().trimmed();
+    auto cpus            = scx::parse_cpu_list(cpus_text.toStdString());
+    if (!cpus) {
+        QMessageBox::warning(this, "CachyOS Kernel Manager", tr("Invalid CPU list: %1").arg(cpus_text));
+        return;
+    }
+
+    const auto load_idx = m_load_combo_box->currentData().toInt();
+    m_options = scx::LatencyProbeOptions{
+        .cpus            = std::move(*cpus),
+        .interval        = std::chrono::microseconds{m_interval_spin_box->value()},
+        .background_load = (load_idx < 0) ? std::nullopt : std::optional{scx::bench::kAllWorkloads[static_cast<std::size_t>(load_idx)]},
+    };
+    restart_probe();
+}
+
+void LatencyProbePanel::restart_probe() noexcept {
+    // keep results of the finished run around to compare against
+    auto summaries = m_probe.summaries();
+    if (const auto* all_cpus = find_all_cpus_summary(summaries); all_cpus != nullptr && all_cpus->count != 0) {
+        m_previous_summaries = std::move(summaries);
+        m_previous_label     = m_scheduler_label;
+        update_previous_label();
+    }
+
+    if (!m_probe.start(m_options)) {
+        QMessageBox::critical(this, "CachyOS Kernel Manager", tr("Cannot start latency probe"));
+        return;
+    }
+    m_refresh_timer->start();
+    m_start_button->setText(tr("Stop"));
+    m_export_button->setEnabled(true);
+}
+
+void LatencyProbePanel::on_export() noexcept {
+    const auto file_path = QFileDialog::getSaveFileName(this, tr("Export latency results"), QStringLiteral("latency.csv"), tr("CSV files (*.csv)"));
+    if (file_path.isEmpty()) {
+        return;
+    }
+
+    const auto summaries = m_probe.summaries();
+    auto csv             = scx::latency_summaries_to_csv(summaries, m_scheduler_label.toStdString());
+    if (!m_previous_summaries.empty()) {
+        csv += scx::latency_summaries_to_csv(m_previous_summaries, m_previous_label.toStdString(), false);
+    }
+
+    QFile file(file_path);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        QMessageBox::critical(this, "CachyOS Kernel Manager", tr("Cannot write %1: %2").arg(file_path, file.errorString()));
+        return;
+    }
+    file.write(csv.data(), static_cast<qint64>(csv.size()));
+}
+
+void LatencyProbePanel::update_table() noexcept {
+    const auto summaries = m_probe.summaries();
+    m_table->setRowCount(static_cast<int>(summaries.size()));
+    for (std::size_t idx = 0; idx < summaries.size(); ++idx) {
+        const auto& summary = summaries[idx];
+        const auto row      = static_cast<int>(idx);
+
+        const std::array columns{
+            (summary.cpu < 0) ? tr("All") : QString::number(summary.cpu),
+            QString::number(summary.count),
+            format_micros(summary.p50),
+            format_micros(summary.p99),
+            format_micros(summary.p999),
+            format_micros(summary.max),
+        };
+        for (std::size_t column = 0; column < columns.size(); ++column) {
+            auto* item = m_table->item(row, static_cast<int>(column));
+            if (item == nullptr) {
+                item = new QTableWidgetItem();
+                item->setTextAlignment(Qt::AlignRight | Qt::AlignVCenter);
+                m_table->setItem(row, static_cast<int>(column), item);
+            }
+            item->setText(columns[column]);
+        }
+    }
+}
+
+void LatencyProbePanel::update_previous_label() noexcept {
+    const auto* all_cpus = find_all_cpus_summary(m_previous_summaries);
+    if (all_cpus == nullptr) {
+        m_previous_run_label->setVisible(false);
+        return;
+    }
+    m_previous_run_label->setText(tr("Previous run (%1): p50 %2 us, p99 %3 us, p99.9 %4 us, max %5 us")
+                                      .arg(m_previous_label.isEmpty() ? tr("unknown") : m_previous_label, format_micros(all_cpus->p50),
+                                          format_micros(all_cpus->p99), format_micros(all_cpus->p999), format_micros(all_cpus->max)));
+    m_previous_run_label->setVisible(true);
+}
+
+}  // namespace scxctl::impl
+
+// NOLINTEND(bugprone-unhandled-exception-at-new)
@@ -0,0 +1,99 @@
+// Copyright (C) 2024-2025 Vladislav Nepogodin
+//
+// This file is part of CachyOS kernel manager.
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+#ifndef LATENCY_PROBE_PANEL_HPP_
+#define LATENCY_PROBE_PANEL_HPP_
+
+#include "scx_latency_probe.hpp"
+
+#include <vector>
+
+#if defined(__clang__)
+#pragma clang diagnostic push
+#pragma clang diagnostic ignored "-Wsign-conversion"
+#pragma clang diagnostic ignored "-Wfloat-conversion"
+#pragma clang diagnostic ignored "-Wdouble-promotion"
+#pragma clang diagnostic ignored "-Wimplicit-int-float-conversion"
+#pragma clang diagnostic ignored "-Wshorten-64-to-32"
+#elif defined(__GNUC__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wuseless-cast"
+#pragma GCC diagnostic ignored "-Wsign-conversion"
+#pragma GCC diagnostic ignored "-Wconversion"
+#pragma GCC diagnostic ignored "-Wsuggest-final-methods"
+#pragma GCC diagnostic ignored "-Wsuggest-attribute=pure"
+#endif
+
+#include <QWidget>
+
+#if defined(__clang__)
+#pragma clang diagnostic pop
+#elif defined(__GNUC__)
+#pragma GCC diagnostic pop
+#endif
+
+class QComboBox;
+class QLabel;
+class QLineEdit;
+class QPushButton;
+class QSpinBox;
+class QTableWidget;
+class QTimer;
+
+namespace scxctl::impl {
+
+/// @brief Runs the wakeup latency probe and shows its results per CPU.
+///
+/// When the scheduler changes during the run, results so far are kept as
+/// the previous run, and measuring starts over for the new scheduler.
+class LatencyProbePanel final : public QWidget {
+    Q_OBJECT
+    Q_DISABLE_COPY_MOVE(LatencyProbePanel)
+ public:
+    explicit LatencyProbePanel(QWidget* parent = nullptr);
+    ~LatencyProbePanel() override;
+
+    /// @brief Sets label of the scheduler being measured, e.g "scx_lavd (Gaming)".
+    void set_scheduler_label(const QString& label) noexcept;
+
+ private:
+    void on_start_stop() noexcept;
+    void on_export() noexcept;
+    void update_table() noexcept;
+    void update_previous_label() noexcept;
+    void restart_probe() noexcept;
+
+    scx::LatencyProbe m_probe{};
+    scx::LatencyProbeOptions m_options{};
+    QString m_scheduler_label{};
+    std::vector<scx::CpuLatencySummary> m_previous_summaries{};
+    QString m_previous_label{};
+
+    QLineEdit* m_cpus_edit{};
+    QSpinBox* m_interval_spin_box{};
+    QComboBox* m_load_combo_box{};
+    QPushButton* m_start_button{};
+    QPushButton* m_export_button{};
+    QTableWidget* m_table{};
+    QLabel* m_previous_run_label{};
+    QTimer* m_refresh_timer{};
+};
+
+}  // namespace scxctl::impl
+
+#endif  // LATENCY_PROBE_PANEL_HPP_
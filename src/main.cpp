@@ -17,6 +17,9 @@
 // 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
 
 #include "schedext-window.hpp"
+#include "startup-trace.hpp"
+
+#include <cstring>  // for strcmp
 
 #include <QApplication>
 #include <QTranslator>
@@ -94,6 +97,13 @@ void initTranslations(QTranslator& qtTranslatorBase, QTranslator& qtTranslator,
 }  // namespace
 
 auto main(int argc, char** argv) -> std::int32_t {
+    // checked before Qt is initialized, so its startup is traced as well
+    for (int arg_idx = 1; arg_idx < argc; ++arg_idx) {
+        if (std::strcmp(argv[arg_idx], "--trace-startup") == 0) {  // NOLINT
+            scxctl::detail::enable_startup_trace();
+        }
+    }
+
     /// 1. Basic Qt initialization (not dependent on parameters or configuration)
 #if (QT_VERSION < QT_VERSION_CHECK(6, 0, 0))
     // Generate high-dpi pixmaps
@@ -109,6 +119,7 @@ auto main(int argc, char** argv) -> std::int32_t {
 
     // Set application attributes
     const QApplication app(argc, argv);
+    scxctl::detail::trace_startup("QApplication created");
 
     /// 3. Initialization of translations
     QTranslator qtTranslatorBase;
@@ -116,8 +127,11 @@ auto main(int argc, char** argv) -> std::int32_t {
     QTranslator translatorBase;
     QTranslator translator;
     initTranslations(qtTranslatorBase, qtTranslator, translatorBase, translator);
+    scxctl::detail::trace_startup("translations loaded");
 
     scxctl::SchedExtWindow w;
+    scxctl::detail::trace_startup("window constructed");
     w.show();
+    scxctl::detail::trace_startup("window shown");
     return app.exec();  // NOLINT
 }
@@ -0,0 +1,204 @@
+// Copyright (C) 2024-2025 Vladislav Nepogodin
+//
+// This file is part of CachyOS kernel manager.
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+// NOLINTBEGIN(bugprone-unhandled-exception-at-new)
+
+#include "process-schedstat-panel.hpp"
+
+#include <algorithm>  // for partial_sort, min
+#include <array>      // for array
+#include <chrono>     // for duration
+#include <numeric>    // for iota
+
+#if defined(__clang__)
+#pragma clang diagnostic push
+#pragma clang diagnostic ignored "-Wold-style-cast"
+#pragma clang diagnostic ignored "-Wfloat-conversion"
+#pragma clang diagnostic ignored "-Wdouble-promotion"
+#elif defined(__GNUC__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wnull-dereference"
+#pragma GCC diagnostic ignored "-Wuseless-cast"
+#pragma GCC diagnostic ignored "-Wold-style-cast"
+#pragma GCC diagnostic ignored "-Wsuggest-final-types"
+#pragma GCC diagnostic ignored "-Wsuggest-attribute=pure"
+#pragma GCC diagnostic ignored "-Wconversion"
+#endif
+
+#include <QHBoxLayout>
+#include <QHeaderView>
+#include <QLabel>
+#include <QLineEdit>
+#include <QMessageBox>
+#include <QPushButton>
+#include <QTableWidget>
+#include <QTimer>
+#include <QVBoxLayout>
+
+#if defined(__clang__)
+#pragma clang diagnostic pop
+#elif defined(__GNUC__)
+#pragma GCC diagnostic pop
+#endif
+
+namespace {
+
+using namespace std::chrono_literals;  // NOLINT
+
+constexpr auto kSampleInterval = 1s;
+/// Only the threads waiting the most are shown
+constexpr std::size_t kMaxShownThreads = 32;
+
+auto format_micros(std::chrono::nanoseconds duration) noexcept -> QString {
+    return QString::number(std::chrono::duration<double, std::micro>(duration).count(), 'f', 1);
+}
+
+template <std::size_t N>
+void set_row(QTableWidget* table, int row, const std::array<QString, N>& columns) noexcept {
+    for (std::size_t column = 0; column < columns.size(); ++column) {
+        auto* item = table->item(row, static_cast<int>(column));
+        if (item == nullptr) {
+            item = new QTableWidgetItem();
+            item->setTextAlignment(Qt::AlignRight | Qt::AlignVCenter);
+            table->setItem(row, static_cast<int>(column), item);
+        }
+        item->setText(columns[column]);
+    }
+}
+
+auto make_table(const QStringList& headers, QWidget* parent) noexcept -> QTableWidget* {
+    auto* table = new QTableWidget(0, static_cast<int>(headers.size()), parent);
+    table->setHorizontalHeaderLabels(headers);
+    table->horizontalHeader()->setSectionResizeMode(QHeaderView::Stretch);
+    table->verticalHeader()->setVisible(false);
+    table->setEditTriggers(QAbstractItemView::NoEditTriggers);
+    return table;
+}
+
+}  // namespace
+
+namespace scxctl::impl {
+
+ProcessSchedstatPanel::ProcessSchedstatPanel(QWidget* parent)
+  : QWidget(parent), m_sample_timer(new QTimer(this)) {
+    auto* main_layout = new QVBoxLayout(this);
+    main_layout->setContentsMargins(0, 0, 0, 0);
+
+    auto* controls_layout = new QHBoxLayout();
+    controls_layout->addWidget(new QLabel(tr("Process:"), this));
+    m_process_edit = new QLineEdit(this);
+    m_process_edit->setPlaceholderText(tr("PID or name, e.g 1234 or wine64-preloader"));
+    controls_layout->addWidget(m_process_edit);
+    m_attach_button = new QPushButton(tr("Attach"), this);
+    controls_layout->addWidget(m_attach_button);
+    m_status_label = new QLabel(this);
+    controls_layout->addWidget(m_status_label, 1);
+    main_layout->addLayout(controls_layout);
+
+    m_threads_table = make_table({tr("Thread"), tr("Name"), tr("Run, ms/s"), tr("Wait, ms/s"), tr("Wait per slice, us")}, this);
+    main_layout->addWidget(m_threads_table);
+    m_summary_table = make_table({tr("Scheduler"), tr("Time, s"), tr("Run, ms/s"), tr("Wait, ms/s"), tr("p50 wait per slice, us"), tr("p99 wait per slice, us")}, this);
+    main_layout->addWidget(m_summary_table);
+
+    m_sample_timer->setInterval(kSampleInterval);
+    connect(m_sample_timer, &QTimer::timeout, this, &ProcessSchedstatPanel::on_sample);
+    connect(m_attach_button, &QPushButton::clicked, this, &ProcessSchedstatPanel::on_attach_detach);
+    connect(m_process_edit, &QLineEdit::returnPressed, this, &ProcessSchedstatPanel::on_attach_detach);
+}
+
+ProcessSchedstatPanel::~ProcessSchedstatPanel() = default;
+
+void ProcessSchedstatPanel::set_scheduler_label(const QString& label) noexcept {
+    m_sampler.set_label(label.toStdString());
+}
+
+void ProcessSchedstatPanel::on_attach_detach() noexcept {
+    if (m_sampler.pid() > 0) {
+        m_sample_timer->stop();
+        m_sampler.detach();
+        m_status_label->setText(tr("Detached"));
+        m_attach_button->setText(tr("Attach"));
+        return;
+    }
+
+    const auto process_text = m_process_edit->text().trimmed();
+    const auto pid          = scx::find_process(process_text.toStdString());
+    if (!pid || !m_sampler.attach(*pid)) {
+        QMessageBox::warning(this, "CachyOS Kernel Manager", tr("Cannot find process: %1").arg(process_text));
+        return;
+    }
+    m_status_label->setText(tr("Attached to %1, %2 threads").arg(*pid).arg(m_sampler.thread_count()));
+    m_attach_button->setText(tr("Detach"));
+    m_sample_timer->start();
+}
+
+void ProcessSchedstatPanel::on_sample() noexcept {
+    const auto pid = m_sampler.pid();
+    if (!m_sampler.sample()) {
+        m_sample_timer->stop();
+        m_status_label->setText(tr("Process %1 has exited").arg(pid));
+        m_attach_button->setText(tr("Attach"));
+        update_summary_table();
+        return;
+    }
+    m_status_label->setText(tr("Attached to %1, %2 threads").arg(pid).arg(m_sampler.thread_count()));
+    update_threads_table();
+    update_summary_table();
+}
+
+void ProcessSchedstatPanel::update_threads_table() noexcept {
+    m_thread_order.resize(m_sampler.thread_count());
+    std::iota(m_thread_order.begin(), m_thread_order.end(), std::size_t{0});
+    const auto shown_count = std::min(m_thread_order.size(), kMaxShownThreads);
+    std::ranges::partial_sort(m_thread_order, m_thread_order.begin() + static_cast<std::ptrdiff_t>(shown_count),
+        [this](std::size_t lhs, std::size_t rhs) { return m_sampler.thread(lhs).wait_rate > m_sampler.thread(rhs).wait_rate; });
+
+    m_threads_table->setRowCount(static_cast<int>(shown_count));
+    for (std::size_t row = 0; row < shown_count; ++row) {
+        const auto& thread = m_sampler.thread(m_thread_order[row]);
+        set_row(m_threads_table, static_cast<int>(row),
+            std::array{
+                QString::number(thread.tid),
+                QString::fromStdString(thread.comm),
+                QString::number(thread.run_rate, 'f', 1),
+                QString::number(thread.wait_rate, 'f', 1),
+                thread.delay_per_slice ? format_micros(*thread.delay_per_slice) : QStringLiteral("-"),
+            });
+    }
+}
+
+void ProcessSchedstatPanel::update_summary_table() noexcept {
+    const auto summaries = m_sampler.summaries();
+    m_summary_table->setRowCount(static_cast<int>(summaries.size()));
+    for (std::size_t row = 0; row < summaries.size(); ++row) {
+        const auto& summary = summaries[row];
+        set_row(m_summary_table, static_cast<int>(row),
+            std::array{
+                QString::fromStdString(summary.label),
+                QString::number(std::chrono::duration<double>(summary.elapsed).count(), 'f', 0),
+                QString::number(summary.run_rate, 'f', 1),
+                QString::number(summary.wait_rate, 'f', 1),
+                format_micros(summary.delay_p50),
+                format_micros(summary.delay_p99),
+            });
+    }
+}
+
+}  // namespace scxctl::impl
+
+// NOLINTEND(bugprone-unhandled-exception-at-new)
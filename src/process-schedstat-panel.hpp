@@ -0,0 +1,92 @@
+// Copyright (C) 2024-2025 Vladislav Nepogodin
+//
+// This file is part of CachyOS kernel manager.
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+#ifndef PROCESS_SCHEDSTAT_PANEL_HPP_
+#define PROCESS_SCHEDSTAT_PANEL_HPP_
+
+#include "scx_process_schedstat.hpp"
+
+#include <vector>
+
+#if defined(__clang__)
+#pragma clang diagnostic push
+#pragma clang diagnostic ignored "-Wsign-conversion"
+#pragma clang diagnostic ignored "-Wfloat-conversion"
+#pragma clang diagnostic ignored "-Wdouble-promotion"
+#pragma clang diagnostic ignored "-Wimplicit-int-float-conversion"
+#pragma clang diagnostic ignored "-Wshorten-64-to-32"
+#elif defined(__GNUC__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wuseless-cast"
+#pragma GCC diagnostic ignored "-Wsign-conversion"
+#pragma GCC diagnostic ignored "-Wconversion"
+#pragma GCC diagnostic ignored "-Wsuggest-final-methods"
+#pragma GCC diagnostic ignored "-Wsuggest-attribute=pure"
+#endif
+
+#include <QWidget>
+
+#if defined(__clang__)
+#pragma clang diagnostic pop
+#elif defined(__GNUC__)
+#pragma GCC diagnostic pop
+#endif
+
+class QLabel;
+class QLineEdit;
+class QPushButton;
+class QTableWidget;
+class QTimer;
+
+namespace scxctl::impl {
+
+/// @brief Shows run-queue wait of the threads of a single process.
+///
+/// The wait is accumulated per scheduler and mode, so changing them while
+/// the process runs shows whether the change cut its wait.
+class ProcessSchedstatPanel final : public QWidget {
+    Q_OBJECT
+    Q_DISABLE_COPY_MOVE(ProcessSchedstatPanel)
+ public:
+    explicit ProcessSchedstatPanel(QWidget* parent = nullptr);
+    ~ProcessSchedstatPanel() override;
+
+    /// @brief Sets label of the running scheduler, e.g "scx_lavd (Gaming)".
+    void set_scheduler_label(const QString& label) noexcept;
+
+ private:
+    void on_attach_detach() noexcept;
+    void on_sample() noexcept;
+    void update_threads_table() noexcept;
+    void update_summary_table() noexcept;
+
+    scx::ProcessSchedstatSampler m_sampler{};
+    /// Threads ordered by their wait, reused between samples
+    std::vector<std::size_t> m_thread_order{};
+
+    QLineEdit* m_process_edit{};
+    QPushButton* m_attach_button{};
+    QLabel* m_status_label{};
+    QTableWidget* m_threads_table{};
+    QTableWidget* m_summary_table{};
+    QTimer* m_sample_timer{};
+};
+
+}  // namespace scxctl::impl
+
+#endif  // PROCESS_SCHEDSTAT_PANEL_HPP_
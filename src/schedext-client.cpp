@@ -0,0 +1,228 @@
+// Copyright (C) 2024-2025 Vladislav Nepogodin
+//
+// This file is part of CachyOS kernel manager.
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+// NOLINTBEGIN(bugprone-unhandled-exception-at-new)
+
+#include "schedext-client.hpp"
+#include "scx_utils.hpp"
+
+#include <cstdint>      // for uint64_t
+#include <optional>     // for optional
+#include <string>       // for string
+#include <string_view>  // for string_view
+#include <utility>      // for move, forward
+
+#include <unistd.h>  // for read, close
+
+#if defined(__clang__)
+#pragma clang diagnostic push
+#pragma clang diagnostic ignored "-Wold-style-cast"
+#elif defined(__GNUC__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wnull-dereference"
+#pragma GCC diagnostic ignored "-Wuseless-cast"
+#pragma GCC diagnostic ignored "-Wold-style-cast"
+#pragma GCC diagnostic ignored "-Wsuggest-final-types"
+#pragma GCC diagnostic ignored "-Wsuggest-attribute=pure"
+#pragma GCC diagnostic ignored "-Wconversion"
+#endif
+
+#include <QSocketNotifier>
+#include <QThreadPool>
+#include <QtConcurrent>
+
+#if defined(__clang__)
+#pragma clang diagnostic pop
+#elif defined(__GNUC__)
+#pragma GCC diagnostic pop
+#endif
+
+namespace {
+
+constexpr std::string_view kDefaultConfigPath{"/etc/scx_loader.toml"};
+
+static_assert(static_cast<int>(scxctl::SchedMode::Auto) == static_cast<int>(scx::SchedMode::Auto));
+static_assert(static_cast<int>(scxctl::SchedMode::Gaming) == static_cast<int>(scx::SchedMode::Gaming));
+static_assert(static_cast<int>(scxctl::SchedMode::PowerSave) == static_cast<int>(scx::SchedMode::PowerSave));
+static_assert(static_cast<int>(scxctl::SchedMode::LowLatency) == static_cast<int>(scx::SchedMode::LowLatency));
+static_assert(static_cast<int>(scxctl::SchedMode::Server) == static_cast<int>(scx::SchedMode::Server));
+
+constexpr auto to_sched_mode(scxctl::SchedMode sched_mode) noexcept -> scx::SchedMode {
+    return static_cast<scx::SchedMode>(sched_mode);
+}
+
+constexpr auto from_sched_mode(scx::SchedMode sched_mode) noexcept -> scxctl::SchedMode {
+    return static_cast<scxctl::SchedMode>(sched_mode);
+}
+
+}  // namespace
+
+namespace scxctl::impl {
+
+/// State shared with the worker thread.
+///
+/// The config is created and used only by the calls running in the pool, which
+/// runs one of them at a time, so it needs no locking.
+class SchedExtClient final {
+ public:
+    explicit SchedExtClient(std::string config_path) noexcept
+      : m_config_path(std::move(config_path)) {
+        // the config caches flags without synchronization, calls must not overlap
+        m_pool.setMaxThreadCount(1);
+    }
+
+    /// Runs the call in the pool, with the config or nullptr if it cannot be initialized.
+    template <typename F>
+    auto run(F&& func) {
+        return QtConcurrent::run(&m_pool, [this, func = std::forward<F>(func)] { return func(config()); });
+    }
+
+    void wait_for_calls() noexcept {
+        m_pool.waitForDone();
+    }
+
+    [[nodiscard]] auto config_path() const noexcept -> const std::string& { return m_config_path; }
+
+    int loader_fd{-1};
+    QSocketNotifier* loader_notifier{};
+    std::optional<SchedulerState> last_state{};
+
+ private:
+    /// Initializes the config on the first call, parsing it and connecting to the bus blocks.
+    auto config() noexcept -> scx::loader::Config* {
+        if (!m_config && !m_is_init_failed) {
+            m_config         = scx::loader::Config::init_config(m_config_path);
+            m_is_init_failed = !m_config.has_value();
+        }
+        return m_config ? &*m_config : nullptr;
+    }
+
+    std::string m_config_path;
+    std::optional<scx::loader::Config> m_config{};
+    bool m_is_init_failed{};
+    // declared last, so that the calls in flight finish before the config is destroyed
+    QThreadPool m_pool;
+};
+
+}  // namespace scxctl::impl
+
+namespace scxctl {
+
+SchedExtClient::SchedExtClient(QObject* parent)
+  : SchedExtClient(QString::fromUtf8(kDefaultConfigPath.data(), static_cast<qsizetype>(kDefaultConfigPath.size())), parent) {
+}
+
+SchedExtClient::SchedExtClient(const QString& config_path, QObject* parent)
+  : QObject(parent), m_impl(new impl::SchedExtClient(config_path.toStdString())) {
+    // subscribing is a D-Bus round trip too, the notifier is set up once it is done
+    m_impl->run([](scx::loader::Config* config) -> std::optional<int> {
+              return config != nullptr ? config->watch_loader_state() : std::nullopt;
+          })
+        .then(this, [this](std::optional<int> loader_fd) {
+            if (!loader_fd) {
+                return;
+            }
+            m_impl->loader_fd       = *loader_fd;
+            m_impl->loader_notifier = new QSocketNotifier(*loader_fd, QSocketNotifier::Read, this);
+            connect(m_impl->loader_notifier, &QSocketNotifier::activated, this, &SchedExtClient::on_loader_event);
+        });
+}
+
+SchedExtClient::~SchedExtClient() {
+    m_impl->wait_for_calls();
+    if (m_impl->loader_fd >= 0) {
+        // the notifier must not outlive its descriptor
+        delete m_impl->loader_notifier;
+        ::close(m_impl->loader_fd);
+    }
+    delete m_impl;
+    m_impl = nullptr;
+}
+
+auto SchedExtClient::supported_schedulers() -> QFuture<std::optional<QStringList>> {
+    return m_impl->run([](scx::loader::Config* config) -> std::optional<QStringList> {
+        return config != nullptr ? config->get_supported_scheds() : std::nullopt;
+    });
+}
+
+auto SchedExtClient::current_state() -> QFuture<std::optional<SchedulerState>> {
+    return m_impl->run([](scx::loader::Config* config) -> std::optional<SchedulerState> {
+        if (config == nullptr) {
+            return std::nullopt;
+        }
+        auto snapshot = config->get_loader_snapshot();
+        if (!snapshot) {
+            return std::nullopt;
+        }
+        SchedulerState state{.mode = from_sched_mode(snapshot->current_mode)};
+        if (snapshot->current_sched != "unknown") {
+            state.scheduler = QString::fromStdString(snapshot->current_sched);
+        }
+        return state;
+    });
+}
+
+auto SchedExtClient::scheduler_flags(const QString& scheduler, SchedMode mode) -> QFuture<std::optional<QStringList>> {
+    return m_impl->run([scx_sched = scheduler.toStdString(), mode](scx::loader::Config* config) -> std::optional<QStringList> {
+        return config != nullptr ? config->scx_flags_for_mode(scx_sched, to_sched_mode(mode)) : std::nullopt;
+    });
+}
+
+auto SchedExtClient::apply(const QString& scheduler, SchedMode mode, const QStringList& extra_args) -> QFuture<bool> {
+    return m_impl->run([scx_sched = scheduler.toStdString(), mode, extra_args, config_path = m_impl->config_path()](scx::loader::Config* config) {
+        if (config == nullptr) {
+            return false;
+        }
+        auto sched_args = extra_args;
+        if (sched_args.isEmpty()) {
+            auto mode_flags = config->scx_flags_for_mode(scx_sched, to_sched_mode(mode));
+            if (!mode_flags) {
+                return false;
+            }
+            sched_args = std::move(*mode_flags);
+        }
+        return config->apply_scheduler_change(scx_sched, to_sched_mode(mode), sched_args, config_path);
+    });
+}
+
+auto SchedExtClient::disable() -> QFuture<bool> {
+    return m_impl->run([config_path = m_impl->config_path()](scx::loader::Config* config) {
+        return config != nullptr && config->disable_scheduler(config_path);
+    });
+}
+
+void SchedExtClient::on_loader_event() noexcept {
+    // reset the eventfd counter
+    std::uint64_t counter{};
+    if (::read(m_impl->loader_fd, &counter, sizeof(counter)) < 0) {
+        return;
+    }
+
+    current_state().then(this, [this](std::optional<SchedulerState> state) {
+        // scx_loader reports the scheduler and the mode separately, report the pair once
+        if (!state || state == m_impl->last_state) {
+            return;
+        }
+        m_impl->last_state = state;
+        emit scheduler_changed(*state);
+    });
+}
+
+}  // namespace scxctl
+
+// NOLINTEND(bugprone-unhandled-exception-at-new)
@@ -19,12 +19,18 @@
 // NOLINTBEGIN(bugprone-unhandled-exception-at-new)
 
 #include "schedext-window-internal.hpp"
+#include "history-panel.hpp"
+#include "kernel-stats-panel.hpp"
+#include "latency-probe-panel.hpp"
+#include "process-schedstat-panel.hpp"
 #include "schedext-window.hpp"
 #include "scx_utils.hpp"
+#include "startup-trace.hpp"
+#include "switch-latency-panel.hpp"
 
 #include <algorithm>    // for any_of
 #include <array>        // for array
-#include <fstream>      // for ifstream
+#include <chrono>       // for duration
 #include <ranges>       // for ranges::*
 #include <string>       // for string
 #include <string_view>  // for string_view
@@ -42,9 +48,13 @@
 #pragma GCC diagnostic ignored "-Wconversion"
 #endif
 
+#include <QFile>
 #include <QMessageBox>
 #include <QProcess>
+#include <QStandardPaths>
 #include <QStringList>
+#include <QTimer>
+#include <QtConcurrent/QtConcurrentRun>
 
 #if defined(__clang__)
 #pragma clang diagnostic pop
@@ -56,37 +66,9 @@
 #include <fmt/core.h>
 
 namespace {
-auto read_kernel_file(std::string_view file_path) noexcept -> std::string {
-    std::string file_content{};
 
-    // Skip if failed to open file descriptor.
-    std::ifstream file_stream{std::string{file_path}};
-    if (!file_stream.is_open()) {
-        return {};
-    }
-    if (!std::getline(file_stream, file_content)) {
-        fmt::print(stderr, "Failed to read := '{}'\n", file_path);
-        return {};
-    }
-
-    return file_content;
-}
-
-auto get_current_scheduler() noexcept -> std::string {
-    using namespace std::string_view_literals;
-
-    // NOTE: we assume that window won't be launched on kernel without sched_ext
-    // e.g we won't show window at all in that case.
-    const auto& current_state = read_kernel_file("/sys/kernel/sched_ext/state"sv);
-    if (current_state != "enabled"sv) {
-        return current_state;
-    }
-    const auto& current_sched = read_kernel_file("/sys/kernel/sched_ext/root/ops"sv);
-    if (current_sched.empty()) {
-        return std::string{"unknown"sv};
-    }
-    return current_sched;
-}
+/// Samples are recorded into the history even while the panels are hidden
+constexpr std::chrono::seconds kHistorySampleInterval{10};
 
 constexpr auto get_scx_mode_from_str(std::string_view scx_mode) noexcept -> scx::SchedMode {
     using namespace std::string_view_literals;
@@ -103,38 +85,136 @@ constexpr auto get_scx_mode_from_str(std::string_view scx_mode) noexcept -> scx:
     return scx::SchedMode::Auto;
 }
 
+/// @brief Reads the application profiles, if the user has any.
+auto load_app_rules() noexcept -> std::vector<scx::profiles::AppRule> {
+    QFile rules_file(QStandardPaths::writableLocation(QStandardPaths::AppConfigLocation) + "/profiles.json");
+    if (!rules_file.open(QIODevice::ReadOnly)) {
+        return {};
+    }
+    std::string error_message{};
+    auto app_rules = scx::profiles::parse_app_rules(rules_file.readAll(), error_message);
+    if (!app_rules) {
+        fmt::print(stderr, "Invalid application profiles in {}: {}\n", rules_file.fileName().toStdString(), error_message);
+        return {};
+    }
+    return std::move(*app_rules);
+}
+
 }  // namespace
 
 namespace scxctl::impl {
 
 SchedExtWindow::SchedExtWindow(QWidget* parent)
-  : QMainWindow(parent), m_sched_timer(new QTimer(this)) {
+  : QMainWindow(parent) {
     m_ui->setupUi(this);
+    m_ui->apply_progress_bar->setVisible(false);
+    m_ui->app_profile_title_label->setVisible(false);
+    m_ui->app_profile_label->setVisible(false);
+    m_ui->kernel_stats_layout->addWidget(new KernelStatsPanel(m_ui->kernel_stats_group));
+    m_latency_probe_panel = new LatencyProbePanel(m_ui->latency_probe_group);
+    m_ui->latency_probe_layout->addWidget(m_latency_probe_panel);
+    m_switch_latency_panel = new SwitchLatencyPanel(m_ui->switch_latency_group);
+    m_ui->switch_latency_layout->addWidget(m_switch_latency_panel);
+    m_process_schedstat_panel = new ProcessSchedstatPanel(m_ui->process_schedstat_group);
+    m_ui->process_schedstat_layout->addWidget(m_process_schedstat_panel);
+    if (const auto history_path = scx::history::default_history_path(); history_path) {
+        m_history.open(*history_path);
+    }
+    m_history_panel = new HistoryPanel(m_history, m_ui->history_group);
+    m_ui->history_layout->addWidget(m_history_panel);
 
     setAttribute(Qt::WA_NativeWindow);
     setWindowFlags(Qt::Window);  // for the close, min and max buttons
 
-    {
-        auto loader_config = scx::loader::Config::init_config(m_config_path);
-        if (loader_config.has_value()) {
-            m_scx_config = std::make_unique<scx::loader::Config>(std::move(*loader_config));
-        } else {
-            QMessageBox::critical(this, "CachyOS Kernel Manager", tr("Cannot initialize scx_loader configuration"));
-            return;
+    // Selecting the performance profile
+    QStringList sched_profiles;
+    sched_profiles << "Auto"
+                   << "Gaming"
+                   << "Powersave"
+                   << "Lowlatency"
+                   << "Server";
+    m_ui->schedext_profile_combo_box->addItems(sched_profiles);
+
+    // Placeholders until the state of scx_loader arrives
+    m_ui->current_sched_label->setText(tr("Loading..."));
+    set_loader_widgets_enabled(false);
+    connect(m_ui->cancel_button, &QPushButton::clicked, this, &SchedExtWindow::on_cancel);
+
+    // Config is parsed and scx_loader queried on a worker thread, so the window is shown right away
+    m_startup_watcher = new QFutureWatcher<StartupState>(this);
+    connect(m_startup_watcher, &QFutureWatcher<StartupState>::finished, this, &SchedExtWindow::on_startup_state_ready);
+    m_startup_watcher->setFuture(QtConcurrent::run([config_path = m_config_path]() -> StartupState {
+        StartupState startup_state{};
+        startup_state.app_rules = load_app_rules();
+        auto loader_config = scx::loader::Config::init_config(config_path);
+        scxctl::detail::trace_startup("config parsed");
+        if (!loader_config.has_value()) {
+            return startup_state;
+        }
+        startup_state.config   = std::make_unique<scx::loader::Config>(std::move(*loader_config));
+        startup_state.snapshot = startup_state.config->get_loader_snapshot();
+        scxctl::detail::trace_startup("scx_loader snapshot received");
+        if (startup_state.snapshot.has_value()) {
+            // combo box browsing is served from the cache afterwards
+            startup_state.config->prime_flags_cache(startup_state.snapshot->supported_scheds);
         }
+        return startup_state;
+    }));
+}
+
+void SchedExtWindow::on_startup_state_ready() noexcept {
+    auto startup_state = m_startup_watcher->future().takeResult();
+    m_startup_watcher->deleteLater();
+    m_startup_watcher = nullptr;
+
+    if (!startup_state.config) {
+        m_ui->current_sched_label->clear();
+        QMessageBox::critical(this, "CachyOS Kernel Manager", tr("Cannot initialize scx_loader configuration"));
+        return;
     }
+    m_scx_config = std::move(startup_state.config);
+
+    // Scheduler changes run on a worker thread, to not freeze the window
+    m_apply_executor = std::make_unique<scx::loader::ApplyExecutor>(*m_scx_config, m_config_path);
+    connect(m_apply_executor.get(), &scx::loader::ApplyExecutor::stage_changed, this, &SchedExtWindow::on_apply_stage_changed);
+    connect(m_apply_executor.get(), &scx::loader::ApplyExecutor::finished, this, &SchedExtWindow::on_apply_finished);
+    connect(m_apply_executor.get(), &scx::loader::ApplyExecutor::traced, m_switch_latency_panel, &SwitchLatencyPanel::record_trace);
 
-    // Timer updates information about currently running scheduler even without scx_loader,
+    m_trial_apply = new scx::trial::TrialApply(*m_scx_config, *m_apply_executor, scx::trial::TrialConfig{}, this);
+    connect(m_trial_apply, &scx::trial::TrialApply::phase_changed, this, &SchedExtWindow::on_trial_phase_changed);
+    connect(m_trial_apply, &scx::trial::TrialApply::finished, this, &SchedExtWindow::on_trial_finished);
+
+    // Watcher updates information about currently running scheduler even without scx_loader,
     // as it reads information reported by scx scheduler.
-    using namespace std::chrono_literals;  // NOLINT
-    connect(m_sched_timer, &QTimer::timeout, this, &SchedExtWindow::update_current_sched);
-    m_sched_timer->start(1s);
-
-    // Selecting the scheduler
-    auto supported_scheds = scx::loader::get_supported_scheds();
-    if (supported_scheds.has_value()) {
-        m_ui->schedext_combo_box->addItems(*supported_scheds);
-    } else {
+    m_state_watcher = new scx::StateWatcher(m_scx_config.get(), this);
+    connect(m_state_watcher, &scx::StateWatcher::scheduler_changed, this, &SchedExtWindow::update_current_sched);
+    // mode can change without switching the scheduler
+    connect(m_state_watcher, &scx::StateWatcher::loader_state_changed, this, [this] {
+        // read on the executor thread, D-Bus calls would block the window
+        m_apply_executor->loader_snapshot().then(this, [this](std::optional<scx::loader::LoaderSnapshot> snapshot) {
+            m_current_mode = snapshot ? std::optional{snapshot->current_mode} : std::nullopt;
+            update_scheduler_label();
+        });
+    });
+    m_ui->current_sched_label->setText(m_state_watcher->current_scheduler());
+
+    if (m_history.is_open()) {
+        m_history_timer = new QTimer(this);
+        connect(m_history_timer, &QTimer::timeout, this, &SchedExtWindow::record_metric_sample);
+        m_history_timer->start(kHistorySampleInterval);
+    }
+
+    // Exports the requests made in the window too, unlike the standalone exporter
+    if (const auto metrics_listen = qEnvironmentVariable("SCX_MANAGER_METRICS_LISTEN"); !metrics_listen.isEmpty()) {
+        if (auto listen_address = scx::metrics::parse_listen_address(metrics_listen.toStdString()); listen_address) {
+            m_metrics_exporter = new scx::metrics::MetricsExporter(*m_scx_config, *m_state_watcher, scx::metrics::ExporterConfig{.listen = std::move(listen_address)}, this);
+            m_metrics_exporter->attach(*m_apply_executor);
+        } else {
+            fmt::print(stderr, "Invalid SCX_MANAGER_METRICS_LISTEN: {}\n", metrics_listen.toStdString());
+        }
+    }
+
+    if (!startup_state.snapshot.has_value()) {
         QMessageBox::critical(this, "CachyOS Kernel Manager", tr("Cannot get information from scx_loader!\nIs it working?\nThis is needed for the app to work properly"));
 
         // hide all components which depends on scheduler management
@@ -145,38 +225,36 @@ SchedExtWindow::SchedExtWindow(QWidget* parent)
         m_ui->scheduler_profile_select_label->setHidden(true);
 
         m_ui->schedext_flags_edit->setHidden(true);
+        m_ui->watchdog_check_box->setHidden(true);
+        m_ui->trial_button->setHidden(true);
         m_ui->scheduler_set_flags_label->setHidden(true);
         return;
     }
-
-    // Set currently running scheduler
-    auto current_sched = m_scx_config->get_current_sched();
-    if (current_sched.has_value()) {
-        m_ui->schedext_combo_box->setCurrentText(QString::fromStdString(*current_sched));
+    const auto& snapshot = *startup_state.snapshot;
+    m_current_mode       = snapshot.current_mode;
+    update_scheduler_label();
+    if (!snapshot.current_sched.empty() && snapshot.current_sched != "unknown") {
+        // started before the window, with the flags of its mode
+        m_last_applied = scx::loader::ApplyRequest{
+            .kind       = scx::loader::ApplyRequest::Kind::Apply,
+            .scx_sched  = snapshot.current_sched,
+            .sched_mode = snapshot.current_mode,
+            .extra_args = m_scx_config->scx_flags_for_mode(snapshot.current_sched, snapshot.current_mode).value_or(QStringList{}),
+        };
     }
 
-    // Selecting the performance profile
-    QStringList sched_profiles;
-    sched_profiles << "Auto"
-                   << "Gaming"
-                   << "Powersave"
-                   << "Lowlatency"
-                   << "Server";
-    m_ui->schedext_profile_combo_box->addItems(sched_profiles);
+    // Selecting the scheduler, and set currently running one
+    m_ui->schedext_combo_box->addItems(snapshot.supported_scheds);
+    m_ui->schedext_combo_box->setCurrentText(QString::fromStdString(snapshot.current_sched));
+
+    // Set currently running scheduler mode
+    // NOTE: the index of profiles and scxmode values MUST match
+    m_ui->schedext_profile_combo_box->setCurrentIndex(static_cast<std::uint8_t>(snapshot.current_mode));
     connect(m_ui->schedext_profile_combo_box,
         QOverload<int>::of(&QComboBox::currentIndexChanged),
         this,
         &SchedExtWindow::on_sched_profile_changed);
 
-    // Set currently running scheduler mode
-    auto current_mode = m_scx_config->get_current_mode();
-    if (current_mode.has_value()) {
-        // NOTE: the index of profiles and scxmode values MUST match
-        m_ui->schedext_profile_combo_box->setCurrentIndex(static_cast<std::uint8_t>(*current_mode));
-    }
-
-    m_ui->current_sched_label->setText(QString::fromStdString(get_current_scheduler()));
-
     connect(m_ui->schedext_combo_box,
         QOverload<int>::of(&QComboBox::currentIndexChanged),
         this,
@@ -186,28 +264,167 @@ SchedExtWindow::SchedExtWindow(QWidget* parent)
 
     // Connect buttons signal
     connect(m_ui->apply_button, &QPushButton::clicked, this, &SchedExtWindow::on_apply);
+    connect(m_ui->preview_button, &QPushButton::clicked, this, &SchedExtWindow::on_preview);
+    connect(m_ui->trial_button, &QPushButton::clicked, this, &SchedExtWindow::on_trial);
     connect(m_ui->disable_button, &QPushButton::clicked, this, &SchedExtWindow::on_disable);
-    connect(m_ui->cancel_button, &QPushButton::clicked, this, &SchedExtWindow::close);
+    connect(m_ui->watchdog_check_box, &QCheckBox::toggled, this, &SchedExtWindow::on_watchdog_toggled);
+    connect(m_ui->perf_profile_check_box, &QCheckBox::toggled, this, &SchedExtWindow::on_perf_profile_toggled);
+    connect(m_ui->energy_check_box, &QCheckBox::toggled, this, &SchedExtWindow::on_energy_toggled);
+    set_loader_widgets_enabled(true);
+
+    if (!startup_state.app_rules.empty()) {
+        m_ui->app_profile_title_label->setVisible(true);
+        m_ui->app_profile_label->setVisible(true);
+        m_ui->app_profile_label->setText(tr("none"));
+        m_app_profile_watcher = new scx::profiles::AppProfileWatcher(std::move(startup_state.app_rules), this);
+        connect(m_app_profile_watcher, &scx::profiles::AppProfileWatcher::active_rule_changed, this, &SchedExtWindow::on_app_profile_changed);
+        if (auto active_rule = m_app_profile_watcher->active_rule(); active_rule) {
+            on_app_profile_changed(static_cast<int>(*active_rule));
+        }
+    }
+    scxctl::detail::trace_startup("window populated");
+}
+
+void SchedExtWindow::set_loader_widgets_enabled(bool enabled) noexcept {
+    m_ui->schedext_combo_box->setEnabled(enabled);
+    m_ui->schedext_profile_combo_box->setEnabled(enabled);
+    m_ui->schedext_flags_edit->setEnabled(enabled);
+    m_ui->apply_button->setEnabled(enabled);
+    m_ui->preview_button->setEnabled(enabled);
+    m_ui->trial_button->setEnabled(enabled);
+    m_ui->disable_button->setEnabled(enabled);
+    m_ui->watchdog_check_box->setEnabled(enabled);
+}
+
+void SchedExtWindow::paintEvent(QPaintEvent* event) {
+    QMainWindow::paintEvent(event);
+    if (!m_first_paint_traced) {
+        m_first_paint_traced = true;
+        scxctl::detail::trace_startup("first paint");
+    }
 }
 
 void SchedExtWindow::closeEvent(QCloseEvent* event) {
+    // Dump latency of the calls made to scx_loader, useful to compare the cost of queries
+    if (m_scx_config && qEnvironmentVariableIsSet("SCX_MANAGER_LOADER_STATS")) {
+        for (auto&& call_stats : m_scx_config->call_stats()) {
+            if (call_stats.calls == 0) {
+                continue;
+            }
+            const auto avg_us = static_cast<double>(call_stats.total.count()) / static_cast<double>(call_stats.calls) / 1000.;
+            fmt::print(stderr, "{}: calls={} failures={} reconnects={} avg={:.1f}us max={:.1f}us\n", call_stats.method,
+                call_stats.calls, call_stats.failures, call_stats.reconnects, avg_us, static_cast<double>(call_stats.max.count()) / 1000.);
+        }
+    }
     QWidget::closeEvent(event);
 }
 
-void SchedExtWindow::update_current_sched() noexcept {
-    m_ui->current_sched_label->setText(QString::fromStdString(get_current_scheduler()));
+void SchedExtWindow::update_current_sched(const QString& current_sched) noexcept {
+    const bool is_enabled = m_state_watcher->is_enabled();
+    m_history.append(scx::history::make_state_change(is_enabled ? "enabled" : "disabled", is_enabled ? current_sched.toStdString() : std::string{}));
+    m_ui->current_sched_label->setText(current_sched);
+    update_scheduler_label();
+}
+
+void SchedExtWindow::update_scheduler_label() noexcept {
+    auto sched_label = m_state_watcher->current_scheduler();
+    if (m_current_mode.has_value()) {
+        const auto mode_name = scx::sched_mode_name(*m_current_mode);
+        sched_label += QStringLiteral(" (%1)").arg(QString::fromUtf8(mode_name.data(), static_cast<qsizetype>(mode_name.size())));
+    }
+    // measurements are kept apart per scheduler and mode
+    m_latency_probe_panel->set_scheduler_label(sched_label);
+    m_process_schedstat_panel->set_scheduler_label(sched_label);
+    m_perf_profiler.set_label(sched_label.toStdString());
+    m_energy_meter.set_label(sched_label.toStdString());
 }
 
 void SchedExtWindow::on_disable() noexcept {
-    m_ui->disable_button->setEnabled(false);
-    m_ui->apply_button->setEnabled(false);
+    m_ui->apply_progress_bar->setVisible(true);
+    m_apply_executor->submit(scx::loader::ApplyRequest{.kind = scx::loader::ApplyRequest::Kind::Disable});
+}
 
-    if (!m_scx_config->disable_scheduler(m_config_path)) {
-        QMessageBox::critical(this, "CachyOS Kernel Manager", tr("Cannot disable scx_loader"));
+void SchedExtWindow::on_cancel() noexcept {
+    if (m_trial_apply && m_trial_apply->is_running()) {
+        m_trial_apply->cancel();
+        return;
     }
+    if (!m_apply_executor || !m_apply_executor->is_running()) {
+        close();
+        return;
+    }
+    if (!m_apply_executor->cancel()) {
+        m_ui->apply_progress_bar->setFormat(tr("Writing configuration, cannot be canceled"));
+    }
+}
+
+auto SchedExtWindow::apply_stage_text(scx::loader::ApplyStage stage) const noexcept -> QString {
+    switch (stage) {
+    case scx::loader::ApplyStage::StopScxService:
+        return tr("Stopping scx.service");
+    case scx::loader::ApplyStage::SwitchScheduler:
+        return tr("Switching scheduler");
+    case scx::loader::ApplyStage::EnableLoaderService:
+        return tr("Enabling scx_loader service");
+    case scx::loader::ApplyStage::StopScheduler:
+        return tr("Stopping scheduler");
+    case scx::loader::ApplyStage::WriteConfig:
+        return tr("Writing configuration");
+    }
+    return {};
+}
 
-    m_ui->disable_button->setEnabled(true);
-    m_ui->apply_button->setEnabled(true);
+void SchedExtWindow::on_apply_stage_changed(scx::loader::ApplyStage stage, int stage_idx, int stage_count) noexcept {
+    if (m_trial_apply->is_running()) {
+        // the trial reports its own progress
+        return;
+    }
+    m_ui->apply_progress_bar->setRange(0, stage_count);
+    m_ui->apply_progress_bar->setValue(stage_idx);
+    m_ui->apply_progress_bar->setFormat(apply_stage_text(stage));
+}
+
+void SchedExtWindow::on_apply_finished(const scx::loader::ApplyRequest& request, bool succeeded, bool canceled) noexcept {
+    if (succeeded && request.kind != scx::loader::ApplyRequest::Kind::Persist) {
+        const bool is_disable = request.kind == scx::loader::ApplyRequest::Kind::Disable;
+        if (is_disable) {
+            m_last_applied.reset();
+        } else {
+            m_last_applied = request;
+        }
+        std::string_view reason{is_disable ? "disable" : "apply"};
+        if (m_trial_apply->is_running()) {
+            reason = "trial";
+        } else if (m_watchdog != nullptr && m_watchdog->is_recovery(request)) {
+            reason = "watchdog";
+        } else if (!request.persist) {
+            reason = "app profile";
+        }
+        m_history.append(scx::history::make_transition(scx::history::Source::Gui, is_disable ? std::string_view{} : request.scx_sched,
+            is_disable ? std::nullopt : std::optional{request.sched_mode}, reason));
+    }
+    if (m_trial_apply->is_running()) {
+        // failures of the trial are reported once it is over
+        return;
+    }
+    if (!m_apply_executor->is_running()) {
+        m_ui->apply_progress_bar->setVisible(false);
+    }
+    if (succeeded || canceled) {
+        return;
+    }
+    if (!request.persist) {
+        // switches of the application profiles and recoveries, the user didn't ask for them
+        fmt::print(stderr, "Failed to switch to {} ({})\n", request.scx_sched, scx::sched_mode_name(request.sched_mode));
+        return;
+    }
+
+    if (request.kind == scx::loader::ApplyRequest::Kind::Disable) {
+        QMessageBox::critical(this, "CachyOS Kernel Manager", tr("Cannot disable scx_loader"));
+        return;
+    }
+    const auto& current_profile = m_ui->schedext_profile_combo_box->itemText(static_cast<std::uint8_t>(request.sched_mode));
+    QMessageBox::critical(this, "CachyOS Kernel Manager", tr("Cannot set default scx scheduler with mode! Scheduler %1 with mode %2").arg(QString::fromStdString(request.scx_sched), current_profile));
 }
 
 void SchedExtWindow::on_sched_profile_changed() noexcept {
@@ -224,7 +441,7 @@ void SchedExtWindow::on_sched_profile_changed() noexcept {
         QMessageBox::critical(this, "CachyOS Kernel Manager", tr("Cannot get scx flags from scx_loader configuration!"));
     }
 
-    m_ui->schedext_flags_edit->setText(sched_args.join(' '));
+    m_ui->schedext_flags_edit->setText(scx::join_sched_args(sched_args));
 }
 
 void SchedExtWindow::on_sched_changed() noexcept {
@@ -246,22 +463,273 @@ void SchedExtWindow::on_sched_changed() noexcept {
     on_sched_profile_changed();
 }
 
+auto SchedExtWindow::selected_apply_request() const noexcept -> scx::loader::ApplyRequest {
+    const auto& current_profile = m_ui->schedext_profile_combo_box->currentText().toStdString();
+    return scx::loader::ApplyRequest{
+        .kind       = scx::loader::ApplyRequest::Kind::Apply,
+        .scx_sched  = m_ui->schedext_combo_box->currentText().toStdString(),
+        .sched_mode = get_scx_mode_from_str(current_profile),
+        .extra_args = scx::split_sched_args(m_ui->schedext_flags_edit->text()),
+    };
+}
+
 void SchedExtWindow::on_apply() noexcept {
-    m_ui->disable_button->setEnabled(false);
-    m_ui->apply_button->setEnabled(false);
+    auto request = selected_apply_request();
+    if (m_profile_baseline) {
+        // the user's choice is restored once the application profile is over
+        m_profile_baseline          = request;
+        m_profile_baseline->persist = false;
+    }
+    m_ui->apply_progress_bar->setVisible(true);
+    m_apply_executor->submit(std::move(request));
+}
 
-    // TODO(vnepogodin): refactor that
-    const auto& current_selected = m_ui->schedext_combo_box->currentText().toStdString();
-    const auto& current_profile  = m_ui->schedext_profile_combo_box->currentText().toStdString();
-    const auto& extra_flags      = m_ui->schedext_flags_edit->text().trimmed().toStdString();
-    const auto& scx_mode         = get_scx_mode_from_str(current_profile);
+void SchedExtWindow::on_preview() noexcept {
+    m_apply_executor->preview(selected_apply_request()).then(this, [this](std::optional<scx::loader::ChangePlan> plan) {
+        if (!plan) {
+            QMessageBox::critical(this, "CachyOS Kernel Manager", tr("Cannot plan the scheduler change!"));
+            return;
+        }
+        QStringList lines;
+        for (auto&& stage : scx::loader::plan_stages(*plan)) {
+            lines << QStringLiteral("• %1").arg(apply_stage_text(stage));
+        }
+        if (lines.isEmpty()) {
+            lines << tr("Nothing to change");
+        }
+        lines << QString{} << plan->reasons;
+        QMessageBox::information(this, "CachyOS Kernel Manager", lines.join('\n'));
+    });
+}
+
+void SchedExtWindow::on_trial() noexcept {
+    if (!m_trial_apply->start(selected_apply_request())) {
+        return;
+    }
+    // only canceling the trial is allowed until it is over
+    set_loader_widgets_enabled(false);
+    m_ui->apply_progress_bar->setVisible(true);
+}
+
+void SchedExtWindow::on_trial_phase_changed(scx::trial::TrialPhase phase) noexcept {
+    const auto& trial_config = m_trial_apply->config();
+    QString phase_text;
+    switch (phase) {
+    case scx::trial::TrialPhase::Idle:
+        return;
+    case scx::trial::TrialPhase::Baseline:
+        phase_text = tr("Measuring current scheduler for %1s").arg(trial_config.baseline.count());
+        break;
+    case scx::trial::TrialPhase::Switching:
+        phase_text = tr("Switching scheduler");
+        break;
+    case scx::trial::TrialPhase::Settling:
+        phase_text = tr("Waiting for the scheduler to settle");
+        break;
+    case scx::trial::TrialPhase::Observing:
+        phase_text = tr("On trial for %1s, Cancel rolls back").arg(trial_config.window.count());
+        break;
+    case scx::trial::TrialPhase::RollingBack:
+        phase_text = tr("Restoring previous scheduler");
+        break;
+    case scx::trial::TrialPhase::Committing:
+        phase_text = tr("Writing configuration");
+        break;
+    }
+    // phases are in the order they are passed
+    m_ui->apply_progress_bar->setRange(0, static_cast<int>(scx::trial::TrialPhase::Committing));
+    m_ui->apply_progress_bar->setValue(static_cast<int>(phase));
+    m_ui->apply_progress_bar->setFormat(phase_text);
+}
+
+void SchedExtWindow::on_trial_finished(const scx::trial::TrialResult& result) noexcept {
+    m_ui->apply_progress_bar->setVisible(false);
+    set_loader_widgets_enabled(true);
+
+    switch (result.outcome) {
+    case scx::trial::TrialOutcome::Committed:
+    case scx::trial::TrialOutcome::Canceled:
+        break;
+    case scx::trial::TrialOutcome::RolledBack:
+        QMessageBox::warning(this, "CachyOS Kernel Manager", tr("The previous scheduler was restored: %1").arg(QString::fromStdString(result.reason)));
+        break;
+    case scx::trial::TrialOutcome::Failed:
+        QMessageBox::critical(this, "CachyOS Kernel Manager", tr("Trial of the scheduler failed: %1").arg(QString::fromStdString(result.reason)));
+        break;
+    }
+}
+
+void SchedExtWindow::on_watchdog_toggled(bool enabled) noexcept {
+    if (!enabled) {
+        delete m_watchdog;
+        m_watchdog = nullptr;
+        m_ui->watchdog_status_label->clear();
+        return;
+    }
+
+    m_watchdog = new scx::watchdog::Watchdog(*m_scx_config, *m_apply_executor, *m_state_watcher, scx::watchdog::WatchdogConfig{}, this);
+    connect(m_watchdog, &scx::watchdog::Watchdog::ejected, this, [this](const scx::watchdog::Incident& incident) {
+        const auto reason = incident.reason.empty() ? tr("unknown reason") : QString::fromStdString(incident.reason);
+        update_watchdog_status(tr("%1 ejected (%2), recovering").arg(QString::fromStdString(incident.ops), reason));
+    });
+    connect(m_watchdog, &scx::watchdog::Watchdog::recovered, this, [this](const scx::watchdog::Incident& incident) {
+        const auto time_to_recovery = std::chrono::duration<double>(incident.time_to_recovery().value_or(scx::watchdog::monotonic_clock::duration{}));
+        update_watchdog_status(tr("%1 recovered in %2s").arg(QString::fromStdString(incident.ops)).arg(time_to_recovery.count(), 0, 'f', 1));
+    });
+    connect(m_watchdog, &scx::watchdog::Watchdog::gave_up, this, [this](const scx::watchdog::Incident& incident) {
+        update_watchdog_status(tr("%1 could not be recovered").arg(QString::fromStdString(incident.ops)));
+    });
+    update_watchdog_status(m_watchdog->reads_kernel_log() ? tr("Watching") : tr("Watching, exit reasons are unavailable"));
+}
+
+void SchedExtWindow::on_perf_profile_toggled(bool enabled) noexcept {
+    if (!enabled) {
+        m_perf_timer->stop();
+        m_perf_profiler.close();
+        m_ui->perf_profile_label->clear();
+        return;
+    }
+    if (!m_perf_profiler.open()) {
+        QMessageBox::warning(this, "CachyOS Kernel Manager", tr("Cannot open perf counters, perf_event_paranoid must be at most 0 or CAP_PERFMON granted"));
+        m_ui->perf_profile_check_box->setChecked(false);
+        return;
+    }
+    if (m_perf_timer == nullptr) {
+        m_perf_timer = new QTimer(this);
+        connect(m_perf_timer, &QTimer::timeout, this, &SchedExtWindow::update_perf_profile);
+    }
+    m_perf_timer->start(std::chrono::seconds{1});
+    m_ui->perf_profile_label->setText(tr("Profiling..."));
+}
+
+void SchedExtWindow::update_perf_profile() noexcept {
+    if (!m_perf_profiler.sample()) {
+        return;
+    }
+    const auto format_counts = [](const scx::perf::PerfCounts& counts) {
+        using scx::perf::PerfCounter;
+        auto text = tr("%1 context switches/s, %2 migrations/s, %3 page faults/s")
+                        .arg(counts.rate(PerfCounter::ContextSwitches).value_or(0.), 0, 'f', 0)
+                        .arg(counts.rate(PerfCounter::CpuMigrations).value_or(0.), 0, 'f', 0)
+                        .arg(counts.rate(PerfCounter::PageFaults).value_or(0.), 0, 'f', 0);
+        if (const auto ipc = counts.ipc(); ipc) {
+            text += tr(", IPC %1").arg(*ipc, 0, 'f', 2);
+        }
+        return text;
+    };
+    m_ui->perf_profile_label->setText(format_counts(m_perf_profiler.last_counts()));
+
+    // same workload under the other schedulers, to compare against
+    QStringList profile_lines;
+    for (auto&& profile : m_perf_profiler.profiles()) {
+        const auto elapsed_secs = std::chrono::duration<double>(profile.counts.elapsed).count();
+        profile_lines << tr("%1 over %2s: %3").arg(QString::fromStdString(profile.label)).arg(elapsed_secs, 0, 'f', 0).arg(format_counts(profile.counts));
+    }
+    m_ui->perf_profile_label->setToolTip(profile_lines.join('\n'));
+}
+
+void SchedExtWindow::on_energy_toggled(bool enabled) noexcept {
+    if (!enabled) {
+        m_energy_timer->stop();
+        m_energy_meter.close();
+        m_ui->energy_label->clear();
+        return;
+    }
+    if (!m_energy_meter.open()) {
+        QMessageBox::warning(this, "CachyOS Kernel Manager", tr("Cannot read RAPL energy counters, they may be missing or readable only by root"));
+        m_ui->energy_check_box->setChecked(false);
+        return;
+    }
+    if (m_energy_timer == nullptr) {
+        m_energy_timer = new QTimer(this);
+        connect(m_energy_timer, &QTimer::timeout, this, &SchedExtWindow::update_energy);
+    }
+    m_energy_timer->start(std::chrono::seconds{1});
+    m_ui->energy_label->setText(tr("Measuring..."));
+}
 
-    if (!m_scx_config->apply_scheduler_change(current_selected, scx_mode, extra_flags, m_config_path)) {
-        QMessageBox::critical(this, "CachyOS Kernel Manager", tr("Cannot set default scx scheduler with mode! Scheduler %1 with mode %2").arg(QString::fromStdString(current_selected), QString::fromStdString(current_profile)));
+void SchedExtWindow::update_energy() noexcept {
+    if (!m_energy_meter.sample()) {
+        return;
+    }
+    using scx::energy::EnergyDomain;
+    const auto format_domains = [](const scx::energy::EnergyCounts& counts, double scale, const QString& unit) {
+        QStringList domain_texts;
+        for (auto domain : {EnergyDomain::Package, EnergyDomain::Core, EnergyDomain::Dram}) {
+            if (const auto joules_per_min = counts.joules_per_minute(domain); joules_per_min) {
+                const auto domain_name = scx::energy::energy_domain_name(domain);
+                domain_texts << QStringLiteral("%1 %2 %3").arg(*joules_per_min * scale, 0, 'f', 1).arg(unit, QString::fromUtf8(domain_name.data(), static_cast<qsizetype>(domain_name.size())));
+            }
+        }
+        return domain_texts.join(QStringLiteral(", "));
+    };
+    // joules per minute over 60 is the average power
+    m_ui->energy_label->setText(format_domains(m_energy_meter.last_counts(), 1. / 60., tr("W")));
+
+    // energy of the same workload under the other schedulers, to compare against
+    QStringList profile_lines;
+    for (auto&& profile : m_energy_meter.profiles()) {
+        const auto elapsed_secs = std::chrono::duration<double>(profile.counts.elapsed).count();
+        profile_lines << tr("%1 over %2s: %3").arg(QString::fromStdString(profile.label)).arg(elapsed_secs, 0, 'f', 0).arg(format_domains(profile.counts, 1., tr("J/min")));
+    }
+    m_ui->energy_label->setToolTip(profile_lines.join('\n'));
+}
+
+void SchedExtWindow::record_metric_sample() noexcept {
+    using scx::history::Metric;
+    auto values = scx::history::empty_metrics();
+    m_history_sampler.sample(values);
+    // the profilers are sampled by their own timers, only their last span is recorded
+    if (m_perf_profiler.is_open()) {
+        if (const auto rate = m_perf_profiler.last_counts().rate(scx::perf::PerfCounter::ContextSwitches); rate) {
+            values[static_cast<std::size_t>(Metric::ContextSwitchRate)] = static_cast<float>(*rate);
+        }
+    }
+    if (m_energy_meter.is_open()) {
+        if (const auto joules_per_min = m_energy_meter.last_counts().joules_per_minute(scx::energy::EnergyDomain::Package); joules_per_min) {
+            values[static_cast<std::size_t>(Metric::PackageWatts)] = static_cast<float>(*joules_per_min / 60.);
+        }
+    }
+    m_history.append(scx::history::make_metric_sample(m_state_watcher->current_scheduler().toStdString(), values));
+}
+
+void SchedExtWindow::update_watchdog_status(QString status_text) noexcept {
+    const auto& stats = m_watchdog->stats();
+    if (auto mttr = stats.mean_time_to_recovery(); mttr) {
+        status_text += tr(" (ejections: %1, mean time to recovery: %2s)").arg(stats.ejections).arg(mttr->count(), 0, 'f', 1);
+    }
+    m_ui->watchdog_status_label->setText(status_text);
+}
+
+void SchedExtWindow::on_app_profile_changed(int rule_idx) noexcept {
+    if (rule_idx < 0) {
+        m_ui->app_profile_label->setText(tr("none"));
+        if (m_profile_baseline) {
+            m_apply_executor->submit(std::move(*m_profile_baseline));
+            m_profile_baseline.reset();
+        }
+        return;
+    }
+
+    const auto& app_rule = m_app_profile_watcher->rules()[static_cast<std::size_t>(rule_idx)];
+    m_ui->app_profile_label->setText(QString::fromStdString(app_rule.name));
+    if (!m_profile_baseline) {
+        // the watcher knows whether a scheduler runs without asking scx_loader
+        if (m_state_watcher->is_enabled() && m_last_applied) {
+            m_profile_baseline          = m_last_applied;
+            m_profile_baseline->persist = false;
+        } else {
+            m_profile_baseline = scx::loader::ApplyRequest{.kind = scx::loader::ApplyRequest::Kind::Disable, .persist = false};
+        }
     }
 
-    m_ui->disable_button->setEnabled(true);
-    m_ui->apply_button->setEnabled(true);
+    m_apply_executor->submit(scx::loader::ApplyRequest{
+        .kind       = scx::loader::ApplyRequest::Kind::Apply,
+        .scx_sched  = app_rule.scx_sched,
+        .sched_mode = app_rule.mode,
+        .extra_args = m_scx_config->scx_flags_for_mode(app_rule.scx_sched, app_rule.mode).value_or(QStringList{}),
+        .persist    = false,
+    });
 }
 
 }  // namespace scxctl::impl
@@ -41,15 +41,25 @@
 
 #include <ui_schedext-window.h>
 
+#include "scx_app_profiles.hpp"
+#include "scx_apply_executor.hpp"
+#include "scx_energy.hpp"
+#include "scx_history.hpp"
+#include "scx_metrics_exporter.hpp"
+#include "scx_perf_profile.hpp"
+#include "scx_state_watcher.hpp"
+#include "scx_trial_apply.hpp"
 #include "scx_utils.hpp"
+#include "scx_watchdog.hpp"
 
 #include <functional>
 #include <memory>
+#include <optional>
 #include <string>
 #include <vector>
 
+#include <QFutureWatcher>
 #include <QMainWindow>
-#include <QTimer>
 
 #if defined(__clang__)
 #pragma clang diagnostic pop
@@ -57,8 +67,15 @@
 #pragma GCC diagnostic pop
 #endif
 
+class QTimer;
+
 namespace scxctl::impl {
 
+class HistoryPanel;
+class LatencyProbePanel;
+class ProcessSchedstatPanel;
+class SwitchLatencyPanel;
+
 class SchedExtWindow final : public QMainWindow {
     Q_OBJECT
     Q_DISABLE_COPY_MOVE(SchedExtWindow)
@@ -68,20 +85,73 @@ class SchedExtWindow final : public QMainWindow {
 
  protected:
     void closeEvent(QCloseEvent* event) override;
+    void paintEvent(QPaintEvent* event) override;
 
  private:
+    /// @brief Everything fetched on the worker thread before the window can be populated.
+    struct StartupState {
+        scx::loader::ConfigPtr config{};
+        std::optional<scx::loader::LoaderSnapshot> snapshot{};
+        std::vector<scx::profiles::AppRule> app_rules{};
+    };
+
+    void on_startup_state_ready() noexcept;
+    void set_loader_widgets_enabled(bool enabled) noexcept;
     void on_apply() noexcept;
+    void on_preview() noexcept;
+    void on_trial() noexcept;
+    void on_trial_phase_changed(scx::trial::TrialPhase phase) noexcept;
+    void on_trial_finished(const scx::trial::TrialResult& result) noexcept;
     void on_disable() noexcept;
+    void on_cancel() noexcept;
+    void on_apply_stage_changed(scx::loader::ApplyStage stage, int stage_idx, int stage_count) noexcept;
+    void on_apply_finished(const scx::loader::ApplyRequest& request, bool succeeded, bool canceled) noexcept;
     void on_sched_changed() noexcept;
     void on_sched_profile_changed() noexcept;
+    void on_app_profile_changed(int rule_idx) noexcept;
+    void on_watchdog_toggled(bool enabled) noexcept;
+    void update_watchdog_status(QString status_text) noexcept;
+    void on_perf_profile_toggled(bool enabled) noexcept;
+    void update_perf_profile() noexcept;
+    void on_energy_toggled(bool enabled) noexcept;
+    void update_energy() noexcept;
+    void record_metric_sample() noexcept;
 
     const std::string_view m_config_path{"/etc/scx_loader.toml"};
     scx::loader::ConfigPtr m_scx_config;
+    // NOTE: must be destroyed before the config, it waits for the in-flight request
+    std::unique_ptr<scx::loader::ApplyExecutor> m_apply_executor;
     std::vector<std::string> m_previously_set_options{};
-    std::unique_ptr<Ui::SchedExtWindow> m_ui = std::make_unique<Ui::SchedExtWindow>();
-    QTimer* m_sched_timer                    = nullptr;
-
-    void update_current_sched() noexcept;
+    std::unique_ptr<Ui::SchedExtWindow> m_ui         = std::make_unique<Ui::SchedExtWindow>();
+    scx::StateWatcher* m_state_watcher               = nullptr;
+    LatencyProbePanel* m_latency_probe_panel         = nullptr;
+    SwitchLatencyPanel* m_switch_latency_panel       = nullptr;
+    ProcessSchedstatPanel* m_process_schedstat_panel = nullptr;
+    HistoryPanel* m_history_panel                    = nullptr;
+    scx::profiles::AppProfileWatcher* m_app_profile_watcher{};
+    scx::watchdog::Watchdog* m_watchdog{};
+    scx::trial::TrialApply* m_trial_apply{};
+    scx::metrics::MetricsExporter* m_metrics_exporter{};
+    scx::perf::PerfProfiler m_perf_profiler{};
+    QTimer* m_perf_timer{};
+    scx::energy::EnergyMeter m_energy_meter{};
+    QTimer* m_energy_timer{};
+    scx::history::HistoryLog m_history{};
+    scx::history::MetricSampler m_history_sampler{};
+    QTimer* m_history_timer{};
+    /// Restores the scheduler chosen by the user, once no application profile is active
+    std::optional<scx::loader::ApplyRequest> m_profile_baseline{};
+    /// Last request which started the running scheduler, with the args it runs with
+    std::optional<scx::loader::ApplyRequest> m_last_applied{};
+    QFutureWatcher<StartupState>* m_startup_watcher{};
+    std::optional<scx::SchedMode> m_current_mode{};
+    bool m_first_paint_traced{};
+
+    /// @brief Scheduler change selected in the widgets.
+    auto selected_apply_request() const noexcept -> scx::loader::ApplyRequest;
+    auto apply_stage_text(scx::loader::ApplyStage stage) const noexcept -> QString;
+    void update_current_sched(const QString& current_sched) noexcept;
+    void update_scheduler_label() noexcept;
 };
 
 }  // namespace scxctl::impl
@@ -0,0 +1,165 @@
+// Copyright (C) 2024-2025 Vladislav Nepogodin
+//
+// This file is part of CachyOS kernel manager.
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+#include "scx_bench.hpp"
+#include "scx_utils.hpp"
+
+#include <cstdint>  // for int32_t
+#include <cstdio>   // for stderr
+
+#include <fmt/core.h>
+
+#if defined(__clang__)
+#pragma clang diagnostic push
+#pragma clang diagnostic ignored "-Wold-style-cast"
+#pragma clang diagnostic ignored "-Wsign-conversion"
+#elif defined(__GNUC__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wnull-dereference"
+#pragma GCC diagnostic ignored "-Wuseless-cast"
+#pragma GCC diagnostic ignored "-Wold-style-cast"
+#pragma GCC diagnostic ignored "-Wsuggest-final-types"
+#pragma GCC diagnostic ignored "-Wsuggest-attribute=pure"
+#pragma GCC diagnostic ignored "-Wconversion"
+#pragma GCC diagnostic ignored "-Wsign-conversion"
+#endif
+
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QFile>
+
+#if defined(__clang__)
+#pragma clang diagnostic pop
+#elif defined(__GNUC__)
+#pragma GCC diagnostic pop
+#endif
+
+namespace {
+
+constexpr std::string_view kConfigPath{"/etc/scx_loader.toml"};
+
+auto split_list(const QString& value) -> QStringList {
+    return value.split(',', Qt::SkipEmptyParts);
+}
+
+}  // namespace
+
+auto main(int argc, char** argv) -> std::int32_t {
+    QCoreApplication::setOrganizationName("CachyOS");
+    QCoreApplication::setOrganizationDomain("cachyos.org");
+    QCoreApplication::setApplicationName("scx-bench");
+
+    const QCoreApplication app(argc, argv);
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Runs synthetic workloads under each sched_ext scheduler and mode.");
+    parser.addHelpOption();
+
+    const QCommandLineOption scheds_option("scheds", "Comma-separated schedulers, all supported by scx_loader by default.", "list");
+    const QCommandLineOption modes_option("modes", "Comma-separated modes: auto, gaming, powersave, lowlatency, server.", "list", "auto");
+    const QCommandLineOption workloads_option("workloads", "Comma-separated workloads: messaging, pipe, cpu.", "list", "messaging,pipe,cpu");
+    const QCommandLineOption duration_option("duration", "Duration of each workload in seconds.", "seconds", "5");
+    const QCommandLineOption settle_option("settle-timeout", "How long to wait for the scheduler to attach, in seconds.", "seconds", "10");
+    const QCommandLineOption format_option("format", "Output format: csv or json.", "format", "csv");
+    const QCommandLineOption output_option({"o", "output"}, "Write results into the file instead of stdout.", "file");
+    const QCommandLineOption powercap_option("powercap-root", "Where RAPL zones are looked up, e.g a fixture tree.", "path", QString::fromUtf8(scx::energy::kPowercapRoot.data(), static_cast<qsizetype>(scx::energy::kPowercapRoot.size())));
+    parser.addOptions({scheds_option, modes_option, workloads_option, duration_option, settle_option, format_option, output_option, powercap_option});
+    parser.process(app);
+
+    const auto format = parser.value(format_option);
+    if (format != "csv" && format != "json") {
+        fmt::print(stderr, "Unknown output format: {}\n", format.toStdString());
+        return 1;
+    }
+
+    bool is_valid_duration{};
+    const auto duration_secs = parser.value(duration_option).toUInt(&is_valid_duration);
+    bool is_valid_settle{};
+    const auto settle_secs = parser.value(settle_option).toUInt(&is_valid_settle);
+    if (!is_valid_duration || duration_secs == 0 || !is_valid_settle) {
+        fmt::print(stderr, "Durations must be positive number of seconds\n");
+        return 1;
+    }
+
+    auto loader_config = scx::loader::Config::init_config(kConfigPath);
+    if (!loader_config) {
+        fmt::print(stderr, "Failed to initialize scx_loader config\n");
+        return 1;
+    }
+
+    scx::bench::BenchOptions options{
+        .workload_duration = std::chrono::seconds{duration_secs},
+        .settle_timeout    = std::chrono::seconds{settle_secs},
+        .powercap_root     = parser.value(powercap_option).toStdString(),
+    };
+
+    options.workloads.clear();
+    for (auto&& workload_str : split_list(parser.value(workloads_option))) {
+        const auto workload = scx::bench::workload_from_name(workload_str.toStdString());
+        if (!workload) {
+            fmt::print(stderr, "Unknown workload: {}\n", workload_str.toStdString());
+            return 1;
+        }
+        options.workloads.emplace_back(*workload);
+    }
+
+    std::vector<scx::SchedMode> modes;
+    for (auto&& mode_str : split_list(parser.value(modes_option))) {
+        const auto sched_mode = scx::sched_mode_from_name(mode_str.toStdString());
+        if (!sched_mode) {
+            fmt::print(stderr, "Unknown mode: {}\n", mode_str.toStdString());
+            return 1;
+        }
+        modes.emplace_back(*sched_mode);
+    }
+
+    QStringList scheds;
+    if (parser.isSet(scheds_option)) {
+        scheds = split_list(parser.value(scheds_option));
+    } else if (auto supported_scheds = loader_config->get_supported_scheds()) {
+        scheds = std::move(*supported_scheds);
+    }
+    if (scheds.isEmpty() || modes.empty() || options.workloads.empty()) {
+        fmt::print(stderr, "Nothing to benchmark\n");
+        return 1;
+    }
+
+    for (auto&& scx_sched : scheds) {
+        for (auto sched_mode : modes) {
+            options.pairs.emplace_back(scx::bench::BenchPair{.scx_sched = scx_sched.toStdString(), .sched_mode = sched_mode});
+        }
+    }
+
+    const auto results = scx::bench::run_benchmark(*loader_config, options, [](auto&& pair, std::size_t pair_idx, std::size_t pair_count) {
+        fmt::print(stderr, "[{}/{}] {} ({})\n", pair_idx + 1, pair_count, pair.scx_sched, scx::sched_mode_name(pair.sched_mode));
+    });
+
+    const auto output = (format == "json") ? scx::bench::results_to_json(results) : scx::bench::results_to_csv(results);
+    if (!parser.isSet(output_option)) {
+        fmt::print("{}", output);
+        return 0;
+    }
+
+    QFile output_file(parser.value(output_option));
+    if (!output_file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        fmt::print(stderr, "Failed to open {}: {}\n", output_file.fileName().toStdString(), output_file.errorString().toStdString());
+        return 1;
+    }
+    output_file.write(output.data(), static_cast<qint64>(output.size()));
+    return 0;
+}
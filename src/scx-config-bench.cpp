@@ -0,0 +1,402 @@
+// Copyright (C) 2024-2025 Vladislav Nepogodin
+//
+// This file is part of CachyOS kernel manager.
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+#include "scx_utils.hpp"
+
+#include <algorithm>  // for max
+#include <atomic>     // for atomic
+#include <cerrno>     // for ENOMEM, EINVAL
+#include <chrono>     // for steady_clock
+#include <cstdint>    // for int32_t, uint64_t
+#include <cstdio>     // for stderr
+#include <cstdlib>    // for malloc, free
+#include <limits>     // for numeric_limits
+#include <optional>   // for optional
+#include <string>     // for string
+#include <utility>    // for move
+#include <vector>     // for vector
+
+#include <fmt/core.h>
+
+#if defined(__clang__)
+#pragma clang diagnostic push
+#pragma clang diagnostic ignored "-Wold-style-cast"
+#pragma clang diagnostic ignored "-Wsign-conversion"
+#elif defined(__GNUC__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wnull-dereference"
+#pragma GCC diagnostic ignored "-Wuseless-cast"
+#pragma GCC diagnostic ignored "-Wold-style-cast"
+#pragma GCC diagnostic ignored "-Wsuggest-final-types"
+#pragma GCC diagnostic ignored "-Wsuggest-attribute=pure"
+#pragma GCC diagnostic ignored "-Wconversion"
+#pragma GCC diagnostic ignored "-Wsign-conversion"
+#endif
+
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QProcess>
+#include <QTemporaryDir>
+
+#if defined(__clang__)
+#pragma clang diagnostic pop
+#elif defined(__GNUC__)
+#pragma GCC diagnostic pop
+#endif
+
+// Allocations are counted by replacing the allocator entry points of glibc, so the ones
+// done by the Rust side of the bridge and by its runtime thread are counted as well.
+extern "C" {
+auto __libc_malloc(std::size_t size) noexcept -> void*;
+auto __libc_calloc(std::size_t count, std::size_t size) noexcept -> void*;
+auto __libc_realloc(void* ptr, std::size_t size) noexcept -> void*;
+auto __libc_memalign(std::size_t alignment, std::size_t size) noexcept -> void*;
+void __libc_free(void* ptr) noexcept;
+}
+
+namespace {
+
+constexpr std::int32_t kExitFailure = 1;
+constexpr std::int32_t kExitUsage   = 2;
+
+constexpr int kStartTimeoutMs = 5000;
+
+/// Operations which start a session or write the config run this many times fewer iterations
+constexpr std::uint64_t kSlowOpDivisor = 10;
+
+/// Runs of each query in the allocation check, the fewest allocations are taken
+constexpr int kCheckRuns = 16;
+
+std::atomic<std::uint64_t> g_alloc_count{};
+
+struct OpResult {
+    std::string name;
+    std::uint64_t iterations{};
+    std::uint64_t failures{};
+    double ns_per_op{};
+    double allocs_per_op{};
+};
+
+/// @brief Runs the op after a warmup, counting time and allocations of the measured iterations.
+template <typename F>
+auto run_op(std::string name, std::uint64_t iterations, std::uint64_t warmup, F&& op) noexcept -> OpResult {
+    for (std::uint64_t i = 0; i < warmup; ++i) {
+        static_cast<void>(op(i));
+    }
+
+    OpResult result{.name = std::move(name), .iterations = iterations};
+    const auto allocs_before = g_alloc_count.load(std::memory_order_relaxed);
+    const auto started_at    = std::chrono::steady_clock::now();
+    for (std::uint64_t i = 0; i < iterations; ++i) {
+        if (!op(warmup + i)) {
+            ++result.failures;
+        }
+    }
+    const auto elapsed = std::chrono::steady_clock::now() - started_at;
+    const auto allocs  = g_alloc_count.load(std::memory_order_relaxed) - allocs_before;
+
+    const auto elapsed_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count();
+    result.ns_per_op      = static_cast<double>(elapsed_ns) / static_cast<double>(iterations);
+    result.allocs_per_op  = static_cast<double>(allocs) / static_cast<double>(iterations);
+    return result;
+}
+
+/// @brief Returns the fewest allocations of the op over a few runs.
+///
+/// Waiting for a reply which isn't there yet allocates too, such runs are not counted.
+template <typename F>
+auto min_allocs(F&& op) -> std::uint64_t {
+    auto fewest_allocs = std::numeric_limits<std::uint64_t>::max();
+    for (int run = 0; run < kCheckRuns; ++run) {
+        const auto allocs_before = g_alloc_count.load(std::memory_order_relaxed);
+        static_cast<void>(op());
+        fewest_allocs = std::min(fewest_allocs, g_alloc_count.load(std::memory_order_relaxed) - allocs_before);
+    }
+    return fewest_allocs;
+}
+
+struct BridgeAllocs {
+    std::string name;
+    std::uint64_t rust_allocs{};
+    std::uint64_t cxx_allocs{};
+    /// Strings and lists returned by the query, each may be allocated once by the C++ side
+    std::uint64_t budget{};
+};
+
+/// @brief Checks that the C++ side of each query allocates at most once per returned string and list.
+///
+/// Each query is compared with the same call made straight into Rust, through a config of its
+/// own on the same bus, so that the allocations done by D-Bus and by Rust are left out.
+auto check_bridge_allocs(scx::loader::Config& loader_config, const std::string& config_path, const std::string& scx_sched) noexcept -> bool {
+    constexpr auto kSchedMode = scx::SchedMode::Gaming;
+
+    std::vector<BridgeAllocs> results;
+    try {
+        const ::rust::Str config_path_rust(config_path.data(), config_path.size());
+        const ::rust::Str scx_sched_rust(scx_sched.data(), scx_sched.size());
+        auto rust_config = ::scx_loader::init_config_file(config_path_rust);
+
+        // persisted, so that the config has a default scheduler
+        const auto mode_flags = loader_config.scx_flags_for_mode(scx_sched, kSchedMode);
+        if (!mode_flags || !loader_config.apply_scheduler_change(scx_sched, kSchedMode, *mode_flags, config_path)) {
+            fmt::print(stderr, "Failed to apply {}\n", scx_sched);
+            return false;
+        }
+        rust_config->reload_config(config_path_rust);
+
+        const auto scheds       = loader_config.get_supported_scheds().value_or(QStringList{});
+        const auto default_args = loader_config.get_default_sched().value_or(scx::loader::DefaultSched{}).extra_args;
+
+        const auto check = [&results](std::string name, auto&& rust_op, auto&& cxx_op, qsizetype strings, qsizetype lists) {
+            results.emplace_back(BridgeAllocs{
+                .name        = std::move(name),
+                .rust_allocs = min_allocs(rust_op),
+                .cxx_allocs  = min_allocs(cxx_op),
+                .budget      = static_cast<std::uint64_t>(strings + lists),
+            });
+        };
+        check(
+            "get_supported_scheds", [&] { return rust_config->get_supported_scheds(); },
+            [&] { return loader_config.get_supported_scheds(); }, scheds.size(), 1);
+        check(
+            "get_current_sched", [&] { return rust_config->get_current_sched(); },
+            [&] { return loader_config.get_current_sched(); }, 1, 0);
+        check(
+            "get_current_mode", [&] { return rust_config->get_current_mode(); },
+            [&] { return loader_config.get_current_mode(); }, 0, 0);
+        check(
+            "get_loader_snapshot", [&] { return rust_config->get_loader_snapshot(); },
+            [&] { return loader_config.get_loader_snapshot(); }, scheds.size() + 1, 1);
+        check(
+            "scx_flags_for_mode", [&] { return rust_config->get_scx_flags_for_mode(scx_sched_rust, kSchedMode); },
+            [&] { return loader_config.scx_flags_for_mode(scx_sched, kSchedMode); }, mode_flags->size(), 1);
+        check(
+            "get_default_sched", [&] { return rust_config->get_default_sched(); },
+            [&] { return loader_config.get_default_sched(); }, default_args.size() + 1, 1);
+    } catch (const std::exception& e) {
+        fmt::print(stderr, "Failed to query scx_loader: {}\n", e.what());
+        return false;
+    }
+
+    bool is_within_budget{true};
+    fmt::print("{:<24} {:>11} {:>11} {:>7}\n", "query", "rust allocs", "c++ allocs", "budget");
+    for (auto&& result : results) {
+        const bool is_over_budget = result.cxx_allocs > result.rust_allocs + result.budget;
+        is_within_budget          = is_within_budget && !is_over_budget;
+        fmt::print("{:<24} {:>11} {:>11} {:>7}{}\n", result.name, result.rust_allocs, result.cxx_allocs, result.budget, is_over_budget ? " over budget" : "");
+    }
+    return is_within_budget;
+}
+
+/// @brief Starts the process and waits until it prints the first line, which is returned.
+auto start_and_read_line(QProcess& process, const QString& program, const QStringList& args) noexcept -> std::optional<QString> {
+    process.setProcessChannelMode(QProcess::ForwardedErrorChannel);
+    process.start(program, args);
+    if (!process.waitForStarted(kStartTimeoutMs)) {
+        fmt::print(stderr, "Failed to start {}: {}\n", program.toStdString(), process.errorString().toStdString());
+        return std::nullopt;
+    }
+    while (!process.canReadLine()) {
+        if (!process.waitForReadyRead(kStartTimeoutMs)) {
+            fmt::print(stderr, "{} didn't get ready in time\n", program.toStdString());
+            return std::nullopt;
+        }
+    }
+    return QString::fromUtf8(process.readLine()).trimmed();
+}
+
+void print_results(const std::vector<OpResult>& results, bool is_csv) noexcept {
+    if (is_csv) {
+        fmt::print("op,iterations,failures,ns_per_op,allocs_per_op\n");
+        for (auto&& result : results) {
+            fmt::print("{},{},{},{:.0f},{:.2f}\n", result.name, result.iterations, result.failures, result.ns_per_op, result.allocs_per_op);
+        }
+        return;
+    }
+
+    fmt::print("{:<32} {:>10} {:>9} {:>14} {:>11}\n", "op", "iterations", "failures", "ns/op", "allocs/op");
+    for (auto&& result : results) {
+        fmt::print("{:<32} {:>10} {:>9} {:>14.0f} {:>11.2f}\n", result.name, result.iterations, result.failures, result.ns_per_op, result.allocs_per_op);
+    }
+}
+
+}  // namespace
+
+extern "C" {
+
+auto malloc(std::size_t size) noexcept -> void* {
+    g_alloc_count.fetch_add(1, std::memory_order_relaxed);
+    return __libc_malloc(size);
+}
+
+auto calloc(std::size_t count, std::size_t size) noexcept -> void* {
+    g_alloc_count.fetch_add(1, std::memory_order_relaxed);
+    return __libc_calloc(count, size);
+}
+
+auto realloc(void* ptr, std::size_t size) noexcept -> void* {
+    g_alloc_count.fetch_add(1, std::memory_order_relaxed);
+    return __libc_realloc(ptr, size);
+}
+
+auto aligned_alloc(std::size_t alignment, std::size_t size) noexcept -> void* {
+    g_alloc_count.fetch_add(1, std::memory_order_relaxed);
+    return __libc_memalign(alignment, size);
+}
+
+auto posix_memalign(void** ptr, std::size_t alignment, std::size_t size) noexcept -> int {
+    // power of two multiple of the pointer size, as glibc checks it
+    if (alignment % sizeof(void*) != 0 || (alignment & (alignment - 1)) != 0) {
+        return EINVAL;
+    }
+    g_alloc_count.fetch_add(1, std::memory_order_relaxed);
+    auto* mem = __libc_memalign(alignment, size);
+    if (mem == nullptr) {
+        return ENOMEM;
+    }
+    *ptr = mem;
+    return 0;
+}
+
+void free(void* ptr) noexcept {
+    __libc_free(ptr);
+}
+
+}  // extern "C"
+
+auto main(int argc, char** argv) -> std::int32_t {
+    QCoreApplication::setOrganizationName("CachyOS");
+    QCoreApplication::setOrganizationDomain("cachyos.org");
+    QCoreApplication::setApplicationName("scx-config-bench");
+
+    const QCoreApplication app(argc, argv);
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription(
+        "Measures time and allocations of the scx_loader config operations against scx-mock-loader on a private bus.");
+    parser.addHelpOption();
+
+    const QCommandLineOption iterations_option("iterations", "Iterations of each op, init_config and apply run a tenth of them.", "count", "1000");
+    const QCommandLineOption warmup_option("warmup", "Iterations run before measuring each op.", "count", "10");
+    const QCommandLineOption latency_option("latency-us", "Latency added by the mock to each call, in microseconds.", "us", "0");
+    const QCommandLineOption fail_every_option("fail-every", "The mock fails every Nth call, 0 disables the failures.", "count", "0");
+    const QCommandLineOption mock_loader_option("mock-loader", "Path of scx-mock-loader.", "path", SCX_MOCK_LOADER_PATH);
+    const QCommandLineOption bus_address_option("bus-address", "Use the bus instead of starting a private dbus-daemon.", "address");
+    const QCommandLineOption scheds_option("scheds", "Two schedulers the apply alternates between.", "list", "scx_bpfland,scx_lavd");
+    const QCommandLineOption format_option("format", "Output format: text or csv.", "format", "text");
+    const QCommandLineOption check_allocs_option("check-allocs", "Instead of benchmarking, check that the C++ side of each query allocates at most once per returned string.");
+    parser.addOptions({iterations_option, warmup_option, latency_option, fail_every_option, mock_loader_option, bus_address_option, scheds_option, format_option, check_allocs_option});
+    parser.process(app);
+
+    bool is_valid_iterations{};
+    const std::uint64_t iterations = parser.value(iterations_option).toULongLong(&is_valid_iterations);
+    bool is_valid_warmup{};
+    const std::uint64_t warmup = parser.value(warmup_option).toULongLong(&is_valid_warmup);
+    bool is_valid_latency{};
+    parser.value(latency_option).toULongLong(&is_valid_latency);
+    bool is_valid_fail_every{};
+    parser.value(fail_every_option).toULongLong(&is_valid_fail_every);
+    if (!is_valid_iterations || iterations == 0 || !is_valid_warmup || !is_valid_latency || !is_valid_fail_every) {
+        fmt::print(stderr, "Iterations, latency and failure interval must be non-negative numbers\n");
+        return kExitUsage;
+    }
+    const auto format = parser.value(format_option);
+    if (format != "text" && format != "csv") {
+        fmt::print(stderr, "Unknown output format: {}\n", format.toStdString());
+        return kExitUsage;
+    }
+    const auto scheds = parser.value(scheds_option).split(',', Qt::SkipEmptyParts);
+    if (scheds.size() != 2) {
+        fmt::print(stderr, "Exactly two schedulers are expected\n");
+        return kExitUsage;
+    }
+
+    // declared first, so that the bus outlives the mock, and both outlive the config
+    QProcess dbus_daemon;
+    QString bus_address = parser.value(bus_address_option);
+    if (bus_address.isEmpty()) {
+        auto printed_address = start_and_read_line(dbus_daemon, "dbus-daemon", {"--session", "--nofork", "--print-address"});
+        if (!printed_address) {
+            return kExitFailure;
+        }
+        bus_address = std::move(*printed_address);
+    }
+
+    QProcess mock_loader;
+    const QStringList mock_args{
+        "--address", bus_address,
+        "--latency-us", parser.value(latency_option),
+        "--fail-every", parser.value(fail_every_option),
+        "--scheds", scheds.join(',')};
+    const auto mock_status = start_and_read_line(mock_loader, parser.value(mock_loader_option), mock_args);
+    if (mock_status != "ready") {
+        return kExitFailure;
+    }
+    qputenv("SCX_MANAGER_BUS_ADDRESS", bus_address.toUtf8());
+
+    // the directory is writable by the user, so the config is written without the privileged helper
+    const QTemporaryDir config_dir;
+    if (!config_dir.isValid()) {
+        fmt::print(stderr, "Failed to create temporary directory: {}\n", config_dir.errorString().toStdString());
+        return kExitFailure;
+    }
+    const auto config_path = config_dir.filePath("scx_loader.toml").toStdString();
+
+    auto loader_config = scx::loader::Config::init_config(config_path);
+    if (!loader_config) {
+        return kExitFailure;
+    }
+
+    const auto slow_iterations = std::max<std::uint64_t>(iterations / kSlowOpDivisor, 1);
+    const auto first_sched     = scheds[0].toStdString();
+    const auto second_sched    = scheds[1].toStdString();
+
+    if (parser.isSet(check_allocs_option)) {
+        return check_bridge_allocs(*loader_config, config_path, first_sched) ? 0 : kExitFailure;
+    }
+
+    std::vector<OpResult> results;
+    results.emplace_back(run_op("init_config", slow_iterations, warmup, [&config_path](std::uint64_t) {
+        return scx::loader::Config::init_config(config_path).has_value();
+    }));
+    results.emplace_back(run_op("get_supported_scheds", iterations, warmup, [&loader_config](std::uint64_t) {
+        return loader_config->get_supported_scheds().has_value();
+    }));
+    results.emplace_back(run_op("get_current_sched", iterations, warmup, [&loader_config](std::uint64_t) {
+        return loader_config->get_current_sched().has_value();
+    }));
+    results.emplace_back(run_op("get_current_mode", iterations, warmup, [&loader_config](std::uint64_t) {
+        return loader_config->get_current_mode().has_value();
+    }));
+    results.emplace_back(run_op("scx_flags_for_mode", iterations, warmup, [&loader_config, &first_sched](std::uint64_t) {
+        return loader_config->scx_flags_for_mode(first_sched, scx::SchedMode::Gaming).has_value();
+    }));
+    loader_config->prime_flags_cache(scheds);
+    results.emplace_back(run_op("scx_flags_for_mode (cached)", iterations, warmup, [&loader_config, &first_sched](std::uint64_t) {
+        return loader_config->scx_flags_for_mode(first_sched, scx::SchedMode::Gaming).has_value();
+    }));
+    results.emplace_back(run_op("apply_scheduler_change", slow_iterations, warmup, [&](std::uint64_t iteration) {
+        // alternates, so that each apply is an actual change
+        const auto& scx_sched = (iteration % 2 == 0) ? first_sched : second_sched;
+        auto extra_args       = loader_config->scx_flags_for_mode(scx_sched, scx::SchedMode::Auto);
+        return extra_args && loader_config->apply_scheduler_change(scx_sched, scx::SchedMode::Auto, *extra_args, config_path);
+    }));
+
+    print_results(results, format == "csv");
+    return 0;
+}
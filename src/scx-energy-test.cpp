@@ -0,0 +1,143 @@
+// Copyright (C) 2024-2025 Vladislav Nepogodin
+//
+// This file is part of CachyOS kernel manager.
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+#include "scx_energy.hpp"
+
+#include <cmath>            // for fabs
+#include <cstdint>          // for int32_t
+#include <cstdio>           // for stderr
+#include <filesystem>       // for create_directories
+#include <fstream>          // for ofstream
+#include <source_location>  // for source_location
+#include <system_error>     // for error_code
+
+#include <unistd.h>  // for getpid
+
+#include <fmt/core.h>
+
+namespace {
+
+using scx::energy::EnergyDomain;
+
+// wraps around quickly, so that the test can cross it
+constexpr std::uint64_t kMaxRangeUj = 10'000'000;
+
+bool g_failed{};
+
+void check(bool condition, std::string_view what, std::source_location location = std::source_location::current()) noexcept {
+    if (!condition) {
+        fmt::print(stderr, "{}:{}: check failed: {}\n", location.file_name(), location.line(), what);
+        g_failed = true;
+    }
+}
+
+auto joules_near(const scx::energy::EnergyCounts& counts, EnergyDomain domain, double expected) noexcept -> bool {
+    const auto domain_idx = static_cast<std::size_t>(domain);
+    return counts.valid.test(domain_idx) && std::fabs(counts.joules[domain_idx] - expected) < 1e-9;
+}
+
+/// Powercap tree as the kernel lays it out, every zone is a directory of the root.
+class PowercapFixture final {
+ public:
+    PowercapFixture() : m_root(std::filesystem::temp_directory_path() / fmt::format("scx-energy-test-{}", ::getpid())) {
+        std::filesystem::remove_all(m_root);
+        // the control type, it has no name
+        std::filesystem::create_directories(m_root / "intel-rapl");
+    }
+    ~PowercapFixture() noexcept {
+        std::error_code err_code{};
+        std::filesystem::remove_all(m_root, err_code);
+    }
+
+    PowercapFixture(const PowercapFixture&)                    = delete;
+    auto operator=(const PowercapFixture&) -> PowercapFixture& = delete;
+
+    void add_zone(std::string_view zone, std::string_view name, std::uint64_t energy_uj) const {
+        std::filesystem::create_directories(m_root / zone);
+        write(zone, "name", name);
+        write(zone, "max_energy_range_uj", fmt::format("{}", kMaxRangeUj));
+        set_energy(zone, energy_uj);
+    }
+
+    void set_energy(std::string_view zone, std::uint64_t energy_uj) const {
+        write(zone, "energy_uj", fmt::format("{}", energy_uj));
+    }
+
+    [[nodiscard]] auto root() const noexcept -> const std::filesystem::path& { return m_root; }
+
+ private:
+    void write(std::string_view zone, std::string_view attribute, std::string_view value) const {
+        // rewritten in place, the meter keeps the files open
+        std::ofstream attribute_file(m_root / zone / attribute, std::ios::trunc);
+        attribute_file << value << '\n';
+    }
+
+    std::filesystem::path m_root;
+};
+
+}  // namespace
+
+auto main() -> std::int32_t {
+    const PowercapFixture fixture;
+    fixture.add_zone("intel-rapl:0", "package-0", 1'000'000);
+    fixture.add_zone("intel-rapl:0:0", "core", 500'000);
+    // overlaps with the package, not accounted
+    fixture.add_zone("intel-rapl:0:1", "uncore", 0);
+    fixture.add_zone("intel-rapl:1", "package-1", kMaxRangeUj - 1'000'000);
+    // the same package read through MMIO
+    fixture.add_zone("intel-rapl-mmio:0", "package-0", 1'000'000);
+
+    scx::energy::EnergyMeter meter{fixture.root().native()};
+    check(meter.open(), "zones are found");
+    meter.set_label("scx_lavd (gaming)");
+
+    fixture.set_energy("intel-rapl:0", 3'000'000);
+    fixture.set_energy("intel-rapl:0:0", 1'000'000);
+    fixture.set_energy("intel-rapl:0:1", 7'000'000);
+    // crosses max_energy_range_uj
+    fixture.set_energy("intel-rapl:1", 500'000);
+    fixture.set_energy("intel-rapl-mmio:0", 100'000'000);
+    check(meter.sample(), "the zones are sampled");
+
+    const auto& last_counts = meter.last_counts();
+    check(joules_near(last_counts, EnergyDomain::Package, 2. + 1.5), "packages are summed, the wrapped one included");
+    check(joules_near(last_counts, EnergyDomain::Core, 0.5), "core is accounted");
+    check(!last_counts.valid.test(static_cast<std::size_t>(EnergyDomain::Dram)), "missing dram is unset");
+
+    meter.set_label("scx_bpfland (auto)");
+    fixture.set_energy("intel-rapl:0", 4'000'000);
+    check(meter.sample(), "the zones are sampled again");
+
+    meter.set_label("scx_lavd (gaming)");
+    fixture.set_energy("intel-rapl:0", 4'500'000);
+    check(meter.sample(), "the zones are sampled for the first label again");
+
+    const auto& profiles = meter.profiles();
+    check(profiles.size() == 2, "a profile per label");
+    if (profiles.size() == 2) {
+        check(profiles[0].label == "scx_lavd (gaming)" && joules_near(profiles[0].counts, EnergyDomain::Package, 3.5 + 0.5), "energy of the label is aggregated");
+        check(joules_near(profiles[0].counts, EnergyDomain::Core, 0.5), "core of the label is aggregated");
+        check(profiles[1].label == "scx_bpfland (auto)" && joules_near(profiles[1].counts, EnergyDomain::Package, 1.), "energy of the other label");
+    }
+
+    if (g_failed) {
+        return 1;
+    }
+    fmt::print("All checks passed\n");
+    return 0;
+}
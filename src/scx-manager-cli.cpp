@@ -0,0 +1,482 @@
+// Copyright (C) 2024-2025 Vladislav Nepogodin
+//
+// This file is part of CachyOS kernel manager.
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+#include "scx_state_watcher.hpp"
+#include "scx_apply_executor.hpp"
+#include "scx_history.hpp"
+#include "scx_sysfs.hpp"
+#include "scx_trial_apply.hpp"
+#include "scx_utils.hpp"
+#include "scx_watchdog.hpp"
+
+#include <array>     // for array
+#include <chrono>    // for duration
+#include <cstdint>   // for int32_t
+#include <cstdio>    // for stderr
+#include <optional>  // for optional
+#include <utility>   // for move
+
+#include <fmt/core.h>
+
+#if defined(__clang__)
+#pragma clang diagnostic push
+#pragma clang diagnostic ignored "-Wold-style-cast"
+#pragma clang diagnostic ignored "-Wsign-conversion"
+#elif defined(__GNUC__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wnull-dereference"
+#pragma GCC diagnostic ignored "-Wuseless-cast"
+#pragma GCC diagnostic ignored "-Wold-style-cast"
+#pragma GCC diagnostic ignored "-Wsuggest-final-types"
+#pragma GCC diagnostic ignored "-Wsuggest-attribute=pure"
+#pragma GCC diagnostic ignored "-Wconversion"
+#pragma GCC diagnostic ignored "-Wsign-conversion"
+#endif
+
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QDateTime>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+
+#if defined(__clang__)
+#pragma clang diagnostic pop
+#elif defined(__GNUC__)
+#pragma GCC diagnostic pop
+#endif
+
+namespace {
+
+constexpr std::int32_t kExitFailure = 1;
+constexpr std::int32_t kExitUsage   = 2;
+
+auto to_qstring(std::string_view str) noexcept -> QString {
+    return QString::fromUtf8(str.data(), static_cast<qsizetype>(str.size()));
+}
+
+void print_json(const QJsonObject& object) noexcept {
+    fmt::print("{}\n", QJsonDocument(object).toJson(QJsonDocument::Compact).toStdString());
+}
+
+auto print_list(scx::loader::Config& config, bool as_json) noexcept -> std::int32_t {
+    const auto supported_scheds = config.get_supported_scheds();
+    if (!supported_scheds) {
+        return kExitFailure;
+    }
+    if (as_json) {
+        print_json(QJsonObject{{"schedulers", QJsonArray::fromStringList(*supported_scheds)}});
+        return 0;
+    }
+    for (auto&& scx_sched : *supported_scheds) {
+        fmt::print("{}\n", scx_sched.toStdString());
+    }
+    return 0;
+}
+
+auto print_status(scx::loader::Config& config, bool as_json) noexcept -> std::int32_t {
+    // sysfs tells what the kernel runs, even if scheduler was started without scx_loader
+    std::array<char, 256> read_buf{};
+    scx::SysfsFile state_file{scx::sched_ext::kStatePath};
+    const std::string state{state_file.read(read_buf)};
+    scx::SysfsFile ops_file{scx::sched_ext::kRootOpsPath};
+    const std::string ops{ops_file.read(read_buf)};
+
+    const auto current_sched = config.get_current_sched();
+    const auto current_mode  = config.get_current_mode();
+    const auto mode_name     = current_mode ? scx::sched_mode_name(*current_mode) : std::string_view{};
+
+    if (as_json) {
+        print_json(QJsonObject{
+            {"state", state.empty() ? QJsonValue{} : QJsonValue{QString::fromStdString(state)}},
+            {"ops", ops.empty() ? QJsonValue{} : QJsonValue{QString::fromStdString(ops)}},
+            {"scheduler", current_sched ? QJsonValue{QString::fromStdString(*current_sched)} : QJsonValue{}},
+            {"mode", current_mode ? QJsonValue{to_qstring(mode_name)} : QJsonValue{}},
+        });
+    } else {
+        fmt::print("state: {}\n", state.empty() ? "unknown" : state);
+        fmt::print("ops: {}\n", ops.empty() ? "none" : ops);
+        fmt::print("scheduler: {}\n", current_sched.value_or("unknown"));
+        fmt::print("mode: {}\n", current_mode ? mode_name : "unknown");
+    }
+    return (current_sched && current_mode) ? 0 : kExitFailure;
+}
+
+void print_result(bool as_json, std::string_view action, std::string_view failed_stage) noexcept {
+    if (as_json) {
+        print_json(QJsonObject{
+            {"action", to_qstring(action)},
+            {"succeeded", failed_stage.empty()},
+            {"failed_stage", failed_stage.empty() ? QJsonValue{} : QJsonValue{to_qstring(failed_stage)}},
+        });
+    } else if (!failed_stage.empty()) {
+        fmt::print(stderr, "{} failed at '{}' stage\n", action, failed_stage);
+    }
+}
+
+/// Records the change into the history shared with the window, if it can be opened.
+void record_history(const scx::history::Record& record) noexcept {
+    scx::history::HistoryLog history;
+    if (const auto history_path = scx::history::default_history_path(); history_path && history.open(*history_path)) {
+        history.append(record);
+    }
+}
+
+auto print_history(std::string_view history_path, bool as_json) noexcept -> std::int32_t {
+    scx::history::HistoryLog history;
+    if (!history.open(history_path, false)) {
+        return kExitFailure;
+    }
+    const auto records = history.records();
+    if (!as_json) {
+        for (auto&& record : records) {
+            fmt::print("{}\n", scx::history::format_record(record));
+        }
+        return 0;
+    }
+
+    QJsonArray records_array;
+    for (auto&& record : records) {
+        QJsonObject metrics_object;
+        for (std::size_t metric_idx = 0; metric_idx < scx::history::kMetricCount; ++metric_idx) {
+            const auto metric = static_cast<scx::history::Metric>(metric_idx);
+            if (const auto value = record.metric(metric); value) {
+                metrics_object.insert(to_qstring(scx::history::metric_name(metric)), *value);
+            }
+        }
+        const auto sched_mode = record.mode();
+        records_array.append(QJsonObject{
+            {"timestamp_ns", static_cast<qint64>(record.timestamp_ns)},
+            {"kind", to_qstring(scx::history::record_kind_name(record.kind))},
+            {"source", to_qstring(scx::history::source_name(record.source))},
+            {"scheduler", to_qstring(record.scheduler_name())},
+            {"mode", sched_mode ? QJsonValue{to_qstring(scx::sched_mode_name(*sched_mode))} : QJsonValue{}},
+            {"text", to_qstring(record.text_view())},
+            {"metrics", metrics_object},
+        });
+    }
+    print_json(QJsonObject{{"records", records_array}});
+    return 0;
+}
+
+void print_plan(bool as_json, std::string_view action, const scx::loader::ChangePlan& plan) noexcept {
+    const auto stages = scx::loader::plan_stages(plan);
+    if (as_json) {
+        QJsonArray stage_names;
+        for (auto&& stage : stages) {
+            stage_names.append(to_qstring(scx::loader::apply_stage_name(stage)));
+        }
+        print_json(QJsonObject{
+            {"action", to_qstring(action)},
+            {"stages", stage_names},
+            {"reasons", QJsonArray::fromStringList(plan.reasons)},
+        });
+        return;
+    }
+    if (stages.empty()) {
+        fmt::print("nothing to change\n");
+    }
+    for (auto&& stage : stages) {
+        fmt::print("{}\n", scx::loader::apply_stage_name(stage));
+    }
+    for (auto&& reason : plan.reasons) {
+        fmt::print("  {}\n", reason.toStdString());
+    }
+}
+
+/// Plans the change, all of its stages are run if planning failed.
+auto plan_or_all(std::optional<scx::loader::ChangePlan> plan, scx::loader::ChangePlan all_stages) noexcept -> scx::loader::ChangePlan {
+    if (!plan) {
+        fmt::print(stderr, "Cannot plan the change, running all of its stages\n");
+        return all_stages;
+    }
+    return std::move(*plan);
+}
+
+auto apply_scheduler(scx::loader::Config& config, std::string_view config_path, std::string_view scx_sched, scx::SchedMode sched_mode, const QStringList& extra_args, bool dry_run, bool as_json) noexcept -> std::int32_t {
+    auto plan = config.plan_scheduler_change(scx_sched, sched_mode, extra_args, true, config_path);
+    if (dry_run) {
+        if (!plan) {
+            return kExitFailure;
+        }
+        print_plan(as_json, "apply", *plan);
+        return 0;
+    }
+    const auto change = plan_or_all(std::move(plan),
+        scx::loader::ChangePlan{.stop_scx_service = true, .switch_scheduler = true, .enable_loader_service = true, .write_config = true});
+
+    // same stages as in the window, but a failed switch isn't ignored
+    std::string_view failed_stage{};
+    if (change.stop_scx_service) {
+        config.stop_scx_service();
+    }
+    if (change.switch_scheduler && !config.switch_scheduler(scx_sched, sched_mode, extra_args)) {
+        failed_stage = "switch";
+    } else {
+        if (change.enable_loader_service) {
+            config.enable_loader_service();
+        }
+        if (change.write_config && !config.write_scheduler_config(scx_sched, sched_mode, extra_args, config_path)) {
+            failed_stage = "write-config";
+        }
+        if (change.switch_scheduler) {
+            record_history(scx::history::make_transition(scx::history::Source::Cli, scx_sched, sched_mode, "apply"));
+        }
+    }
+    print_result(as_json, "apply", failed_stage);
+    return failed_stage.empty() ? 0 : kExitFailure;
+}
+
+auto disable_scheduler(scx::loader::Config& config, std::string_view config_path, bool dry_run, bool as_json) noexcept -> std::int32_t {
+    auto plan = config.plan_disable(true, config_path);
+    if (dry_run) {
+        if (!plan) {
+            return kExitFailure;
+        }
+        print_plan(as_json, "disable", *plan);
+        return 0;
+    }
+    const auto change = plan_or_all(std::move(plan), scx::loader::ChangePlan{.stop_scheduler = true, .write_config = true});
+
+    std::string_view failed_stage{};
+    if (change.stop_scheduler && !config.stop_scheduler()) {
+        failed_stage = "stop";
+    } else {
+        if (change.stop_scheduler) {
+            record_history(scx::history::make_transition(scx::history::Source::Cli, {}, std::nullopt, "disable"));
+        }
+        if (change.write_config && !config.write_disabled_config(config_path)) {
+            failed_stage = "write-config";
+        }
+    }
+    print_result(as_json, "disable", failed_stage);
+    return failed_stage.empty() ? 0 : kExitFailure;
+}
+
+auto trial_metrics_to_json(const scx::trial::TrialMetrics& metrics) noexcept -> QJsonObject {
+    const auto to_json = [](const std::optional<double>& value) { return value ? QJsonValue{*value} : QJsonValue{}; };
+    return QJsonObject{
+        {"cpu_pressure_pct", to_json(metrics.cpu_pressure_pct)},
+        {"run_delay_us", to_json(metrics.run_delay_us)},
+        {"context_switch_rate", to_json(metrics.context_switch_rate)},
+    };
+}
+
+auto run_trial(scx::loader::Config& config, std::string_view config_path, scx::loader::ApplyRequest request, std::chrono::seconds window, bool as_json) noexcept -> std::int32_t {
+    scx::loader::ApplyExecutor executor(config, config_path);
+    scx::trial::TrialApply trial_apply(config, executor, scx::trial::TrialConfig{.window = window});
+
+    QObject::connect(&trial_apply, &scx::trial::TrialApply::phase_changed, [as_json](scx::trial::TrialPhase phase) {
+        if (!as_json && phase != scx::trial::TrialPhase::Idle) {
+            fmt::print(stderr, "trial: {}\n", scx::trial::trial_phase_name(phase));
+        }
+    });
+    QObject::connect(&trial_apply, &scx::trial::TrialApply::finished, [as_json](const scx::trial::TrialResult& result) {
+        constexpr std::array kOutcomeNames{"committed", "rolled-back", "failed", "canceled"};
+        const std::string_view outcome_name = kOutcomeNames[static_cast<std::size_t>(result.outcome)];
+        if (as_json) {
+            print_json(QJsonObject{
+                {"action", QStringLiteral("trial")},
+                {"outcome", to_qstring(outcome_name)},
+                {"reason", result.reason.empty() ? QJsonValue{} : QJsonValue{QString::fromStdString(result.reason)}},
+                {"baseline", trial_metrics_to_json(result.baseline)},
+                {"trial", trial_metrics_to_json(result.trial)},
+            });
+        } else {
+            fmt::print("baseline: {}\ntrial: {}\n{}{}{}\n", scx::trial::format_trial_metrics(result.baseline), scx::trial::format_trial_metrics(result.trial),
+                outcome_name, result.reason.empty() ? "" : ": ", result.reason);
+        }
+        QCoreApplication::exit(result.outcome == scx::trial::TrialOutcome::Committed ? 0 : kExitFailure);
+    });
+
+    if (!trial_apply.start(request)) {
+        return kExitFailure;
+    }
+    return QCoreApplication::exec();
+}
+
+void print_incident(std::string_view event, const scx::watchdog::Incident& incident, const scx::watchdog::WatchdogStats& stats, bool as_json) noexcept {
+    const auto time_to_recovery = incident.time_to_recovery();
+    const auto mttr             = stats.mean_time_to_recovery();
+    if (as_json) {
+        const auto ejected_at_ms = std::chrono::duration_cast<std::chrono::milliseconds>(incident.ejected_at_wall.time_since_epoch()).count();
+        print_json(QJsonObject{
+            {"event", to_qstring(event)},
+            {"ops", QString::fromStdString(incident.ops)},
+            {"reason", incident.reason.empty() ? QJsonValue{} : QJsonValue{QString::fromStdString(incident.reason)}},
+            {"message", incident.message.empty() ? QJsonValue{} : QJsonValue{QString::fromStdString(incident.message)}},
+            {"ejected_at", QDateTime::fromMSecsSinceEpoch(ejected_at_ms).toString(Qt::ISODateWithMs)},
+            {"attempts", static_cast<qint64>(incident.attempts)},
+            {"recovered_with", incident.recovered_with ? QJsonValue{QString::fromStdString(incident.recovered_with->scx_sched)} : QJsonValue{}},
+            {"time_to_recovery_secs", time_to_recovery ? QJsonValue{std::chrono::duration<double>(*time_to_recovery).count()} : QJsonValue{}},
+            {"ejections", static_cast<qint64>(stats.ejections)},
+            {"mttr_secs", mttr ? QJsonValue{mttr->count()} : QJsonValue{}},
+        });
+        return;
+    }
+
+    fmt::print("{} {}", event, incident.ops);
+    if (!incident.reason.empty()) {
+        fmt::print(" ({}{}{})", incident.reason, incident.message.empty() ? "" : ": ", incident.message);
+    }
+    if (incident.recovered_with && time_to_recovery) {
+        fmt::print(" with {} ({}) after {:.3f}s", incident.recovered_with->scx_sched, scx::sched_mode_name(incident.recovered_with->mode),
+            std::chrono::duration<double>(*time_to_recovery).count());
+    }
+    if (incident.attempts > 0) {
+        fmt::print(", attempts: {}", incident.attempts);
+    }
+    if (mttr) {
+        fmt::print(", MTTR: {:.3f}s over {} ejections", mttr->count(), stats.ejections);
+    }
+    fmt::print("\n");
+}
+
+auto run_watchdog(scx::loader::Config& config, std::string_view config_path, std::optional<scx::watchdog::Target> fallback, bool as_json) noexcept -> std::int32_t {
+    scx::loader::ApplyExecutor executor(config, config_path);
+    scx::StateWatcher state_watcher(&config);
+    scx::watchdog::Watchdog watchdog(config, executor, state_watcher, scx::watchdog::WatchdogConfig{.fallback = std::move(fallback)});
+    if (!watchdog.reads_kernel_log()) {
+        fmt::print(stderr, "Kernel log isn't readable, exit reasons are unknown\n");
+    }
+
+    QObject::connect(&watchdog, &scx::watchdog::Watchdog::ejected, [&](const scx::watchdog::Incident& incident) {
+        print_incident("ejected", incident, watchdog.stats(), as_json);
+    });
+    QObject::connect(&watchdog, &scx::watchdog::Watchdog::recovered, [&](const scx::watchdog::Incident& incident) {
+        print_incident("recovered", incident, watchdog.stats(), as_json);
+    });
+    QObject::connect(&watchdog, &scx::watchdog::Watchdog::gave_up, [&](const scx::watchdog::Incident& incident) {
+        print_incident("gave-up", incident, watchdog.stats(), as_json);
+    });
+    return QCoreApplication::exec();
+}
+
+}  // namespace
+
+auto main(int argc, char** argv) -> std::int32_t {
+    QCoreApplication::setOrganizationName("CachyOS");
+    QCoreApplication::setOrganizationDomain("cachyos.org");
+    QCoreApplication::setApplicationName("scx-manager-cli");
+
+    // NOTE: event loop is started only by --watchdog and --trial, otherwise QCoreApplication is needed only for the parser
+    const QCoreApplication app(argc, argv);
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Manages sched_ext schedulers via scx_loader, without the GUI.");
+    parser.addHelpOption();
+
+    const QCommandLineOption list_option("list", "List schedulers supported by scx_loader.");
+    const QCommandLineOption status_option("status", "Show the running scheduler and mode.");
+    const QCommandLineOption apply_option("apply", "Switch to the scheduler and make it default.", "sched");
+    const QCommandLineOption mode_option("mode", "Mode for --apply and --fallback: auto, gaming, powersave, lowlatency, server.", "mode", "auto");
+    const QCommandLineOption args_option("args", "Extra scheduler arguments for --apply, overriding the mode. Quote arguments containing spaces.", "args");
+    const QCommandLineOption trial_option("trial", "Run --apply on trial for the seconds, roll back if CPU pressure, run queue delay or context switches regress.", "secs");
+    const QCommandLineOption disable_option("disable", "Stop the scheduler and disable its auto start.");
+    const QCommandLineOption dry_run_option("dry-run", "Print the steps --apply or --disable would run, without running them.");
+    const QCommandLineOption watchdog_option("watchdog", "Keep running, and apply the scheduler again if the kernel ejects it.");
+    const QCommandLineOption fallback_option("fallback", "Scheduler for --watchdog, if the ejected one cannot be recovered.", "sched");
+    const QCommandLineOption json_option("json", "Print output as JSON.");
+    const QCommandLineOption config_option("config", "Path to scx_loader config.", "path", "/etc/scx_loader.toml");
+    const QCommandLineOption history_option("history", "Print the recorded scheduler changes, sched_ext state changes and metric samples.");
+    const QCommandLineOption history_file_option("history-file", "History file for --history, $XDG_STATE_HOME/scx-manager/history.bin by default.", "path");
+    parser.addOptions({list_option, status_option, apply_option, mode_option, args_option, trial_option, disable_option, dry_run_option, watchdog_option, fallback_option,
+        json_option, config_option, history_option, history_file_option});
+    parser.process(app);
+
+    const auto action_count = static_cast<int>(parser.isSet(list_option)) + static_cast<int>(parser.isSet(status_option))
+        + static_cast<int>(parser.isSet(apply_option)) + static_cast<int>(parser.isSet(disable_option)) + static_cast<int>(parser.isSet(watchdog_option))
+        + static_cast<int>(parser.isSet(history_option));
+    if (action_count != 1) {
+        fmt::print(stderr, "Exactly one of --list, --status, --apply, --disable, --watchdog or --history is required\n");
+        return kExitUsage;
+    }
+    if (parser.isSet(history_option)) {
+        // reading the history doesn't need scx_loader
+        auto history_path = parser.isSet(history_file_option) ? std::optional{parser.value(history_file_option).toStdString()} : scx::history::default_history_path();
+        if (!history_path) {
+            fmt::print(stderr, "Neither XDG_STATE_HOME nor HOME is set, pass --history-file\n");
+            return kExitUsage;
+        }
+        return print_history(*history_path, parser.isSet(json_option));
+    }
+
+    const auto sched_mode = scx::sched_mode_from_name(parser.value(mode_option).toStdString());
+    if (!sched_mode) {
+        fmt::print(stderr, "Unknown mode: {}\n", parser.value(mode_option).toStdString());
+        return kExitUsage;
+    }
+
+    std::optional<std::chrono::seconds> trial_window{};
+    if (parser.isSet(trial_option)) {
+        bool is_valid{};
+        const auto trial_secs = parser.value(trial_option).toUInt(&is_valid);
+        if (!is_valid || trial_secs == 0 || !parser.isSet(apply_option)) {
+            fmt::print(stderr, "--trial requires --apply and a positive number of seconds\n");
+            return kExitUsage;
+        }
+        trial_window = std::chrono::seconds{trial_secs};
+    }
+    const bool dry_run = parser.isSet(dry_run_option);
+    if (dry_run && ((!parser.isSet(apply_option) && !parser.isSet(disable_option)) || trial_window)) {
+        fmt::print(stderr, "--dry-run requires --apply or --disable, and cannot be combined with --trial\n");
+        return kExitUsage;
+    }
+
+    const auto config_path = parser.value(config_option).toStdString();
+    auto loader_config     = scx::loader::Config::init_config(config_path);
+    if (!loader_config) {
+        return kExitFailure;
+    }
+
+    const bool as_json = parser.isSet(json_option);
+    if (parser.isSet(list_option)) {
+        return print_list(*loader_config, as_json);
+    }
+    if (parser.isSet(status_option)) {
+        return print_status(*loader_config, as_json);
+    }
+    if (parser.isSet(disable_option)) {
+        return disable_scheduler(*loader_config, config_path, dry_run, as_json);
+    }
+    if (parser.isSet(watchdog_option)) {
+        std::optional<scx::watchdog::Target> fallback{};
+        if (parser.isSet(fallback_option)) {
+            fallback = scx::watchdog::Target{.scx_sched = parser.value(fallback_option).toStdString(), .mode = *sched_mode};
+        }
+        return run_watchdog(*loader_config, config_path, std::move(fallback), as_json);
+    }
+    const auto scx_sched = parser.value(apply_option).toStdString();
+    // without --args the scheduler runs with the args of the mode, same as in the window
+    auto extra_args = parser.isSet(args_option) ? std::optional{scx::split_sched_args(parser.value(args_option))}
+                                                : loader_config->scx_flags_for_mode(scx_sched, *sched_mode);
+    if (!extra_args) {
+        return kExitFailure;
+    }
+    if (trial_window) {
+        return run_trial(*loader_config, config_path,
+            scx::loader::ApplyRequest{
+                .kind       = scx::loader::ApplyRequest::Kind::Apply,
+                .scx_sched  = scx_sched,
+                .sched_mode = *sched_mode,
+                .extra_args = std::move(*extra_args),
+            },
+            *trial_window, as_json);
+    }
+    return apply_scheduler(*loader_config, config_path, scx_sched, *sched_mode, *extra_args, dry_run, as_json);
+}
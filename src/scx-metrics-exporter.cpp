@@ -0,0 +1,110 @@
+// Copyright (C) 2024-2025 Vladislav Nepogodin
+//
+// This file is part of CachyOS kernel manager.
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+#include "scx_metrics_exporter.hpp"
+#include "scx_state_watcher.hpp"
+#include "scx_utils.hpp"
+
+#include <cstdint>  // for int32_t
+#include <cstdio>   // for stderr
+
+#include <fmt/core.h>
+
+#if defined(__clang__)
+#pragma clang diagnostic push
+#pragma clang diagnostic ignored "-Wold-style-cast"
+#pragma clang diagnostic ignored "-Wsign-conversion"
+#elif defined(__GNUC__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wnull-dereference"
+#pragma GCC diagnostic ignored "-Wuseless-cast"
+#pragma GCC diagnostic ignored "-Wold-style-cast"
+#pragma GCC diagnostic ignored "-Wsuggest-final-types"
+#pragma GCC diagnostic ignored "-Wsuggest-attribute=pure"
+#pragma GCC diagnostic ignored "-Wconversion"
+#pragma GCC diagnostic ignored "-Wsign-conversion"
+#endif
+
+#include <QCommandLineParser>
+#include <QCoreApplication>
+
+#if defined(__clang__)
+#pragma clang diagnostic pop
+#elif defined(__GNUC__)
+#pragma GCC diagnostic pop
+#endif
+
+namespace {
+
+constexpr std::int32_t kExitFailure = 1;
+constexpr std::int32_t kExitUsage   = 2;
+
+}  // namespace
+
+auto main(int argc, char** argv) -> std::int32_t {
+    QCoreApplication::setOrganizationName("CachyOS");
+    QCoreApplication::setOrganizationDomain("cachyos.org");
+    QCoreApplication::setApplicationName("scx-metrics-exporter");
+
+    const QCoreApplication app(argc, argv);
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Exports sched_ext scheduler state and kernel counters as OpenMetrics.");
+    parser.addHelpOption();
+
+    const QCommandLineOption listen_option("listen", "Serve metrics on unix:<path>, <ipv4>:<port> or <port> on localhost.", "address");
+    const QCommandLineOption textfile_option("textfile", "Write metrics into node_exporter textfile, e.g /var/lib/node_exporter/scx.prom.", "path");
+    const QCommandLineOption interval_option("interval", "Interval of the textfile writes in seconds.", "secs", "15");
+    const QCommandLineOption config_option("config", "Path to scx_loader config.", "path", "/etc/scx_loader.toml");
+    parser.addOptions({listen_option, textfile_option, interval_option, config_option});
+    parser.process(app);
+
+    scx::metrics::ExporterConfig exporter_config{};
+    if (parser.isSet(listen_option)) {
+        exporter_config.listen = scx::metrics::parse_listen_address(parser.value(listen_option).toStdString());
+        if (!exporter_config.listen) {
+            fmt::print(stderr, "Invalid listen address: {}\n", parser.value(listen_option).toStdString());
+            return kExitUsage;
+        }
+    }
+    exporter_config.textfile_path = parser.value(textfile_option).toStdString();
+    if (!exporter_config.listen && exporter_config.textfile_path.empty()) {
+        fmt::print(stderr, "At least one of --listen or --textfile is required\n");
+        return kExitUsage;
+    }
+    bool is_valid_interval{};
+    const auto interval_secs = parser.value(interval_option).toUInt(&is_valid_interval);
+    if (!is_valid_interval || interval_secs == 0) {
+        fmt::print(stderr, "Invalid interval: {}\n", parser.value(interval_option).toStdString());
+        return kExitUsage;
+    }
+    exporter_config.textfile_interval = std::chrono::seconds{interval_secs};
+
+    auto loader_config = scx::loader::Config::init_config(parser.value(config_option).toStdString());
+    if (!loader_config) {
+        return kExitFailure;
+    }
+
+    scx::StateWatcher state_watcher(&*loader_config);
+    const bool needs_listen = exporter_config.listen.has_value();
+    scx::metrics::MetricsExporter exporter(*loader_config, state_watcher, std::move(exporter_config));
+    if (needs_listen && !exporter.is_listening()) {
+        return kExitFailure;
+    }
+    return QCoreApplication::exec();
+}
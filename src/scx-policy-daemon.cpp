@@ -0,0 +1,115 @@
+// Copyright (C) 2024-2025 Vladislav Nepogodin
+//
+// This file is part of CachyOS kernel manager.
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+#include "scx_policy.hpp"
+#include "scx_policy_daemon.hpp"
+#include "scx_utils.hpp"
+
+#include <cstdint>  // for int32_t
+#include <cstdio>   // for stderr
+#include <string>   // for string
+
+#include <fmt/core.h>
+
+#if defined(__clang__)
+#pragma clang diagnostic push
+#pragma clang diagnostic ignored "-Wold-style-cast"
+#pragma clang diagnostic ignored "-Wsign-conversion"
+#elif defined(__GNUC__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wnull-dereference"
+#pragma GCC diagnostic ignored "-Wuseless-cast"
+#pragma GCC diagnostic ignored "-Wold-style-cast"
+#pragma GCC diagnostic ignored "-Wsuggest-final-types"
+#pragma GCC diagnostic ignored "-Wsuggest-attribute=pure"
+#pragma GCC diagnostic ignored "-Wconversion"
+#pragma GCC diagnostic ignored "-Wsign-conversion"
+#endif
+
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QFile>
+#include <QStandardPaths>
+
+#if defined(__clang__)
+#pragma clang diagnostic pop
+#elif defined(__GNUC__)
+#pragma GCC diagnostic pop
+#endif
+
+namespace {
+
+constexpr std::int32_t kExitFailure = 1;
+constexpr std::int32_t kExitUsage   = 2;
+
+/// @brief Reads the rules, falls back to the default ones if the file doesn't exist.
+auto load_policy_config(const QString& rules_path) noexcept -> std::optional<scx::policy::PolicyConfig> {
+    QFile rules_file(rules_path);
+    if (!rules_file.exists()) {
+        fmt::print(stderr, "policy: {} doesn't exist, using the default rules\n", rules_path.toStdString());
+        return scx::policy::default_policy_config();
+    }
+    if (!rules_file.open(QIODevice::ReadOnly)) {
+        fmt::print(stderr, "policy: failed to open {}: {}\n", rules_path.toStdString(), rules_file.errorString().toStdString());
+        return std::nullopt;
+    }
+
+    std::string error_message{};
+    auto policy_config = scx::policy::parse_policy_config(rules_file.readAll(), error_message);
+    if (!policy_config) {
+        fmt::print(stderr, "policy: invalid rules in {}: {}\n", rules_path.toStdString(), error_message);
+    }
+    return policy_config;
+}
+
+}  // namespace
+
+auto main(int argc, char** argv) -> std::int32_t {
+    QCoreApplication::setOrganizationName("CachyOS");
+    QCoreApplication::setOrganizationDomain("cachyos.org");
+    QCoreApplication::setApplicationName("scx-policy-daemon");
+
+    const QCoreApplication app(argc, argv);
+
+    const auto default_rules_path = QStandardPaths::writableLocation(QStandardPaths::AppConfigLocation) + "/policy.json";
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Switches the mode of the running sched_ext scheduler by CPU pressure, load and power source.");
+    parser.addHelpOption();
+
+    const QCommandLineOption rules_option("rules", "Path to the rules in JSON.", "path", default_rules_path);
+    const QCommandLineOption dry_run_option("dry-run", "Only log the switches, don't change the mode.");
+    const QCommandLineOption config_option("config", "Path to scx_loader config.", "path", "/etc/scx_loader.toml");
+    parser.addOptions({rules_option, dry_run_option, config_option});
+    parser.process(app);
+
+    const auto policy_config = load_policy_config(parser.value(rules_option));
+    if (!policy_config) {
+        return kExitUsage;
+    }
+
+    auto loader_config = scx::loader::Config::init_config(parser.value(config_option).toStdString());
+    if (!loader_config) {
+        return kExitFailure;
+    }
+
+    scx::policy::PolicyDaemon daemon(*loader_config, *policy_config, parser.isSet(dry_run_option));
+    // decide on the initial state right away, instead of waiting for the first sample
+    daemon.evaluate();
+    return QCoreApplication::exec();
+}
@@ -0,0 +1,410 @@
+// Copyright (C) 2024-2025 Vladislav Nepogodin
+//
+// This file is part of CachyOS kernel manager.
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+#include "scx_app_profiles.hpp"
+#include "scx_sysfs.hpp"
+
+#include <algorithm>     // for any_of, find_if
+#include <array>         // for array
+#include <cerrno>        // for errno
+#include <charconv>      // for from_chars
+#include <chrono>        // for seconds
+#include <cstdint>       // for uint32_t
+#include <cstring>       // for memcpy, strerror
+#include <filesystem>    // for directory_iterator
+#include <system_error>  // for errc, error_code
+
+#include <linux/cn_proc.h>    // for proc_event, PROC_CN_MCAST_LISTEN
+#include <linux/connector.h>  // for cn_msg, CN_IDX_PROC
+#include <linux/netlink.h>    // for sockaddr_nl, nlmsghdr, NETLINK_CONNECTOR
+#include <sys/socket.h>       // for socket, bind, send, recv
+#include <sys/syscall.h>      // for SYS_pidfd_open
+#include <unistd.h>           // for close, readlink, syscall
+
+#include <fmt/core.h>
+
+#if defined(__clang__)
+#pragma clang diagnostic push
+#pragma clang diagnostic ignored "-Wold-style-cast"
+#pragma clang diagnostic ignored "-Wsign-conversion"
+#elif defined(__GNUC__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wnull-dereference"
+#pragma GCC diagnostic ignored "-Wuseless-cast"
+#pragma GCC diagnostic ignored "-Wold-style-cast"
+#pragma GCC diagnostic ignored "-Wsuggest-final-types"
+#pragma GCC diagnostic ignored "-Wsuggest-attribute=pure"
+#pragma GCC diagnostic ignored "-Wconversion"
+#pragma GCC diagnostic ignored "-Wsign-conversion"
+#endif
+
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QSocketNotifier>
+#include <QTimer>
+
+#if defined(__clang__)
+#pragma clang diagnostic pop
+#elif defined(__GNUC__)
+#pragma GCC diagnostic pop
+#endif
+
+namespace {
+
+using scx::profiles::AppRule;
+
+// Values of proc_event::what, the enum was moved out of the struct in newer kernel headers
+constexpr std::uint32_t kProcEventNone = 0x00000000;
+constexpr std::uint32_t kProcEventExec = 0x00000002;
+constexpr std::uint32_t kProcEventExit = 0x80000000;
+
+// Used only without the proc connector, to find processes started since the last scan
+constexpr std::chrono::seconds kRescanInterval{2};
+
+auto send_mcast_op(int connector_fd, proc_cn_mcast_op mcast_op) noexcept -> bool {
+    alignas(nlmsghdr) std::array<char, NLMSG_SPACE(sizeof(cn_msg) + sizeof(proc_cn_mcast_op))> msg_buf{};
+
+    auto* nl_hdr        = reinterpret_cast<nlmsghdr*>(msg_buf.data());
+    nl_hdr->nlmsg_len   = NLMSG_LENGTH(sizeof(cn_msg) + sizeof(proc_cn_mcast_op));
+    nl_hdr->nlmsg_type  = NLMSG_DONE;
+    auto* connector_msg = reinterpret_cast<cn_msg*>(NLMSG_DATA(nl_hdr));
+    connector_msg->id   = {.idx = CN_IDX_PROC, .val = CN_VAL_PROC};
+    connector_msg->len  = sizeof(proc_cn_mcast_op);
+    std::memcpy(connector_msg->data, &mcast_op, sizeof(mcast_op));
+
+    return ::send(connector_fd, msg_buf.data(), nl_hdr->nlmsg_len, 0) >= 0;
+}
+
+auto parse_pid(std::string_view pid_str) noexcept -> std::optional<pid_t> {
+    pid_t pid{};
+    const auto* str_end = pid_str.data() + pid_str.size();
+    auto [ptr, ec]      = std::from_chars(pid_str.data(), str_end, pid);
+    if (ec != std::errc{} || ptr != str_end) {
+        return std::nullopt;
+    }
+    return pid;
+}
+
+auto parse_rule(const QJsonObject& rule_obj, std::string& error_message) -> std::optional<AppRule> {
+    AppRule rule{
+        .name      = rule_obj.value("name").toString().toStdString(),
+        .exes      = {},
+        .cgroup    = rule_obj.value("cgroup").toString().toStdString(),
+        .scx_sched = rule_obj.value("scheduler").toString().toStdString(),
+        .mode      = scx::SchedMode::Auto,
+    };
+    if (rule.scx_sched.empty()) {
+        error_message = fmt::format("rule '{}' has no scheduler", rule.name);
+        return std::nullopt;
+    }
+
+    const auto mode_name = rule_obj.value("mode").toString("auto").toStdString();
+    const auto sched_mode = scx::sched_mode_from_name(mode_name);
+    if (!sched_mode) {
+        error_message = fmt::format("rule '{}' has unknown mode '{}'", rule.name, mode_name);
+        return std::nullopt;
+    }
+    rule.mode = *sched_mode;
+
+    for (auto&& exe_value : rule_obj.value("exe").toArray()) {
+        rule.exes.emplace_back(exe_value.toString().toStdString());
+    }
+    if (rule.exes.empty() && rule.cgroup.empty()) {
+        error_message = fmt::format("rule '{}' needs either 'exe' or 'cgroup'", rule.name);
+        return std::nullopt;
+    }
+    if (rule.name.empty()) {
+        rule.name = rule.exes.empty() ? rule.cgroup : rule.exes.front();
+    }
+    return rule;
+}
+
+}  // namespace
+
+namespace scx::profiles {
+
+auto parse_app_rules(const QByteArray& json, std::string& error_message) -> std::optional<std::vector<AppRule>> {
+    QJsonParseError parse_error{};
+    const auto json_doc = QJsonDocument::fromJson(json, &parse_error);
+    if (parse_error.error != QJsonParseError::NoError || !json_doc.isObject()) {
+        error_message = fmt::format("not a JSON object: {}", parse_error.errorString().toStdString());
+        return std::nullopt;
+    }
+
+    std::vector<AppRule> rules{};
+    for (auto&& rule_value : json_doc.object().value("rules").toArray()) {
+        auto rule = parse_rule(rule_value.toObject(), error_message);
+        if (!rule) {
+            return std::nullopt;
+        }
+        rules.emplace_back(std::move(*rule));
+    }
+    return rules;
+}
+
+auto match_rule(std::span<const AppRule> rules, std::string_view exe_path, std::string_view cgroup) noexcept -> std::optional<std::size_t> {
+    // the binary was replaced while running, e.g by an update
+    constexpr std::string_view kDeletedSuffix{" (deleted)"};
+    if (exe_path.ends_with(kDeletedSuffix)) {
+        exe_path.remove_suffix(kDeletedSuffix.size());
+    }
+    const auto exe_name = exe_path.substr(exe_path.rfind('/') + 1);
+
+    for (std::size_t rule_idx = 0; rule_idx < rules.size(); ++rule_idx) {
+        const auto& rule       = rules[rule_idx];
+        const bool exe_matched = !exe_path.empty() && std::ranges::any_of(rule.exes, [&](const std::string& exe) {
+            return exe.starts_with('/') ? exe == exe_path : exe == exe_name;
+        });
+        if (exe_matched || (!rule.cgroup.empty() && cgroup.find(rule.cgroup) != std::string_view::npos)) {
+            return rule_idx;
+        }
+    }
+    return std::nullopt;
+}
+
+void MatchedProcesses::on_exec(pid_t pid, std::optional<std::size_t> rule_idx) noexcept {
+    on_exit(pid);
+    if (rule_idx) {
+        m_pids.emplace(pid, *rule_idx);
+        ++m_rule_counts[*rule_idx];
+    }
+}
+
+void MatchedProcesses::on_exit(pid_t pid) noexcept {
+    if (auto pid_it = m_pids.find(pid); pid_it != m_pids.end()) {
+        --m_rule_counts[pid_it->second];
+        m_pids.erase(pid_it);
+    }
+}
+
+void MatchedProcesses::reset(const std::unordered_map<pid_t, std::size_t>& pids) noexcept {
+    m_pids = pids;
+    std::ranges::fill(m_rule_counts, 0);
+    for (auto&& [pid, rule_idx] : m_pids) {
+        ++m_rule_counts[rule_idx];
+    }
+}
+
+auto MatchedProcesses::active_rule() const noexcept -> std::optional<std::size_t> {
+    const auto count_it = std::ranges::find_if(m_rule_counts, [](std::size_t count) { return count > 0; });
+    if (count_it == m_rule_counts.end()) {
+        return std::nullopt;
+    }
+    return static_cast<std::size_t>(count_it - m_rule_counts.begin());
+}
+
+AppProfileWatcher::AppProfileWatcher(std::vector<AppRule> rules, QObject* parent)
+  : QObject(parent), m_rules(std::move(rules)), m_processes(m_rules.size()) {
+    m_needs_cgroup = std::ranges::any_of(m_rules, [](auto&& rule) { return !rule.cgroup.empty(); });
+
+    if (!open_proc_connector()) {
+        start_fallback();
+    }
+    // processes started before us
+    rescan();
+}
+
+AppProfileWatcher::~AppProfileWatcher() {
+    if (m_connector_fd >= 0) {
+        send_mcast_op(m_connector_fd, PROC_CN_MCAST_IGNORE);
+        ::close(m_connector_fd);
+    }
+    for (auto&& [pid, exit_notifier] : m_exit_notifiers) {
+        ::close(static_cast<int>(exit_notifier->socket()));
+    }
+}
+
+auto AppProfileWatcher::open_proc_connector() noexcept -> bool {
+    const int connector_fd = ::socket(AF_NETLINK, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, NETLINK_CONNECTOR);
+    if (connector_fd < 0) {
+        return false;
+    }
+    sockaddr_nl addr{};
+    addr.nl_family = AF_NETLINK;
+    addr.nl_groups = CN_IDX_PROC;
+    if (::bind(connector_fd, reinterpret_cast<const sockaddr*>(&addr), sizeof(addr)) < 0 || !send_mcast_op(connector_fd, PROC_CN_MCAST_LISTEN)) {
+        ::close(connector_fd);
+        return false;
+    }
+
+    m_connector_fd       = connector_fd;
+    m_connector_notifier = new QSocketNotifier(m_connector_fd, QSocketNotifier::Read, this);
+    connect(m_connector_notifier, &QSocketNotifier::activated, this, &AppProfileWatcher::on_proc_events);
+    return true;
+}
+
+void AppProfileWatcher::start_fallback() noexcept {
+    if (m_connector_fd >= 0) {
+        // may be called from the notifier's own signal
+        m_connector_notifier->setEnabled(false);
+        m_connector_notifier->deleteLater();
+        m_connector_notifier = nullptr;
+        ::close(m_connector_fd);
+        m_connector_fd = -1;
+    }
+
+    m_rescan_timer = new QTimer(this);
+    m_rescan_timer->setInterval(kRescanInterval);
+    connect(m_rescan_timer, &QTimer::timeout, this, &AppProfileWatcher::rescan);
+    m_rescan_timer->start();
+}
+
+void AppProfileWatcher::on_proc_events() noexcept {
+    bool is_overflowed{};
+    alignas(nlmsghdr) std::array<char, 8192> events_buf{};
+    while (true) {
+        const auto recv_len = ::recv(m_connector_fd, events_buf.data(), events_buf.size(), 0);
+        if (recv_len < 0 && errno == ENOBUFS) {
+            // events were dropped, processes are found again by a scan
+            is_overflowed = true;
+            continue;
+        }
+        if (recv_len <= 0) {
+            break;
+        }
+
+        auto msg_len = static_cast<std::uint32_t>(recv_len);
+        for (auto* nl_hdr = reinterpret_cast<nlmsghdr*>(events_buf.data()); NLMSG_OK(nl_hdr, msg_len); nl_hdr = NLMSG_NEXT(nl_hdr, msg_len)) {
+            if (nl_hdr->nlmsg_type == NLMSG_NOOP || nl_hdr->nlmsg_type == NLMSG_ERROR) {
+                continue;
+            }
+            const auto* connector_msg = reinterpret_cast<const cn_msg*>(NLMSG_DATA(nl_hdr));
+            if (connector_msg->id.idx != CN_IDX_PROC || connector_msg->id.val != CN_VAL_PROC) {
+                continue;
+            }
+            const auto* event = reinterpret_cast<const proc_event*>(connector_msg->data);
+            switch (static_cast<std::uint32_t>(event->what)) {
+            case kProcEventExec: {
+                const auto pid = event->event_data.exec.process_tgid;
+                m_processes.on_exec(pid, classify(pid));
+                break;
+            }
+            case kProcEventExit:
+                // exits of the other threads don't end the process
+                if (event->event_data.exit.process_pid == event->event_data.exit.process_tgid) {
+                    m_processes.on_exit(event->event_data.exit.process_tgid);
+                }
+                break;
+            case kProcEventNone:
+                if (event->event_data.ack.err != 0) {
+                    fmt::print(stderr, "Proc connector is not permitted ({}), scanning processes instead\n", std::strerror(static_cast<int>(event->event_data.ack.err)));
+                    start_fallback();
+                    rescan();
+                    return;
+                }
+                break;
+            default:
+                break;
+            }
+        }
+    }
+
+    if (is_overflowed) {
+        rescan();
+    } else {
+        update_active_rule();
+    }
+}
+
+void AppProfileWatcher::rescan() noexcept {
+    std::unordered_map<pid_t, std::size_t> matched_pids{};
+    std::error_code err_code{};
+    for (const auto& entry : std::filesystem::directory_iterator("/proc", err_code)) {
+        const auto pid = parse_pid(entry.path().filename().native());
+        if (!pid) {
+            continue;
+        }
+        if (auto rule_idx = classify(*pid); rule_idx) {
+            matched_pids.emplace(*pid, *rule_idx);
+        }
+    }
+    m_processes.reset(matched_pids);
+
+    if (m_connector_fd < 0) {
+        // exits are reported right away, the scan only finds new processes
+        std::erase_if(m_exit_notifiers, [&](auto&& pid_notifier) {
+            if (m_processes.contains(pid_notifier.first)) {
+                return false;
+            }
+            ::close(static_cast<int>(pid_notifier.second->socket()));
+            delete pid_notifier.second;
+            return true;
+        });
+        for (auto&& [pid, rule_idx] : matched_pids) {
+            watch_exit(pid);
+        }
+    }
+    update_active_rule();
+}
+
+auto AppProfileWatcher::classify(pid_t pid) const noexcept -> std::optional<std::size_t> {
+    std::array<char, 64> proc_path{};
+    *fmt::format_to_n(proc_path.data(), proc_path.size() - 1, "/proc/{}/exe", pid).out = '\0';
+    std::array<char, 4096> exe_buf{};
+    const auto exe_len = ::readlink(proc_path.data(), exe_buf.data(), exe_buf.size());
+    const std::string_view exe_path{exe_buf.data(), exe_len > 0 ? static_cast<std::size_t>(exe_len) : 0};
+
+    std::string_view cgroup{};
+    std::array<char, 512> cgroup_buf{};
+    if (m_needs_cgroup) {
+        // "0::/user.slice/user-1000.slice/..." on the unified hierarchy
+        *fmt::format_to_n(proc_path.data(), proc_path.size() - 1, "/proc/{}/cgroup", pid).out = '\0';
+        cgroup = SysfsFile{proc_path.data()}.read(cgroup_buf);
+        if (const auto unified_pos = cgroup.find("0::"); unified_pos != std::string_view::npos) {
+            cgroup.remove_prefix(unified_pos + 3);
+        }
+    }
+    return match_rule(m_rules, exe_path, cgroup);
+}
+
+void AppProfileWatcher::watch_exit(pid_t pid) noexcept {
+    if (m_exit_notifiers.contains(pid)) {
+        return;
+    }
+    const auto pid_fd = static_cast<int>(::syscall(SYS_pidfd_open, pid, 0));
+    if (pid_fd < 0) {
+        // already gone, or pidfd isn't supported and the exit is found by the next scan
+        return;
+    }
+    auto* exit_notifier = new QSocketNotifier(pid_fd, QSocketNotifier::Read, this);
+    connect(exit_notifier, &QSocketNotifier::activated, this, [this, pid] { on_process_exited(pid); });
+    m_exit_notifiers.emplace(pid, exit_notifier);
+}
+
+void AppProfileWatcher::on_process_exited(pid_t pid) noexcept {
+    if (auto notifier_it = m_exit_notifiers.find(pid); notifier_it != m_exit_notifiers.end()) {
+        notifier_it->second->setEnabled(false);
+        ::close(static_cast<int>(notifier_it->second->socket()));
+        notifier_it->second->deleteLater();
+        m_exit_notifiers.erase(notifier_it);
+    }
+    m_processes.on_exit(pid);
+    update_active_rule();
+}
+
+void AppProfileWatcher::update_active_rule() noexcept {
+    const auto active_rule = m_processes.active_rule();
+    if (active_rule == m_active_rule) {
+        return;
+    }
+    m_active_rule = active_rule;
+    emit active_rule_changed(active_rule ? static_cast<int>(*active_rule) : -1);
+}
+
+}  // namespace scx::profiles
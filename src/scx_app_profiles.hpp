@@ -0,0 +1,147 @@
+// Copyright (C) 2024-2025 Vladislav Nepogodin
+//
+// This file is part of CachyOS kernel manager.
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+#ifndef SCX_APP_PROFILES_HPP
+#define SCX_APP_PROFILES_HPP
+
+#include "scx_utils.hpp"
+
+#include <cstddef>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include <sys/types.h>  // for pid_t
+
+#if defined(__clang__)
+#pragma clang diagnostic push
+#pragma clang diagnostic ignored "-Wsign-conversion"
+#pragma clang diagnostic ignored "-Wshorten-64-to-32"
+#elif defined(__GNUC__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wuseless-cast"
+#pragma GCC diagnostic ignored "-Wsign-conversion"
+#pragma GCC diagnostic ignored "-Wconversion"
+#pragma GCC diagnostic ignored "-Wsuggest-final-methods"
+#pragma GCC diagnostic ignored "-Wsuggest-attribute=pure"
+#endif
+
+#include <QObject>
+
+#if defined(__clang__)
+#pragma clang diagnostic pop
+#elif defined(__GNUC__)
+#pragma GCC diagnostic pop
+#endif
+
+class QByteArray;
+class QSocketNotifier;
+class QTimer;
+
+namespace scx::profiles {
+
+/// @brief Scheduler and mode to run while any of the matching processes is alive.
+struct AppRule {
+    std::string name;
+    /// Executable names, or absolute paths if starting with '/'
+    std::vector<std::string> exes;
+    /// Part of the cgroup v2 path, e.g "app-steam" matches everything launched by Steam
+    std::string cgroup;
+    std::string scx_sched;
+    SchedMode mode{SchedMode::Auto};
+};
+
+/// @brief Parses the rules in JSON.
+///
+/// Returns nullopt and the reason in error_message if the rules are invalid.
+auto parse_app_rules(const QByteArray& json, std::string& error_message) -> std::optional<std::vector<AppRule>>;
+
+/// @brief Returns the first rule matching the process executable or cgroup.
+///
+/// Cgroup is read only if some rule needs it, so it is passed lazily.
+auto match_rule(std::span<const AppRule> rules, std::string_view exe_path, std::string_view cgroup) noexcept -> std::optional<std::size_t>;
+
+/// @brief Processes matched by the rules.
+///
+/// The active rule is the first one, which has a live process.
+class MatchedProcesses final {
+ public:
+    explicit MatchedProcesses(std::size_t rule_count) : m_rule_counts(rule_count) { }
+
+    /// @brief Process has started a new executable, which matched the rule or nothing.
+    void on_exec(pid_t pid, std::optional<std::size_t> rule_idx) noexcept;
+    void on_exit(pid_t pid) noexcept;
+    /// @brief Replaces all processes with the ones found by a full scan.
+    void reset(const std::unordered_map<pid_t, std::size_t>& pids) noexcept;
+
+    [[nodiscard]] auto contains(pid_t pid) const noexcept -> bool { return m_pids.contains(pid); }
+    [[nodiscard]] auto active_rule() const noexcept -> std::optional<std::size_t>;
+
+ private:
+    std::unordered_map<pid_t, std::size_t> m_pids;
+    std::vector<std::size_t> m_rule_counts;
+};
+
+/// @brief Tracks processes matching the rules, and reports the active rule.
+///
+/// Exec and exit events come from the netlink proc connector, so the cost
+/// doesn't depend on the number of processes running. The connector requires
+/// CAP_NET_ADMIN, without it the processes are found by a periodic scan and
+/// their exit is watched with pidfds.
+class AppProfileWatcher final : public QObject {
+    Q_OBJECT
+    Q_DISABLE_COPY_MOVE(AppProfileWatcher)
+ public:
+    explicit AppProfileWatcher(std::vector<AppRule> rules, QObject* parent = nullptr);
+    ~AppProfileWatcher() override;
+
+    [[nodiscard]] auto rules() const noexcept -> const std::vector<AppRule>& { return m_rules; }
+    [[nodiscard]] auto active_rule() const noexcept -> std::optional<std::size_t> { return m_active_rule; }
+
+ signals:
+    /// @brief Emitted when the active rule changes, rule_idx is -1 if none is active.
+    void active_rule_changed(int rule_idx);
+
+ private:
+    auto open_proc_connector() noexcept -> bool;
+    void start_fallback() noexcept;
+    void on_proc_events() noexcept;
+    void rescan() noexcept;
+    auto classify(pid_t pid) const noexcept -> std::optional<std::size_t>;
+    void watch_exit(pid_t pid) noexcept;
+    void on_process_exited(pid_t pid) noexcept;
+    void update_active_rule() noexcept;
+
+    std::vector<AppRule> m_rules;
+    bool m_needs_cgroup{};
+    MatchedProcesses m_processes;
+    std::optional<std::size_t> m_active_rule{};
+
+    int m_connector_fd{-1};
+    QSocketNotifier* m_connector_notifier{};
+    QTimer* m_rescan_timer{};
+    /// Exit watches of the fallback, pidfd notifiers by pid
+    std::unordered_map<pid_t, QSocketNotifier*> m_exit_notifiers;
+};
+
+}  // namespace scx::profiles
+
+#endif  // SCX_APP_PROFILES_HPP
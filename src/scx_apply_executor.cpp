@@ -0,0 +1,298 @@
+// Copyright (C) 2024-2025 Vladislav Nepogodin
+//
+// This file is part of CachyOS kernel manager.
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+#include "scx_apply_executor.hpp"
+
+#include <array>    // for array
+#include <span>     // for span
+#include <utility>  // for pair
+
+#if defined(__clang__)
+#pragma clang diagnostic push
+#pragma clang diagnostic ignored "-Wold-style-cast"
+#pragma clang diagnostic ignored "-Wsign-conversion"
+#elif defined(__GNUC__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wnull-dereference"
+#pragma GCC diagnostic ignored "-Wuseless-cast"
+#pragma GCC diagnostic ignored "-Wold-style-cast"
+#pragma GCC diagnostic ignored "-Wsuggest-final-types"
+#pragma GCC diagnostic ignored "-Wsuggest-attribute=pure"
+#pragma GCC diagnostic ignored "-Wconversion"
+#pragma GCC diagnostic ignored "-Wsign-conversion"
+#endif
+
+#include <QPromise>
+#include <QtConcurrent/QtConcurrentRun>
+
+#if defined(__clang__)
+#pragma clang diagnostic pop
+#elif defined(__GNUC__)
+#pragma GCC diagnostic pop
+#endif
+
+namespace {
+
+using scx::loader::ApplyRequest;
+using scx::loader::ApplyStage;
+
+using namespace std::chrono_literals;  // NOLINT
+
+/// The new scheduler attaches after scx_loader has started it, which may outlast the D-Bus call
+constexpr auto kAttachTimeout = 5s;
+
+constexpr std::array kApplyStages{ApplyStage::StopScxService, ApplyStage::SwitchScheduler, ApplyStage::EnableLoaderService, ApplyStage::WriteConfig};
+constexpr std::array kSwitchStages{ApplyStage::SwitchScheduler};
+constexpr std::array kDisableStages{ApplyStage::StopScheduler, ApplyStage::WriteConfig};
+constexpr std::array kPersistStages{ApplyStage::StopScxService, ApplyStage::EnableLoaderService, ApplyStage::WriteConfig};
+
+/// All stages of the request, run when it cannot be planned
+constexpr auto get_request_stages(const ApplyRequest& request) noexcept -> std::span<const ApplyStage> {
+    if (request.kind == ApplyRequest::Kind::Persist) {
+        return kPersistStages;
+    }
+    if (request.kind == ApplyRequest::Kind::Disable) {
+        // writing the config is the last stage
+        const std::span<const ApplyStage> stages{kDisableStages};
+        return request.persist ? stages : stages.first(stages.size() - 1);
+    }
+    // the units decide what runs on boot, same as the config
+    return request.persist ? std::span<const ApplyStage>{kApplyStages} : std::span<const ApplyStage>{kSwitchStages};
+}
+
+}  // namespace
+
+namespace scx::loader {
+
+auto apply_stage_name(ApplyStage stage) noexcept -> std::string_view {
+    switch (stage) {
+    case ApplyStage::StopScxService:
+        return "stop-scx-service";
+    case ApplyStage::SwitchScheduler:
+        return "switch-scheduler";
+    case ApplyStage::EnableLoaderService:
+        return "enable-loader-service";
+    case ApplyStage::StopScheduler:
+        return "stop-scheduler";
+    case ApplyStage::WriteConfig:
+        return "write-config";
+    }
+    return "unknown";
+}
+
+auto plan_request(Config& config, const ApplyRequest& request, std::string_view config_path) noexcept -> std::optional<ChangePlan> {
+    switch (request.kind) {
+    case ApplyRequest::Kind::Apply:
+        return config.plan_scheduler_change(request.scx_sched, request.sched_mode, request.extra_args, request.persist, config_path);
+    case ApplyRequest::Kind::Disable:
+        return config.plan_disable(request.persist, config_path);
+    case ApplyRequest::Kind::Persist: {
+        auto plan = config.plan_scheduler_change(request.scx_sched, request.sched_mode, request.extra_args, true, config_path);
+        if (plan) {
+            // only the boot is set up, whatever runs now
+            plan->switch_scheduler = false;
+        }
+        return plan;
+    }
+    }
+    return std::nullopt;
+}
+
+auto plan_stages(const ChangePlan& plan) noexcept -> std::vector<ApplyStage> {
+    const std::array planned_stages{
+        std::pair{plan.stop_scx_service, ApplyStage::StopScxService},
+        std::pair{plan.switch_scheduler, ApplyStage::SwitchScheduler},
+        std::pair{plan.enable_loader_service, ApplyStage::EnableLoaderService},
+        std::pair{plan.stop_scheduler, ApplyStage::StopScheduler},
+        std::pair{plan.write_config, ApplyStage::WriteConfig},
+    };
+    std::vector<ApplyStage> stages;
+    for (auto&& [is_planned, stage] : planned_stages) {
+        if (is_planned) {
+            stages.emplace_back(stage);
+        }
+    }
+    return stages;
+}
+
+ApplyExecutor::ApplyExecutor(Config& config, std::string_view config_path, QObject* parent)
+  : QObject(parent), m_config(config), m_config_path(config_path) {
+    // requests must never run concurrently
+    m_pool.setMaxThreadCount(1);
+
+    connect(&m_watcher, &QFutureWatcher<bool>::progressValueChanged, this, [this](int stage_idx) {
+        if (!m_running) {
+            return;
+        }
+        // written by the worker before it reports the first stage
+        const auto& stages = m_trace->stages;
+        if (stage_idx >= 0 && static_cast<std::size_t>(stage_idx) < stages.size()) {
+            emit stage_changed(stages[static_cast<std::size_t>(stage_idx)], stage_idx, static_cast<int>(stages.size()));
+        }
+    });
+    connect(&m_watcher, &QFutureWatcher<bool>::finished, this, &ApplyExecutor::on_finished);
+}
+
+ApplyExecutor::~ApplyExecutor() {
+    m_pending.reset();
+    m_watcher.disconnect();
+    m_watcher.waitForFinished();
+}
+
+void ApplyExecutor::submit(ApplyRequest request) noexcept {
+    if (!m_running) {
+        start(std::move(request));
+        return;
+    }
+    if (request == *m_running) {
+        // same request is already in flight
+        m_pending.reset();
+        return;
+    }
+    m_pending = std::move(request);
+}
+
+auto ApplyExecutor::cancel() noexcept -> bool {
+    m_pending.reset();
+    if (!m_running) {
+        return true;
+    }
+    auto expected = RunState::Running;
+    if (m_run_state->compare_exchange_strong(expected, RunState::CancelRequested)) {
+        return true;
+    }
+    return expected == RunState::CancelRequested || expected == RunState::Canceled;
+}
+
+void ApplyExecutor::start(ApplyRequest request) noexcept {
+    m_running    = std::move(request);
+    m_run_state  = std::make_shared<std::atomic<RunState>>(RunState::Running);
+    m_trace      = std::make_shared<ApplyTrace>();
+    m_started_at = std::chrono::steady_clock::now();
+
+    auto future = QtConcurrent::run(&m_pool, [&config = m_config, config_path = m_config_path, request = *m_running, run_state = m_run_state,
+                                                 trace = m_trace, started_at = m_started_at](QPromise<bool>& promise) {
+        if (auto plan = plan_request(config, request, config_path); plan) {
+            trace->stages = plan_stages(*plan);
+        } else {
+            const auto request_stages = get_request_stages(request);
+            trace->stages.assign(request_stages.begin(), request_stages.end());
+        }
+        const auto& stages = trace->stages;
+        promise.setProgressRange(0, static_cast<int>(stages.size()));
+        trace->spans.reserve(stages.size());
+
+        SchedExtTransitionMonitor transition_monitor;
+        bool is_settle_expected{};
+        bool succeeded{true};
+        for (std::size_t stage_idx = 0; stage_idx < stages.size(); ++stage_idx) {
+            const auto stage = stages[stage_idx];
+            if (stage == ApplyStage::WriteConfig) {
+                // past this point the request cannot be canceled
+                auto expected = RunState::Running;
+                if (!run_state->compare_exchange_strong(expected, RunState::Privileged)) {
+                    run_state->store(RunState::Canceled);
+                    succeeded = false;
+                    break;
+                }
+            } else if (run_state->load() == RunState::CancelRequested) {
+                run_state->store(RunState::Canceled);
+                succeeded = false;
+                break;
+            }
+            promise.setProgressValue(static_cast<int>(stage_idx));
+
+            const auto stage_started_at = std::chrono::steady_clock::now();
+            switch (stage) {
+            case ApplyStage::StopScxService:
+                config.stop_scx_service();
+                break;
+            case ApplyStage::SwitchScheduler:
+                transition_monitor.start(started_at, true);
+                // the change is still persisted, even if the loader failed to switch
+                is_settle_expected = config.switch_scheduler(request.scx_sched, request.sched_mode, request.extra_args);
+                break;
+            case ApplyStage::EnableLoaderService:
+                config.enable_loader_service();
+                break;
+            case ApplyStage::StopScheduler:
+                transition_monitor.start(started_at, false);
+                succeeded          = config.stop_scheduler();
+                is_settle_expected = succeeded;
+                break;
+            case ApplyStage::WriteConfig:
+                if (request.kind == ApplyRequest::Kind::Disable) {
+                    succeeded = config.write_disabled_config(config_path);
+                } else {
+                    succeeded = config.write_scheduler_config(request.scx_sched, request.sched_mode, request.extra_args, config_path);
+                }
+                break;
+            }
+            const auto stage_finished_at = std::chrono::steady_clock::now();
+            trace->spans.emplace_back(StageSpan{.stage = stage, .start = stage_started_at - started_at, .duration = stage_finished_at - stage_started_at});
+            if (!succeeded) {
+                break;
+            }
+        }
+        if (const auto state = run_state->load(); state == RunState::Running || state == RunState::CancelRequested) {
+            // cancel after the last stage has no effect, the change went through
+            run_state->store(RunState::Completed);
+        }
+        if (transition_monitor.is_running()) {
+            // nothing changes if the loader refused the request
+            trace->transition = transition_monitor.finish(is_settle_expected ? std::chrono::nanoseconds{kAttachTimeout} : 0ns);
+        }
+        promise.addResult(succeeded);
+    });
+    m_watcher.setFuture(future);
+}
+
+auto ApplyExecutor::preview(ApplyRequest request) noexcept -> QFuture<std::optional<ChangePlan>> {
+    return QtConcurrent::run(&m_pool, [&config = m_config, config_path = m_config_path, request = std::move(request)] {
+        return plan_request(config, request, config_path);
+    });
+}
+
+auto ApplyExecutor::loader_snapshot() noexcept -> QFuture<std::optional<LoaderSnapshot>> {
+    return QtConcurrent::run(&m_pool, [&config = m_config] { return config.get_loader_snapshot(); });
+}
+
+void ApplyExecutor::on_finished() noexcept {
+    if (!m_running) {
+        return;
+    }
+    const auto request   = std::move(*m_running);
+    const bool canceled  = m_run_state->load() == RunState::Canceled;
+    const bool succeeded = !canceled && m_watcher.future().resultCount() > 0 && m_watcher.result();
+    const auto elapsed   = std::chrono::steady_clock::now() - m_started_at;
+    const auto trace     = std::move(m_trace);
+    m_running.reset();
+
+    emit traced(request, *trace);
+    emit finished(request, succeeded, canceled, std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed));
+
+    if (m_pending) {
+        auto pending = std::move(*m_pending);
+        m_pending.reset();
+        if (pending != request) {
+            start(std::move(pending));
+        }
+    }
+}
+
+}  // namespace scx::loader
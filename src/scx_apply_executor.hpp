@@ -0,0 +1,194 @@
+// Copyright (C) 2024-2025 Vladislav Nepogodin
+//
+// This file is part of CachyOS kernel manager.
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+#ifndef SCX_APPLY_EXECUTOR_HPP
+#define SCX_APPLY_EXECUTOR_HPP
+
+#include "scx_switch_trace.hpp"
+#include "scx_utils.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#if defined(__clang__)
+#pragma clang diagnostic push
+#pragma clang diagnostic ignored "-Wsign-conversion"
+#pragma clang diagnostic ignored "-Wshorten-64-to-32"
+#elif defined(__GNUC__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wuseless-cast"
+#pragma GCC diagnostic ignored "-Wsign-conversion"
+#pragma GCC diagnostic ignored "-Wconversion"
+#pragma GCC diagnostic ignored "-Wsuggest-final-methods"
+#pragma GCC diagnostic ignored "-Wsuggest-attribute=pure"
+#endif
+
+#include <QFuture>
+#include <QFutureWatcher>
+#include <QObject>
+#include <QString>
+#include <QThreadPool>
+
+#if defined(__clang__)
+#pragma clang diagnostic pop
+#elif defined(__GNUC__)
+#pragma GCC diagnostic pop
+#endif
+
+namespace scx::loader {
+
+/// @brief Stages of the scheduler change, reported as progress.
+enum class ApplyStage : std::uint8_t {
+    StopScxService,
+    SwitchScheduler,
+    EnableLoaderService,
+    StopScheduler,
+    /// Privileged step, the request cannot be canceled anymore.
+    WriteConfig,
+};
+
+/// @brief Returns short name of the stage, e.g "switch-scheduler".
+auto apply_stage_name(ApplyStage stage) noexcept -> std::string_view;
+
+/// @brief Scheduler change requested by the user.
+struct ApplyRequest {
+    enum class Kind : std::uint8_t {
+        Apply,
+        Disable,
+        /// Only sets up the units and the config to start the scheduler on boot, e.g the one running on trial.
+        Persist,
+    };
+
+    Kind kind{Kind::Apply};
+    std::string scx_sched{};
+    SchedMode sched_mode{SchedMode::Auto};
+    QStringList extra_args{};
+    /// Without it only the running scheduler is changed, the units and the config are left as they are.
+    bool persist{true};
+
+    auto operator==(const ApplyRequest&) const -> bool = default;
+};
+
+/// @brief Time spent in a stage, relative to the start of the request.
+struct StageSpan {
+    ApplyStage stage{};
+    std::chrono::nanoseconds start{};
+    std::chrono::nanoseconds duration{};
+};
+
+/// @brief Timeline of the request: its stages, and the switch as seen in sysfs.
+///
+/// Stages map one-to-one to the calls into scx-rustlib, so the spans cover the
+/// service checks, the D-Bus switch and the config write.
+struct ApplyTrace {
+    /// Stages planned for the request, the ones which would change nothing are skipped
+    std::vector<ApplyStage> stages{};
+    std::vector<StageSpan> spans{};
+    SchedExtTransition transition{};
+};
+
+/// @brief Plans the request against the current state, see Config::plan_scheduler_change.
+///
+/// Blocks on D-Bus, must not be called from the GUI thread.
+auto plan_request(Config& config, const ApplyRequest& request, std::string_view config_path) noexcept -> std::optional<ChangePlan>;
+
+/// @brief Returns the stages of the plan, in the order they run.
+auto plan_stages(const ChangePlan& plan) noexcept -> std::vector<ApplyStage>;
+
+/// @brief Runs scheduler changes on a worker thread, one at a time.
+///
+/// Progress of each stage is streamed back on the thread owning the executor.
+/// Requests submitted while one is in flight are coalesced: a duplicate of the
+/// running request is dropped, otherwise only the latest one is kept and started
+/// once the running request finishes. Each request is planned first, and only
+/// the stages which change something are run.
+class ApplyExecutor final : public QObject {
+    Q_OBJECT
+    Q_DISABLE_COPY_MOVE(ApplyExecutor)
+ public:
+    /// @brief Config must outlive the executor.
+    ApplyExecutor(Config& config, std::string_view config_path, QObject* parent = nullptr);
+    /// @brief Waits for the in-flight request to finish.
+    ~ApplyExecutor() override;
+
+    /// @brief Starts the request, or queues it if another one is in flight.
+    void submit(ApplyRequest request) noexcept;
+
+    /// @brief Cancels the in-flight request and drops the queued one.
+    ///
+    /// Returns false if the request has already reached the privileged step or
+    /// ran all its stages, in which case it will complete normally.
+    auto cancel() noexcept -> bool;
+
+    /// @brief Whether a request is in flight.
+    [[nodiscard]] auto is_running() const noexcept -> bool { return m_running.has_value(); }
+
+    /// @brief Plans the request without running it, as a dry run.
+    ///
+    /// Runs after the request in flight, so that the plan reflects its result.
+    auto preview(ApplyRequest request) noexcept -> QFuture<std::optional<ChangePlan>>;
+
+    /// @brief Reads the state of scx_loader on the worker thread.
+    ///
+    /// Runs after the request in flight, the same as the preview.
+    auto loader_snapshot() noexcept -> QFuture<std::optional<LoaderSnapshot>>;
+
+ signals:
+    /// @brief Emitted when the request enters the next stage.
+    void stage_changed(scx::loader::ApplyStage stage, int stage_idx, int stage_count);
+    /// @brief Emitted right before finished, with the timeline of the request.
+    void traced(const scx::loader::ApplyRequest& request, const scx::loader::ApplyTrace& trace);
+    /// @brief Emitted once the request has finished, failed or was canceled.
+    ///
+    /// Elapsed is the time since the request was started, without the time it was queued.
+    void finished(const scx::loader::ApplyRequest& request, bool succeeded, bool canceled, std::chrono::nanoseconds elapsed);
+
+ private:
+    enum class RunState : std::uint8_t {
+        Running,
+        CancelRequested,
+        /// Worker stopped because of the cancel, before running all stages.
+        Canceled,
+        Privileged,
+        /// All stages ran, a late cancel has no effect.
+        Completed,
+    };
+
+    void start(ApplyRequest request) noexcept;
+    void on_finished() noexcept;
+
+    Config& m_config;
+    std::string m_config_path;
+    QThreadPool m_pool;
+    QFutureWatcher<bool> m_watcher;
+    std::optional<ApplyRequest> m_running{};
+    std::optional<ApplyRequest> m_pending{};
+    std::shared_ptr<std::atomic<RunState>> m_run_state{};
+    std::shared_ptr<ApplyTrace> m_trace{};
+    std::chrono::steady_clock::time_point m_started_at{};
+};
+
+}  // namespace scx::loader
+
+#endif  // SCX_APPLY_EXECUTOR_HPP
@@ -0,0 +1,282 @@
+// Copyright (C) 2024-2025 Vladislav Nepogodin
+//
+// This file is part of CachyOS kernel manager.
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+#include "scx_bench.hpp"
+#include "scx_sysfs.hpp"
+
+#include <array>         // for array
+#include <charconv>      // for from_chars
+#include <string>        // for string
+#include <system_error>  // for errc
+#include <thread>        // for sleep_for
+
+#include <fmt/core.h>
+
+#if defined(__clang__)
+#pragma clang diagnostic push
+#pragma clang diagnostic ignored "-Wold-style-cast"
+#pragma clang diagnostic ignored "-Wsign-conversion"
+#elif defined(__GNUC__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wnull-dereference"
+#pragma GCC diagnostic ignored "-Wuseless-cast"
+#pragma GCC diagnostic ignored "-Wold-style-cast"
+#pragma GCC diagnostic ignored "-Wsuggest-final-types"
+#pragma GCC diagnostic ignored "-Wsuggest-attribute=pure"
+#pragma GCC diagnostic ignored "-Wconversion"
+#pragma GCC diagnostic ignored "-Wsign-conversion"
+#endif
+
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+
+#if defined(__clang__)
+#pragma clang diagnostic pop
+#elif defined(__GNUC__)
+#pragma GCC diagnostic pop
+#endif
+
+namespace {
+
+using namespace std::chrono_literals;  // NOLINT
+
+constexpr auto kSettlePollInterval = 20ms;
+// root/ops has to stay the same for this long, before the scheduler is considered attached
+constexpr auto kSettleStableTime = 200ms;
+
+constexpr auto to_micros(std::chrono::nanoseconds duration) noexcept -> double {
+    return std::chrono::duration<double, std::micro>(duration).count();
+}
+
+/// Empty field, if the value is unavailable
+auto format_optional(const std::optional<double>& value) -> std::string {
+    return value ? fmt::format("{:.6f}", *value) : std::string{};
+}
+
+auto energy_to_json(const std::optional<scx::energy::EnergyCounts>& energy) -> QJsonValue {
+    if (!energy) {
+        return QJsonValue{};
+    }
+    const auto to_json = [](const std::optional<double>& value) { return value ? QJsonValue{*value} : QJsonValue{}; };
+    QJsonObject energy_object;
+    for (std::size_t domain_idx = 0; domain_idx < scx::energy::kEnergyDomainCount; ++domain_idx) {
+        const auto domain = static_cast<scx::energy::EnergyDomain>(domain_idx);
+        if (!energy->valid.test(domain_idx)) {
+            continue;
+        }
+        const auto name = scx::energy::energy_domain_name(domain);
+        energy_object.insert(QString::fromUtf8(name.data(), static_cast<qsizetype>(name.size())),
+            QJsonObject{
+                {"joules", energy->joules[domain_idx]},
+                {"joules_per_min", to_json(energy->joules_per_minute(domain))},
+                {"joules_per_op", to_json(energy->joules_per_op(domain))},
+            });
+    }
+    return energy_object;
+}
+
+auto latency_to_json(const scx::bench::LatencySummary& latency) -> QJsonObject {
+    return QJsonObject{
+        {"count", static_cast<qint64>(latency.count)},
+        {"p50_us", to_micros(latency.p50)},
+        {"p90_us", to_micros(latency.p90)},
+        {"p99_us", to_micros(latency.p99)},
+        {"p999_us", to_micros(latency.p999)},
+        {"max_us", to_micros(latency.max)},
+    };
+}
+
+}  // namespace
+
+namespace scx::bench {
+
+auto read_enable_seq() noexcept -> std::optional<std::uint64_t> {
+    SysfsFile enable_seq_file{sched_ext::kEnableSeqPath};
+    std::array<char, 32> enable_seq_buf{};
+    const auto enable_seq_str = enable_seq_file.read(enable_seq_buf);
+
+    std::uint64_t enable_seq{};
+    const auto* str_end = enable_seq_str.data() + enable_seq_str.size();
+    auto [ptr, ec]      = std::from_chars(enable_seq_str.data(), str_end, enable_seq);
+    if (ec != std::errc{} || ptr != str_end) {
+        return std::nullopt;
+    }
+    return enable_seq;
+}
+
+auto wait_for_scheduler(std::string_view scx_sched, std::optional<std::uint64_t> prev_enable_seq, std::chrono::milliseconds timeout) noexcept -> std::optional<std::chrono::nanoseconds> {
+    // root/ops holds the name of sched_ext_ops, e.g "bpfland_1.0.14_x86_64_linux" for scx_bpfland
+    auto expected_ops = scx_sched;
+    if (expected_ops.starts_with("scx_")) {
+        expected_ops.remove_prefix(4);
+    }
+
+    SysfsFile state_file{sched_ext::kStatePath};
+    SysfsFile ops_file{sched_ext::kRootOpsPath};
+    std::array<char, 64> state_buf{};
+    std::array<char, 256> ops_buf{};
+    std::array<char, 256> stable_ops_buf{};
+    std::string_view stable_ops{};
+    std::optional<std::uint64_t> stable_enable_seq{};
+
+    const auto started_at = std::chrono::steady_clock::now();
+    auto stable_since     = started_at;
+    while (true) {
+        const auto now = std::chrono::steady_clock::now();
+
+        const auto state      = state_file.read(state_buf);
+        const auto ops        = ops_file.read(ops_buf);
+        const auto enable_seq = prev_enable_seq ? read_enable_seq() : std::nullopt;
+        // the old instance of the same scheduler is still attached, until enable_seq is bumped
+        const bool is_reattached = !prev_enable_seq || (enable_seq && enable_seq != prev_enable_seq);
+        if (state != "enabled" || !is_reattached || !ops.starts_with(expected_ops)) {
+            stable_ops = {};
+        } else if (ops != stable_ops || enable_seq != stable_enable_seq) {
+            const auto ops_len = ops.copy(stable_ops_buf.data(), stable_ops_buf.size());
+            stable_ops         = std::string_view{stable_ops_buf.data(), ops_len};
+            stable_enable_seq  = enable_seq;
+            stable_since       = now;
+        } else if (now - stable_since >= kSettleStableTime) {
+            return stable_since - started_at;
+        }
+
+        if (now - started_at >= timeout) {
+            return std::nullopt;
+        }
+        std::this_thread::sleep_for(kSettlePollInterval);
+    }
+}
+
+auto run_benchmark(loader::Config& config, const BenchOptions& options, const PairStartedFn& on_pair_started) noexcept -> std::vector<PairResult> {
+    std::vector<PairResult> results;
+    results.reserve(options.pairs.size());
+
+    const auto original_sched = config.get_current_sched();
+    const auto original_mode  = config.get_current_mode();
+
+    // same as the first stage of apply, scx.service would fight with scx_loader otherwise
+    const auto scx_service_action = config.stop_scx_service();
+
+    energy::EnergyMeter energy_meter{options.powercap_root};
+    const bool measures_energy = energy_meter.open();
+    if (!measures_energy) {
+        fmt::print(stderr, "No RAPL zone can be read under {}, energy is not measured\n", options.powercap_root);
+    }
+
+    for (std::size_t pair_idx = 0; pair_idx < options.pairs.size(); ++pair_idx) {
+        const auto& pair = options.pairs[pair_idx];
+        if (on_pair_started) {
+            on_pair_started(pair, pair_idx, options.pairs.size());
+        }
+
+        auto& result               = results.emplace_back(PairResult{.pair = pair});
+        const auto prev_enable_seq = read_enable_seq();
+        if (!config.switch_mode(pair.scx_sched, pair.sched_mode)) {
+            continue;
+        }
+        const auto settle_time = wait_for_scheduler(pair.scx_sched, prev_enable_seq, options.settle_timeout);
+        if (!settle_time) {
+            fmt::print(stderr, "{} ({}) didn't attach within {}ms, skipping\n", pair.scx_sched, sched_mode_name(pair.sched_mode), options.settle_timeout.count());
+            continue;
+        }
+        result.switched    = true;
+        result.settle_time = *settle_time;
+
+        result.workloads.reserve(options.workloads.size());
+        for (auto workload : options.workloads) {
+            if (measures_energy) {
+                // starts the span of the workload, the settling isn't counted
+                energy_meter.sample();
+            }
+            auto workload_result = run_workload(workload, options.workload_duration);
+            if (!workload_result) {
+                continue;
+            }
+            if (measures_energy && energy_meter.sample()) {
+                workload_result->energy           = energy_meter.last_counts();
+                workload_result->energy->work_ops = workload_result->ops;
+            }
+            result.workloads.emplace_back(*workload_result);
+        }
+    }
+
+    // leave the system as we found it
+    if (original_sched && *original_sched != "unknown") {
+        config.switch_mode(*original_sched, original_mode.value_or(SchedMode::Auto));
+    } else {
+        config.stop_scheduler();
+    }
+    config.restore_scx_service(scx_service_action);
+    return results;
+}
+
+auto results_to_csv(std::span<const PairResult> results) -> std::string {
+    using energy::EnergyDomain;
+
+    std::string csv{"scheduler,mode,workload,ops,elapsed_s,ops_per_sec,p50_us,p90_us,p99_us,p999_us,max_us,"
+                    "package_j,core_j,dram_j,package_j_per_min,package_j_per_op\n"};
+    for (auto&& result : results) {
+        for (auto&& workload : result.workloads) {
+            const auto& latency = workload.latency;
+            const auto& energy  = workload.energy;
+            const auto joules   = [&energy](EnergyDomain domain) -> std::optional<double> {
+                const auto domain_idx = static_cast<std::size_t>(domain);
+                return (energy && energy->valid.test(domain_idx)) ? std::optional{energy->joules[domain_idx]} : std::nullopt;
+            };
+            csv += fmt::format("{},{},{},{},{:.3f},{:.1f},{:.2f},{:.2f},{:.2f},{:.2f},{:.2f},{},{},{},{},{}\n", result.pair.scx_sched,
+                sched_mode_name(result.pair.sched_mode), workload_name(workload.workload), workload.ops,
+                std::chrono::duration<double>(workload.elapsed).count(), workload.ops_per_sec, to_micros(latency.p50),
+                to_micros(latency.p90), to_micros(latency.p99), to_micros(latency.p999), to_micros(latency.max),
+                format_optional(joules(EnergyDomain::Package)), format_optional(joules(EnergyDomain::Core)), format_optional(joules(EnergyDomain::Dram)),
+                format_optional(energy ? energy->joules_per_minute(EnergyDomain::Package) : std::nullopt),
+                format_optional(energy ? energy->joules_per_op(EnergyDomain::Package) : std::nullopt));
+        }
+    }
+    return csv;
+}
+
+auto results_to_json(std::span<const PairResult> results) -> std::string {
+    QJsonArray pairs_array;
+    for (auto&& result : results) {
+        QJsonArray workloads_array;
+        for (auto&& workload : result.workloads) {
+            const auto name = workload_name(workload.workload);
+            workloads_array.append(QJsonObject{
+                {"workload", QString::fromUtf8(name.data(), static_cast<qsizetype>(name.size()))},
+                {"ops", static_cast<qint64>(workload.ops)},
+                {"elapsed_s", std::chrono::duration<double>(workload.elapsed).count()},
+                {"ops_per_sec", workload.ops_per_sec},
+                {"latency", latency_to_json(workload.latency)},
+                {"energy", energy_to_json(workload.energy)},
+            });
+        }
+
+        const auto mode_name = sched_mode_name(result.pair.sched_mode);
+        pairs_array.append(QJsonObject{
+            {"scheduler", QString::fromStdString(result.pair.scx_sched)},
+            {"mode", QString::fromUtf8(mode_name.data(), static_cast<qsizetype>(mode_name.size()))},
+            {"switched", result.switched},
+            {"settle_time_ms", std::chrono::duration<double, std::milli>(result.settle_time).count()},
+            {"workloads", workloads_array},
+        });
+    }
+    return QJsonDocument(pairs_array).toJson().toStdString();
+}
+
+}  // namespace scx::bench
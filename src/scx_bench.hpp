@@ -0,0 +1,89 @@
+// Copyright (C) 2024-2025 Vladislav Nepogodin
+//
+// This file is part of CachyOS kernel manager.
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+#ifndef SCX_BENCH_HPP
+#define SCX_BENCH_HPP
+
+#include "scx_bench_workloads.hpp"
+#include "scx_utils.hpp"
+
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace scx::bench {
+
+/// @brief Scheduler and mode being benchmarked.
+struct BenchPair {
+    std::string scx_sched;
+    SchedMode sched_mode{};
+};
+
+struct PairResult {
+    BenchPair pair;
+    /// Whether the scheduler was switched and attached in time, workloads are empty otherwise
+    bool switched{};
+    /// Time from the switch request until root/ops settled
+    std::chrono::nanoseconds settle_time{};
+    std::vector<WorkloadResult> workloads{};
+};
+
+struct BenchOptions {
+    std::vector<BenchPair> pairs{};
+    std::vector<Workload> workloads{kAllWorkloads.begin(), kAllWorkloads.end()};
+    std::chrono::milliseconds workload_duration{std::chrono::seconds{5}};
+    std::chrono::milliseconds settle_timeout{std::chrono::seconds{10}};
+    /// Where the RAPL zones are looked up, a fixture tree can be given instead
+    std::string powercap_root{energy::kPowercapRoot};
+};
+
+/// @brief Called before each pair is switched to, with index of the pair.
+using PairStartedFn = std::function<void(const BenchPair& pair, std::size_t pair_idx, std::size_t pair_count)>;
+
+/// @brief Waits until sched_ext is enabled with the scheduler, and root/ops stays unchanged.
+///
+/// A mode change reattaches the same scheduler, so the new instance is only accepted once
+/// enable_seq differs from prev_enable_seq, read before the switch. Without enable_seq
+/// the scheduler name alone is matched.
+/// Returns time it took to settle, or nullopt on timeout.
+auto wait_for_scheduler(std::string_view scx_sched, std::optional<std::uint64_t> prev_enable_seq, std::chrono::milliseconds timeout) noexcept -> std::optional<std::chrono::nanoseconds>;
+
+/// @brief Reads sched_ext enable_seq, nullopt if the kernel doesn't have it.
+auto read_enable_seq() noexcept -> std::optional<std::uint64_t>;
+
+/// @brief Switches to each pair in turn and runs the workloads on it.
+///
+/// Pairs are switched at runtime only, without persisting them into the config.
+/// The scheduler which was running before is restored afterwards. Energy of each
+/// workload is measured, where the RAPL zones can be read.
+auto run_benchmark(loader::Config& config, const BenchOptions& options, const PairStartedFn& on_pair_started = {}) noexcept -> std::vector<PairResult>;
+
+/// @brief Formats results as CSV, one row per pair and workload.
+auto results_to_csv(std::span<const PairResult> results) -> std::string;
+
+/// @brief Formats results as JSON array of pairs.
+auto results_to_json(std::span<const PairResult> results) -> std::string;
+
+}  // namespace scx::bench
+
+#endif  // SCX_BENCH_HPP
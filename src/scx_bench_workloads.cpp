@@ -0,0 +1,371 @@
+// Copyright (C) 2024-2025 Vladislav Nepogodin
+//
+// This file is part of CachyOS kernel manager.
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+#include "scx_bench_workloads.hpp"
+
+#include <algorithm>  // for nth_element, max_element
+#include <atomic>     // for atomic
+#include <cerrno>     // for errno
+#include <cstring>    // for memcpy, strerror
+#include <thread>     // for thread
+#include <utility>    // for exchange
+
+#include <fcntl.h>       // for O_CLOEXEC
+#include <sys/socket.h>  // for socketpair, shutdown
+#include <unistd.h>      // for pipe2, read, write, close
+
+#include <fmt/core.h>
+
+namespace {
+
+using namespace std::chrono_literals;  // NOLINT
+using Clock = std::chrono::steady_clock;
+
+// Messaging parameters, similar to 'hackbench -T' with smaller groups
+constexpr std::size_t kMessagingGroups = 4;
+constexpr std::size_t kMessagingFds    = 10;
+constexpr std::size_t kMessageSize     = 100;
+
+// Iterations of a single compute chunk of the cpu workload
+constexpr std::uint64_t kCpuChunkIterations = 200'000;
+
+constexpr std::array kWorkloadNames{
+    std::string_view{"messaging"},
+    std::string_view{"pipe"},
+    std::string_view{"cpu"},
+};
+
+/// Owning file descriptor
+class UniqueFd final {
+ public:
+    UniqueFd() = default;
+    explicit UniqueFd(int fd) noexcept : m_fd(fd) { }
+    ~UniqueFd() noexcept { reset(); }
+
+    UniqueFd(const UniqueFd&)                    = delete;
+    auto operator=(const UniqueFd&) -> UniqueFd& = delete;
+    UniqueFd(UniqueFd&& other) noexcept : m_fd(std::exchange(other.m_fd, -1)) { }
+    auto operator=(UniqueFd&& other) noexcept -> UniqueFd& {
+        reset(std::exchange(other.m_fd, -1));
+        return *this;
+    }
+
+    void reset(int fd = -1) noexcept {
+        if (m_fd >= 0) {
+            ::close(m_fd);
+        }
+        m_fd = fd;
+    }
+    [[nodiscard]] auto get() const noexcept -> int { return m_fd; }
+
+ private:
+    int m_fd{-1};
+};
+
+auto now_ns() noexcept -> std::int64_t {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now().time_since_epoch()).count();
+}
+
+auto write_all(int fd, const void* data, std::size_t size) noexcept -> bool {
+    const auto* bytes = static_cast<const char*>(data);
+    while (size > 0) {
+        const auto written = ::write(fd, bytes, size);
+        if (written < 0 && errno == EINTR) {
+            continue;
+        }
+        if (written <= 0) {
+            return false;
+        }
+        bytes += written;
+        size -= static_cast<std::size_t>(written);
+    }
+    return true;
+}
+
+auto make_result(scx::bench::Workload workload, std::uint64_t ops, Clock::duration elapsed, std::span<const scx::bench::LatencyRecorder> recorders) -> scx::bench::WorkloadResult {
+    const auto elapsed_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed);
+    const auto elapsed_s  = std::chrono::duration<double>(elapsed).count();
+    return scx::bench::WorkloadResult{
+        .workload    = workload,
+        .ops         = ops,
+        .elapsed     = elapsed_ns,
+        .ops_per_sec = elapsed_s > 0. ? static_cast<double>(ops) / elapsed_s : 0.,
+        .latency     = scx::bench::summarize_latencies(recorders),
+    };
+}
+
+// Each receiver has a socket, all senders of the group write every message to every receiver.
+// The message carries its send timestamp, receivers record the delivery latency.
+auto run_messaging(std::chrono::milliseconds duration) -> std::optional<scx::bench::WorkloadResult> {
+    constexpr std::size_t kReceivers = kMessagingGroups * kMessagingFds;
+
+    std::vector<UniqueFd> read_fds(kReceivers);
+    std::vector<UniqueFd> write_fds(kReceivers);
+    for (std::size_t idx = 0; idx < kReceivers; ++idx) {
+        std::array<int, 2> fds{};
+        // seqpacket keeps messages from concurrent senders intact
+        if (::socketpair(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0, fds.data()) != 0) {
+            fmt::print(stderr, "messaging: failed to create socketpair: {}\n", std::strerror(errno));
+            return std::nullopt;
+        }
+        read_fds[idx].reset(fds[0]);
+        write_fds[idx].reset(fds[1]);
+    }
+
+    std::vector<scx::bench::LatencyRecorder> recorders(kReceivers);
+    std::vector<std::uint64_t> received(kReceivers);
+    std::atomic_bool stop{false};
+
+    std::vector<std::thread> receivers;
+    receivers.reserve(kReceivers);
+    for (std::size_t idx = 0; idx < kReceivers; ++idx) {
+        receivers.emplace_back([&, idx] {
+            std::array<char, kMessageSize> message{};
+            while (true) {
+                const auto bytes_read = ::read(read_fds[idx].get(), message.data(), message.size());
+                if (bytes_read < 0 && errno == EINTR) {
+                    continue;
+                }
+                if (bytes_read < static_cast<ssize_t>(sizeof(std::int64_t))) {
+                    break;
+                }
+                std::int64_t sent_ns{};
+                std::memcpy(&sent_ns, message.data(), sizeof(sent_ns));
+                recorders[idx].record(std::chrono::nanoseconds(now_ns() - sent_ns));
+                ++received[idx];
+            }
+        });
+    }
+
+    const auto started = Clock::now();
+    std::vector<std::thread> senders;
+    senders.reserve(kReceivers);
+    for (std::size_t group = 0; group < kMessagingGroups; ++group) {
+        for (std::size_t sender = 0; sender < kMessagingFds; ++sender) {
+            senders.emplace_back([&, group] {
+                std::array<char, kMessageSize> message{};
+                while (!stop.load(std::memory_order_relaxed)) {
+                    for (std::size_t receiver = 0; receiver < kMessagingFds; ++receiver) {
+                        const auto sent_ns = now_ns();
+                        std::memcpy(message.data(), &sent_ns, sizeof(sent_ns));
+                        if (!write_all(write_fds[group * kMessagingFds + receiver].get(), message.data(), message.size())) {
+                            return;
+                        }
+                    }
+                }
+            });
+        }
+    }
+
+    std::this_thread::sleep_for(duration);
+    stop = true;
+    for (auto&& sender : senders) {
+        sender.join();
+    }
+    const auto elapsed = Clock::now() - started;
+
+    // receivers drain what was sent and exit on EOF
+    for (auto&& write_fd : write_fds) {
+        ::shutdown(write_fd.get(), SHUT_WR);
+    }
+    for (auto&& receiver : receivers) {
+        receiver.join();
+    }
+
+    std::uint64_t total_received{};
+    for (auto&& count : received) {
+        total_received += count;
+    }
+    return make_result(scx::bench::Workload::Messaging, total_received, elapsed, recorders);
+}
+
+// Round trip of one byte between two threads, the latency is the whole round trip.
+auto run_pipe_ping_pong(std::chrono::milliseconds duration) -> std::optional<scx::bench::WorkloadResult> {
+    std::array<int, 2> ping_fds{};
+    std::array<int, 2> pong_fds{};
+    if (::pipe2(ping_fds.data(), O_CLOEXEC) != 0) {
+        fmt::print(stderr, "pipe: failed to create pipe: {}\n", std::strerror(errno));
+        return std::nullopt;
+    }
+    UniqueFd ping_read{ping_fds[0]};
+    UniqueFd ping_write{ping_fds[1]};
+    if (::pipe2(pong_fds.data(), O_CLOEXEC) != 0) {
+        fmt::print(stderr, "pipe: failed to create pipe: {}\n", std::strerror(errno));
+        return std::nullopt;
+    }
+    UniqueFd pong_read{pong_fds[0]};
+    UniqueFd pong_write{pong_fds[1]};
+
+    std::thread ponger([&] {
+        char token{};
+        while (::read(ping_read.get(), &token, 1) == 1) {
+            if (::write(pong_write.get(), &token, 1) != 1) {
+                break;
+            }
+        }
+    });
+
+    std::array<scx::bench::LatencyRecorder, 1> recorders{};
+    std::uint64_t round_trips{};
+    const auto started  = Clock::now();
+    const auto deadline = started + duration;
+    char token{'x'};
+    while (true) {
+        const auto sent = Clock::now();
+        if (sent >= deadline) {
+            break;
+        }
+        if (::write(ping_write.get(), &token, 1) != 1 || ::read(pong_read.get(), &token, 1) != 1) {
+            break;
+        }
+        recorders[0].record(Clock::now() - sent);
+        ++round_trips;
+    }
+    const auto elapsed = Clock::now() - started;
+
+    // ponger exits on EOF
+    ping_write.reset();
+    ponger.join();
+    return make_result(scx::bench::Workload::PipePingPong, round_trips, elapsed, recorders);
+}
+
+// Every CPU runs compute chunks of a fixed size, the latency is the wall time of the chunk.
+// Under a fair scheduler it only grows because of preemption and migrations.
+auto run_cpu_throughput(std::chrono::milliseconds duration) -> std::optional<scx::bench::WorkloadResult> {
+    const auto nr_threads = std::max(1U, std::thread::hardware_concurrency());
+
+    std::vector<scx::bench::LatencyRecorder> recorders(nr_threads);
+    std::vector<std::uint64_t> chunks(nr_threads);
+    std::atomic_bool stop{false};
+    std::atomic_uint64_t sink{};
+
+    const auto started = Clock::now();
+    std::vector<std::thread> workers;
+    workers.reserve(nr_threads);
+    for (std::size_t idx = 0; idx < nr_threads; ++idx) {
+        workers.emplace_back([&, idx] {
+            std::uint64_t state = 0x2545F4914F6CDD1DULL + idx;
+            while (!stop.load(std::memory_order_relaxed)) {
+                const auto chunk_started = Clock::now();
+                for (std::uint64_t iter = 0; iter < kCpuChunkIterations; ++iter) {
+                    state ^= state << 13U;
+                    state ^= state >> 7U;
+                    state ^= state << 17U;
+                }
+                recorders[idx].record(Clock::now() - chunk_started);
+                ++chunks[idx];
+            }
+            // keeps the loop from being optimized away
+            sink.fetch_add(state, std::memory_order_relaxed);
+        });
+    }
+
+    std::this_thread::sleep_for(duration);
+    stop = true;
+    for (auto&& worker : workers) {
+        worker.join();
+    }
+    const auto elapsed = Clock::now() - started;
+
+    std::uint64_t total_chunks{};
+    for (auto&& count : chunks) {
+        total_chunks += count;
+    }
+    return make_result(scx::bench::Workload::CpuThroughput, total_chunks, elapsed, recorders);
+}
+
+}  // namespace
+
+namespace scx::bench {
+
+auto workload_name(Workload workload) noexcept -> std::string_view {
+    return kWorkloadNames[static_cast<std::size_t>(workload)];
+}
+
+auto workload_from_name(std::string_view name) noexcept -> std::optional<Workload> {
+    for (auto&& workload : kAllWorkloads) {
+        if (workload_name(workload) == name) {
+            return workload;
+        }
+    }
+    return std::nullopt;
+}
+
+LatencyRecorder::LatencyRecorder(std::size_t capacity)
+  : m_capacity(capacity) {
+    m_samples.reserve(capacity);
+}
+
+void LatencyRecorder::record(std::chrono::nanoseconds latency) noexcept {
+    ++m_count;
+    if (m_samples.size() < m_capacity) {
+        m_samples.emplace_back(latency.count());
+        return;
+    }
+
+    // reservoir sampling, replace with probability capacity/count
+    m_rng_state ^= m_rng_state << 13U;
+    m_rng_state ^= m_rng_state >> 7U;
+    m_rng_state ^= m_rng_state << 17U;
+    const auto slot = m_rng_state % m_count;
+    if (slot < m_capacity) {
+        m_samples[slot] = latency.count();
+    }
+}
+
+auto summarize_latencies(std::span<const LatencyRecorder> recorders) -> LatencySummary {
+    std::vector<std::int64_t> merged;
+    LatencySummary summary{};
+    for (auto&& recorder : recorders) {
+        merged.insert(merged.end(), recorder.samples().begin(), recorder.samples().end());
+        summary.count += recorder.count();
+    }
+    if (merged.empty()) {
+        return summary;
+    }
+
+    const auto percentile = [&merged](double quantile) {
+        const auto rank = static_cast<std::size_t>(quantile * static_cast<double>(merged.size() - 1));
+        std::ranges::nth_element(merged, merged.begin() + static_cast<std::ptrdiff_t>(rank));
+        return std::chrono::nanoseconds(merged[rank]);
+    };
+    summary.p50  = percentile(0.50);
+    summary.p90  = percentile(0.90);
+    summary.p99  = percentile(0.99);
+    summary.p999 = percentile(0.999);
+    summary.max  = std::chrono::nanoseconds(*std::ranges::max_element(merged));
+    return summary;
+}
+
+auto run_workload(Workload workload, std::chrono::milliseconds duration) noexcept -> std::optional<WorkloadResult> {
+    try {
+        switch (workload) {
+        case Workload::Messaging:
+            return run_messaging(duration);
+        case Workload::PipePingPong:
+            return run_pipe_ping_pong(duration);
+        case Workload::CpuThroughput:
+            return run_cpu_throughput(duration);
+        }
+    } catch (const std::exception& e) {
+        fmt::print(stderr, "Failed to run '{}' workload: {}\n", workload_name(workload), e.what());
+    }
+    return std::nullopt;
+}
+
+}  // namespace scx::bench
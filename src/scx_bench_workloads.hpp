@@ -0,0 +1,102 @@
+// Copyright (C) 2024-2025 Vladislav Nepogodin
+//
+// This file is part of CachyOS kernel manager.
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+#ifndef SCX_BENCH_WORKLOADS_HPP
+#define SCX_BENCH_WORKLOADS_HPP
+
+#include "scx_energy.hpp"
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <string_view>
+#include <vector>
+
+namespace scx::bench {
+
+/// @brief Synthetic workloads run for each scheduler/mode pair.
+enum class Workload : std::uint8_t {
+    /// hackbench-style messaging between groups of sender and receiver threads
+    Messaging,
+    /// Token bouncing between two threads over a pair of pipes
+    PipePingPong,
+    /// Fixed-size compute chunks on every CPU
+    CpuThroughput,
+};
+
+inline constexpr std::array kAllWorkloads{Workload::Messaging, Workload::PipePingPong, Workload::CpuThroughput};
+
+auto workload_name(Workload workload) noexcept -> std::string_view;
+auto workload_from_name(std::string_view name) noexcept -> std::optional<Workload>;
+
+/// @brief Latency percentiles of the workload operations.
+struct LatencySummary {
+    std::uint64_t count{};
+    std::chrono::nanoseconds p50{};
+    std::chrono::nanoseconds p90{};
+    std::chrono::nanoseconds p99{};
+    std::chrono::nanoseconds p999{};
+    std::chrono::nanoseconds max{};
+};
+
+struct WorkloadResult {
+    Workload workload{};
+    /// Completed operations: messages, round trips or compute chunks
+    std::uint64_t ops{};
+    std::chrono::nanoseconds elapsed{};
+    double ops_per_sec{};
+    LatencySummary latency{};
+    /// Energy of the RAPL zones while the workload ran, set by run_benchmark if they can be read
+    std::optional<energy::EnergyCounts> energy{};
+};
+
+/// @brief Records operation latencies into fixed-size storage.
+///
+/// Once full, keeps an unbiased reservoir sample, so long runs don't grow memory.
+class LatencyRecorder final {
+ public:
+    static constexpr std::size_t kDefaultCapacity = 1U << 15U;
+
+    LatencyRecorder() : LatencyRecorder(kDefaultCapacity) { }
+    explicit LatencyRecorder(std::size_t capacity);
+
+    void record(std::chrono::nanoseconds latency) noexcept;
+
+    [[nodiscard]] auto samples() const noexcept -> std::span<const std::int64_t> { return m_samples; }
+    [[nodiscard]] auto count() const noexcept -> std::uint64_t { return m_count; }
+
+ private:
+    std::vector<std::int64_t> m_samples{};
+    std::size_t m_capacity{};
+    std::uint64_t m_count{};
+    std::uint64_t m_rng_state{0x9E3779B97F4A7C15ULL};
+};
+
+/// @brief Merges recorders and computes percentiles.
+auto summarize_latencies(std::span<const LatencyRecorder> recorders) -> LatencySummary;
+
+/// @brief Runs the workload for the given duration.
+///
+/// Returns nullopt if the workload could not be set up, e.g out of file descriptors.
+auto run_workload(Workload workload, std::chrono::milliseconds duration) noexcept -> std::optional<WorkloadResult>;
+
+}  // namespace scx::bench
+
+#endif  // SCX_BENCH_WORKLOADS_HPP
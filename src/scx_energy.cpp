@@ -0,0 +1,212 @@
+// Copyright (C) 2024-2025 Vladislav Nepogodin
+//
+// This file is part of CachyOS kernel manager.
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+
+#include "scx_energy.hpp"
+
+#include <algorithm>     // for find_if
+#include <charconv>      // for from_chars
+#include <filesystem>    // for directory_iterator
+#include <system_error>  // for error_code
+
+#include <fmt/core.h>
+
+namespace {
+
+using scx::energy::EnergyDomain;
+using scx::energy::kEnergyDomainCount;
+
+constexpr double kMicrojoulesPerJoule = 1'000'000.;
+
+constexpr auto trim_whitespace(std::string_view str) noexcept -> std::string_view {
+    constexpr std::string_view kWhitespace{" \t\r\n"};
+    const auto first = str.find_first_not_of(kWhitespace);
+    if (first == std::string_view::npos) {
+        return {};
+    }
+    const auto last = str.find_last_not_of(kWhitespace);
+    return str.substr(first, last - first + 1);
+}
+
+auto parse_u64(std::string_view str, std::uint64_t& value) noexcept -> bool {
+    str                 = trim_whitespace(str);
+    const auto* str_end = str.data() + str.size();
+    auto [ptr, ec]      = std::from_chars(str.data(), str_end, value);
+    return ec == std::errc{} && ptr == str_end;
+}
+
+auto read_u64(scx::SysfsFile& file) noexcept -> std::optional<std::uint64_t> {
+    std::array<char, 32> read_buf{};
+    std::uint64_t value{};
+    if (!parse_u64(file.read(read_buf), value)) {
+        return std::nullopt;
+    }
+    return value;
+}
+
+constexpr auto domain_from_zone_name(std::string_view zone_name) noexcept -> std::optional<EnergyDomain> {
+    if (zone_name.starts_with("package-")) {
+        return EnergyDomain::Package;
+    }
+    if (zone_name == "core") {
+        return EnergyDomain::Core;
+    }
+    if (zone_name == "dram") {
+        return EnergyDomain::Dram;
+    }
+    // uncore and psys overlap with the package
+    return std::nullopt;
+}
+
+}  // namespace
+
+namespace scx::energy {
+
+auto energy_domain_name(EnergyDomain domain) noexcept -> std::string_view {
+    switch (domain) {
+    case EnergyDomain::Package:
+        return "package";
+    case EnergyDomain::Core:
+        return "core";
+    case EnergyDomain::Dram:
+        return "dram";
+    }
+    return "unknown";
+}
+
+auto EnergyCounts::joules_per_minute(EnergyDomain domain) const noexcept -> std::optional<double> {
+    const auto domain_idx = static_cast<std::size_t>(domain);
+    const auto minutes    = std::chrono::duration<double, std::ratio<60>>(elapsed).count();
+    if (!valid.test(domain_idx) || minutes <= 0.) {
+        return std::nullopt;
+    }
+    return joules[domain_idx] / minutes;
+}
+
+auto EnergyCounts::joules_per_op(EnergyDomain domain) const noexcept -> std::optional<double> {
+    const auto domain_idx = static_cast<std::size_t>(domain);
+    if (!valid.test(domain_idx) || work_ops == 0) {
+        return std::nullopt;
+    }
+    return joules[domain_idx] / static_cast<double>(work_ops);
+}
+
+void EnergyCounts::add(const EnergyCounts& other) noexcept {
+    for (std::size_t domain_idx = 0; domain_idx < kEnergyDomainCount; ++domain_idx) {
+        joules[domain_idx] += other.joules[domain_idx];
+    }
+    valid |= other.valid;
+    elapsed += other.elapsed;
+    work_ops += other.work_ops;
+}
+
+EnergyMeter::EnergyMeter(std::string_view powercap_root) : m_powercap_root(powercap_root) { }
+
+auto EnergyMeter::open() noexcept -> bool {
+    close();
+
+    std::error_code err_code{};
+    for (const auto& entry : std::filesystem::directory_iterator(m_powercap_root, err_code)) {
+        // intel-rapl-mmio:0 is the same package as intel-rapl:0, read through MMIO
+        const auto& zone_dir = entry.path();
+        if (zone_dir.filename().native().find("mmio") != std::string::npos) {
+            continue;
+        }
+
+        std::array<char, 64> name_buf{};
+        SysfsFile name_file{(zone_dir / "name").native()};
+        const auto domain = domain_from_zone_name(name_file.read(name_buf));
+        if (!domain) {
+            continue;
+        }
+
+        Zone zone{.domain = *domain, .energy_file = SysfsFile{(zone_dir / "energy_uj").native()}};
+        const auto energy_uj = read_u64(zone.energy_file);
+        if (!energy_uj) {
+            fmt::print(stderr, "Cannot read {}, it may need root\n", zone.energy_file.path());
+            continue;
+        }
+        SysfsFile range_file{(zone_dir / "max_energy_range_uj").native()};
+        zone.max_range_uj = read_u64(range_file).value_or(0);
+        zone.last_uj      = *energy_uj;
+        m_zones.emplace_back(std::move(zone));
+    }
+    m_sampled_at = std::chrono::steady_clock::now();
+    return is_open();
+}
+
+void EnergyMeter::close() noexcept {
+    m_zones.clear();
+    m_last_counts = {};
+}
+
+void EnergyMeter::set_label(std::string_view label) noexcept {
+    if (label == m_label) {
+        return;
+    }
+    if (is_open()) {
+        sample();
+    }
+    m_label.assign(label);
+}
+
+auto EnergyMeter::sample() noexcept -> bool {
+    if (!is_open()) {
+        return false;
+    }
+    EnergyCounts counts{};
+    for (auto&& zone : m_zones) {
+        const auto energy_uj = read_u64(zone.energy_file);
+        if (!energy_uj) {
+            continue;
+        }
+        const auto domain_idx = static_cast<std::size_t>(zone.domain);
+        counts.joules[domain_idx] += static_cast<double>(energy_delta_uj(zone.last_uj, *energy_uj, zone.max_range_uj)) / kMicrojoulesPerJoule;
+        counts.valid.set(domain_idx);
+        zone.last_uj = *energy_uj;
+    }
+    const auto now = std::chrono::steady_clock::now();
+    counts.elapsed = now - m_sampled_at;
+    m_sampled_at   = now;
+    if (counts.valid.none()) {
+        return false;
+    }
+
+    m_last_counts = counts;
+    if (!m_label.empty()) {
+        find_or_add_profile(m_label).counts.add(counts);
+    }
+    return true;
+}
+
+void EnergyMeter::add_work(std::uint64_t ops) noexcept {
+    m_last_counts.work_ops += ops;
+    if (!m_label.empty()) {
+        find_or_add_profile(m_label).counts.work_ops += ops;
+    }
+}
+
+auto EnergyMeter::find_or_add_profile(std::string_view label) noexcept -> EnergyProfile& {
+    auto profile_it = std::ranges::find_if(m_profiles, [label](auto&& profile) { return profile.label == label; });
+    if (profile_it != m_profiles.end()) {
+        return *profile_it;
+    }
+    return m_profiles.emplace_back(EnergyProfile{.label = std::string{label}});
+}
+
+}  // namespace scx::energy
@@ -0,0 +1,139 @@
+// Copyright (C) 2024-2025 Vladislav Nepogodin
+//
+// This file is part of CachyOS kernel manager.
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+
+#ifndef SCX_ENERGY_HPP
+#define SCX_ENERGY_HPP
+
+#include "scx_sysfs.hpp"
+
+#include <array>
+#include <bitset>
+#include <chrono>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace scx::energy {
+
+inline constexpr std::string_view kPowercapRoot{"/sys/class/powercap"};
+
+/// @brief RAPL domains, as named by the "name" attribute of the powercap zone.
+enum class EnergyDomain : std::uint8_t {
+    /// Whole socket, "package-N", summed over the sockets
+    Package,
+    /// CPU cores of the package, "core"
+    Core,
+    /// Memory controller, "dram"
+    Dram,
+};
+
+inline constexpr std::size_t kEnergyDomainCount = 3;
+
+auto energy_domain_name(EnergyDomain domain) noexcept -> std::string_view;
+
+/// @brief Returns the energy counted between two reads of energy_uj.
+///
+/// The counter wraps around to 0 after max_energy_range_uj.
+constexpr auto energy_delta_uj(std::uint64_t prev_uj, std::uint64_t now_uj, std::uint64_t max_range_uj) noexcept -> std::uint64_t {
+    if (now_uj >= prev_uj) {
+        return now_uj - prev_uj;
+    }
+    // a counter reset, e.g after resume, has no range to wrap around
+    return (max_range_uj > prev_uj) ? (max_range_uj - prev_uj) + now_uj : now_uj;
+}
+
+/// @brief Energy of all zones over a span of time.
+struct EnergyCounts {
+    std::array<double, kEnergyDomainCount> joules{};
+    /// Domains missing on the system, e.g dram on most AMD CPUs, are unset
+    std::bitset<kEnergyDomainCount> valid{};
+    std::chrono::nanoseconds elapsed{};
+    /// Operations of the synthetic workload done over the span, if any
+    std::uint64_t work_ops{};
+
+    /// @brief Returns joules per minute of the span, i.e average power scaled by 60.
+    [[nodiscard]] auto joules_per_minute(EnergyDomain domain) const noexcept -> std::optional<double>;
+    /// @brief Returns joules per operation of the workload, if any was done.
+    [[nodiscard]] auto joules_per_op(EnergyDomain domain) const noexcept -> std::optional<double>;
+
+    void add(const EnergyCounts& other) noexcept;
+};
+
+/// @brief Energy accumulated while the scheduler was running, labeled e.g "scx_lavd (Gaming)".
+struct EnergyProfile {
+    std::string label{};
+    EnergyCounts counts{};
+};
+
+/// @brief Accounts energy of the RAPL zones exposed through powercap per scheduler and mode.
+///
+/// Zones are found under the root, /sys/class/powercap unless a fixture tree is
+/// given. MMIO zones duplicate the MSR ones and are skipped. Reading energy_uj
+/// needs root on kernels which restrict it against power side channels.
+class EnergyMeter final {
+ public:
+    explicit EnergyMeter(std::string_view powercap_root = kPowercapRoot);
+
+    /// @brief Finds the zones and takes the first reading.
+    ///
+    /// Returns false if no zone can be read.
+    auto open() noexcept -> bool;
+    void close() noexcept;
+
+    [[nodiscard]] auto is_open() const noexcept -> bool { return !m_zones.empty(); }
+
+    /// @brief Sets the label the following energy is accounted to.
+    ///
+    /// Energy so far is sampled into the previous label first.
+    void set_label(std::string_view label) noexcept;
+
+    /// @brief Reads all zones and accounts the energy since the previous sample.
+    auto sample() noexcept -> bool;
+
+    /// @brief Accounts operations of a synthetic workload to the current label.
+    void add_work(std::uint64_t ops) noexcept;
+
+    /// @brief Energy of the last sampled span, e.g for the current power.
+    [[nodiscard]] auto last_counts() const noexcept -> const EnergyCounts& { return m_last_counts; }
+
+    [[nodiscard]] auto profiles() const noexcept -> const std::vector<EnergyProfile>& { return m_profiles; }
+
+ private:
+    struct Zone {
+        EnergyDomain domain{};
+        SysfsFile energy_file;
+        std::uint64_t max_range_uj{};
+        std::uint64_t last_uj{};
+    };
+
+    auto find_or_add_profile(std::string_view label) noexcept -> EnergyProfile&;
+
+    std::string m_powercap_root;
+    std::vector<Zone> m_zones{};
+    std::chrono::steady_clock::time_point m_sampled_at{};
+    std::string m_label{};
+    EnergyCounts m_last_counts{};
+    std::vector<EnergyProfile> m_profiles{};
+};
+
+}  // namespace scx::energy
+
+#endif  // SCX_ENERGY_HPP
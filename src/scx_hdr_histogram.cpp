@@ -0,0 +1,70 @@
+// Copyright (C) 2024-2025 Vladislav Nepogodin
+//
+// This file is part of CachyOS kernel manager.
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+#include "scx_hdr_histogram.hpp"
+
+#include <algorithm>  // for min, max
+#include <cmath>      // for ceil
+
+namespace scx {
+
+void HdrHistogram::merge(const HdrHistogram& other) noexcept {
+    // NOTE: merged histogram is owned by the reader, relaxed RMW is fine here
+    std::uint64_t merged_count{};
+    for (std::size_t idx = 0; idx < kBucketCount; ++idx) {
+        const auto bucket_count = other.m_counts[idx].load(std::memory_order_relaxed);
+        if (bucket_count != 0) {
+            m_counts[idx].fetch_add(bucket_count, std::memory_order_relaxed);
+            merged_count += bucket_count;
+        }
+    }
+    // sum of the buckets, so the total stays consistent with them while other is recorded
+    m_total_count.fetch_add(merged_count, std::memory_order_relaxed);
+    const auto other_max = other.max();
+    if (other_max > max()) {
+        m_max.store(other_max, std::memory_order_relaxed);
+    }
+}
+
+void HdrHistogram::reset() noexcept {
+    for (auto& bucket_count : m_counts) {
+        bucket_count.store(0, std::memory_order_relaxed);
+    }
+    m_total_count.store(0, std::memory_order_relaxed);
+    m_max.store(0, std::memory_order_relaxed);
+}
+
+auto HdrHistogram::value_at_percentile(double percentile) const noexcept -> std::uint64_t {
+    const auto total_count = count();
+    if (total_count == 0) {
+        return 0;
+    }
+    percentile        = std::clamp(percentile, 0., 100.);
+    const auto target = std::max<std::uint64_t>(1, static_cast<std::uint64_t>(std::ceil(percentile / 100. * static_cast<double>(total_count))));
+
+    std::uint64_t seen_count{};
+    for (std::size_t idx = 0; idx < kBucketCount; ++idx) {
+        seen_count += m_counts[idx].load(std::memory_order_relaxed);
+        if (seen_count >= target) {
+            return std::min(bucket_upper_bound(idx), max());
+        }
+    }
+    return max();
+}
+
+}  // namespace scx
@@ -0,0 +1,104 @@
+// Copyright (C) 2024-2025 Vladislav Nepogodin
+//
+// This file is part of CachyOS kernel manager.
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+#ifndef SCX_HDR_HISTOGRAM_HPP
+#define SCX_HDR_HISTOGRAM_HPP
+
+#include <array>
+#include <atomic>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+
+namespace scx {
+
+/// @brief High dynamic range histogram of nanosecond values.
+///
+/// Buckets are log-linear: values below 128 are exact, larger ones are kept
+/// with 1/64 relative precision, up to ~18 minutes. Counters are atomic, so the
+/// histogram can be recorded by a single thread while others merge it, without locks.
+class HdrHistogram final {
+ public:
+    static constexpr std::uint32_t kSubBucketBits     = 7;
+    static constexpr std::uint64_t kSubBucketCount    = 1ULL << kSubBucketBits;
+    static constexpr std::uint64_t kSubBucketHalf     = kSubBucketCount / 2;
+    static constexpr std::uint32_t kMaxValueBits      = 40;
+    static constexpr std::uint64_t kMaxTrackableValue = (1ULL << kMaxValueBits) - 1;
+    static constexpr std::size_t kBucketCount         = kSubBucketCount + (kMaxValueBits - kSubBucketBits) * kSubBucketHalf;
+
+    HdrHistogram() noexcept = default;
+
+    HdrHistogram(const HdrHistogram&)                    = delete;
+    auto operator=(const HdrHistogram&) -> HdrHistogram& = delete;
+
+    static constexpr auto bucket_index(std::uint64_t value) noexcept -> std::size_t {
+        if (value < kSubBucketCount) {
+            return value;
+        }
+        value            = (value > kMaxTrackableValue) ? kMaxTrackableValue : value;
+        const auto shift = static_cast<std::uint32_t>(std::bit_width(value)) - kSubBucketBits;
+        return kSubBucketCount + (shift - 1) * kSubBucketHalf + ((value >> shift) - kSubBucketHalf);
+    }
+
+    /// @brief Returns the highest value, which falls into the bucket.
+    static constexpr auto bucket_upper_bound(std::size_t idx) noexcept -> std::uint64_t {
+        if (idx < kSubBucketCount) {
+            return idx;
+        }
+        const auto shift = static_cast<std::uint32_t>((idx - kSubBucketCount) / kSubBucketHalf) + 1;
+        const auto sub   = ((idx - kSubBucketCount) % kSubBucketHalf) + kSubBucketHalf;
+        return ((sub + 1) << shift) - 1;
+    }
+
+    /// @brief Records the value. Must be called only from a single thread at a time.
+    void record(std::uint64_t value) noexcept {
+        // single writer, so plain load/store is enough and avoids locked instructions
+        bump(m_counts[bucket_index(value)]);
+        bump(m_total_count);
+        if (value > m_max.load(std::memory_order_relaxed)) {
+            m_max.store(value, std::memory_order_relaxed);
+        }
+    }
+
+    /// @brief Adds counts of other histogram, which may be concurrently recorded.
+    void merge(const HdrHistogram& other) noexcept;
+
+    /// @brief Clears the histogram. Must not race with record.
+    void reset() noexcept;
+
+    /// @brief Returns the value at the given percentile, e.g 99.9.
+    ///
+    /// Value is the upper bound of the bucket, clamped by the maximum recorded value.
+    [[nodiscard]] auto value_at_percentile(double percentile) const noexcept -> std::uint64_t;
+
+    [[nodiscard]] auto count() const noexcept -> std::uint64_t { return m_total_count.load(std::memory_order_relaxed); }
+    [[nodiscard]] auto max() const noexcept -> std::uint64_t { return m_max.load(std::memory_order_relaxed); }
+
+ private:
+    static void bump(std::atomic<std::uint64_t>& counter) noexcept {
+        counter.store(counter.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    }
+
+    std::array<std::atomic<std::uint64_t>, kBucketCount> m_counts{};
+    std::atomic<std::uint64_t> m_total_count{};
+    std::atomic<std::uint64_t> m_max{};
+};
+
+}  // namespace scx
+
+#endif  // SCX_HDR_HISTOGRAM_HPP
@@ -0,0 +1,349 @@
+// Copyright (C) 2024-2025 Vladislav Nepogodin
+//
+// This file is part of CachyOS kernel manager.
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+
+#include "scx_history.hpp"
+#include "scx_policy.hpp"
+
+#include <algorithm>     // for min, max
+#include <atomic>        // for atomic_ref
+#include <chrono>        // for system_clock
+#include <cmath>         // for isnan
+#include <cstdlib>       // for getenv
+#include <cstring>       // for memcpy, strerror
+#include <ctime>         // for localtime_r
+#include <filesystem>    // for create_directories
+#include <system_error>  // for error_code
+
+#include <fcntl.h>     // for open
+#include <sys/file.h>  // for flock
+#include <sys/mman.h>  // for mmap
+#include <sys/stat.h>  // for fstat
+#include <unistd.h>    // for close, ftruncate, pread, sysconf
+
+#include <fmt/chrono.h>
+#include <fmt/core.h>
+
+namespace scx::history {
+
+struct HistoryLog::FileHeader {
+    std::array<char, 8> magic;
+    std::uint32_t version;
+    std::uint32_t record_size;
+    std::uint64_t capacity;
+    /// Records ever appended, the next one goes into the slot head % capacity
+    std::uint64_t head;
+    std::array<std::uint8_t, 32> reserved;
+};
+
+}  // namespace scx::history
+
+namespace {
+
+using scx::history::Record;
+
+constexpr std::array<char, 8> kHistoryMagic{'S', 'C', 'X', 'H', 'I', 'S', 'T', '\0'};
+constexpr std::uint32_t kHistoryVersion = 1;
+
+template <std::size_t N>
+void copy_truncated(std::array<char, N>& field, std::string_view str) noexcept {
+    // the rest stays NUL-padded, a field can be filled up completely
+    str.copy(field.data(), std::min(str.size(), N));
+}
+
+template <std::size_t N>
+constexpr auto field_view(const std::array<char, N>& field) noexcept -> std::string_view {
+    const std::string_view str{field.data(), N};
+    return str.substr(0, str.find('\0'));
+}
+
+auto now_ns() noexcept -> std::int64_t {
+    // vDSO, doesn't enter the kernel
+    const auto now = std::chrono::system_clock::now();
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(now.time_since_epoch()).count();
+}
+
+}  // namespace
+
+namespace scx::history {
+
+auto record_kind_name(RecordKind kind) noexcept -> std::string_view {
+    switch (kind) {
+    case RecordKind::Transition:
+        return "transition";
+    case RecordKind::StateChange:
+        return "state";
+    case RecordKind::MetricSample:
+        return "sample";
+    }
+    return "unknown";
+}
+
+auto source_name(Source source) noexcept -> std::string_view {
+    switch (source) {
+    case Source::Unknown:
+        return "unknown";
+    case Source::Gui:
+        return "gui";
+    case Source::Cli:
+        return "cli";
+    case Source::Policy:
+        return "policy";
+    case Source::Kernel:
+        return "kernel";
+    }
+    return "unknown";
+}
+
+auto metric_name(Metric metric) noexcept -> std::string_view {
+    switch (metric) {
+    case Metric::CpuPressure:
+        return "cpu_pressure";
+    case Metric::LoadPerCpu:
+        return "load_per_cpu";
+    case Metric::ContextSwitchRate:
+        return "context_switches_per_sec";
+    case Metric::PackageWatts:
+        return "package_watts";
+    }
+    return "unknown";
+}
+
+auto Record::scheduler_name() const noexcept -> std::string_view {
+    return field_view(scheduler);
+}
+
+auto Record::text_view() const noexcept -> std::string_view {
+    return field_view(text);
+}
+
+auto Record::mode() const noexcept -> std::optional<SchedMode> {
+    if (sched_mode == kNoMode) {
+        return std::nullopt;
+    }
+    return static_cast<SchedMode>(sched_mode);
+}
+
+auto Record::metric(Metric metric) const noexcept -> std::optional<double> {
+    const auto value = metrics[static_cast<std::size_t>(metric)];
+    if (std::isnan(value)) {
+        return std::nullopt;
+    }
+    return static_cast<double>(value);
+}
+
+auto make_transition(Source source, std::string_view scx_sched, std::optional<SchedMode> sched_mode, std::string_view reason) noexcept -> Record {
+    Record record{.timestamp_ns = now_ns(), .kind = RecordKind::Transition, .source = source, .metrics = empty_metrics()};
+    if (sched_mode) {
+        record.sched_mode = static_cast<std::uint8_t>(*sched_mode);
+    }
+    copy_truncated(record.scheduler, scx_sched);
+    copy_truncated(record.text, reason);
+    return record;
+}
+
+auto make_state_change(std::string_view state, std::string_view ops) noexcept -> Record {
+    Record record{.timestamp_ns = now_ns(), .kind = RecordKind::StateChange, .source = Source::Kernel, .metrics = empty_metrics()};
+    copy_truncated(record.scheduler, ops);
+    copy_truncated(record.text, state);
+    return record;
+}
+
+auto make_metric_sample(std::string_view scx_sched, const MetricValues& values) noexcept -> Record {
+    Record record{.timestamp_ns = now_ns(), .kind = RecordKind::MetricSample, .metrics = values};
+    copy_truncated(record.scheduler, scx_sched);
+    return record;
+}
+
+auto format_record(const Record& record) -> std::string {
+    const auto timestamp = std::chrono::nanoseconds{record.timestamp_ns};
+    const auto secs      = static_cast<std::time_t>(std::chrono::duration_cast<std::chrono::seconds>(timestamp).count());
+    const auto millis    = std::chrono::duration_cast<std::chrono::milliseconds>(timestamp).count() % 1000;
+    std::tm local_tm{};
+    ::localtime_r(&secs, &local_tm);
+
+    auto line = fmt::format("{:%F %T}.{:03} {}", local_tm, millis, record_kind_name(record.kind));
+    switch (record.kind) {
+    case RecordKind::Transition: {
+        const auto sched_mode = record.mode();
+        line += fmt::format(" {} {} {} {}", source_name(record.source), record.scheduler_name().empty() ? "-" : record.scheduler_name(),
+            sched_mode ? sched_mode_name(*sched_mode) : "-", record.text_view());
+        break;
+    }
+    case RecordKind::StateChange:
+        line += fmt::format(" {} {}", record.text_view(), record.scheduler_name().empty() ? "-" : record.scheduler_name());
+        break;
+    case RecordKind::MetricSample:
+        line += fmt::format(" {}", record.scheduler_name().empty() ? "-" : record.scheduler_name());
+        for (std::size_t metric_idx = 0; metric_idx < kMetricCount; ++metric_idx) {
+            const auto metric = static_cast<Metric>(metric_idx);
+            if (const auto value = record.metric(metric); value) {
+                line += fmt::format(" {}={:.2f}", metric_name(metric), *value);
+            }
+        }
+        break;
+    }
+    return line;
+}
+
+auto default_history_path() -> std::optional<std::string> {
+    if (const auto* state_home = std::getenv("XDG_STATE_HOME"); state_home != nullptr && state_home[0] == '/') {
+        return fmt::format("{}/scx-manager/history.bin", state_home);
+    }
+    if (const auto* home = std::getenv("HOME"); home != nullptr && home[0] != '\0') {
+        return fmt::format("{}/.local/state/scx-manager/history.bin", home);
+    }
+    return std::nullopt;
+}
+
+MetricSampler::MetricSampler() noexcept
+  : m_cpu_count(static_cast<double>(std::max(::sysconf(_SC_NPROCESSORS_ONLN), 1L))) { }
+
+void MetricSampler::sample(MetricValues& values) noexcept {
+    if (auto cpu_pressure = policy::parse_cpu_pressure(m_pressure_file.read(m_read_buf)); cpu_pressure) {
+        values[static_cast<std::size_t>(Metric::CpuPressure)] = static_cast<float>(*cpu_pressure);
+    }
+    if (auto loadavg = policy::parse_loadavg(m_loadavg_file.read(m_read_buf)); loadavg) {
+        values[static_cast<std::size_t>(Metric::LoadPerCpu)] = static_cast<float>((*loadavg)[0] / m_cpu_count);
+    }
+}
+
+auto HistoryLog::mapping_size(std::uint64_t capacity) noexcept -> std::size_t {
+    static_assert(sizeof(FileHeader) == 64);
+    return sizeof(FileHeader) + (static_cast<std::size_t>(capacity) * sizeof(Record));
+}
+
+HistoryLog::~HistoryLog() noexcept {
+    close();
+}
+
+auto HistoryLog::open(std::string_view file_path, bool writable, std::uint64_t capacity) noexcept -> bool {
+    close();
+    const std::string path{file_path};
+    if (writable) {
+        std::error_code err_code{};
+        std::filesystem::create_directories(std::filesystem::path{path}.parent_path(), err_code);
+    }
+
+    const int fd = ::open(path.c_str(), (writable ? (O_RDWR | O_CREAT) : O_RDONLY) | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        fmt::print(stderr, "Cannot open history {}: {}\n", path, std::strerror(errno));
+        return false;
+    }
+    if (writable) {
+        // serializes the creation between the processes, released by close
+        ::flock(fd, LOCK_EX);
+    }
+
+    FileHeader header{};
+    struct stat file_stat{};
+    const bool has_header = ::fstat(fd, &file_stat) == 0 && ::pread(fd, &header, sizeof(header), 0) == static_cast<ssize_t>(sizeof(header));
+    const bool is_valid   = has_header && header.magic == kHistoryMagic && header.version == kHistoryVersion && header.record_size == sizeof(Record)
+        && header.capacity != 0 && static_cast<std::size_t>(file_stat.st_size) == mapping_size(header.capacity);
+    if (!is_valid) {
+        if (!writable || capacity == 0) {
+            fmt::print(stderr, "{} is not a history file of this version\n", path);
+            ::close(fd);
+            return false;
+        }
+        // truncating first zeroes the slots of the old format
+        header = FileHeader{.magic = kHistoryMagic, .version = kHistoryVersion, .record_size = sizeof(Record), .capacity = capacity, .head = 0, .reserved = {}};
+        if (::ftruncate(fd, 0) != 0 || ::ftruncate(fd, static_cast<off_t>(mapping_size(capacity))) != 0
+            || ::pwrite(fd, &header, sizeof(header), 0) != static_cast<ssize_t>(sizeof(header))) {
+            fmt::print(stderr, "Cannot create history {}: {}\n", path, std::strerror(errno));
+            ::close(fd);
+            return false;
+        }
+    }
+
+    const auto size = mapping_size(header.capacity);
+    void* mapping   = ::mmap(nullptr, size, writable ? (PROT_READ | PROT_WRITE) : PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (mapping == MAP_FAILED) {
+        fmt::print(stderr, "Cannot map history {}: {}\n", path, std::strerror(errno));
+        return false;
+    }
+    m_header       = static_cast<FileHeader*>(mapping);
+    m_mapping_size = size;
+    m_writable     = writable;
+    return true;
+}
+
+void HistoryLog::close() noexcept {
+    if (m_header != nullptr) {
+        ::munmap(m_header, m_mapping_size);
+    }
+    m_header       = nullptr;
+    m_mapping_size = 0;
+    m_writable     = false;
+}
+
+auto HistoryLog::slots() const noexcept -> Record* {
+    return reinterpret_cast<Record*>(reinterpret_cast<char*>(m_header) + sizeof(FileHeader));
+}
+
+void HistoryLog::append(const Record& record) noexcept {
+    if (!m_writable) {
+        return;
+    }
+    const auto idx = std::atomic_ref{m_header->head}.fetch_add(1, std::memory_order_relaxed);
+    auto& slot     = slots()[idx % m_header->capacity];
+
+    std::atomic_ref slot_seq{slot.seq};
+    slot_seq.store(0, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    // everything but the sequence, which publishes the record
+    std::memcpy(reinterpret_cast<char*>(&slot) + sizeof(slot.seq), reinterpret_cast<const char*>(&record) + sizeof(record.seq), sizeof(Record) - sizeof(Record::seq));
+    slot_seq.store(idx + 1, std::memory_order_release);
+}
+
+auto HistoryLog::written() const noexcept -> std::uint64_t {
+    if (m_header == nullptr) {
+        return 0;
+    }
+    return std::atomic_ref{m_header->head}.load(std::memory_order_acquire);
+}
+
+auto HistoryLog::records() const -> std::vector<Record> {
+    const auto head = written();
+    if (head == 0) {
+        return {};
+    }
+    const auto capacity = m_header->capacity;
+    const auto first    = (head > capacity) ? head - capacity : 0;
+
+    std::vector<Record> records;
+    records.reserve(static_cast<std::size_t>(head - first));
+    for (auto idx = first; idx < head; ++idx) {
+        auto& slot = slots()[idx % capacity];
+        std::atomic_ref slot_seq{slot.seq};
+        if (slot_seq.load(std::memory_order_acquire) != idx + 1) {
+            // still being written, or overwritten already
+            continue;
+        }
+        Record record;
+        std::memcpy(&record, &slot, sizeof(Record));
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (slot_seq.load(std::memory_order_relaxed) == idx + 1) {
+            records.emplace_back(record);
+        }
+    }
+    return records;
+}
+
+}  // namespace scx::history
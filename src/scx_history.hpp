@@ -0,0 +1,187 @@
+// Copyright (C) 2024-2025 Vladislav Nepogodin
+//
+// This file is part of CachyOS kernel manager.
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+
+#ifndef SCX_HISTORY_HPP
+#define SCX_HISTORY_HPP
+
+#include "scx_sysfs.hpp"
+#include "scx_utils.hpp"
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+
+namespace scx::history {
+
+enum class RecordKind : std::uint8_t {
+    /// Scheduler or mode switched through scx_loader
+    Transition,
+    /// sched_ext state or root/ops changed, whoever caused it
+    StateChange,
+    /// Periodic sample of the system metrics
+    MetricSample,
+};
+
+/// @brief Who made the change.
+enum class Source : std::uint8_t {
+    Unknown,
+    Gui,
+    Cli,
+    Policy,
+    Kernel,
+};
+
+enum class Metric : std::uint8_t {
+    /// some avg10 of /proc/pressure/cpu, percents
+    CpuPressure,
+    /// 1 minute load average divided by the CPUs
+    LoadPerCpu,
+    /// Only while the system cost is profiled
+    ContextSwitchRate,
+    /// Only while the energy is measured
+    PackageWatts,
+};
+
+inline constexpr std::size_t kMetricCount = 4;
+/// Spare slots keep the record size, when metrics are added
+inline constexpr std::size_t kMetricSlots = 6;
+
+/// @brief Values of a sample, metrics which were not measured are NaN.
+using MetricValues = std::array<float, kMetricSlots>;
+
+auto record_kind_name(RecordKind kind) noexcept -> std::string_view;
+auto source_name(Source source) noexcept -> std::string_view;
+auto metric_name(Metric metric) noexcept -> std::string_view;
+
+/// @brief Returns the values with no metric measured.
+constexpr auto empty_metrics() noexcept -> MetricValues {
+    MetricValues values{};
+    values.fill(std::numeric_limits<float>::quiet_NaN());
+    return values;
+}
+
+/// @brief Record of the history file, copied into the mapping as is.
+///
+/// Strings are NUL-padded and truncated to their field.
+struct Record {
+    /// Index of the record plus one, 0 while the record is being written
+    std::uint64_t seq{};
+    /// CLOCK_REALTIME, to correlate with logs of other tools
+    std::int64_t timestamp_ns{};
+    RecordKind kind{};
+    Source source{};
+    /// SchedMode, or kNoMode
+    std::uint8_t sched_mode{kNoMode};
+    std::array<std::uint8_t, 5> reserved{};
+    /// Scheduler switched to, or root/ops of the state change
+    std::array<char, 24> scheduler{};
+    /// Reason of the transition, or sched_ext state
+    std::array<char, 24> text{};
+    MetricValues metrics{};
+
+    static constexpr std::uint8_t kNoMode = 0xff;
+
+    [[nodiscard]] auto scheduler_name() const noexcept -> std::string_view;
+    [[nodiscard]] auto text_view() const noexcept -> std::string_view;
+    [[nodiscard]] auto mode() const noexcept -> std::optional<SchedMode>;
+    [[nodiscard]] auto metric(Metric metric) const noexcept -> std::optional<double>;
+};
+
+static_assert(std::is_trivially_copyable_v<Record>);
+static_assert(sizeof(Record) == 96);
+
+auto make_transition(Source source, std::string_view scx_sched, std::optional<SchedMode> sched_mode, std::string_view reason) noexcept -> Record;
+auto make_state_change(std::string_view state, std::string_view ops) noexcept -> Record;
+auto make_metric_sample(std::string_view scx_sched, const MetricValues& values) noexcept -> Record;
+
+/// @brief Formats the record as a line of the dump, e.g "2025-01-31 12:00:00.120 transition gui scx_lavd gaming apply".
+auto format_record(const Record& record) -> std::string;
+
+/// @brief Returns $XDG_STATE_HOME/scx-manager/history.bin, or the same under ~/.local/state.
+auto default_history_path() -> std::optional<std::string>;
+
+/// @brief Reads the metrics every process can read, i.e CPU pressure and load per CPU.
+class MetricSampler final {
+ public:
+    MetricSampler() noexcept;
+
+    void sample(MetricValues& values) noexcept;
+
+ private:
+    SysfsFile m_pressure_file{"/proc/pressure/cpu"};
+    SysfsFile m_loadavg_file{"/proc/loadavg"};
+    std::array<char, 256> m_read_buf{};
+    double m_cpu_count{1.};
+};
+
+/// @brief Fixed-size ring of records in a memory-mapped file, shared by the processes.
+///
+/// The window, scx-manager-cli and scx-policy-daemon append to the same file.
+/// Appending claims a slot with an atomic increment of the head in the file
+/// header, and copies the record into the mapping, without any syscall. Each
+/// record is guarded by its sequence like a seqlock, so the readers skip the
+/// records being written or overwritten while they read.
+class HistoryLog final {
+ public:
+    static constexpr std::uint64_t kDefaultCapacity = 8192;
+
+    HistoryLog() = default;
+    ~HistoryLog() noexcept;
+
+    HistoryLog(const HistoryLog&)                    = delete;
+    auto operator=(const HistoryLog&) -> HistoryLog& = delete;
+
+    /// @brief Maps the file, creating it with the capacity if needed.
+    ///
+    /// A file of an older format is recreated. Read-only opening never creates
+    /// or changes the file, and keeps the capacity the file was created with.
+    auto open(std::string_view file_path, bool writable = true, std::uint64_t capacity = kDefaultCapacity) noexcept -> bool;
+    void close() noexcept;
+
+    [[nodiscard]] auto is_open() const noexcept -> bool { return m_header != nullptr; }
+
+    /// @brief Appends the record, dropped if the log isn't open.
+    void append(const Record& record) noexcept;
+
+    /// @brief Returns how many records were ever appended, cheap to poll for new records.
+    [[nodiscard]] auto written() const noexcept -> std::uint64_t;
+
+    /// @brief Copies the records still in the ring, the oldest first.
+    [[nodiscard]] auto records() const -> std::vector<Record>;
+
+ private:
+    struct FileHeader;
+
+    static auto mapping_size(std::uint64_t capacity) noexcept -> std::size_t;
+    [[nodiscard]] auto slots() const noexcept -> Record*;
+
+    FileHeader* m_header{};
+    std::size_t m_mapping_size{};
+    bool m_writable{};
+};
+
+}  // namespace scx::history
+
+#endif  // SCX_HISTORY_HPP
@@ -0,0 +1,143 @@
+// Copyright (C) 2024-2025 Vladislav Nepogodin
+//
+// This file is part of CachyOS kernel manager.
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+#include "scx_kernel_stats.hpp"
+
+#include <algorithm>     // for find_if
+#include <charconv>      // for from_chars
+#include <string_view>   // for string_view
+#include <system_error>  // for errc
+
+namespace {
+
+struct ScalarCounter {
+    std::string_view name;
+    scx::KernelCounterKind kind;
+};
+
+// Files directly under /sys/kernel/sched_ext
+constexpr std::array kScalarCounters{
+    ScalarCounter{"enable_seq", scx::KernelCounterKind::Counter},
+    ScalarCounter{"hotplug_seq", scx::KernelCounterKind::Counter},
+    ScalarCounter{"nr_rejected", scx::KernelCounterKind::Counter},
+    ScalarCounter{"switch_all", scx::KernelCounterKind::Gauge},
+};
+
+constexpr auto trim_whitespace(std::string_view str) noexcept -> std::string_view {
+    constexpr std::string_view kWhitespace{" \t\r\n"};
+    const auto first = str.find_first_not_of(kWhitespace);
+    if (first == std::string_view::npos) {
+        return {};
+    }
+    const auto last = str.find_last_not_of(kWhitespace);
+    return str.substr(first, last - first + 1);
+}
+
+auto parse_u64(std::string_view str, std::uint64_t& value) noexcept -> bool {
+    str                 = trim_whitespace(str);
+    const auto* str_end = str.data() + str.size();
+    auto [ptr, ec]      = std::from_chars(str.data(), str_end, value);
+    return ec == std::errc{} && ptr == str_end;
+}
+
+}  // namespace
+
+namespace scx {
+
+KernelStatsSampler::KernelStatsSampler(std::string_view sched_ext_root) noexcept
+  : m_events_file(std::string{sched_ext_root} + "/root/events") {
+    m_counters.reserve(kMaxKernelCounters);
+    m_scalar_files.reserve(kScalarCounters.size());
+    for (auto&& scalar_counter : kScalarCounters) {
+        m_counters.emplace_back(KernelCounterInfo{.name = std::string{scalar_counter.name}, .kind = scalar_counter.kind});
+        m_scalar_files.emplace_back(std::string{sched_ext_root} + '/' + std::string{scalar_counter.name});
+    }
+}
+
+auto KernelStatsSampler::find_or_add_counter(std::string_view name) noexcept -> std::size_t {
+    auto counter_it = std::ranges::find_if(m_counters, [name](auto&& counter) { return counter.name == name; });
+    if (counter_it != m_counters.end()) {
+        return static_cast<std::size_t>(counter_it - m_counters.begin());
+    }
+    if (m_counters.size() >= kMaxKernelCounters) {
+        return kMaxKernelCounters;
+    }
+    // only allocates the first time the event is seen
+    m_counters.emplace_back(KernelCounterInfo{.name = std::string{name}, .kind = KernelCounterKind::Counter});
+    return m_counters.size() - 1;
+}
+
+void KernelStatsSampler::parse_events(std::string_view content, KernelStatsSample& sample) noexcept {
+    // each line is "SCX_EV_NAME value", older kernels used "SCX_EV_NAME: value"
+    while (!content.empty()) {
+        const auto line_end = content.find('\n');
+        const auto line     = content.substr(0, line_end);
+        content.remove_prefix(line_end == std::string_view::npos ? content.size() : line_end + 1);
+
+        const auto sep_pos = line.find_first_of(" :\t");
+        if (sep_pos == std::string_view::npos) {
+            continue;
+        }
+        auto name      = line.substr(0, sep_pos);
+        auto value_str = line.substr(sep_pos + 1);
+        if (!value_str.empty() && value_str.front() == ':') {
+            value_str.remove_prefix(1);
+        }
+
+        std::uint64_t value{};
+        if (name.empty() || !parse_u64(value_str, value)) {
+            continue;
+        }
+        const auto counter_idx = find_or_add_counter(name);
+        if (counter_idx < kMaxKernelCounters) {
+            sample.values[counter_idx] = value;
+            sample.valid.set(counter_idx);
+        }
+    }
+}
+
+auto KernelStatsSampler::sample(KernelStatsSample& sample) noexcept -> bool {
+    sample.timestamp = std::chrono::steady_clock::now();
+    sample.valid.reset();
+
+    for (std::size_t idx = 0; idx < m_scalar_files.size(); ++idx) {
+        std::uint64_t value{};
+        if (parse_u64(m_scalar_files[idx].read(m_buffer), value)) {
+            sample.values[idx] = value;
+            sample.valid.set(idx);
+        }
+    }
+
+    // root/events exists only while a scheduler is attached
+    parse_events(m_events_file.read(m_buffer), sample);
+    return sample.valid.any();
+}
+
+auto KernelStatsSampler::rate(const KernelStatsSample& prev, const KernelStatsSample& curr, std::size_t counter_idx) noexcept -> double {
+    if (counter_idx >= kMaxKernelCounters || !prev.valid.test(counter_idx) || !curr.valid.test(counter_idx)) {
+        return 0.;
+    }
+    const auto elapsed = std::chrono::duration<double>(curr.timestamp - prev.timestamp).count();
+    // counters are reset when scheduler is reattached
+    if (elapsed <= 0. || curr.values[counter_idx] < prev.values[counter_idx]) {
+        return 0.;
+    }
+    return static_cast<double>(curr.values[counter_idx] - prev.values[counter_idx]) / elapsed;
+}
+
+}  // namespace scx
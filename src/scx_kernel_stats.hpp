@@ -0,0 +1,96 @@
+// Copyright (C) 2024-2025 Vladislav Nepogodin
+//
+// This file is part of CachyOS kernel manager.
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+#ifndef SCX_KERNEL_STATS_HPP
+#define SCX_KERNEL_STATS_HPP
+
+#include "scx_sysfs.hpp"
+
+#include <array>
+#include <bitset>
+#include <chrono>
+#include <cstdint>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace scx {
+
+/// @brief Maximum number of counters tracked, including per-root events.
+inline constexpr std::size_t kMaxKernelCounters = 32;
+
+enum class KernelCounterKind : std::uint8_t {
+    /// Monotonic counter, shown as rate
+    Counter,
+    /// Current value, e.g switch_all
+    Gauge,
+};
+
+struct KernelCounterInfo {
+    std::string name;
+    KernelCounterKind kind{KernelCounterKind::Counter};
+};
+
+/// @brief Values of all counters at one point in time.
+///
+/// Index of the value matches the index of KernelStatsSampler::counters.
+struct KernelStatsSample {
+    std::chrono::steady_clock::time_point timestamp{};
+    std::array<std::uint64_t, kMaxKernelCounters> values{};
+    std::bitset<kMaxKernelCounters> valid{};
+};
+
+/// @brief Samples sched_ext health counters from sysfs.
+///
+/// Reads enable_seq, hotplug_seq, nr_rejected, switch_all and the per-root
+/// events file through descriptors kept open between samples. Parsing is done
+/// in place, once all the event names were seen, sampling doesn't allocate.
+class KernelStatsSampler final {
+ public:
+    explicit KernelStatsSampler(std::string_view sched_ext_root = "/sys/kernel/sched_ext") noexcept;
+
+    /// @brief Returns counters discovered so far.
+    ///
+    /// New events might appear after a scheduler is attached.
+    [[nodiscard]] auto counters() const noexcept -> std::span<const KernelCounterInfo> { return m_counters; }
+
+    /// @brief Number of counters read from the files directly under the root, the per-root events follow them.
+    [[nodiscard]] auto scalar_counter_count() const noexcept -> std::size_t { return m_scalar_files.size(); }
+
+    /// @brief Reads all counters into the sample.
+    ///
+    /// Returns false if nothing could be read, e.g kernel is built without sched_ext.
+    auto sample(KernelStatsSample& sample) noexcept -> bool;
+
+    /// @brief Returns rate per second of the counter between two samples.
+    static auto rate(const KernelStatsSample& prev, const KernelStatsSample& curr, std::size_t counter_idx) noexcept -> double;
+
+ private:
+    auto find_or_add_counter(std::string_view name) noexcept -> std::size_t;
+    void parse_events(std::string_view content, KernelStatsSample& sample) noexcept;
+
+    std::vector<KernelCounterInfo> m_counters{};
+    std::vector<SysfsFile> m_scalar_files{};
+    SysfsFile m_events_file;
+    std::array<char, 4096> m_buffer{};
+};
+
+}  // namespace scx
+
+#endif  // SCX_KERNEL_STATS_HPP
@@ -0,0 +1,225 @@
+// Copyright (C) 2024-2025 Vladislav Nepogodin
+//
+// This file is part of CachyOS kernel manager.
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+#include "scx_latency_probe.hpp"
+
+#include <algorithm>     // for max, sort, unique
+#include <cerrno>        // for EINTR
+#include <charconv>      // for from_chars
+#include <cstring>       // for strerror
+#include <system_error>  // for errc
+
+#include <pthread.h>  // for pthread_setaffinity_np
+#include <sched.h>    // for sched_getaffinity, CPU_SET
+#include <time.h>     // for clock_nanosleep
+
+#include <fmt/core.h>
+
+namespace {
+
+using namespace std::chrono_literals;  // NOLINT
+
+// Background load is restarted in chunks, so stopping doesn't wait for long
+constexpr auto kLoadChunkDuration = 250ms;
+
+auto monotonic_now_ns() noexcept -> std::int64_t {
+    timespec now{};
+    ::clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec * 1'000'000'000 + now.tv_nsec;
+}
+
+auto parse_cpu(std::string_view str, int& cpu) noexcept -> bool {
+    const auto* str_end = str.data() + str.size();
+    auto [ptr, ec]      = std::from_chars(str.data(), str_end, cpu);
+    return ec == std::errc{} && ptr == str_end && cpu >= 0 && cpu < CPU_SETSIZE;
+}
+
+void probe_cpu(std::stop_token stop_token, int cpu, std::chrono::nanoseconds interval, scx::HdrHistogram& histogram) noexcept {
+    cpu_set_t cpu_set;
+    CPU_ZERO(&cpu_set);
+    CPU_SET(static_cast<std::size_t>(cpu), &cpu_set);
+    if (const int ret = ::pthread_setaffinity_np(::pthread_self(), sizeof(cpu_set), &cpu_set); ret != 0) {
+        fmt::print(stderr, "Failed to pin latency probe to CPU {}: {}\n", cpu, std::strerror(ret));
+        return;
+    }
+
+    const auto interval_ns = interval.count();
+    auto deadline_ns       = monotonic_now_ns();
+    while (!stop_token.stop_requested()) {
+        deadline_ns += interval_ns;
+
+        const timespec deadline{.tv_sec = deadline_ns / 1'000'000'000, .tv_nsec = deadline_ns % 1'000'000'000};
+        while (::clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &deadline, nullptr) == EINTR) { }
+
+        const auto now_ns       = monotonic_now_ns();
+        const auto overshoot_ns = std::max<std::int64_t>(now_ns - deadline_ns, 0);
+        histogram.record(static_cast<std::uint64_t>(overshoot_ns));
+
+        // don't try to catch up with the missed wakeups, that would measure back-to-back wakeups
+        if (overshoot_ns > interval_ns) {
+            deadline_ns = now_ns;
+        }
+    }
+}
+
+auto summarize_histogram(int cpu, const scx::HdrHistogram& histogram) noexcept -> scx::CpuLatencySummary {
+    const auto to_ns = [](std::uint64_t value) { return std::chrono::nanoseconds{static_cast<std::int64_t>(value)}; };
+    return scx::CpuLatencySummary{
+        .cpu   = cpu,
+        .count = histogram.count(),
+        .p50   = to_ns(histogram.value_at_percentile(50.)),
+        .p99   = to_ns(histogram.value_at_percentile(99.)),
+        .p999  = to_ns(histogram.value_at_percentile(99.9)),
+        .max   = to_ns(histogram.max()),
+    };
+}
+
+}  // namespace
+
+namespace scx {
+
+auto parse_cpu_list(std::string_view cpu_list) noexcept -> std::optional<std::vector<int>> {
+    std::vector<int> cpus;
+    while (!cpu_list.empty()) {
+        const auto sep_pos = cpu_list.find(',');
+        const auto range   = cpu_list.substr(0, sep_pos);
+        cpu_list.remove_prefix(sep_pos == std::string_view::npos ? cpu_list.size() : sep_pos + 1);
+        if (range.empty()) {
+            continue;
+        }
+
+        int first_cpu{};
+        int last_cpu{};
+        if (const auto dash_pos = range.find('-'); dash_pos != std::string_view::npos) {
+            if (!parse_cpu(range.substr(0, dash_pos), first_cpu) || !parse_cpu(range.substr(dash_pos + 1), last_cpu) || first_cpu > last_cpu) {
+                return std::nullopt;
+            }
+        } else if (parse_cpu(range, first_cpu)) {
+            last_cpu = first_cpu;
+        } else {
+            return std::nullopt;
+        }
+        for (int cpu = first_cpu; cpu <= last_cpu; ++cpu) {
+            cpus.emplace_back(cpu);
+        }
+    }
+
+    std::ranges::sort(cpus);
+    const auto [first, last] = std::ranges::unique(cpus);
+    cpus.erase(first, last);
+    return cpus;
+}
+
+auto allowed_cpus() noexcept -> std::vector<int> {
+    std::vector<int> cpus;
+    cpu_set_t cpu_set;
+    CPU_ZERO(&cpu_set);
+    if (::sched_getaffinity(0, sizeof(cpu_set), &cpu_set) != 0) {
+        return cpus;
+    }
+    for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+        if (CPU_ISSET(static_cast<std::size_t>(cpu), &cpu_set)) {
+            cpus.emplace_back(cpu);
+        }
+    }
+    return cpus;
+}
+
+LatencyProbe::~LatencyProbe() noexcept {
+    stop();
+}
+
+auto LatencyProbe::start(const LatencyProbeOptions& options) noexcept -> bool {
+    stop();
+    m_cpu_probes.clear();
+
+    const auto cpus = options.cpus.empty() ? allowed_cpus() : options.cpus;
+    if (cpus.empty() || options.interval <= std::chrono::microseconds::zero()) {
+        return false;
+    }
+
+    try {
+        m_cpu_probes.reserve(cpus.size());
+        for (auto cpu : cpus) {
+            auto& cpu_probe  = m_cpu_probes.emplace_back(std::make_unique<CpuProbe>());
+            cpu_probe->cpu    = cpu;
+            cpu_probe->thread = std::jthread(probe_cpu, cpu, options.interval, std::ref(cpu_probe->histogram));
+        }
+        if (options.background_load) {
+            m_load_thread = std::jthread([workload = *options.background_load](std::stop_token stop_token) {
+                while (!stop_token.stop_requested()) {
+                    if (!bench::run_workload(workload, kLoadChunkDuration)) {
+                        break;
+                    }
+                }
+            });
+        }
+    } catch (const std::exception& e) {
+        fmt::print(stderr, "Failed to start latency probe: {}\n", e.what());
+        stop();
+        return false;
+    }
+    return true;
+}
+
+void LatencyProbe::stop() noexcept {
+    // request everything to stop first, to not wait for each thread in turn
+    for (auto& cpu_probe : m_cpu_probes) {
+        cpu_probe->thread.request_stop();
+    }
+    m_load_thread.request_stop();
+
+    for (auto& cpu_probe : m_cpu_probes) {
+        if (cpu_probe->thread.joinable()) {
+            cpu_probe->thread.join();
+        }
+    }
+    if (m_load_thread.joinable()) {
+        m_load_thread.join();
+    }
+}
+
+auto LatencyProbe::summaries() const noexcept -> std::vector<CpuLatencySummary> {
+    std::vector<CpuLatencySummary> summaries;
+    if (m_cpu_probes.empty()) {
+        return summaries;
+    }
+    summaries.reserve(m_cpu_probes.size() + 1);
+
+    auto merged_histogram = std::make_unique<HdrHistogram>();
+    for (auto&& cpu_probe : m_cpu_probes) {
+        summaries.emplace_back(summarize_histogram(cpu_probe->cpu, cpu_probe->histogram));
+        merged_histogram->merge(cpu_probe->histogram);
+    }
+    summaries.emplace_back(summarize_histogram(-1, *merged_histogram));
+    return summaries;
+}
+
+auto latency_summaries_to_csv(std::span<const CpuLatencySummary> summaries, std::string_view label, bool with_header) -> std::string {
+    const auto to_micros = [](std::chrono::nanoseconds duration) { return std::chrono::duration<double, std::micro>(duration).count(); };
+
+    std::string csv{with_header ? "label,cpu,samples,p50_us,p99_us,p999_us,max_us\n" : ""};
+    for (auto&& summary : summaries) {
+        const auto cpu = (summary.cpu < 0) ? std::string{"all"} : std::to_string(summary.cpu);
+        csv += fmt::format("{},{},{},{:.1f},{:.1f},{:.1f},{:.1f}\n", label, cpu, summary.count, to_micros(summary.p50),
+            to_micros(summary.p99), to_micros(summary.p999), to_micros(summary.max));
+    }
+    return csv;
+}
+
+}  // namespace scx
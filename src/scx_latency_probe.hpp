@@ -0,0 +1,104 @@
+// Copyright (C) 2024-2025 Vladislav Nepogodin
+//
+// This file is part of CachyOS kernel manager.
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+#ifndef SCX_LATENCY_PROBE_HPP
+#define SCX_LATENCY_PROBE_HPP
+
+#include "scx_bench_workloads.hpp"
+#include "scx_hdr_histogram.hpp"
+
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+namespace scx {
+
+/// @brief Parses list of CPUs in the kernel format, e.g "0-3,8".
+auto parse_cpu_list(std::string_view cpu_list) noexcept -> std::optional<std::vector<int>>;
+
+/// @brief Returns CPUs the process is allowed to run on.
+auto allowed_cpus() noexcept -> std::vector<int>;
+
+struct LatencyProbeOptions {
+    /// CPUs to measure, all allowed CPUs if empty
+    std::vector<int> cpus{};
+    /// Period of the wakeups
+    std::chrono::microseconds interval{1000};
+    /// Workload run in the background while measuring
+    std::optional<bench::Workload> background_load{};
+};
+
+/// @brief Wakeup latency percentiles of a CPU.
+struct CpuLatencySummary {
+    /// CPU number, or -1 for all measured CPUs
+    int cpu{-1};
+    std::uint64_t count{};
+    std::chrono::nanoseconds p50{};
+    std::chrono::nanoseconds p99{};
+    std::chrono::nanoseconds p999{};
+    std::chrono::nanoseconds max{};
+};
+
+/// @brief Measures wakeup latency in the cyclictest way.
+///
+/// One thread is pinned to each CPU, it sleeps until an absolute deadline
+/// and records how late it woke up into its own histogram. Threads run with
+/// the normal policy, so the latency reflects the sched_ext scheduler.
+/// Histograms are merged on demand, without stopping the measurement.
+class LatencyProbe final {
+ public:
+    LatencyProbe() = default;
+    ~LatencyProbe() noexcept;
+
+    LatencyProbe(const LatencyProbe&)                    = delete;
+    auto operator=(const LatencyProbe&) -> LatencyProbe& = delete;
+
+    /// @brief Starts measuring from scratch, stopping the previous run.
+    auto start(const LatencyProbeOptions& options) noexcept -> bool;
+
+    /// @brief Stops measuring, results of the run are kept.
+    void stop() noexcept;
+
+    [[nodiscard]] auto is_running() const noexcept -> bool { return !m_cpu_probes.empty() && m_cpu_probes.front()->thread.joinable(); }
+
+    /// @brief Returns per-CPU summaries, followed by the summary of all CPUs.
+    [[nodiscard]] auto summaries() const noexcept -> std::vector<CpuLatencySummary>;
+
+ private:
+    struct CpuProbe {
+        int cpu{};
+        HdrHistogram histogram{};
+        std::jthread thread{};
+    };
+
+    std::vector<std::unique_ptr<CpuProbe>> m_cpu_probes{};
+    std::jthread m_load_thread{};
+};
+
+/// @brief Formats summaries as CSV, labeled e.g by scheduler and mode.
+auto latency_summaries_to_csv(std::span<const CpuLatencySummary> summaries, std::string_view label, bool with_header = true) -> std::string;
+
+}  // namespace scx
+
+#endif  // SCX_LATENCY_PROBE_HPP
@@ -0,0 +1,280 @@
+// Copyright (C) 2024-2025 Vladislav Nepogodin
+//
+// This file is part of CachyOS kernel manager.
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+#include "scx_metrics.hpp"
+
+#include <algorithm>  // for min, find_if
+#include <cmath>      // for trunc
+#include <iterator>   // for back_inserter
+#include <span>       // for span
+
+namespace {
+
+using scx::metrics::MetricsFormat;
+
+enum class MetricType : std::uint8_t {
+    Gauge,
+    Counter,
+    Info,
+    Histogram,
+};
+
+constexpr std::array<std::string_view, scx::metrics::kRequestKindCount> kRequestKindNames{"apply", "disable", "persist"};
+constexpr std::array<std::string_view, scx::metrics::kRequestResultCount> kRequestResultNames{"succeeded", "failed", "canceled"};
+
+/// @brief Writes TYPE and HELP of the metric family.
+///
+/// The family name is the prefix followed by the name, so it isn't built in a temporary.
+/// Prometheus text format has no info type, and names counter families with the suffix.
+void write_header(fmt::memory_buffer& out, MetricsFormat format, MetricType type, std::string_view prefix, std::string_view name, std::string_view help) noexcept {
+    std::string_view type_name{};
+    std::string_view suffix{};
+    switch (type) {
+    case MetricType::Gauge:
+        type_name = "gauge";
+        break;
+    case MetricType::Counter:
+        type_name = "counter";
+        suffix    = (format == MetricsFormat::Prometheus) ? "_total" : "";
+        break;
+    case MetricType::Info:
+        type_name = (format == MetricsFormat::Prometheus) ? "gauge" : "info";
+        suffix    = (format == MetricsFormat::Prometheus) ? "_info" : "";
+        break;
+    case MetricType::Histogram:
+        type_name = "histogram";
+        break;
+    }
+    fmt::format_to(std::back_inserter(out), "# TYPE {0}{1}{2} {3}\n# HELP {0}{1}{2} {4}\n", prefix, name, suffix, type_name, help);
+}
+
+/// @brief Writes the label value, escaping backslashes, quotes and newlines.
+void write_label_value(fmt::memory_buffer& out, std::string_view value) noexcept {
+    for (const char value_char : value) {
+        switch (value_char) {
+        case '\\':
+            out.append(std::string_view{"\\\\"});
+            break;
+        case '"':
+            out.append(std::string_view{"\\\""});
+            break;
+        case '\n':
+            out.append(std::string_view{"\\n"});
+            break;
+        default:
+            out.push_back(value_char);
+            break;
+        }
+    }
+}
+
+/// @brief Writes the bucket bound in the canonical form, e.g "1.0" rather than "1".
+void write_bucket_bound(fmt::memory_buffer& out, double bound) noexcept {
+    if (std::trunc(bound) == bound) {
+        fmt::format_to(std::back_inserter(out), "{:.1f}", bound);
+    } else {
+        fmt::format_to(std::back_inserter(out), "{}", bound);
+    }
+}
+
+/// @brief Counts the duration in the first bucket it fits, or in the last one above all bounds.
+void record_duration(std::span<const double> bounds, std::span<std::uint64_t> buckets, double& sum_secs, std::chrono::nanoseconds duration) noexcept {
+    const auto duration_secs = std::chrono::duration<double>(duration).count();
+    std::size_t bucket_idx{};
+    while (bucket_idx < bounds.size() && duration_secs > bounds[bucket_idx]) {
+        ++bucket_idx;
+    }
+    ++buckets[bucket_idx];
+    sum_secs += duration_secs;
+}
+
+/// @brief Writes the cumulative buckets, sum and count of the histogram with a single label.
+void write_histogram(fmt::memory_buffer& out, std::string_view family, std::string_view label_name, std::string_view label_value,
+    std::span<const double> bounds, std::span<const std::uint64_t> buckets, double sum_secs) noexcept {
+    std::uint64_t cumulative_count{};
+    for (std::size_t bucket_idx = 0; bucket_idx < bounds.size(); ++bucket_idx) {
+        cumulative_count += buckets[bucket_idx];
+        fmt::format_to(std::back_inserter(out), "{}_bucket{{{}=\"", family, label_name);
+        write_label_value(out, label_value);
+        out.append(std::string_view{"\",le=\""});
+        write_bucket_bound(out, bounds[bucket_idx]);
+        fmt::format_to(std::back_inserter(out), "\"}} {}\n", cumulative_count);
+    }
+    cumulative_count += buckets.back();
+    fmt::format_to(std::back_inserter(out), "{}_bucket{{{}=\"", family, label_name);
+    write_label_value(out, label_value);
+    fmt::format_to(std::back_inserter(out), "\",le=\"+Inf\"}} {}\n{}_sum{{{}=\"", cumulative_count, family, label_name);
+    write_label_value(out, label_value);
+    fmt::format_to(std::back_inserter(out), "\"}} {}\n{}_count{{{}=\"", sum_secs, family, label_name);
+    write_label_value(out, label_value);
+    fmt::format_to(std::back_inserter(out), "\"}} {}\n", cumulative_count);
+}
+
+}  // namespace
+
+namespace scx::metrics {
+
+void RequestStats::record(RequestResult result, std::chrono::nanoseconds elapsed) noexcept {
+    ++results[static_cast<std::size_t>(result)];
+    record_duration(kRequestDurationBuckets, duration_buckets, duration_sum_secs, elapsed);
+}
+
+void SwitchStats::record(const SchedExtTransition& transition) noexcept {
+    if (const auto attach_latency = transition.attach_latency(); attach_latency) {
+        record_duration(kSwitchLatencyBuckets, attach_buckets, attach_sum_secs, *attach_latency);
+    }
+    if (const auto gap = transition.fair_class_gap(); gap) {
+        record_duration(kSwitchLatencyBuckets, gap_buckets, gap_sum_secs, *gap);
+    }
+}
+
+MetricsCollector::MetricsCollector(std::string_view sched_ext_root) noexcept
+  : m_kernel_stats(sched_ext_root), m_state_file(std::string{sched_ext_root} + "/state") { }
+
+void MetricsCollector::set_scheduler(std::string_view scx_sched, std::optional<SchedMode> sched_mode) noexcept {
+    // only changes with the scheduler, the capacity is reused
+    m_scx_sched.assign(scx_sched);
+    m_sched_mode = sched_mode;
+}
+
+void MetricsCollector::record_request(loader::ApplyRequest::Kind kind, RequestResult result, std::chrono::nanoseconds elapsed) noexcept {
+    const auto kind_idx = static_cast<std::size_t>(kind);
+    if (kind_idx < m_request_stats.size()) {
+        m_request_stats[kind_idx].record(result, elapsed);
+    }
+}
+
+void MetricsCollector::record_switch(std::string_view scx_sched, const SchedExtTransition& transition) noexcept {
+    if (!transition.attached_at) {
+        return;
+    }
+    auto switch_it = std::ranges::find_if(m_switch_stats, [scx_sched](auto&& switch_stats) { return switch_stats.scx_sched == scx_sched; });
+    if (switch_it == m_switch_stats.end()) {
+        switch_it = m_switch_stats.insert(m_switch_stats.end(), SwitchStats{.scx_sched = std::string{scx_sched}});
+    }
+    switch_it->record(transition);
+}
+
+auto MetricsCollector::render(MetricsFormat format) noexcept -> std::string_view {
+    m_out.clear();
+    auto out = std::back_inserter(m_out);
+
+    if (!m_scx_sched.empty()) {
+        write_header(m_out, format, MetricType::Info, "scx_scheduler", {}, "Running sched_ext scheduler and its mode, as reported by scx_loader.");
+        m_out.append(std::string_view{"scx_scheduler_info{scheduler=\""});
+        write_label_value(m_out, m_scx_sched);
+        m_out.append(std::string_view{"\",mode=\""});
+        write_label_value(m_out, m_sched_mode ? sched_mode_name(*m_sched_mode) : std::string_view{"unknown"});
+        m_out.append(std::string_view{"\"} 1\n"});
+    }
+
+    const auto state = m_state_file.read(m_state_buf);
+    if (!state.empty()) {
+        write_header(m_out, format, MetricType::Gauge, "scx_sched_ext_enabled", {}, "Whether a sched_ext scheduler is attached.");
+        fmt::format_to(out, "scx_sched_ext_enabled {}\n", state == "enabled" ? 1 : 0);
+    }
+
+    render_kernel_counters(format);
+    render_request_stats(format);
+    render_switch_stats(format);
+
+    if (format == MetricsFormat::OpenMetrics) {
+        m_out.append(std::string_view{"# EOF\n"});
+    }
+    return {m_out.data(), m_out.size()};
+}
+
+void MetricsCollector::render_kernel_counters(MetricsFormat format) noexcept {
+    if (!m_kernel_stats.sample(m_kernel_sample)) {
+        return;
+    }
+    auto out = std::back_inserter(m_out);
+
+    const auto counters     = m_kernel_stats.counters();
+    const auto scalar_count = std::min(m_kernel_stats.scalar_counter_count(), counters.size());
+    for (std::size_t counter_idx = 0; counter_idx < scalar_count; ++counter_idx) {
+        if (!m_kernel_sample.valid.test(counter_idx)) {
+            continue;
+        }
+        const auto& counter = counters[counter_idx];
+        const auto value    = m_kernel_sample.values[counter_idx];
+        if (counter.kind == KernelCounterKind::Gauge) {
+            write_header(m_out, format, MetricType::Gauge, "scx_sched_ext_", counter.name, "Value of the sched_ext attribute in sysfs.");
+            fmt::format_to(out, "scx_sched_ext_{} {}\n", counter.name, value);
+        } else {
+            write_header(m_out, format, MetricType::Counter, "scx_sched_ext_", counter.name, "Value of the sched_ext counter in sysfs.");
+            fmt::format_to(out, "scx_sched_ext_{}_total {}\n", counter.name, value);
+        }
+    }
+
+    // per-root events exist only while a scheduler is attached
+    bool has_events{};
+    for (std::size_t counter_idx = scalar_count; counter_idx < counters.size() && counter_idx < kMaxKernelCounters; ++counter_idx) {
+        if (!m_kernel_sample.valid.test(counter_idx)) {
+            continue;
+        }
+        if (!has_events) {
+            write_header(m_out, format, MetricType::Counter, "scx_sched_ext_events", {}, "Events of the attached sched_ext scheduler.");
+            has_events = true;
+        }
+        m_out.append(std::string_view{"scx_sched_ext_events_total{event=\""});
+        write_label_value(m_out, counters[counter_idx].name);
+        fmt::format_to(out, "\"}} {}\n", m_kernel_sample.values[counter_idx]);
+    }
+}
+
+void MetricsCollector::render_request_stats(MetricsFormat format) noexcept {
+    if (!m_has_request_stats) {
+        // always zero, rather than missing
+        return;
+    }
+    auto out = std::back_inserter(m_out);
+
+    write_header(m_out, format, MetricType::Counter, "scx_manager_requests", {}, "Scheduler changes requested through scx-manager, by result.");
+    for (std::size_t kind_idx = 0; kind_idx < m_request_stats.size(); ++kind_idx) {
+        for (std::size_t result_idx = 0; result_idx < kRequestResultCount; ++result_idx) {
+            fmt::format_to(out, "scx_manager_requests_total{{kind=\"{}\",result=\"{}\"}} {}\n", kRequestKindNames[kind_idx],
+                kRequestResultNames[result_idx], m_request_stats[kind_idx].results[result_idx]);
+        }
+    }
+
+    write_header(m_out, format, MetricType::Histogram, "scx_manager_request_duration_seconds", {}, "Time scheduler changes took, from the start until finished.");
+    for (std::size_t kind_idx = 0; kind_idx < m_request_stats.size(); ++kind_idx) {
+        const auto& request_stats = m_request_stats[kind_idx];
+        write_histogram(m_out, "scx_manager_request_duration_seconds", "kind", kRequestKindNames[kind_idx], kRequestDurationBuckets,
+            request_stats.duration_buckets, request_stats.duration_sum_secs);
+    }
+}
+
+void MetricsCollector::render_switch_stats(MetricsFormat format) noexcept {
+    if (m_switch_stats.empty()) {
+        return;
+    }
+    write_header(m_out, format, MetricType::Histogram, "scx_manager_switch_attach_seconds", {}, "Time from requesting the switch until the scheduler attached.");
+    for (auto&& switch_stats : m_switch_stats) {
+        write_histogram(m_out, "scx_manager_switch_attach_seconds", "scheduler", switch_stats.scx_sched, kSwitchLatencyBuckets,
+            switch_stats.attach_buckets, switch_stats.attach_sum_secs);
+    }
+    write_header(m_out, format, MetricType::Histogram, "scx_manager_switch_gap_seconds", {}, "Time tasks ran on the fair class between the old scheduler detaching and the new one attaching.");
+    for (auto&& switch_stats : m_switch_stats) {
+        write_histogram(m_out, "scx_manager_switch_gap_seconds", "scheduler", switch_stats.scx_sched, kSwitchLatencyBuckets,
+            switch_stats.gap_buckets, switch_stats.gap_sum_secs);
+    }
+}
+
+}  // namespace scx::metrics
@@ -0,0 +1,130 @@
+// Copyright (C) 2024-2025 Vladislav Nepogodin
+//
+// This file is part of CachyOS kernel manager.
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+#ifndef SCX_METRICS_HPP
+#define SCX_METRICS_HPP
+
+#include "scx_apply_executor.hpp"
+#include "scx_kernel_stats.hpp"
+#include "scx_switch_trace.hpp"
+#include "scx_sysfs.hpp"
+#include "scx_utils.hpp"
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <fmt/format.h>
+
+namespace scx::metrics {
+
+enum class MetricsFormat : std::uint8_t {
+    /// Served to the scrapers
+    OpenMetrics,
+    /// Prometheus text format, which node_exporter expects in the textfiles
+    Prometheus,
+};
+
+enum class RequestResult : std::uint8_t {
+    Succeeded,
+    Failed,
+    Canceled,
+};
+
+inline constexpr std::size_t kRequestResultCount = 3;
+/// Apply, disable and persist, as in ApplyRequest::Kind
+inline constexpr std::size_t kRequestKindCount = 3;
+
+/// Upper bounds of the request duration histogram, in seconds
+inline constexpr std::array kRequestDurationBuckets{0.1, 0.25, 0.5, 1., 2.5, 5., 10., 30.};
+/// Upper bounds of the switch latency histograms, in seconds
+inline constexpr std::array kSwitchLatencyBuckets{0.005, 0.01, 0.025, 0.05, 0.1, 0.25, 0.5, 1., 2.5};
+
+/// @brief Counts and latencies of the requests of a single kind.
+struct RequestStats {
+    std::array<std::uint64_t, kRequestResultCount> results{};
+    /// Non-cumulative, the last one counts requests above all bounds
+    std::array<std::uint64_t, kRequestDurationBuckets.size() + 1> duration_buckets{};
+    double duration_sum_secs{};
+
+    void record(RequestResult result, std::chrono::nanoseconds elapsed) noexcept;
+};
+
+/// @brief Switch latencies of the scheduler switched to.
+struct SwitchStats {
+    std::string scx_sched{};
+    /// Non-cumulative, as the request durations
+    std::array<std::uint64_t, kSwitchLatencyBuckets.size() + 1> gap_buckets{};
+    double gap_sum_secs{};
+    std::array<std::uint64_t, kSwitchLatencyBuckets.size() + 1> attach_buckets{};
+    double attach_sum_secs{};
+
+    void record(const SchedExtTransition& transition) noexcept;
+};
+
+/// @brief Collects scheduler state, sched_ext counters and request stats, and renders them as text.
+///
+/// Sysfs is read through descriptors kept open, and the text is rendered into a buffer
+/// reused between scrapes, so once it has grown to the size of the output and all
+/// the kernel events were seen, rendering doesn't allocate.
+class MetricsCollector final {
+ public:
+    explicit MetricsCollector(std::string_view sched_ext_root = "/sys/kernel/sched_ext") noexcept;
+
+    /// @brief Scheduler reported by scx_loader, empty if none is running.
+    void set_scheduler(std::string_view scx_sched, std::optional<SchedMode> sched_mode) noexcept;
+
+    /// @brief Renders the request stats from now on, they are only known to the process making the requests.
+    void enable_request_stats() noexcept { m_has_request_stats = true; }
+
+    void record_request(loader::ApplyRequest::Kind kind, RequestResult result, std::chrono::nanoseconds elapsed) noexcept;
+
+    /// @brief Records the switch, allocates only the first time the scheduler is seen.
+    void record_switch(std::string_view scx_sched, const SchedExtTransition& transition) noexcept;
+
+    /// @brief Samples sysfs and renders all metrics.
+    ///
+    /// The view is valid until the next call.
+    auto render(MetricsFormat format) noexcept -> std::string_view;
+
+ private:
+    void render_kernel_counters(MetricsFormat format) noexcept;
+    void render_request_stats(MetricsFormat format) noexcept;
+    void render_switch_stats(MetricsFormat format) noexcept;
+
+    KernelStatsSampler m_kernel_stats;
+    KernelStatsSample m_kernel_sample{};
+    SysfsFile m_state_file;
+    std::array<char, 64> m_state_buf{};
+
+    std::string m_scx_sched{};
+    std::optional<SchedMode> m_sched_mode{};
+    bool m_has_request_stats{};
+    std::array<RequestStats, kRequestKindCount> m_request_stats{};
+    std::vector<SwitchStats> m_switch_stats{};
+
+    fmt::memory_buffer m_out{};
+};
+
+}  // namespace scx::metrics
+
+#endif  // SCX_METRICS_HPP
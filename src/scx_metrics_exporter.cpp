@@ -0,0 +1,402 @@
+// Copyright (C) 2024-2025 Vladislav Nepogodin
+//
+// This file is part of CachyOS kernel manager.
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+#include "scx_metrics_exporter.hpp"
+#include "scx_state_watcher.hpp"
+
+#include <algorithm>     // for min
+#include <cerrno>        // for errno
+#include <charconv>      // for from_chars
+#include <cstdio>        // for rename
+#include <cstring>       // for strerror, memcpy
+#include <string>        // for string
+#include <system_error>  // for errc
+
+#include <arpa/inet.h>   // for inet_pton, htonl, ntohl, htons
+#include <fcntl.h>       // for open
+#include <netinet/in.h>  // for sockaddr_in
+#include <poll.h>        // for poll
+#include <sys/socket.h>  // for socket, bind, listen, accept4, sendmsg
+#include <sys/stat.h>    // for stat
+#include <sys/uio.h>     // for iovec
+#include <sys/un.h>      // for sockaddr_un
+#include <unistd.h>      // for close, write, unlink
+
+#include <fmt/core.h>
+
+#if defined(__clang__)
+#pragma clang diagnostic push
+#pragma clang diagnostic ignored "-Wold-style-cast"
+#elif defined(__GNUC__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wnull-dereference"
+#pragma GCC diagnostic ignored "-Wuseless-cast"
+#pragma GCC diagnostic ignored "-Wold-style-cast"
+#pragma GCC diagnostic ignored "-Wsuggest-final-types"
+#pragma GCC diagnostic ignored "-Wsuggest-attribute=pure"
+#pragma GCC diagnostic ignored "-Wconversion"
+#endif
+
+#include <QSocketNotifier>
+#include <QTimer>
+#include <QtConcurrent/QtConcurrentRun>
+
+#if defined(__clang__)
+#pragma clang diagnostic pop
+#elif defined(__GNUC__)
+#pragma GCC diagnostic pop
+#endif
+
+namespace {
+
+using scx::metrics::ListenAddress;
+
+constexpr int kListenBacklog = 16;
+// Bound on the time a slow client can block the event loop while the response is sent
+constexpr int kSendTimeoutMs = 1000;
+
+constexpr std::string_view kOpenMetricsContentType{"application/openmetrics-text; version=1.0.0; charset=utf-8"};
+constexpr std::string_view kPrometheusContentType{"text/plain; version=0.0.4; charset=utf-8"};
+
+auto open_listen_socket(const ListenAddress& address) noexcept -> int {
+    const bool is_unix = !address.unix_path.empty();
+    const int listen_fd = ::socket(is_unix ? AF_UNIX : AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (listen_fd < 0) {
+        fmt::print(stderr, "metrics: failed to open socket: {}\n", std::strerror(errno));
+        return -1;
+    }
+
+    int bind_result{};
+    if (is_unix) {
+        // socket left behind by the previous run
+        struct stat path_stat{};
+        if (::stat(address.unix_path.c_str(), &path_stat) == 0 && S_ISSOCK(path_stat.st_mode)) {
+            ::unlink(address.unix_path.c_str());
+        }
+        sockaddr_un addr{};
+        addr.sun_family = AF_UNIX;
+        std::memcpy(addr.sun_path, address.unix_path.data(), address.unix_path.size());
+        bind_result = ::bind(listen_fd, reinterpret_cast<const sockaddr*>(&addr), sizeof(addr));
+    } else {
+        const int reuse_addr = 1;
+        ::setsockopt(listen_fd, SOL_SOCKET, SO_REUSEADDR, &reuse_addr, sizeof(reuse_addr));
+        sockaddr_in addr{};
+        addr.sin_family      = AF_INET;
+        addr.sin_addr.s_addr = htonl(address.ipv4_addr);
+        addr.sin_port        = htons(address.port);
+        bind_result          = ::bind(listen_fd, reinterpret_cast<const sockaddr*>(&addr), sizeof(addr));
+    }
+    if (bind_result < 0 || ::listen(listen_fd, kListenBacklog) < 0) {
+        fmt::print(stderr, "metrics: failed to listen: {}\n", std::strerror(errno));
+        ::close(listen_fd);
+        return -1;
+    }
+    return listen_fd;
+}
+
+/// @brief Sends the header and the body, waiting for the socket to drain if needed.
+auto send_response(int fd, std::string_view header, std::string_view body) noexcept -> bool {
+    std::array<iovec, 2> iov{
+        iovec{.iov_base = const_cast<char*>(header.data()), .iov_len = header.size()},
+        iovec{.iov_base = const_cast<char*>(body.data()), .iov_len = body.size()},
+    };
+    std::size_t iov_idx{};
+    while (iov_idx < iov.size()) {
+        msghdr msg{};
+        msg.msg_iov    = &iov[iov_idx];
+        msg.msg_iovlen = iov.size() - iov_idx;
+        const auto sent = ::sendmsg(fd, &msg, MSG_NOSIGNAL);
+        if (sent < 0) {
+            pollfd poll_fd{.fd = fd, .events = POLLOUT, .revents = 0};
+            if ((errno != EAGAIN && errno != EINTR) || ::poll(&poll_fd, 1, kSendTimeoutMs) <= 0) {
+                return false;
+            }
+            continue;
+        }
+        auto sent_left = static_cast<std::size_t>(sent);
+        while (iov_idx < iov.size() && sent_left >= iov[iov_idx].iov_len) {
+            sent_left -= iov[iov_idx].iov_len;
+            ++iov_idx;
+        }
+        if (iov_idx < iov.size()) {
+            iov[iov_idx].iov_base = static_cast<char*>(iov[iov_idx].iov_base) + sent_left;
+            iov[iov_idx].iov_len -= sent_left;
+        }
+    }
+    return true;
+}
+
+/// @brief Whether the header block of the request contains the value, case-sensitive.
+auto request_accepts(std::string_view request, std::string_view content_type) noexcept -> bool {
+    // "Accept: application/openmetrics-text;version=1.0.0,text/plain;version=0.0.4;q=0.5,*/*;q=0.1"
+    return request.find(content_type) != std::string_view::npos;
+}
+
+auto write_file(const std::string& file_path, std::string_view content) noexcept -> bool {
+    const int file_fd = ::open(file_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);  // NOLINT
+    if (file_fd < 0) {
+        fmt::print(stderr, "metrics: failed to open {}: {}\n", file_path, std::strerror(errno));
+        return false;
+    }
+    while (!content.empty()) {
+        const auto written = ::write(file_fd, content.data(), content.size());
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            fmt::print(stderr, "metrics: failed to write {}: {}\n", file_path, std::strerror(errno));
+            break;
+        }
+        content.remove_prefix(static_cast<std::size_t>(written));
+    }
+    ::close(file_fd);
+    return content.empty();
+}
+
+}  // namespace
+
+namespace scx::metrics {
+
+auto parse_listen_address(std::string_view address) noexcept -> std::optional<ListenAddress> {
+    if (address.starts_with("unix:")) {
+        address.remove_prefix(5);
+        if (address.empty() || address.size() >= sizeof(sockaddr_un::sun_path)) {
+            return std::nullopt;
+        }
+        return ListenAddress{.unix_path = std::string{address}};
+    }
+
+    // port alone is served on localhost only
+    ListenAddress listen_address{.ipv4_addr = INADDR_LOOPBACK};
+    const auto port_sep = address.rfind(':');
+    if (port_sep != std::string_view::npos) {
+        const std::string host{address.substr(0, port_sep)};
+        in_addr host_addr{};
+        if (::inet_pton(AF_INET, host.c_str(), &host_addr) != 1) {
+            return std::nullopt;
+        }
+        listen_address.ipv4_addr = ntohl(host_addr.s_addr);
+        address.remove_prefix(port_sep + 1);
+    }
+
+    const auto* address_end = address.data() + address.size();
+    auto [ptr, ec]          = std::from_chars(address.data(), address_end, listen_address.port);
+    if (ec != std::errc{} || ptr != address_end || listen_address.port == 0) {
+        return std::nullopt;
+    }
+    return listen_address;
+}
+
+MetricsExporter::MetricsExporter(loader::Config& config, StateWatcher& state_watcher, ExporterConfig exporter_config, QObject* parent)
+  : QObject(parent), m_config(config), m_exporter_config(std::move(exporter_config)), m_sweep_timer(new QTimer(this)), m_textfile_timer(new QTimer(this)) {
+    m_snapshot_pool.setMaxThreadCount(1);
+    on_loader_state_changed();
+    connect(&state_watcher, &StateWatcher::loader_state_changed, this, &MetricsExporter::on_loader_state_changed);
+    // scheduler ejected by the kernel isn't reported by scx_loader
+    connect(&state_watcher, &StateWatcher::scheduler_changed, this, &MetricsExporter::on_loader_state_changed);
+
+    if (m_exporter_config.listen) {
+        m_listen_fd = open_listen_socket(*m_exporter_config.listen);
+    }
+    if (m_listen_fd >= 0) {
+        m_listen_notifier = new QSocketNotifier(m_listen_fd, QSocketNotifier::Read, this);
+        connect(m_listen_notifier, &QSocketNotifier::activated, this, &MetricsExporter::on_accept);
+
+        for (std::size_t client_idx = 0; client_idx < m_clients.size(); ++client_idx) {
+            auto* notifier = new QSocketNotifier(QSocketNotifier::Read, this);
+            notifier->setEnabled(false);
+            connect(notifier, &QSocketNotifier::activated, this, [this, client_idx] { on_client_readable(client_idx); });
+            m_clients[client_idx].notifier = notifier;
+        }
+        m_sweep_timer->setInterval(std::chrono::seconds{1});
+        connect(m_sweep_timer, &QTimer::timeout, this, &MetricsExporter::on_sweep);
+    }
+
+    if (!m_exporter_config.textfile_path.empty()) {
+        // node_exporter only reads *.prom files, the temporary one is skipped
+        m_textfile_tmp_path = m_exporter_config.textfile_path + ".tmp";
+        m_textfile_timer->setInterval(m_exporter_config.textfile_interval);
+        connect(m_textfile_timer, &QTimer::timeout, this, &MetricsExporter::write_textfile);
+        m_textfile_timer->start();
+        write_textfile();
+    }
+}
+
+MetricsExporter::~MetricsExporter() {
+    for (auto& client : m_clients) {
+        close_client(client);
+    }
+    if (m_listen_fd >= 0) {
+        ::close(m_listen_fd);
+        if (!m_exporter_config.listen->unix_path.empty()) {
+            ::unlink(m_exporter_config.listen->unix_path.c_str());
+        }
+    }
+}
+
+void MetricsExporter::attach(loader::ApplyExecutor& executor) noexcept {
+    m_collector.enable_request_stats();
+    connect(&executor, &loader::ApplyExecutor::finished, this,
+        [this](const loader::ApplyRequest& request, bool succeeded, bool canceled, std::chrono::nanoseconds elapsed) {
+            const auto result = canceled ? RequestResult::Canceled : (succeeded ? RequestResult::Succeeded : RequestResult::Failed);
+            m_collector.record_request(request.kind, result, elapsed);
+        });
+    connect(&executor, &loader::ApplyExecutor::traced, this, [this](const loader::ApplyRequest& request, const loader::ApplyTrace& trace) {
+        if (request.kind == loader::ApplyRequest::Kind::Apply) {
+            m_collector.record_switch(request.scx_sched, trace.transition);
+        }
+    });
+}
+
+void MetricsExporter::write_textfile() noexcept {
+    if (m_textfile_tmp_path.empty()) {
+        return;
+    }
+    // node_exporter must never see a partially written file
+    if (!write_file(m_textfile_tmp_path, m_collector.render(MetricsFormat::Prometheus))) {
+        return;
+    }
+    if (::rename(m_textfile_tmp_path.c_str(), m_exporter_config.textfile_path.c_str()) < 0) {
+        fmt::print(stderr, "metrics: failed to replace {}: {}\n", m_exporter_config.textfile_path, std::strerror(errno));
+    }
+}
+
+void MetricsExporter::on_loader_state_changed() noexcept {
+    if (m_is_snapshot_running) {
+        m_is_snapshot_stale = true;
+        return;
+    }
+    m_is_snapshot_running = true;
+    // blocks on D-Bus, and the exporter may live on the GUI thread
+    QtConcurrent::run(&m_snapshot_pool, [&config = m_config] { return config.get_loader_snapshot(); })
+        .then(this, [this](std::optional<loader::LoaderSnapshot> snapshot) { on_loader_snapshot(std::move(snapshot)); });
+}
+
+void MetricsExporter::on_loader_snapshot(std::optional<loader::LoaderSnapshot> snapshot) noexcept {
+    m_is_snapshot_running = false;
+    if (m_is_snapshot_stale) {
+        // this one is still newer than the last, the next one catches up
+        m_is_snapshot_stale = false;
+        on_loader_state_changed();
+    }
+    if (!snapshot || snapshot->current_sched == "unknown") {
+        m_collector.set_scheduler({}, std::nullopt);
+        return;
+    }
+    m_collector.set_scheduler(snapshot->current_sched, snapshot->current_sched.empty() ? std::nullopt : std::optional{snapshot->current_mode});
+}
+
+void MetricsExporter::on_accept() noexcept {
+    for (auto& client : m_clients) {
+        if (client.fd >= 0) {
+            continue;
+        }
+        client.fd = ::accept4(m_listen_fd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (client.fd < 0) {
+            // EAGAIN, no more pending connections
+            return;
+        }
+        client.request_len = 0;
+        client.accepted_at = std::chrono::steady_clock::now();
+        client.notifier->setSocket(client.fd);
+        client.notifier->setEnabled(true);
+        m_sweep_timer->start();
+    }
+    // all slots are busy, the rest waits in the backlog until one is freed
+    m_listen_notifier->setEnabled(false);
+}
+
+void MetricsExporter::on_client_readable(std::size_t client_idx) noexcept {
+    auto& client = m_clients[client_idx];
+    if (client.fd < 0) {
+        return;
+    }
+    const auto recv_len = ::recv(client.fd, client.request_buf.data() + client.request_len, client.request_buf.size() - client.request_len, 0);
+    if (recv_len < 0 && (errno == EAGAIN || errno == EINTR)) {
+        return;
+    }
+    if (recv_len <= 0) {
+        close_client(client);
+        return;
+    }
+    client.request_len += static_cast<std::size_t>(recv_len);
+
+    const std::string_view request{client.request_buf.data(), client.request_len};
+    if (request.find("\r\n\r\n") != std::string_view::npos || client.request_len == client.request_buf.size()) {
+        respond(client);
+        close_client(client);
+    }
+}
+
+void MetricsExporter::respond(Client& client) noexcept {
+    const std::string_view request{client.request_buf.data(), client.request_len};
+    // "GET /metrics HTTP/1.1"
+    const auto line_end = request.find("\r\n");
+    if (line_end == std::string_view::npos) {
+        send_response(client.fd, "HTTP/1.1 431 Request Header Fields Too Large\r\nConnection: close\r\nContent-Length: 0\r\n\r\n", {});
+        return;
+    }
+    const auto request_line = request.substr(0, line_end);
+    if (!request_line.starts_with("GET ")) {
+        send_response(client.fd, "HTTP/1.1 405 Method Not Allowed\r\nAllow: GET\r\nConnection: close\r\nContent-Length: 0\r\n\r\n", {});
+        return;
+    }
+    auto target = request_line.substr(4, request_line.find(' ', 4) - 4);
+    target      = target.substr(0, target.find('?'));
+    if (target != "/metrics" && target != "/") {
+        send_response(client.fd, "HTTP/1.1 404 Not Found\r\nConnection: close\r\nContent-Length: 0\r\n\r\n", {});
+        return;
+    }
+
+    // Prometheus text format for clients which don't ask for OpenMetrics, e.g curl
+    const bool is_open_metrics = request_accepts(request, "application/openmetrics-text");
+    const auto body            = m_collector.render(is_open_metrics ? MetricsFormat::OpenMetrics : MetricsFormat::Prometheus);
+
+    std::array<char, 256> header_buf{};
+    const auto header_end = fmt::format_to_n(header_buf.data(), header_buf.size(), "HTTP/1.1 200 OK\r\nContent-Type: {}\r\nContent-Length: {}\r\nConnection: close\r\n\r\n",
+        is_open_metrics ? kOpenMetricsContentType : kPrometheusContentType, body.size());
+    send_response(client.fd, {header_buf.data(), std::min(header_end.size, header_buf.size())}, body);
+}
+
+void MetricsExporter::close_client(Client& client) noexcept {
+    if (client.fd < 0) {
+        return;
+    }
+    client.notifier->setEnabled(false);
+    ::close(client.fd);
+    client.fd = -1;
+    if (m_listen_notifier) {
+        m_listen_notifier->setEnabled(true);
+    }
+}
+
+void MetricsExporter::on_sweep() noexcept {
+    const auto now = std::chrono::steady_clock::now();
+    bool has_clients{};
+    for (auto& client : m_clients) {
+        if (client.fd >= 0 && now - client.accepted_at > kClientTimeout) {
+            close_client(client);
+        }
+        has_clients |= client.fd >= 0;
+    }
+    if (!has_clients) {
+        m_sweep_timer->stop();
+    }
+}
+
+}  // namespace scx::metrics
@@ -0,0 +1,147 @@
+// Copyright (C) 2024-2025 Vladislav Nepogodin
+//
+// This file is part of CachyOS kernel manager.
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+#ifndef SCX_METRICS_EXPORTER_HPP
+#define SCX_METRICS_EXPORTER_HPP
+
+#include "scx_apply_executor.hpp"
+#include "scx_metrics.hpp"
+#include "scx_utils.hpp"
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+
+#if defined(__clang__)
+#pragma clang diagnostic push
+#pragma clang diagnostic ignored "-Wsign-conversion"
+#pragma clang diagnostic ignored "-Wshorten-64-to-32"
+#elif defined(__GNUC__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wuseless-cast"
+#pragma GCC diagnostic ignored "-Wsign-conversion"
+#pragma GCC diagnostic ignored "-Wconversion"
+#pragma GCC diagnostic ignored "-Wsuggest-final-methods"
+#pragma GCC diagnostic ignored "-Wsuggest-attribute=pure"
+#endif
+
+#include <QObject>
+#include <QThreadPool>
+
+#if defined(__clang__)
+#pragma clang diagnostic pop
+#elif defined(__GNUC__)
+#pragma GCC diagnostic pop
+#endif
+
+class QSocketNotifier;
+class QTimer;
+
+namespace scx {
+class StateWatcher;
+}  // namespace scx
+
+namespace scx::metrics {
+
+/// @brief Address the metrics are served on.
+struct ListenAddress {
+    /// Path of the Unix socket, empty for TCP
+    std::string unix_path{};
+    /// IPv4 address and port in host byte order
+    std::uint32_t ipv4_addr{};
+    std::uint16_t port{};
+};
+
+/// @brief Parses "unix:/path", "host:port" with IPv4 host, or a port on localhost.
+auto parse_listen_address(std::string_view address) noexcept -> std::optional<ListenAddress>;
+
+struct ExporterConfig {
+    std::optional<ListenAddress> listen{};
+    /// node_exporter textfile, replaced atomically at the interval
+    std::string textfile_path{};
+    std::chrono::seconds textfile_interval{15};
+};
+
+/// @brief Serves the metrics over HTTP, and writes them into node_exporter textfile.
+///
+/// Scrapes are answered from the event loop, a fixed number of clients is served
+/// at once with per-client buffers allocated upfront, further connections wait in
+/// the backlog. Scheduler and mode are queried from scx_loader on a worker thread,
+/// only when it reports a change, so scrapes don't cost a D-Bus round trip. Request
+/// stats are served only once an executor is attached, i.e from the window.
+class MetricsExporter final : public QObject {
+    Q_OBJECT
+    Q_DISABLE_COPY_MOVE(MetricsExporter)
+ public:
+    /// @brief Config and state watcher must outlive the exporter.
+    MetricsExporter(loader::Config& config, StateWatcher& state_watcher, ExporterConfig exporter_config, QObject* parent = nullptr);
+    ~MetricsExporter() override;
+
+    /// @brief Whether the listening socket is open.
+    [[nodiscard]] auto is_listening() const noexcept -> bool { return m_listen_fd >= 0; }
+
+    /// @brief Records and serves the requests run by the executor, which must outlive the exporter.
+    void attach(loader::ApplyExecutor& executor) noexcept;
+
+    /// @brief Writes the textfile, if configured.
+    void write_textfile() noexcept;
+
+ private:
+    static constexpr std::size_t kMaxClients       = 4;
+    static constexpr std::size_t kRequestBufSize   = 2048;
+    static constexpr std::chrono::seconds kClientTimeout{5};
+
+    struct Client {
+        int fd{-1};
+        QSocketNotifier* notifier{};
+        std::array<char, kRequestBufSize> request_buf{};
+        std::size_t request_len{};
+        std::chrono::steady_clock::time_point accepted_at{};
+    };
+
+    void on_accept() noexcept;
+    void on_client_readable(std::size_t client_idx) noexcept;
+    void respond(Client& client) noexcept;
+    void close_client(Client& client) noexcept;
+    void on_sweep() noexcept;
+    void on_loader_state_changed() noexcept;
+    void on_loader_snapshot(std::optional<loader::LoaderSnapshot> snapshot) noexcept;
+
+    loader::Config& m_config;
+    ExporterConfig m_exporter_config;
+    MetricsCollector m_collector;
+    std::string m_textfile_tmp_path{};
+    /// Reads the state of scx_loader, one snapshot at a time
+    QThreadPool m_snapshot_pool;
+    bool m_is_snapshot_running{};
+    /// State changed while the snapshot was read, it has to be read again
+    bool m_is_snapshot_stale{};
+
+    int m_listen_fd{-1};
+    QSocketNotifier* m_listen_notifier{};
+    std::array<Client, kMaxClients> m_clients{};
+    QTimer* m_sweep_timer{};
+    QTimer* m_textfile_timer{};
+};
+
+}  // namespace scx::metrics
+
+#endif  // SCX_METRICS_EXPORTER_HPP
@@ -0,0 +1,271 @@
+// Copyright (C) 2024-2025 Vladislav Nepogodin
+//
+// This file is part of CachyOS kernel manager.
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+#include "scx_perf_profile.hpp"
+#include "scx_latency_probe.hpp"
+#include "scx_sysfs.hpp"
+
+#include <algorithm>  // for find_if
+#include <cerrno>     // for errno
+#include <cstring>    // for strerror
+
+#include <linux/perf_event.h>  // for perf_event_attr
+#include <sys/ioctl.h>         // for ioctl
+#include <sys/syscall.h>       // for SYS_perf_event_open
+#include <unistd.h>            // for syscall, read, close
+
+#include <fmt/core.h>
+
+namespace {
+
+using scx::perf::kPerfCounterCount;
+
+struct CounterEvent {
+    std::uint32_t type;
+    std::uint64_t config;
+};
+
+// In the order of PerfCounter, leaders of the groups go first
+constexpr std::array<CounterEvent, kPerfCounterCount> kCounterEvents{{
+    {PERF_TYPE_SOFTWARE, PERF_COUNT_SW_TASK_CLOCK},
+    {PERF_TYPE_SOFTWARE, PERF_COUNT_SW_CONTEXT_SWITCHES},
+    {PERF_TYPE_SOFTWARE, PERF_COUNT_SW_CPU_MIGRATIONS},
+    {PERF_TYPE_SOFTWARE, PERF_COUNT_SW_PAGE_FAULTS},
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+}};
+
+// nr, time_enabled and time_running, followed by value and id of each counter
+constexpr std::size_t kGroupReadSize = 3 + (2 * kPerfCounterCount);
+
+constexpr std::size_t kSoftwareGroup = 0;
+constexpr std::size_t kHardwareGroup = 1;
+
+auto perf_event_open(perf_event_attr& attr, int cpu, int group_fd) noexcept -> int {
+    // system-wide, all tasks on the CPU
+    return static_cast<int>(::syscall(SYS_perf_event_open, &attr, -1, cpu, group_fd, PERF_FLAG_FD_CLOEXEC));
+}
+
+auto online_cpus() noexcept -> std::vector<int> {
+    std::array<char, 256> buf{};
+    scx::SysfsFile online_file("/sys/devices/system/cpu/online");
+    auto cpus = scx::parse_cpu_list(online_file.read(buf));
+    return cpus ? std::move(*cpus) : std::vector<int>{};
+}
+
+}  // namespace
+
+namespace scx::perf {
+
+auto perf_counter_name(PerfCounter counter) noexcept -> std::string_view {
+    switch (counter) {
+    case PerfCounter::TaskClock:
+        return "task-clock";
+    case PerfCounter::ContextSwitches:
+        return "context-switches";
+    case PerfCounter::CpuMigrations:
+        return "cpu-migrations";
+    case PerfCounter::PageFaults:
+        return "page-faults";
+    case PerfCounter::Cycles:
+        return "cycles";
+    case PerfCounter::Instructions:
+        return "instructions";
+    }
+    return "unknown";
+}
+
+auto PerfCounts::rate(PerfCounter counter) const noexcept -> std::optional<double> {
+    const auto counter_idx = static_cast<std::size_t>(counter);
+    if (!valid.test(counter_idx) || elapsed <= std::chrono::nanoseconds::zero()) {
+        return std::nullopt;
+    }
+    return static_cast<double>(values[counter_idx]) / std::chrono::duration<double>(elapsed).count();
+}
+
+auto PerfCounts::ipc() const noexcept -> std::optional<double> {
+    constexpr auto kCyclesIdx       = static_cast<std::size_t>(PerfCounter::Cycles);
+    constexpr auto kInstructionsIdx = static_cast<std::size_t>(PerfCounter::Instructions);
+    if (!valid.test(kCyclesIdx) || !valid.test(kInstructionsIdx) || values[kCyclesIdx] == 0) {
+        return std::nullopt;
+    }
+    return static_cast<double>(values[kInstructionsIdx]) / static_cast<double>(values[kCyclesIdx]);
+}
+
+void PerfCounts::add(const PerfCounts& other) noexcept {
+    for (std::size_t counter_idx = 0; counter_idx < kPerfCounterCount; ++counter_idx) {
+        values[counter_idx] += other.values[counter_idx];
+    }
+    valid |= other.valid;
+    elapsed += other.elapsed;
+}
+
+PerfProfiler::~PerfProfiler() noexcept {
+    close();
+}
+
+auto PerfProfiler::open(std::span<const int> cpus) noexcept -> bool {
+    close();
+
+    const auto all_cpus = cpus.empty() ? online_cpus() : std::vector<int>{};
+    if (cpus.empty()) {
+        cpus = all_cpus;
+    }
+    m_cpus.reserve(cpus.size());
+
+    int open_errno{};
+    for (const int cpu : cpus) {
+        if (auto cpu_counters = open_cpu(cpu, open_errno); cpu_counters) {
+            m_cpus.emplace_back(*cpu_counters);
+        }
+    }
+    if (m_cpus.empty()) {
+        fmt::print(stderr, "perf: cannot open counters: {}, perf_event_paranoid <= 0 or CAP_PERFMON is needed\n", std::strerror(open_errno));
+        return false;
+    }
+    m_sampled_at = std::chrono::steady_clock::now();
+    return true;
+}
+
+auto PerfProfiler::open_cpu(int cpu, int& open_errno) noexcept -> std::optional<CpuCounters> {
+    CpuCounters cpu_counters{.cpu = cpu};
+    for (std::size_t counter_idx = 0; counter_idx < kPerfCounterCount; ++counter_idx) {
+        const auto& event = kCounterEvents[counter_idx];
+        // a software counter in the hardware group would be scaled along with it, when the PMU is multiplexed
+        const auto group_idx = (event.type == PERF_TYPE_HARDWARE) ? kHardwareGroup : kSoftwareGroup;
+        auto& group          = cpu_counters.groups[group_idx];
+
+        perf_event_attr attr{};
+        attr.size        = sizeof(attr);
+        attr.type        = event.type;
+        attr.config      = event.config;
+        attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_ID | PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+        // the group is enabled at once through the leader
+        attr.disabled = group.leader_fd < 0;
+
+        const int counter_fd = perf_event_open(attr, cpu, group.leader_fd);
+        if (counter_fd < 0) {
+            if (group_idx == kSoftwareGroup && group.leader_fd < 0) {
+                open_errno = errno;
+                return std::nullopt;
+            }
+            // e.g no PMU in a VM, the group goes on without the counter
+            continue;
+        }
+        auto& counter = cpu_counters.counters[counter_idx];
+        counter.fd    = counter_fd;
+        ::ioctl(counter_fd, PERF_EVENT_IOC_ID, &counter.id);  // NOLINT
+        if (group.leader_fd < 0) {
+            group.leader_fd = counter_fd;
+        }
+    }
+    for (auto&& group : cpu_counters.groups) {
+        if (group.leader_fd >= 0) {
+            ::ioctl(group.leader_fd, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);  // NOLINT
+        }
+    }
+    return cpu_counters;
+}
+
+void PerfProfiler::close() noexcept {
+    for (auto&& cpu_counters : m_cpus) {
+        for (auto&& counter : cpu_counters.counters) {
+            if (counter.fd >= 0) {
+                ::close(counter.fd);
+            }
+        }
+    }
+    m_cpus.clear();
+}
+
+void PerfProfiler::set_label(std::string_view label) noexcept {
+    if (label == m_label) {
+        return;
+    }
+    if (is_open()) {
+        sample();
+    }
+    m_label.assign(label);
+}
+
+auto PerfProfiler::read_group(CpuCounters& cpu_counters, GroupState& group, PerfCounts& counts) noexcept -> bool {
+    std::array<std::uint64_t, kGroupReadSize> read_buf{};
+    const auto bytes_read = ::read(group.leader_fd, read_buf.data(), sizeof(read_buf));
+    if (bytes_read < static_cast<ssize_t>(3 * sizeof(std::uint64_t))) {
+        return false;
+    }
+    const auto nr_counters  = std::min<std::uint64_t>(read_buf[0], kPerfCounterCount);
+    const auto enabled_diff = read_buf[1] - group.time_enabled;
+    const auto running_diff = read_buf[2] - group.time_running;
+    group.time_enabled      = read_buf[1];
+    group.time_running      = read_buf[2];
+
+    // the hardware group may be multiplexed with other users of the PMU
+    const double scale = (running_diff != 0 && running_diff < enabled_diff) ? static_cast<double>(enabled_diff) / static_cast<double>(running_diff) : 1.;
+    for (std::size_t entry_idx = 0; entry_idx < nr_counters; ++entry_idx) {
+        const auto value      = read_buf[3 + (2 * entry_idx)];
+        const auto counter_id = read_buf[4 + (2 * entry_idx)];
+        auto counter_it       = std::ranges::find_if(cpu_counters.counters, [counter_id](auto&& counter) { return counter.fd >= 0 && counter.id == counter_id; });
+        if (counter_it == cpu_counters.counters.end()) {
+            continue;
+        }
+        const auto counter_idx = static_cast<std::size_t>(counter_it - cpu_counters.counters.begin());
+        const auto value_diff  = value - counter_it->value;
+        counter_it->value      = value;
+        counts.values[counter_idx] += static_cast<std::uint64_t>(static_cast<double>(value_diff) * scale);
+        counts.valid.set(counter_idx);
+    }
+    return true;
+}
+
+auto PerfProfiler::sample() noexcept -> bool {
+    if (!is_open()) {
+        return false;
+    }
+    PerfCounts counts{};
+    bool has_read{};
+    for (auto&& cpu_counters : m_cpus) {
+        for (auto&& group : cpu_counters.groups) {
+            if (group.leader_fd >= 0) {
+                has_read |= read_group(cpu_counters, group, counts);
+            }
+        }
+    }
+    const auto now = std::chrono::steady_clock::now();
+    counts.elapsed = now - m_sampled_at;
+    m_sampled_at   = now;
+    if (!has_read) {
+        return false;
+    }
+
+    m_last_counts = counts;
+    if (!m_label.empty()) {
+        find_or_add_profile(m_label).counts.add(counts);
+    }
+    return true;
+}
+
+auto PerfProfiler::find_or_add_profile(std::string_view label) noexcept -> PerfProfile& {
+    auto profile_it = std::ranges::find_if(m_profiles, [label](auto&& profile) { return profile.label == label; });
+    if (profile_it != m_profiles.end()) {
+        return *profile_it;
+    }
+    return m_profiles.emplace_back(PerfProfile{.label = std::string{label}});
+}
+
+}  // namespace scx::perf
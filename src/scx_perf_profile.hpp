@@ -0,0 +1,141 @@
+// Copyright (C) 2024-2025 Vladislav Nepogodin
+//
+// This file is part of CachyOS kernel manager.
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+#ifndef SCX_PERF_PROFILE_HPP
+#define SCX_PERF_PROFILE_HPP
+
+#include <array>
+#include <bitset>
+#include <chrono>
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace scx::perf {
+
+enum class PerfCounter : std::uint8_t {
+    /// Leader of the group, time tasks ran on the CPU
+    TaskClock,
+    ContextSwitches,
+    CpuMigrations,
+    PageFaults,
+    /// Hardware counters, only where the PMU is available
+    Cycles,
+    Instructions,
+};
+
+inline constexpr std::size_t kPerfCounterCount = 6;
+
+/// @brief Returns name of the counter as perf names it, e.g "context-switches".
+auto perf_counter_name(PerfCounter counter) noexcept -> std::string_view;
+
+/// @brief Counts of all the profiled CPUs over a span of time.
+struct PerfCounts {
+    std::array<std::uint64_t, kPerfCounterCount> values{};
+    /// Counters missing on the system, e.g without a PMU, are unset
+    std::bitset<kPerfCounterCount> valid{};
+    std::chrono::nanoseconds elapsed{};
+
+    /// @brief Returns the counter per second of the span.
+    [[nodiscard]] auto rate(PerfCounter counter) const noexcept -> std::optional<double>;
+    /// @brief Returns instructions per cycle, if both are counted.
+    [[nodiscard]] auto ipc() const noexcept -> std::optional<double>;
+
+    void add(const PerfCounts& other) noexcept;
+};
+
+/// @brief Counts accumulated while the scheduler was running, labeled e.g "scx_lavd (Gaming)".
+struct PerfProfile {
+    std::string label{};
+    PerfCounts counts{};
+};
+
+/// @brief Profiles the system cost of the running scheduler with system-wide perf counters.
+///
+/// Counters of a CPU are opened as two groups, software ones led by task-clock and
+/// hardware ones led by cycles. Each group is read with one read() and its counters
+/// cover the same time. Only the hardware group can be multiplexed with other users
+/// of the PMU, so the scaling doesn't touch the software counts.
+/// Counts are accumulated per scheduler and mode.
+/// Opening system-wide counters needs perf_event_paranoid <= 0 or CAP_PERFMON.
+class PerfProfiler final {
+ public:
+    PerfProfiler() = default;
+    ~PerfProfiler() noexcept;
+
+    PerfProfiler(const PerfProfiler&)                    = delete;
+    auto operator=(const PerfProfiler&) -> PerfProfiler& = delete;
+
+    /// @brief Opens the counters on the CPUs, all online CPUs if empty.
+    ///
+    /// Returns false if the software counters cannot be opened on any CPU.
+    auto open(std::span<const int> cpus = {}) noexcept -> bool;
+    void close() noexcept;
+
+    [[nodiscard]] auto is_open() const noexcept -> bool { return !m_cpus.empty(); }
+
+    /// @brief Sets the label the following counts are accounted to.
+    ///
+    /// Counts so far are sampled into the previous label first.
+    void set_label(std::string_view label) noexcept;
+
+    /// @brief Reads all groups and accounts the counts since the previous sample.
+    auto sample() noexcept -> bool;
+
+    /// @brief Counts of the last sampled span, e.g for the current rates.
+    [[nodiscard]] auto last_counts() const noexcept -> const PerfCounts& { return m_last_counts; }
+
+    [[nodiscard]] auto profiles() const noexcept -> const std::vector<PerfProfile>& { return m_profiles; }
+
+ private:
+    struct CounterState {
+        int fd{-1};
+        std::uint64_t id{};
+        std::uint64_t value{};
+    };
+
+    struct GroupState {
+        int leader_fd{-1};
+        std::uint64_t time_enabled{};
+        std::uint64_t time_running{};
+    };
+
+    struct CpuCounters {
+        int cpu{};
+        std::array<CounterState, kPerfCounterCount> counters{};
+        // the software group, then the hardware one
+        std::array<GroupState, 2> groups{};
+    };
+
+    auto open_cpu(int cpu, int& open_errno) noexcept -> std::optional<CpuCounters>;
+    auto read_group(CpuCounters& cpu_counters, GroupState& group, PerfCounts& counts) noexcept -> bool;
+    auto find_or_add_profile(std::string_view label) noexcept -> PerfProfile&;
+
+    std::vector<CpuCounters> m_cpus{};
+    std::chrono::steady_clock::time_point m_sampled_at{};
+    std::string m_label{};
+    PerfCounts m_last_counts{};
+    std::vector<PerfProfile> m_profiles{};
+};
+
+}  // namespace scx::perf
+
+#endif  // SCX_PERF_PROFILE_HPP
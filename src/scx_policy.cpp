@@ -0,0 +1,356 @@
+// Copyright (C) 2024-2025 Vladislav Nepogodin
+//
+// This file is part of CachyOS kernel manager.
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+#include "scx_policy.hpp"
+#include "scx_sysfs.hpp"
+
+#include <algorithm>     // for all_of, max
+#include <charconv>      // for from_chars
+#include <filesystem>    // for directory_iterator
+#include <system_error>  // for errc, error_code
+
+#include <fmt/core.h>
+
+#if defined(__clang__)
+#pragma clang diagnostic push
+#pragma clang diagnostic ignored "-Wold-style-cast"
+#pragma clang diagnostic ignored "-Wsign-conversion"
+#elif defined(__GNUC__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wnull-dereference"
+#pragma GCC diagnostic ignored "-Wuseless-cast"
+#pragma GCC diagnostic ignored "-Wold-style-cast"
+#pragma GCC diagnostic ignored "-Wsuggest-final-types"
+#pragma GCC diagnostic ignored "-Wsuggest-attribute=pure"
+#pragma GCC diagnostic ignored "-Wconversion"
+#pragma GCC diagnostic ignored "-Wsign-conversion"
+#endif
+
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+
+#if defined(__clang__)
+#pragma clang diagnostic pop
+#elif defined(__GNUC__)
+#pragma GCC diagnostic pop
+#endif
+
+namespace {
+
+using scx::policy::Condition;
+using scx::policy::Metric;
+
+constexpr std::array kMetricNames{
+    std::string_view{"cpu_some_avg10"},
+    std::string_view{"load_per_cpu"},
+    std::string_view{"load_trend"},
+    std::string_view{"on_battery"},
+};
+static_assert(kMetricNames.size() == scx::policy::kMetricCount);
+
+auto parse_double(std::string_view str, double& value) noexcept -> bool {
+    const auto* str_end = str.data() + str.size();
+    auto [ptr, ec]      = std::from_chars(str.data(), str_end, value);
+    return ec == std::errc{} && ptr == str_end;
+}
+
+auto exit_threshold(const Condition& condition) noexcept -> double {
+    return (condition.comparison == Condition::Comparison::Above) ? condition.threshold - condition.hysteresis
+                                                                   : condition.threshold + condition.hysteresis;
+}
+
+auto parse_condition(const QJsonObject& condition_obj, std::string& error_message) -> std::optional<Condition> {
+    const auto metric_name = condition_obj.value("metric").toString().toStdString();
+    const auto metric      = scx::policy::metric_from_name(metric_name);
+    if (!metric) {
+        error_message = fmt::format("unknown metric '{}'", metric_name);
+        return std::nullopt;
+    }
+
+    const bool has_above = condition_obj.value("above").isDouble();
+    const bool has_below = condition_obj.value("below").isDouble();
+    if (has_above == has_below) {
+        error_message = fmt::format("condition on '{}' needs either 'above' or 'below'", metric_name);
+        return std::nullopt;
+    }
+
+    Condition condition{
+        .metric     = *metric,
+        .comparison = has_above ? Condition::Comparison::Above : Condition::Comparison::Below,
+        .threshold  = condition_obj.value(has_above ? "above" : "below").toDouble(),
+        .hysteresis = condition_obj.value("hysteresis").toDouble(0.),
+    };
+    if (condition.hysteresis < 0.) {
+        error_message = fmt::format("hysteresis of '{}' is negative", metric_name);
+        return std::nullopt;
+    }
+    return condition;
+}
+
+}  // namespace
+
+namespace scx::policy {
+
+auto metric_name(Metric metric) noexcept -> std::string_view {
+    return kMetricNames[static_cast<std::size_t>(metric)];
+}
+
+auto metric_from_name(std::string_view name) noexcept -> std::optional<Metric> {
+    for (std::size_t metric_idx = 0; metric_idx < kMetricNames.size(); ++metric_idx) {
+        if (kMetricNames[metric_idx] == name) {
+            return static_cast<Metric>(metric_idx);
+        }
+    }
+    return std::nullopt;
+}
+
+auto Condition::holds(const Metrics& metrics, bool is_active) const noexcept -> bool {
+    const double value = metrics[metric];
+    const double limit = is_active ? exit_threshold(*this) : threshold;
+    return (comparison == Comparison::Above) ? value > limit : value < limit;
+}
+
+auto default_policy_config() -> PolicyConfig {
+    using Comparison = Condition::Comparison;
+
+    PolicyConfig config{};
+    config.rules = {
+        Rule{
+            .name       = "battery",
+            .mode       = SchedMode::PowerSave,
+            .conditions = {{.metric = Metric::OnBattery, .comparison = Comparison::Above, .threshold = 0.5}},
+        },
+        Rule{
+            .name       = "batch",
+            .mode       = SchedMode::Server,
+            .conditions = {
+                {.metric = Metric::LoadPerCpu, .comparison = Comparison::Above, .threshold = 0.9, .hysteresis = 0.2},
+                {.metric = Metric::LoadTrend, .comparison = Comparison::Above, .threshold = 0., .hysteresis = 0.1},
+            },
+        },
+        Rule{
+            .name       = "pressure",
+            .mode       = SchedMode::LowLatency,
+            .conditions = {{.metric = Metric::CpuSomeAvg10, .comparison = Comparison::Above, .threshold = 20., .hysteresis = 10.}},
+        },
+        Rule{.name = "default", .mode = SchedMode::Auto, .conditions = {}},
+    };
+    return config;
+}
+
+auto parse_policy_config(const QByteArray& json, std::string& error_message) -> std::optional<PolicyConfig> {
+    QJsonParseError parse_error{};
+    const auto json_doc = QJsonDocument::fromJson(json, &parse_error);
+    if (parse_error.error != QJsonParseError::NoError || !json_doc.isObject()) {
+        error_message = fmt::format("not a JSON object: {}", parse_error.errorString().toStdString());
+        return std::nullopt;
+    }
+    const auto root_obj = json_doc.object();
+
+    PolicyConfig config{};
+    config.min_dwell       = std::chrono::seconds(root_obj.value("min_dwell_secs").toInt(static_cast<int>(config.min_dwell.count())));
+    config.sample_interval = std::chrono::seconds(root_obj.value("sample_interval_secs").toInt(static_cast<int>(config.sample_interval.count())));
+    if (config.min_dwell.count() < 0 || config.sample_interval.count() <= 0) {
+        error_message = "min_dwell_secs and sample_interval_secs must be positive";
+        return std::nullopt;
+    }
+
+    if (const auto psi_obj = root_obj.value("psi_trigger").toObject(); !psi_obj.isEmpty()) {
+        config.psi_stall  = std::chrono::microseconds(psi_obj.value("stall_us").toInteger(config.psi_stall.count()));
+        config.psi_window = std::chrono::microseconds(psi_obj.value("window_us").toInteger(config.psi_window.count()));
+        if (config.psi_stall.count() <= 0 || config.psi_window <= config.psi_stall) {
+            error_message = "psi_trigger stall_us must be positive and shorter than window_us";
+            return std::nullopt;
+        }
+    }
+
+    const auto rules_array = root_obj.value("rules").toArray();
+    if (rules_array.isEmpty()) {
+        error_message = "no rules";
+        return std::nullopt;
+    }
+    for (auto&& rule_value : rules_array) {
+        const auto rule_obj  = rule_value.toObject();
+        const auto mode_name = rule_obj.value("mode").toString().toStdString();
+        const auto rule_mode = sched_mode_from_name(mode_name);
+        if (!rule_mode) {
+            error_message = fmt::format("unknown mode '{}'", mode_name);
+            return std::nullopt;
+        }
+
+        Rule rule{.name = rule_obj.value("name").toString(QString::fromUtf8(mode_name.data(), static_cast<qsizetype>(mode_name.size()))).toStdString(), .mode = *rule_mode, .conditions = {}};
+        for (auto&& condition_value : rule_obj.value("when").toArray()) {
+            auto condition = parse_condition(condition_value.toObject(), error_message);
+            if (!condition) {
+                error_message = fmt::format("rule '{}': {}", rule.name, error_message);
+                return std::nullopt;
+            }
+            rule.conditions.emplace_back(*condition);
+        }
+        config.rules.emplace_back(std::move(rule));
+    }
+    return config;
+}
+
+Engine::Engine(PolicyConfig config) noexcept
+  : m_config(std::move(config)) { }
+
+void Engine::set_current_mode(SchedMode mode, clock_t::time_point now) noexcept {
+    if (m_current_mode == mode) {
+        return;
+    }
+    if (m_current_mode) {
+        m_last_switch = now;
+    }
+    m_current_mode = mode;
+    if (m_active_rule && m_config.rules[*m_active_rule].mode != mode) {
+        m_active_rule.reset();
+    }
+}
+
+auto Engine::match(const Metrics& metrics) const noexcept -> std::optional<std::size_t> {
+    for (std::size_t rule_idx = 0; rule_idx < m_config.rules.size(); ++rule_idx) {
+        const bool is_active = (m_active_rule == rule_idx);
+        if (std::ranges::all_of(m_config.rules[rule_idx].conditions, [&](auto&& condition) { return condition.holds(metrics, is_active); })) {
+            return rule_idx;
+        }
+    }
+    return std::nullopt;
+}
+
+auto Engine::describe_trigger(std::size_t rule_idx, const Metrics& metrics) const -> std::string {
+    std::string trigger{};
+    const auto append = [&trigger](std::string&& part) {
+        trigger += trigger.empty() ? part : ", " + part;
+    };
+
+    const auto& rule = m_config.rules[rule_idx];
+    for (auto&& condition : rule.conditions) {
+        const bool is_above = (condition.comparison == Condition::Comparison::Above);
+        append(fmt::format("{}={:.2f} {} {:.2f}", metric_name(condition.metric), metrics[condition.metric], is_above ? '>' : '<', condition.threshold));
+    }
+    if (!rule.conditions.empty() || !m_active_rule) {
+        return trigger.empty() ? std::string{"fallback"} : trigger;
+    }
+
+    // the fallback was reached, because the previous rule has been released
+    const auto& prev_rule = m_config.rules[*m_active_rule];
+    for (auto&& condition : prev_rule.conditions) {
+        if (!condition.holds(metrics, true)) {
+            const bool is_above = (condition.comparison == Condition::Comparison::Above);
+            append(fmt::format("{}={:.2f} {} {:.2f}", metric_name(condition.metric), metrics[condition.metric], is_above ? "<=" : ">=", exit_threshold(condition)));
+        }
+    }
+    return fmt::format("'{}' released: {}", prev_rule.name, trigger);
+}
+
+auto Engine::evaluate(const Metrics& metrics, clock_t::time_point now) -> std::optional<Decision> {
+    const auto rule_idx = match(metrics);
+    if (!rule_idx) {
+        m_is_pending = false;
+        return std::nullopt;
+    }
+
+    const auto& rule = m_config.rules[*rule_idx];
+    if (m_current_mode == rule.mode) {
+        m_active_rule = rule_idx;
+        m_is_pending  = false;
+        return std::nullopt;
+    }
+    if (m_last_switch && now - *m_last_switch < m_config.min_dwell) {
+        // held back, re-evaluated once the dwell time passes
+        m_is_pending = true;
+        return std::nullopt;
+    }
+
+    m_is_pending = false;
+    return Decision{.rule_idx = *rule_idx, .mode = rule.mode, .trigger = describe_trigger(*rule_idx, metrics)};
+}
+
+void Engine::commit(const Decision& decision, clock_t::time_point now) noexcept {
+    m_active_rule  = decision.rule_idx;
+    m_current_mode = decision.mode;
+    m_last_switch  = now;
+}
+
+auto Engine::pending_delay(clock_t::time_point now) const noexcept -> std::optional<clock_t::duration> {
+    if (!m_is_pending || !m_last_switch) {
+        return std::nullopt;
+    }
+    return std::max<clock_t::duration>(*m_last_switch + m_config.min_dwell - now, clock_t::duration::zero());
+}
+
+auto parse_cpu_pressure(std::string_view content) noexcept -> std::optional<double> {
+    // "some avg10=1.23 avg60=0.50 avg300=0.10 total=12345"
+    constexpr std::string_view kSomePrefix{"some "};
+    constexpr std::string_view kAvg10Key{"avg10="};
+    if (!content.starts_with(kSomePrefix)) {
+        return std::nullopt;
+    }
+    const auto key_pos = content.find(kAvg10Key);
+    if (key_pos == std::string_view::npos) {
+        return std::nullopt;
+    }
+    auto value_str = content.substr(key_pos + kAvg10Key.size());
+    value_str      = value_str.substr(0, value_str.find_first_of(" \n"));
+
+    double value{};
+    if (!parse_double(value_str, value)) {
+        return std::nullopt;
+    }
+    return value;
+}
+
+auto parse_loadavg(std::string_view content) noexcept -> std::optional<std::array<double, 2>> {
+    // "0.52 0.58 0.59 1/467 12345"
+    std::array<double, 2> loadavg{};
+    for (auto& value : loadavg) {
+        const auto sep_pos = content.find(' ');
+        if (sep_pos == std::string_view::npos || !parse_double(content.substr(0, sep_pos), value)) {
+            return std::nullopt;
+        }
+        content.remove_prefix(sep_pos + 1);
+    }
+    return loadavg;
+}
+
+auto read_on_battery(std::string_view power_supply_root) noexcept -> bool {
+    bool has_battery{};
+    bool is_adapter_online{};
+
+    // the iterator throws on errors while advancing, unless it is given the error code
+    std::error_code err_code{};
+    for (std::filesystem::directory_iterator entry_it(power_supply_root, err_code); !err_code && entry_it != std::filesystem::directory_iterator{}; entry_it.increment(err_code)) {
+        const auto supply_path = entry_it->path().string();
+        std::array<char, 32> buffer{};
+
+        // batteries of the mice and keyboards don't power the machine
+        if (SysfsFile{supply_path + "/scope"}.read(buffer) == "Device") {
+            continue;
+        }
+        if (SysfsFile{supply_path + "/type"}.read(buffer) == "Battery") {
+            has_battery = true;
+        } else if (SysfsFile{supply_path + "/online"}.read(buffer) == "1") {
+            is_adapter_online = true;
+        }
+    }
+    return has_battery && !is_adapter_online;
+}
+
+}  // namespace scx::policy
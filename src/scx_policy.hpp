@@ -0,0 +1,168 @@
+// Copyright (C) 2024-2025 Vladislav Nepogodin
+//
+// This file is part of CachyOS kernel manager.
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+#ifndef SCX_POLICY_HPP
+#define SCX_POLICY_HPP
+
+#include "scx_utils.hpp"
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+class QByteArray;
+
+namespace scx::policy {
+
+/// @brief Metrics the rules are evaluated against.
+enum class Metric : std::uint8_t {
+    /// "some" CPU pressure over the last 10 seconds, in percents
+    CpuSomeAvg10,
+    /// 1-minute load average divided by the number of CPUs
+    LoadPerCpu,
+    /// Difference of 1-minute and 5-minute load averages per CPU, positive while load is rising
+    LoadTrend,
+    /// 1 while running on battery, 0 otherwise
+    OnBattery,
+};
+
+inline constexpr std::size_t kMetricCount = 4;
+
+auto metric_name(Metric metric) noexcept -> std::string_view;
+auto metric_from_name(std::string_view name) noexcept -> std::optional<Metric>;
+
+/// @brief Values of all metrics at one point in time.
+struct Metrics {
+    std::array<double, kMetricCount> values{};
+
+    [[nodiscard]] auto operator[](Metric metric) const noexcept -> double { return values[static_cast<std::size_t>(metric)]; }
+    [[nodiscard]] auto operator[](Metric metric) noexcept -> double& { return values[static_cast<std::size_t>(metric)]; }
+};
+
+/// @brief Threshold on a single metric.
+///
+/// Once the rule is active, the threshold is relaxed by the hysteresis,
+/// so the metric hovering around the threshold doesn't flip the mode back and forth.
+struct Condition {
+    enum class Comparison : std::uint8_t {
+        Above,
+        Below,
+    };
+
+    Metric metric{};
+    Comparison comparison{Comparison::Above};
+    double threshold{};
+    double hysteresis{};
+
+    [[nodiscard]] auto holds(const Metrics& metrics, bool is_active) const noexcept -> bool;
+};
+
+/// @brief Switches to the mode, while all of its conditions hold.
+struct Rule {
+    std::string name;
+    SchedMode mode{SchedMode::Auto};
+    /// Rule without conditions always matches, it is used as the fallback
+    std::vector<Condition> conditions;
+};
+
+struct PolicyConfig {
+    /// Ordered by priority, the first matching rule wins
+    std::vector<Rule> rules;
+    /// Minimal time between two mode switches
+    std::chrono::seconds min_dwell{120};
+    /// Interval of the load average sampling, it has no change notifications
+    std::chrono::seconds sample_interval{5};
+    /// PSI trigger on /proc/pressure/cpu: stall time within the window.
+    /// Unprivileged users need the window to be a multiple of 2 seconds.
+    std::chrono::microseconds psi_stall{150'000};
+    std::chrono::microseconds psi_window{2'000'000};
+};
+
+/// @brief Rules used if the user didn't provide any.
+///
+/// PowerSave on battery, Server under sustained load, LowLatency while CPU
+/// pressure is high, otherwise Auto.
+auto default_policy_config() -> PolicyConfig;
+
+/// @brief Parses user rules in JSON.
+///
+/// Returns nullopt and the reason in error_message if the rules are invalid.
+auto parse_policy_config(const QByteArray& json, std::string& error_message) -> std::optional<PolicyConfig>;
+
+/// @brief Mode switch decided by the engine.
+struct Decision {
+    std::size_t rule_idx{};
+    SchedMode mode{};
+    /// Metrics which triggered the switch, e.g "cpu_some_avg10=27.40 > 20.00"
+    std::string trigger;
+};
+
+/// @brief Picks the mode for the metrics, with hysteresis and minimal dwell time.
+class Engine final {
+ public:
+    using clock_t = std::chrono::steady_clock;
+
+    explicit Engine(PolicyConfig config) noexcept;
+
+    /// @brief Mode which is currently running, e.g read from scx_loader or changed by the user.
+    ///
+    /// Restarts the dwell time, unless it is the initial mode,
+    /// so the user's choice is kept at least as long as our own.
+    void set_current_mode(SchedMode mode, clock_t::time_point now) noexcept;
+
+    /// @brief Returns the switch to do, or nullopt if the mode should stay.
+    ///
+    /// The switch isn't considered done until it is committed, so a switch which
+    /// failed is decided again on the next evaluation.
+    auto evaluate(const Metrics& metrics, clock_t::time_point now) -> std::optional<Decision>;
+
+    /// @brief Records the switch once it went through, starting the dwell time.
+    void commit(const Decision& decision, clock_t::time_point now) noexcept;
+
+    /// @brief Time left until a switch held back by the dwell time may happen.
+    [[nodiscard]] auto pending_delay(clock_t::time_point now) const noexcept -> std::optional<clock_t::duration>;
+
+    [[nodiscard]] auto config() const noexcept -> const PolicyConfig& { return m_config; }
+
+ private:
+    auto match(const Metrics& metrics) const noexcept -> std::optional<std::size_t>;
+    auto describe_trigger(std::size_t rule_idx, const Metrics& metrics) const -> std::string;
+
+    PolicyConfig m_config;
+    std::optional<SchedMode> m_current_mode{};
+    std::optional<std::size_t> m_active_rule{};
+    std::optional<clock_t::time_point> m_last_switch{};
+    bool m_is_pending{};
+};
+
+/// @brief Parses "some avg10" out of /proc/pressure/cpu content.
+auto parse_cpu_pressure(std::string_view content) noexcept -> std::optional<double>;
+
+/// @brief Parses 1-minute and 5-minute load averages out of /proc/loadavg content.
+auto parse_loadavg(std::string_view content) noexcept -> std::optional<std::array<double, 2>>;
+
+/// @brief Whether the machine has a battery and no power adapter is online.
+auto read_on_battery(std::string_view power_supply_root = "/sys/class/power_supply") noexcept -> bool;
+
+}  // namespace scx::policy
+
+#endif  // SCX_POLICY_HPP
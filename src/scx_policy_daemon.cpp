@@ -0,0 +1,249 @@
+// Copyright (C) 2024-2025 Vladislav Nepogodin
+//
+// This file is part of CachyOS kernel manager.
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+#include "scx_policy_daemon.hpp"
+
+#include <algorithm>    // for max
+#include <array>        // for array
+#include <cerrno>       // for errno
+#include <chrono>       // for milliseconds
+#include <cstring>      // for strerror
+#include <string_view>  // for string_view
+
+#include <fcntl.h>          // for open
+#include <linux/netlink.h>  // for sockaddr_nl, NETLINK_KOBJECT_UEVENT
+#include <sys/socket.h>     // for socket, bind, recv
+#include <unistd.h>         // for read, write, close, sysconf
+
+#include <fmt/core.h>
+
+#if defined(__clang__)
+#pragma clang diagnostic push
+#pragma clang diagnostic ignored "-Wold-style-cast"
+#elif defined(__GNUC__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wnull-dereference"
+#pragma GCC diagnostic ignored "-Wuseless-cast"
+#pragma GCC diagnostic ignored "-Wold-style-cast"
+#pragma GCC diagnostic ignored "-Wsuggest-final-types"
+#pragma GCC diagnostic ignored "-Wsuggest-attribute=pure"
+#pragma GCC diagnostic ignored "-Wconversion"
+#endif
+
+#include <QSocketNotifier>
+#include <QTimer>
+
+#if defined(__clang__)
+#pragma clang diagnostic pop
+#elif defined(__GNUC__)
+#pragma GCC diagnostic pop
+#endif
+
+namespace {
+
+// Multicast group of the kernel uevents, udev rebroadcasts them on its own group
+constexpr std::uint32_t kKernelUeventGroup = 1;
+
+auto open_psi_trigger(std::chrono::microseconds stall, std::chrono::microseconds window) noexcept -> int {
+    const int trigger_fd = ::open("/proc/pressure/cpu", O_RDWR | O_NONBLOCK | O_CLOEXEC);  // NOLINT
+    if (trigger_fd < 0) {
+        fmt::print(stderr, "policy: PSI is not available: {}\n", std::strerror(errno));
+        return -1;
+    }
+    // the trigger is armed for as long as the descriptor stays open
+    const auto trigger = fmt::format("some {} {}", stall.count(), window.count());
+    if (::write(trigger_fd, trigger.c_str(), trigger.size() + 1) < 0) {
+        fmt::print(stderr, "policy: failed to set PSI trigger '{}': {}\n", trigger, std::strerror(errno));
+        ::close(trigger_fd);
+        return -1;
+    }
+    return trigger_fd;
+}
+
+auto open_uevent_socket() noexcept -> int {
+    const int uevent_fd = ::socket(AF_NETLINK, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, NETLINK_KOBJECT_UEVENT);
+    if (uevent_fd < 0) {
+        fmt::print(stderr, "policy: failed to open uevent socket: {}\n", std::strerror(errno));
+        return -1;
+    }
+    sockaddr_nl addr{};
+    addr.nl_family = AF_NETLINK;
+    addr.nl_groups = kKernelUeventGroup;
+    if (::bind(uevent_fd, reinterpret_cast<const sockaddr*>(&addr), sizeof(addr)) < 0) {
+        fmt::print(stderr, "policy: failed to bind uevent socket: {}\n", std::strerror(errno));
+        ::close(uevent_fd);
+        return -1;
+    }
+    return uevent_fd;
+}
+
+/// @brief Whether the uevent is about a power supply, e.g charger plugged in.
+auto is_power_supply_uevent(std::string_view uevent) noexcept -> bool {
+    // "action@devpath\0KEY=VALUE\0KEY=VALUE\0..."
+    while (!uevent.empty()) {
+        const auto field_end = uevent.find('\0');
+        if (uevent.substr(0, field_end) == "SUBSYSTEM=power_supply") {
+            return true;
+        }
+        uevent.remove_prefix(field_end == std::string_view::npos ? uevent.size() : field_end + 1);
+    }
+    return false;
+}
+
+void close_fd(int& fd) noexcept {
+    if (fd >= 0) {
+        ::close(fd);
+        fd = -1;
+    }
+}
+
+}  // namespace
+
+namespace scx::policy {
+
+PolicyDaemon::PolicyDaemon(loader::Config& config, PolicyConfig policy_config, bool dry_run, QObject* parent)
+  : QObject(parent), m_config(config), m_engine(std::move(policy_config)), m_dry_run(dry_run), m_sample_timer(new QTimer(this)), m_dwell_timer(new QTimer(this)) {
+    m_cpu_count  = static_cast<std::uint32_t>(std::max(::sysconf(_SC_NPROCESSORS_ONLN), 1L));
+    m_on_battery = read_on_battery();
+    if (const auto history_path = history::default_history_path(); history_path) {
+        // switches of the policy show up in the window's timeline
+        m_history.open(*history_path);
+    }
+    if (auto current_mode = m_config.get_current_mode(); current_mode.has_value()) {
+        m_engine.set_current_mode(*current_mode, Engine::clock_t::now());
+    }
+
+    const auto& engine_config = m_engine.config();
+    m_psi_trigger_fd          = open_psi_trigger(engine_config.psi_stall, engine_config.psi_window);
+    if (m_psi_trigger_fd >= 0) {
+        // PSI triggers are reported as POLLPRI
+        m_psi_notifier = new QSocketNotifier(m_psi_trigger_fd, QSocketNotifier::Exception, this);
+        connect(m_psi_notifier, &QSocketNotifier::activated, this, &PolicyDaemon::on_psi_event);
+    }
+
+    m_uevent_fd = open_uevent_socket();
+    if (m_uevent_fd >= 0) {
+        m_uevent_notifier = new QSocketNotifier(m_uevent_fd, QSocketNotifier::Read, this);
+        connect(m_uevent_notifier, &QSocketNotifier::activated, this, &PolicyDaemon::on_uevent);
+    }
+
+    if (auto loader_fd = m_config.watch_loader_state(); loader_fd.has_value()) {
+        m_loader_fd       = *loader_fd;
+        m_loader_notifier = new QSocketNotifier(m_loader_fd, QSocketNotifier::Read, this);
+        connect(m_loader_notifier, &QSocketNotifier::activated, this, &PolicyDaemon::on_loader_state_changed);
+    }
+
+    m_sample_timer->setInterval(std::chrono::duration_cast<std::chrono::milliseconds>(engine_config.sample_interval));
+    connect(m_sample_timer, &QTimer::timeout, this, &PolicyDaemon::evaluate);
+    m_sample_timer->start();
+
+    m_dwell_timer->setSingleShot(true);
+    connect(m_dwell_timer, &QTimer::timeout, this, &PolicyDaemon::evaluate);
+}
+
+PolicyDaemon::~PolicyDaemon() {
+    close_fd(m_psi_trigger_fd);
+    close_fd(m_uevent_fd);
+    close_fd(m_loader_fd);
+}
+
+auto PolicyDaemon::read_metrics() noexcept -> Metrics {
+    Metrics metrics{};
+    if (auto cpu_pressure = parse_cpu_pressure(m_pressure_file.read(m_read_buf)); cpu_pressure.has_value()) {
+        metrics[Metric::CpuSomeAvg10] = *cpu_pressure;
+    }
+    if (auto loadavg = parse_loadavg(m_loadavg_file.read(m_read_buf)); loadavg.has_value()) {
+        const auto [load1, load5]   = *loadavg;
+        metrics[Metric::LoadPerCpu] = load1 / m_cpu_count;
+        metrics[Metric::LoadTrend]  = (load1 - load5) / m_cpu_count;
+    }
+    metrics[Metric::OnBattery] = m_on_battery ? 1. : 0.;
+    return metrics;
+}
+
+void PolicyDaemon::evaluate() noexcept {
+    const auto now = Engine::clock_t::now();
+    if (auto decision = m_engine.evaluate(read_metrics(), now); decision.has_value()) {
+        if (apply(*decision)) {
+            m_engine.commit(*decision, now);
+        }
+    } else if (auto delay = m_engine.pending_delay(now); delay.has_value() && !m_dwell_timer->isActive()) {
+        m_dwell_timer->start(std::chrono::ceil<std::chrono::milliseconds>(*delay));
+    }
+}
+
+auto PolicyDaemon::apply(const Decision& decision) noexcept -> bool {
+    const auto& rule = m_engine.config().rules[decision.rule_idx];
+    fmt::print(stderr, "policy: rule '{}' switches to {} on {}\n", rule.name, sched_mode_name(decision.mode), decision.trigger);
+    if (m_dry_run) {
+        return true;
+    }
+
+    const auto current_sched = m_config.get_current_sched();
+    if (!current_sched || current_sched->empty() || *current_sched == "unknown") {
+        fmt::print(stderr, "policy: no scheduler is running, nothing to switch\n");
+        return false;
+    }
+    if (!m_config.switch_mode(*current_sched, decision.mode)) {
+        fmt::print(stderr, "policy: failed to switch {} to {}\n", *current_sched, sched_mode_name(decision.mode));
+        return false;
+    }
+    m_history.append(history::make_transition(history::Source::Policy, *current_sched, decision.mode, rule.name));
+    return true;
+}
+
+void PolicyDaemon::on_psi_event() noexcept {
+    evaluate();
+}
+
+void PolicyDaemon::on_uevent() noexcept {
+    bool is_power_changed{};
+    std::array<char, 8192> uevent_buf{};
+    while (true) {
+        const auto recv_len = ::recv(m_uevent_fd, uevent_buf.data(), uevent_buf.size(), 0);
+        if (recv_len <= 0) {
+            // EAGAIN, all events were read
+            break;
+        }
+        is_power_changed |= is_power_supply_uevent({uevent_buf.data(), static_cast<std::size_t>(recv_len)});
+    }
+    if (!is_power_changed) {
+        return;
+    }
+
+    const bool on_battery = read_on_battery();
+    if (on_battery != m_on_battery) {
+        fmt::print(stderr, "policy: running on {}\n", on_battery ? "battery" : "external power");
+        m_on_battery = on_battery;
+        evaluate();
+    }
+}
+
+void PolicyDaemon::on_loader_state_changed() noexcept {
+    // reset the eventfd counter
+    std::uint64_t counter{};
+    if (::read(m_loader_fd, &counter, sizeof(counter)) < 0) {
+        return;
+    }
+    // our own switches report the mode the engine has already
+    if (auto current_mode = m_config.get_current_mode(); current_mode.has_value()) {
+        m_engine.set_current_mode(*current_mode, Engine::clock_t::now());
+    }
+}
+
+}  // namespace scx::policy
@@ -0,0 +1,103 @@
+// Copyright (C) 2024-2025 Vladislav Nepogodin
+//
+// This file is part of CachyOS kernel manager.
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+#ifndef SCX_POLICY_DAEMON_HPP
+#define SCX_POLICY_DAEMON_HPP
+
+#include "scx_history.hpp"
+#include "scx_policy.hpp"
+#include "scx_sysfs.hpp"
+#include "scx_utils.hpp"
+
+#include <array>
+#include <cstdint>
+
+#if defined(__clang__)
+#pragma clang diagnostic push
+#pragma clang diagnostic ignored "-Wsign-conversion"
+#pragma clang diagnostic ignored "-Wshorten-64-to-32"
+#elif defined(__GNUC__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wuseless-cast"
+#pragma GCC diagnostic ignored "-Wsign-conversion"
+#pragma GCC diagnostic ignored "-Wconversion"
+#pragma GCC diagnostic ignored "-Wsuggest-final-methods"
+#pragma GCC diagnostic ignored "-Wsuggest-attribute=pure"
+#endif
+
+#include <QObject>
+
+#if defined(__clang__)
+#pragma clang diagnostic pop
+#elif defined(__GNUC__)
+#pragma GCC diagnostic pop
+#endif
+
+class QSocketNotifier;
+class QTimer;
+
+namespace scx::policy {
+
+/// @brief Switches the mode of the running scheduler according to the rules.
+///
+/// Reacts to PSI triggers on /proc/pressure/cpu and to power supply uevents
+/// as they happen. The load average has no notifications, so it is sampled
+/// at the configured interval, which also catches the pressure going down.
+/// Mode changes done by the user restart the dwell time.
+class PolicyDaemon final : public QObject {
+    Q_OBJECT
+    Q_DISABLE_COPY_MOVE(PolicyDaemon)
+ public:
+    /// @brief With dry_run the switches are only logged.
+    PolicyDaemon(loader::Config& config, PolicyConfig policy_config, bool dry_run, QObject* parent = nullptr);
+    ~PolicyDaemon() override;
+
+    /// @brief Reads all metrics and switches the mode if needed.
+    void evaluate() noexcept;
+
+ private:
+    void on_psi_event() noexcept;
+    void on_uevent() noexcept;
+    void on_loader_state_changed() noexcept;
+    auto read_metrics() noexcept -> Metrics;
+    auto apply(const Decision& decision) noexcept -> bool;
+
+    loader::Config& m_config;
+    Engine m_engine;
+    bool m_dry_run{};
+    std::uint32_t m_cpu_count{1};
+    bool m_on_battery{};
+    history::HistoryLog m_history{};
+
+    SysfsFile m_pressure_file{"/proc/pressure/cpu"};
+    SysfsFile m_loadavg_file{"/proc/loadavg"};
+    std::array<char, 256> m_read_buf{};
+
+    int m_psi_trigger_fd{-1};
+    int m_uevent_fd{-1};
+    int m_loader_fd{-1};
+    QSocketNotifier* m_psi_notifier{};
+    QSocketNotifier* m_uevent_notifier{};
+    QSocketNotifier* m_loader_notifier{};
+    QTimer* m_sample_timer{};
+    QTimer* m_dwell_timer{};
+};
+
+}  // namespace scx::policy
+
+#endif  // SCX_POLICY_DAEMON_HPP
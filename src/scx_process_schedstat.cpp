@@ -0,0 +1,253 @@
+// Copyright (C) 2024-2025 Vladislav Nepogodin
+//
+// This file is part of CachyOS kernel manager.
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+#include "scx_process_schedstat.hpp"
+
+#include <algorithm>     // for lower_bound, erase_if, find_if
+#include <charconv>      // for from_chars
+#include <system_error>  // for errc
+
+#include <fmt/format.h>
+
+namespace {
+
+auto parse_u64(std::string_view& str, std::uint64_t& value) noexcept -> bool {
+    const auto* str_end = str.data() + str.size();
+    auto [ptr, ec]      = std::from_chars(str.data(), str_end, value);
+    if (ec != std::errc{}) {
+        return false;
+    }
+    str.remove_prefix(static_cast<std::size_t>(ptr - str.data()));
+    if (!str.empty() && str.front() == ' ') {
+        str.remove_prefix(1);
+    }
+    return true;
+}
+
+auto parse_pid(std::string_view str) noexcept -> std::optional<int> {
+    int pid{};
+    const auto* str_end = str.data() + str.size();
+    auto [ptr, ec]      = std::from_chars(str.data(), str_end, pid);
+    if (ec != std::errc{} || ptr != str_end || pid <= 0) {
+        return std::nullopt;
+    }
+    return pid;
+}
+
+auto read_comm(const std::string& comm_path) noexcept -> std::string {
+    std::array<char, 64> comm_buf{};
+    scx::SysfsFile comm_file(comm_path);
+    return std::string{comm_file.read(comm_buf)};
+}
+
+constexpr auto to_ns(std::uint64_t value) noexcept -> std::chrono::nanoseconds {
+    return std::chrono::nanoseconds{static_cast<std::int64_t>(value)};
+}
+
+/// @brief Returns milliseconds per second of the interval.
+auto to_rate(std::uint64_t value_ns, std::chrono::nanoseconds elapsed) noexcept -> double {
+    return (elapsed.count() > 0) ? static_cast<double>(value_ns) / 1'000'000. / std::chrono::duration<double>(elapsed).count() : 0.;
+}
+
+}  // namespace
+
+namespace scx {
+
+auto parse_task_schedstat(std::string_view content) noexcept -> std::optional<TaskSchedstat> {
+    TaskSchedstat schedstat{};
+    if (!parse_u64(content, schedstat.run_ns) || !parse_u64(content, schedstat.wait_ns) || !parse_u64(content, schedstat.timeslices)) {
+        return std::nullopt;
+    }
+    return schedstat;
+}
+
+auto find_process(std::string_view pid_or_name) noexcept -> std::optional<int> {
+    if (auto pid = parse_pid(pid_or_name); pid) {
+        return pid;
+    }
+    // comm is truncated to 15 characters
+    constexpr std::size_t kCommMaxLen = 15;
+    const auto name                   = pid_or_name.substr(0, kCommMaxLen);
+    if (name.empty()) {
+        return std::nullopt;
+    }
+
+    DIR* proc_dir = ::opendir("/proc");
+    if (proc_dir == nullptr) {
+        return std::nullopt;
+    }
+    std::optional<int> found_pid{};
+    while (const auto* entry = ::readdir(proc_dir)) {
+        const auto pid = parse_pid(entry->d_name);
+        if (!pid || (found_pid && *found_pid < *pid)) {
+            continue;
+        }
+        if (read_comm(fmt::format("/proc/{}/comm", *pid)) == name) {
+            found_pid = pid;
+        }
+    }
+    ::closedir(proc_dir);
+    return found_pid;
+}
+
+ProcessSchedstatSampler::~ProcessSchedstatSampler() noexcept {
+    detach();
+}
+
+auto ProcessSchedstatSampler::attach(int pid) noexcept -> bool {
+    detach();
+    m_task_dir = ::opendir(fmt::format("/proc/{}/task", pid).c_str());
+    if (m_task_dir == nullptr) {
+        return false;
+    }
+    m_pid = pid;
+    scan_threads();
+    // threads running before the attach only count from here on
+    for (auto&& thread : m_threads) {
+        if (auto schedstat = parse_task_schedstat(thread.schedstat_file.read(m_read_buf)); schedstat) {
+            thread.previous = *schedstat;
+        }
+    }
+    m_sampled_at = std::chrono::steady_clock::now();
+    return !m_threads.empty();
+}
+
+void ProcessSchedstatSampler::detach() noexcept {
+    if (m_task_dir != nullptr) {
+        ::closedir(m_task_dir);
+        m_task_dir = nullptr;
+    }
+    m_threads.clear();
+    m_pid = -1;
+}
+
+void ProcessSchedstatSampler::set_label(std::string_view label) noexcept {
+    if (label == m_label) {
+        return;
+    }
+    if (m_pid > 0) {
+        sample();
+    }
+    m_label.assign(label);
+}
+
+void ProcessSchedstatSampler::scan_threads() noexcept {
+    ++m_generation;
+    ::rewinddir(m_task_dir);
+    while (const auto* entry = ::readdir(m_task_dir)) {
+        const auto tid = parse_pid(entry->d_name);
+        if (!tid) {
+            continue;
+        }
+        auto thread_it = std::ranges::lower_bound(m_threads, *tid, {}, [](auto&& thread) { return thread.stats.tid; });
+        if (thread_it == m_threads.end() || thread_it->stats.tid != *tid) {
+            // new threads start from zero, so their whole run so far falls into this interval
+            const auto task_path = fmt::format("/proc/{}/task/{}/", m_pid, *tid);
+            ThreadState thread{
+                .stats          = ThreadSchedstat{.tid = *tid, .comm = read_comm(task_path + "comm")},
+                .schedstat_file = SysfsFile(task_path + "schedstat"),
+            };
+            thread_it = m_threads.insert(thread_it, std::move(thread));
+        }
+        thread_it->seen_generation = m_generation;
+    }
+    std::erase_if(m_threads, [generation = m_generation](auto&& thread) { return thread.seen_generation != generation; });
+}
+
+auto ProcessSchedstatSampler::sample() noexcept -> bool {
+    if (m_pid <= 0) {
+        return false;
+    }
+    scan_threads();
+    if (m_threads.empty()) {
+        // the process has exited
+        detach();
+        return false;
+    }
+    const auto now     = std::chrono::steady_clock::now();
+    const auto elapsed = now - m_sampled_at;
+    m_sampled_at       = now;
+
+    auto* label_stats = find_or_add_label_stats();
+    if (label_stats != nullptr) {
+        label_stats->elapsed += elapsed;
+    }
+    for (auto&& thread : m_threads) {
+        const auto schedstat = parse_task_schedstat(thread.schedstat_file.read(m_read_buf));
+        if (!schedstat) {
+            // exited after the scan, dropped on the next one
+            thread.stats.run_rate  = 0.;
+            thread.stats.wait_rate = 0.;
+            thread.stats.delay_per_slice.reset();
+            continue;
+        }
+        const auto run_diff    = schedstat->run_ns - thread.previous.run_ns;
+        const auto wait_diff   = schedstat->wait_ns - thread.previous.wait_ns;
+        const auto slices_diff = schedstat->timeslices - thread.previous.timeslices;
+        thread.previous        = *schedstat;
+
+        thread.stats.run_rate  = to_rate(run_diff, elapsed);
+        thread.stats.wait_rate = to_rate(wait_diff, elapsed);
+        thread.stats.delay_per_slice.reset();
+        if (slices_diff != 0) {
+            thread.stats.delay_per_slice = to_ns(wait_diff / slices_diff);
+        }
+
+        if (label_stats != nullptr) {
+            label_stats->run_ns += run_diff;
+            label_stats->wait_ns += wait_diff;
+            if (thread.stats.delay_per_slice) {
+                label_stats->delays.record(wait_diff / slices_diff);
+            }
+        }
+    }
+    return true;
+}
+
+auto ProcessSchedstatSampler::find_or_add_label_stats() noexcept -> LabelStats* {
+    if (m_label.empty()) {
+        return nullptr;
+    }
+    auto label_it = std::ranges::find_if(m_label_stats, [this](auto&& label_stats) { return label_stats->label == m_label; });
+    if (label_it != m_label_stats.end()) {
+        return label_it->get();
+    }
+    auto label_stats   = std::make_unique<LabelStats>();
+    label_stats->label = m_label;
+    return m_label_stats.emplace_back(std::move(label_stats)).get();
+}
+
+auto ProcessSchedstatSampler::summaries() const noexcept -> std::vector<ProcessSchedstatSummary> {
+    std::vector<ProcessSchedstatSummary> summaries;
+    summaries.reserve(m_label_stats.size());
+    for (auto&& label_stats : m_label_stats) {
+        summaries.emplace_back(ProcessSchedstatSummary{
+            .label       = label_stats->label,
+            .elapsed     = label_stats->elapsed,
+            .run_rate    = to_rate(label_stats->run_ns, label_stats->elapsed),
+            .wait_rate   = to_rate(label_stats->wait_ns, label_stats->elapsed),
+            .delay_count = label_stats->delays.count(),
+            .delay_p50   = to_ns(label_stats->delays.value_at_percentile(50.)),
+            .delay_p99   = to_ns(label_stats->delays.value_at_percentile(99.)),
+            .delay_max   = to_ns(label_stats->delays.max()),
+        });
+    }
+    return summaries;
+}
+
+}  // namespace scx
@@ -0,0 +1,140 @@
+// Copyright (C) 2024-2025 Vladislav Nepogodin
+//
+// This file is part of CachyOS kernel manager.
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+#ifndef SCX_PROCESS_SCHEDSTAT_HPP
+#define SCX_PROCESS_SCHEDSTAT_HPP
+
+#include "scx_hdr_histogram.hpp"
+#include "scx_sysfs.hpp"
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <dirent.h>  // for DIR
+
+namespace scx {
+
+/// @brief Counters of /proc/<pid>/task/<tid>/schedstat.
+struct TaskSchedstat {
+    /// Time spent on the CPU
+    std::uint64_t run_ns{};
+    /// Time spent waiting on a run-queue
+    std::uint64_t wait_ns{};
+    std::uint64_t timeslices{};
+};
+
+/// @brief Parses the schedstat line, e.g "1204005 60130 31".
+auto parse_task_schedstat(std::string_view content) noexcept -> std::optional<TaskSchedstat>;
+
+/// @brief Finds the process by PID, or by its name as in comm, the oldest one if several match.
+auto find_process(std::string_view pid_or_name) noexcept -> std::optional<int>;
+
+/// @brief Rates of a thread over the last interval.
+struct ThreadSchedstat {
+    int tid{};
+    std::string comm{};
+    /// Milliseconds per second of the interval
+    double run_rate{};
+    double wait_rate{};
+    /// Run-queue wait per timeslice, if the thread ran in the interval
+    std::optional<std::chrono::nanoseconds> delay_per_slice{};
+};
+
+/// @brief Run-queue wait of the process accumulated under a scheduler and mode.
+struct ProcessSchedstatSummary {
+    std::string label{};
+    std::chrono::nanoseconds elapsed{};
+    /// Milliseconds per second, summed over the threads
+    double run_rate{};
+    double wait_rate{};
+    /// Distribution of the per-interval wait per timeslice of the threads
+    std::uint64_t delay_count{};
+    std::chrono::nanoseconds delay_p50{};
+    std::chrono::nanoseconds delay_p99{};
+    std::chrono::nanoseconds delay_max{};
+};
+
+/// @brief Samples schedstat of all threads of a process.
+///
+/// Descriptors of the thread files are kept open between samples and the
+/// task directory is rescanned through the same handle, so a sample of a
+/// process with hundreds of threads costs a read per thread and allocates
+/// only for the threads that appeared since the previous one.
+class ProcessSchedstatSampler final {
+ public:
+    ProcessSchedstatSampler() = default;
+    ~ProcessSchedstatSampler() noexcept;
+
+    ProcessSchedstatSampler(const ProcessSchedstatSampler&)                    = delete;
+    auto operator=(const ProcessSchedstatSampler&) -> ProcessSchedstatSampler& = delete;
+
+    /// @brief Starts sampling the process, the summaries are kept.
+    auto attach(int pid) noexcept -> bool;
+    void detach() noexcept;
+
+    [[nodiscard]] auto pid() const noexcept -> int { return m_pid; }
+
+    /// @brief Sets the label the following intervals are accounted to, e.g "scx_lavd (Gaming)".
+    void set_label(std::string_view label) noexcept;
+
+    /// @brief Samples all threads, returns false once the process has exited.
+    auto sample() noexcept -> bool;
+
+    [[nodiscard]] auto thread_count() const noexcept -> std::size_t { return m_threads.size(); }
+    [[nodiscard]] auto thread(std::size_t idx) const noexcept -> const ThreadSchedstat& { return m_threads[idx].stats; }
+
+    [[nodiscard]] auto summaries() const noexcept -> std::vector<ProcessSchedstatSummary>;
+
+ private:
+    struct ThreadState {
+        ThreadSchedstat stats{};
+        SysfsFile schedstat_file;
+        TaskSchedstat previous{};
+        std::uint64_t seen_generation{};
+    };
+
+    struct LabelStats {
+        std::string label{};
+        std::chrono::nanoseconds elapsed{};
+        std::uint64_t run_ns{};
+        std::uint64_t wait_ns{};
+        HdrHistogram delays{};
+    };
+
+    void scan_threads() noexcept;
+    auto find_or_add_label_stats() noexcept -> LabelStats*;
+
+    int m_pid{-1};
+    DIR* m_task_dir{};
+    std::vector<ThreadState> m_threads{};
+    std::uint64_t m_generation{};
+    std::array<char, 128> m_read_buf{};
+    std::chrono::steady_clock::time_point m_sampled_at{};
+    std::string m_label{};
+    std::vector<std::unique_ptr<LabelStats>> m_label_stats{};
+};
+
+}  // namespace scx
+
+#endif  // SCX_PROCESS_SCHEDSTAT_HPP
@@ -0,0 +1,74 @@
+// Copyright (C) 2024-2025 Vladislav Nepogodin
+//
+// This file is part of CachyOS kernel manager.
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+#ifndef SCX_RING_BUFFER_HPP
+#define SCX_RING_BUFFER_HPP
+
+#include <array>
+#include <cstddef>
+
+namespace scx {
+
+/// @brief Fixed-size ring buffer, overwriting the oldest element once full.
+///
+/// Storage is allocated once together with the buffer, pushing never allocates.
+template <typename T, std::size_t Capacity>
+class RingBuffer final {
+    static_assert(Capacity > 0, "RingBuffer capacity must be non-zero");
+
+ public:
+    /// @brief Returns the slot for the next element, evicting the oldest one if full.
+    ///
+    /// The slot still holds the evicted value, caller is expected to overwrite it.
+    constexpr auto push() noexcept -> T& {
+        auto& slot = m_storage[m_head];
+        m_head     = (m_head + 1) % Capacity;
+        if (m_size < Capacity) {
+            ++m_size;
+        }
+        return slot;
+    }
+
+    constexpr void push(const T& value) noexcept { push() = value; }
+
+    constexpr void clear() noexcept {
+        m_head = 0;
+        m_size = 0;
+    }
+
+    /// @brief Returns element by its age, 0 being the oldest one.
+    [[nodiscard]] constexpr auto operator[](std::size_t idx) const noexcept -> const T& {
+        return m_storage[(m_head + Capacity - m_size + idx) % Capacity];
+    }
+
+    /// @brief Returns the newest element, buffer must not be empty.
+    [[nodiscard]] constexpr auto back() const noexcept -> const T& { return (*this)[m_size - 1]; }
+
+    [[nodiscard]] constexpr auto size() const noexcept -> std::size_t { return m_size; }
+    [[nodiscard]] constexpr auto empty() const noexcept -> bool { return m_size == 0; }
+    [[nodiscard]] static constexpr auto capacity() noexcept -> std::size_t { return Capacity; }
+
+ private:
+    std::array<T, Capacity> m_storage{};
+    std::size_t m_head{};
+    std::size_t m_size{};
+};
+
+}  // namespace scx
+
+#endif  // SCX_RING_BUFFER_HPP
@@ -0,0 +1,171 @@
+// Copyright (C) 2024-2025 Vladislav Nepogodin
+//
+// This file is part of CachyOS kernel manager.
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+#include "scx_state_watcher.hpp"
+
+#include <algorithm>  // for copy, equal
+#include <cstdint>    // for uint64_t
+
+#include <unistd.h>  // for read, close
+
+#if defined(__clang__)
+#pragma clang diagnostic push
+#pragma clang diagnostic ignored "-Wold-style-cast"
+#elif defined(__GNUC__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wnull-dereference"
+#pragma GCC diagnostic ignored "-Wuseless-cast"
+#pragma GCC diagnostic ignored "-Wold-style-cast"
+#pragma GCC diagnostic ignored "-Wsuggest-final-types"
+#pragma GCC diagnostic ignored "-Wsuggest-attribute=pure"
+#pragma GCC diagnostic ignored "-Wconversion"
+#endif
+
+#include <QSocketNotifier>
+#include <QTimer>
+
+#if defined(__clang__)
+#pragma clang diagnostic pop
+#elif defined(__GNUC__)
+#pragma GCC diagnostic pop
+#endif
+
+namespace {
+
+using namespace std::chrono_literals;  // NOLINT
+
+// Polling interval, for changes scx_loader doesn't report
+constexpr auto kFallbackMinInterval = 1s;
+constexpr auto kFallbackMaxInterval = 8s;
+
+// Re-reading the state after scx_loader reported a change, until the new scheduler attaches
+constexpr auto kSettleInterval = 50ms;
+constexpr int kSettleTicks     = 60;
+
+}  // namespace
+
+namespace scx {
+
+StateWatcher::StateWatcher(loader::Config* config, QObject* parent)
+  : QObject(parent), m_fallback_timer(new QTimer(this)), m_fallback_interval(kFallbackMinInterval), m_settle_timer(new QTimer(this)) {
+    if (config != nullptr) {
+        if (auto loader_fd = config->watch_loader_state(); loader_fd.has_value()) {
+            m_loader_fd       = *loader_fd;
+            m_loader_notifier = new QSocketNotifier(m_loader_fd, QSocketNotifier::Read, this);
+            connect(m_loader_notifier, &QSocketNotifier::activated, this, &StateWatcher::on_loader_event);
+        }
+    }
+
+    // Kernel raises POLLPRI on the attribute, if it notifies about changes
+    if (m_state_file.fd() >= 0) {
+        m_state_notifier = new QSocketNotifier(m_state_file.fd(), QSocketNotifier::Exception, this);
+        connect(m_state_notifier, &QSocketNotifier::activated, this, &StateWatcher::refresh);
+    }
+
+    m_settle_timer->setInterval(kSettleInterval);
+    connect(m_settle_timer, &QTimer::timeout, this, &StateWatcher::on_settle_tick);
+
+    m_fallback_timer->setSingleShot(true);
+    connect(m_fallback_timer, &QTimer::timeout, this, &StateWatcher::on_fallback_tick);
+    m_fallback_timer->start(m_fallback_interval);
+
+    refresh();
+}
+
+StateWatcher::~StateWatcher() {
+    if (m_loader_fd >= 0) {
+        ::close(m_loader_fd);
+    }
+}
+
+void StateWatcher::refresh() noexcept {
+    poll_state();
+}
+
+auto StateWatcher::poll_state() noexcept -> bool {
+    using namespace std::string_view_literals;
+
+    // NOTE: we assume that window won't be launched on kernel without sched_ext
+    // e.g we won't show window at all in that case.
+    const auto current_state = m_state_file.read(m_state_buf);
+    std::string_view current_ops{};
+    if (current_state == "enabled"sv) {
+        current_ops = m_ops_file.read(m_ops_buf);
+    }
+
+    std::array<char, std::tuple_size_v<decltype(m_last_raw)>> raw{};
+    auto raw_end = std::ranges::copy(current_state, raw.begin()).out;
+    *raw_end++   = '\0';
+    raw_end      = std::ranges::copy(current_ops, raw_end).out;
+
+    const auto raw_len = static_cast<std::size_t>(raw_end - raw.begin());
+    if (raw_len == m_last_raw_len && std::equal(raw.begin(), raw_end, m_last_raw.begin())) {
+        return false;
+    }
+    m_last_raw     = raw;
+    m_last_raw_len = raw_len;
+    m_is_enabled   = current_state == "enabled"sv;
+
+    if (current_state != "enabled"sv) {
+        m_current = QString::fromUtf8(current_state.data(), static_cast<qsizetype>(current_state.size()));
+    } else if (current_ops.empty()) {
+        m_current = QStringLiteral("unknown");
+    } else {
+        m_current = QString::fromUtf8(current_ops.data(), static_cast<qsizetype>(current_ops.size()));
+    }
+
+    // something changed, poll more often again
+    m_fallback_interval = kFallbackMinInterval;
+    emit scheduler_changed(m_current);
+    return true;
+}
+
+void StateWatcher::on_loader_event() noexcept {
+    // reset the eventfd counter
+    std::uint64_t counter{};
+    if (::read(m_loader_fd, &counter, sizeof(counter)) < 0) {
+        return;
+    }
+
+    emit loader_state_changed();
+
+    refresh();
+    m_settle_ticks_left = kSettleTicks;
+    m_settle_timer->start();
+
+    // scheduler may still crash or restart itself shortly after the switch
+    m_fallback_interval = kFallbackMinInterval;
+    m_fallback_timer->start(m_fallback_interval);
+}
+
+void StateWatcher::on_settle_tick() noexcept {
+    refresh();
+    if (--m_settle_ticks_left <= 0) {
+        m_settle_timer->stop();
+    }
+}
+
+void StateWatcher::on_fallback_tick() noexcept {
+    // back off while nothing changes
+    if (!poll_state()) {
+        m_fallback_interval = std::min<std::chrono::milliseconds>(m_fallback_interval * 2, kFallbackMaxInterval);
+    }
+    m_fallback_timer->start(m_fallback_interval);
+}
+
+}  // namespace scx
@@ -0,0 +1,119 @@
+// Copyright (C) 2024-2025 Vladislav Nepogodin
+//
+// This file is part of CachyOS kernel manager.
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+#ifndef SCX_STATE_WATCHER_HPP
+#define SCX_STATE_WATCHER_HPP
+
+#include "scx_sysfs.hpp"
+#include "scx_utils.hpp"
+
+#include <array>
+#include <chrono>
+#include <cstddef>
+
+#if defined(__clang__)
+#pragma clang diagnostic push
+#pragma clang diagnostic ignored "-Wsign-conversion"
+#pragma clang diagnostic ignored "-Wshorten-64-to-32"
+#elif defined(__GNUC__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wuseless-cast"
+#pragma GCC diagnostic ignored "-Wsign-conversion"
+#pragma GCC diagnostic ignored "-Wconversion"
+#pragma GCC diagnostic ignored "-Wsuggest-final-methods"
+#pragma GCC diagnostic ignored "-Wsuggest-attribute=pure"
+#endif
+
+#include <QObject>
+#include <QString>
+
+#if defined(__clang__)
+#pragma clang diagnostic pop
+#elif defined(__GNUC__)
+#pragma GCC diagnostic pop
+#endif
+
+class QSocketNotifier;
+class QTimer;
+
+namespace scx {
+
+/// @brief Tracks the currently running sched_ext scheduler.
+///
+/// scx_loader reports scheduler/mode changes over D-Bus, after which the kernel
+/// state is re-read until the new scheduler attaches. The sched_ext state
+/// attribute is also polled for POLLPRI, in case the kernel notifies about it.
+/// Changes which scx_loader doesn't report (e.g ejected or externally started
+/// schedulers) are caught by polling the state periodically, backing off
+/// while nothing changes, and polling often again after each change.
+class StateWatcher final : public QObject {
+    Q_OBJECT
+    Q_DISABLE_COPY_MOVE(StateWatcher)
+ public:
+    /// @brief Config is used to subscribe to scx_loader, may be null.
+    explicit StateWatcher(loader::Config* config, QObject* parent = nullptr);
+    ~StateWatcher() override;
+
+    /// @brief Returns the currently running scheduler, or the sched_ext state if none is running.
+    [[nodiscard]] auto current_scheduler() const noexcept -> const QString& { return m_current; }
+
+    /// @brief Whether a scheduler is attached, i.e sched_ext state is "enabled".
+    [[nodiscard]] auto is_enabled() const noexcept -> bool { return m_is_enabled; }
+
+    /// @brief Whether the changes are reported by scx_loader, next to the periodic polling.
+    [[nodiscard]] auto is_event_driven() const noexcept -> bool { return m_loader_fd >= 0; }
+
+    /// @brief Re-reads the kernel state, emitting scheduler_changed if it differs.
+    void refresh() noexcept;
+
+ signals:
+    void scheduler_changed(const QString& scheduler);
+    /// @brief Emitted when scx_loader reports scheduler or mode change.
+    void loader_state_changed();
+
+ private:
+    void on_loader_event() noexcept;
+    void on_fallback_tick() noexcept;
+    void on_settle_tick() noexcept;
+    /// @brief Re-reads the kernel state, returns whether it changed.
+    auto poll_state() noexcept -> bool;
+
+    SysfsFile m_state_file{sched_ext::kStatePath};
+    SysfsFile m_ops_file{sched_ext::kRootOpsPath};
+    std::array<char, 64> m_state_buf{};
+    std::array<char, 128> m_ops_buf{};
+    // last seen "state\0ops", compared to skip building the string when nothing changed
+    std::array<char, 64 + 128 + 1> m_last_raw{};
+    std::size_t m_last_raw_len{};
+    QString m_current{};
+    bool m_is_enabled{};
+
+    int m_loader_fd{-1};
+    QSocketNotifier* m_loader_notifier{};
+    QSocketNotifier* m_state_notifier{};
+
+    QTimer* m_fallback_timer{};
+    std::chrono::milliseconds m_fallback_interval{};
+
+    QTimer* m_settle_timer{};
+    int m_settle_ticks_left{};
+};
+
+}  // namespace scx
+
+#endif  // SCX_STATE_WATCHER_HPP
@@ -0,0 +1,188 @@
+// Copyright (C) 2024-2025 Vladislav Nepogodin
+//
+// This file is part of CachyOS kernel manager.
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+#include "scx_switch_trace.hpp"
+
+#include <algorithm>     // for find_if
+#include <charconv>      // for from_chars
+#include <system_error>  // for errc
+
+#include <fmt/format.h>
+
+namespace {
+
+using namespace std::chrono_literals;  // NOLINT
+
+constexpr std::string_view kEnabledState{"enabled"};
+
+auto parse_u64(std::string_view str) noexcept -> std::optional<std::uint64_t> {
+    std::uint64_t value{};
+    const auto* str_end = str.data() + str.size();
+    auto [ptr, ec]      = std::from_chars(str.data(), str_end, value);
+    if (ec != std::errc{} || ptr != str_end) {
+        return std::nullopt;
+    }
+    return value;
+}
+
+constexpr auto to_ns(std::uint64_t value) noexcept -> std::chrono::nanoseconds {
+    return std::chrono::nanoseconds{static_cast<std::int64_t>(value)};
+}
+
+auto to_millis(std::chrono::nanoseconds duration) noexcept -> double {
+    return std::chrono::duration<double, std::milli>(duration).count();
+}
+
+}  // namespace
+
+namespace scx {
+
+auto SchedExtTransition::fair_class_gap() const noexcept -> std::optional<std::chrono::nanoseconds> {
+    if (!detached_at || !attached_at) {
+        return std::nullopt;
+    }
+    return *attached_at - *detached_at;
+}
+
+auto SchedExtTransition::attach_latency() const noexcept -> std::optional<std::chrono::nanoseconds> {
+    if (!attached_at) {
+        return std::nullopt;
+    }
+    return *attached_at - watch_started_at;
+}
+
+SchedExtTransitionMonitor::SchedExtTransitionMonitor(std::string_view sched_ext_root) noexcept
+  : m_state_file(std::string{sched_ext_root} + "/state"), m_ops_file(std::string{sched_ext_root} + "/root/ops"),
+    m_enable_seq_file(std::string{sched_ext_root} + "/enable_seq") { }
+
+SchedExtTransitionMonitor::~SchedExtTransitionMonitor() noexcept = default;
+
+auto SchedExtTransitionMonitor::sample() noexcept -> Sample {
+    // root/ops disappears while no scheduler is attached, enable_seq is missing on older kernels
+    return Sample{
+        .state      = m_state_file.read(m_state_buf),
+        .ops        = m_ops_file.read(m_ops_buf),
+        .enable_seq = parse_u64(m_enable_seq_file.read(m_enable_seq_buf)),
+    };
+}
+
+void SchedExtTransitionMonitor::start(std::chrono::steady_clock::time_point origin, bool expects_attach) noexcept {
+    if (m_thread.joinable()) {
+        return;
+    }
+    const auto initial = sample();
+    m_was_enabled        = initial.state == kEnabledState;
+    m_expects_attach     = expects_attach;
+    m_initial_enable_seq = initial.enable_seq;
+    m_transition         = SchedExtTransition{
+        .old_ops          = m_was_enabled ? std::string{initial.ops} : std::string{},
+        .watch_started_at = std::chrono::steady_clock::now() - origin,
+    };
+    m_settled.store(false, std::memory_order_relaxed);
+    m_thread = std::jthread([this, origin](std::stop_token stop_token) { watch(std::move(stop_token), origin); });
+}
+
+void SchedExtTransitionMonitor::watch(std::stop_token stop_token, std::chrono::steady_clock::time_point origin) noexcept {
+    while (!stop_token.stop_requested()) {
+        const auto current = sample();
+        const auto now     = std::chrono::steady_clock::now() - origin;
+
+        const bool is_enabled    = current.state == kEnabledState;
+        const bool is_reattached  = current.enable_seq && current.enable_seq != m_initial_enable_seq;
+        if (m_was_enabled && !m_transition.detached_at && (!is_enabled || is_reattached || current.ops != m_transition.old_ops)) {
+            m_transition.detached_at = now;
+        }
+
+        // detaching and attaching may both happen between two polls, then the gap is zero
+        const bool is_attached = is_enabled && !current.ops.empty() && (is_reattached || !m_was_enabled || m_transition.detached_at);
+        if (m_expects_attach && is_attached) {
+            m_transition.new_ops.assign(current.ops);
+            m_transition.attached_at = now;
+            m_settled.store(true, std::memory_order_release);
+            return;
+        }
+        if (!m_expects_attach && (!m_was_enabled || (m_transition.detached_at && !is_enabled))) {
+            m_settled.store(true, std::memory_order_release);
+            return;
+        }
+        std::this_thread::sleep_for(kPollInterval);
+    }
+}
+
+auto SchedExtTransitionMonitor::finish(std::chrono::nanoseconds timeout) noexcept -> SchedExtTransition {
+    if (!m_thread.joinable()) {
+        return {};
+    }
+    const auto deadline = std::chrono::steady_clock::now() + timeout;
+    while (!m_settled.load(std::memory_order_acquire) && std::chrono::steady_clock::now() < deadline) {
+        std::this_thread::sleep_for(1ms);
+    }
+    m_thread.request_stop();
+    m_thread.join();
+    return std::move(m_transition);
+}
+
+void SwitchLatencyStats::record(std::string_view scx_sched, const SchedExtTransition& transition) noexcept {
+    const auto attach_latency = transition.attach_latency();
+    if (!attach_latency) {
+        return;
+    }
+    auto sched_it = std::ranges::find_if(m_sched_stats, [scx_sched](auto&& sched_stats) { return sched_stats->scx_sched == scx_sched; });
+    if (sched_it == m_sched_stats.end()) {
+        auto sched_stats       = std::make_unique<SchedStats>();
+        sched_stats->scx_sched = std::string{scx_sched};
+        sched_it               = m_sched_stats.insert(m_sched_stats.end(), std::move(sched_stats));
+    }
+    auto& sched_stats = **sched_it;
+
+    sched_stats.attach_latencies.record(static_cast<std::uint64_t>(attach_latency->count()));
+    sched_stats.last_gap = transition.fair_class_gap();
+    if (sched_stats.last_gap) {
+        sched_stats.gaps.record(static_cast<std::uint64_t>(sched_stats.last_gap->count()));
+    }
+}
+
+auto SwitchLatencyStats::summaries() const noexcept -> std::vector<SwitchLatencySummary> {
+    std::vector<SwitchLatencySummary> summaries;
+    summaries.reserve(m_sched_stats.size());
+    for (auto&& sched_stats : m_sched_stats) {
+        summaries.emplace_back(SwitchLatencySummary{
+            .scx_sched  = sched_stats->scx_sched,
+            .count      = sched_stats->attach_latencies.count(),
+            .last_gap   = sched_stats->last_gap,
+            .gap_p50    = to_ns(sched_stats->gaps.value_at_percentile(50.)),
+            .gap_p99    = to_ns(sched_stats->gaps.value_at_percentile(99.)),
+            .gap_max    = to_ns(sched_stats->gaps.max()),
+            .attach_p50 = to_ns(sched_stats->attach_latencies.value_at_percentile(50.)),
+            .attach_max = to_ns(sched_stats->attach_latencies.max()),
+        });
+    }
+    return summaries;
+}
+
+auto switch_latency_summaries_to_csv(std::span<const SwitchLatencySummary> summaries) -> std::string {
+    std::string csv{"scheduler,switches,last_gap_ms,gap_p50_ms,gap_p99_ms,gap_max_ms,attach_p50_ms,attach_max_ms\n"};
+    for (auto&& summary : summaries) {
+        const auto last_gap = summary.last_gap ? fmt::format("{:.3f}", to_millis(*summary.last_gap)) : std::string{};
+        csv += fmt::format("{},{},{},{:.3f},{:.3f},{:.3f},{:.3f},{:.3f}\n", summary.scx_sched, summary.count, last_gap, to_millis(summary.gap_p50),
+            to_millis(summary.gap_p99), to_millis(summary.gap_max), to_millis(summary.attach_p50), to_millis(summary.attach_max));
+    }
+    return csv;
+}
+
+}  // namespace scx
@@ -0,0 +1,145 @@
+// Copyright (C) 2024-2025 Vladislav Nepogodin
+//
+// This file is part of CachyOS kernel manager.
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+#ifndef SCX_SWITCH_TRACE_HPP
+#define SCX_SWITCH_TRACE_HPP
+
+#include "scx_hdr_histogram.hpp"
+#include "scx_sysfs.hpp"
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+namespace scx {
+
+/// @brief Scheduler switch as seen in sysfs, times are relative to the start of the request.
+struct SchedExtTransition {
+    /// ops of the scheduler attached before the switch, empty if none was
+    std::string old_ops{};
+    /// ops of the scheduler attached by the switch, empty if none attached
+    std::string new_ops{};
+    /// When sysfs started to be watched, right before the switch was requested
+    std::chrono::nanoseconds watch_started_at{};
+    /// When the old scheduler was seen detaching
+    std::optional<std::chrono::nanoseconds> detached_at{};
+    /// When the new scheduler was seen attached
+    std::optional<std::chrono::nanoseconds> attached_at{};
+
+    /// @brief Time tasks ran on the fair class between the old scheduler detaching and the new one attaching.
+    [[nodiscard]] auto fair_class_gap() const noexcept -> std::optional<std::chrono::nanoseconds>;
+    /// @brief Time from requesting the switch until the new scheduler attached.
+    [[nodiscard]] auto attach_latency() const noexcept -> std::optional<std::chrono::nanoseconds>;
+};
+
+/// @brief Watches sched_ext state, root/ops and enable_seq on its own thread during a switch.
+///
+/// Sysfs doesn't notify about the ops changes, so the files are polled and the
+/// times are accurate to the poll interval. enable_seq tells apart reattaching
+/// the same scheduler, e.g when only its mode changes.
+class SchedExtTransitionMonitor final {
+ public:
+    static constexpr std::chrono::microseconds kPollInterval{200};
+
+    explicit SchedExtTransitionMonitor(std::string_view sched_ext_root = "/sys/kernel/sched_ext") noexcept;
+    ~SchedExtTransitionMonitor() noexcept;
+
+    SchedExtTransitionMonitor(const SchedExtTransitionMonitor&)                    = delete;
+    auto operator=(const SchedExtTransitionMonitor&) -> SchedExtTransitionMonitor& = delete;
+
+    /// @brief Records the attached scheduler and starts watching, times are relative to the origin.
+    ///
+    /// Without the attach expected, the switch settles once the old scheduler has detached.
+    void start(std::chrono::steady_clock::time_point origin, bool expects_attach) noexcept;
+
+    /// @brief Waits up to the timeout for the switch to settle, then stops watching.
+    auto finish(std::chrono::nanoseconds timeout) noexcept -> SchedExtTransition;
+
+    [[nodiscard]] auto is_running() const noexcept -> bool { return m_thread.joinable(); }
+
+ private:
+    struct Sample {
+        std::string_view state{};
+        std::string_view ops{};
+        std::optional<std::uint64_t> enable_seq{};
+    };
+
+    auto sample() noexcept -> Sample;
+    void watch(std::stop_token stop_token, std::chrono::steady_clock::time_point origin) noexcept;
+
+    SysfsFile m_state_file;
+    SysfsFile m_ops_file;
+    SysfsFile m_enable_seq_file;
+    std::array<char, 64> m_state_buf{};
+    std::array<char, 64> m_ops_buf{};
+    std::array<char, 32> m_enable_seq_buf{};
+
+    bool m_was_enabled{};
+    bool m_expects_attach{};
+    std::optional<std::uint64_t> m_initial_enable_seq{};
+    SchedExtTransition m_transition{};
+    std::atomic<bool> m_settled{};
+    std::jthread m_thread{};
+};
+
+/// @brief Switch latencies of a scheduler.
+struct SwitchLatencySummary {
+    std::string scx_sched{};
+    /// Switches the scheduler was seen attaching in
+    std::uint64_t count{};
+    std::optional<std::chrono::nanoseconds> last_gap{};
+    std::chrono::nanoseconds gap_p50{};
+    std::chrono::nanoseconds gap_p99{};
+    std::chrono::nanoseconds gap_max{};
+    std::chrono::nanoseconds attach_p50{};
+    std::chrono::nanoseconds attach_max{};
+};
+
+/// @brief Histograms of the switch latencies per scheduler switched to.
+class SwitchLatencyStats final {
+ public:
+    void record(std::string_view scx_sched, const SchedExtTransition& transition) noexcept;
+
+    [[nodiscard]] auto summaries() const noexcept -> std::vector<SwitchLatencySummary>;
+
+ private:
+    struct SchedStats {
+        std::string scx_sched{};
+        /// Only switches from another scheduler have a gap
+        HdrHistogram gaps{};
+        HdrHistogram attach_latencies{};
+        std::optional<std::chrono::nanoseconds> last_gap{};
+    };
+
+    std::vector<std::unique_ptr<SchedStats>> m_sched_stats{};
+};
+
+/// @brief Formats summaries as CSV.
+auto switch_latency_summaries_to_csv(std::span<const SwitchLatencySummary> summaries) -> std::string;
+
+}  // namespace scx
+
+#endif  // SCX_SWITCH_TRACE_HPP
@@ -0,0 +1,91 @@
+// Copyright (C) 2024-2025 Vladislav Nepogodin
+//
+// This file is part of CachyOS kernel manager.
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+#include "scx_sysfs.hpp"
+
+#include <cerrno>   // for errno
+#include <utility>  // for exchange
+
+#include <fcntl.h>   // for open
+#include <unistd.h>  // for pread, close
+
+namespace scx {
+
+SysfsFile::SysfsFile(std::string_view file_path) noexcept
+  : m_path(file_path) {
+    ensure_open();
+}
+
+SysfsFile::~SysfsFile() noexcept {
+    close();
+}
+
+SysfsFile::SysfsFile(SysfsFile&& other) noexcept
+  : m_path(std::move(other.m_path)), m_fd(std::exchange(other.m_fd, -1)) {
+}
+
+auto SysfsFile::operator=(SysfsFile&& other) noexcept -> SysfsFile& {
+    if (this != &other) {
+        close();
+        m_path = std::move(other.m_path);
+        m_fd   = std::exchange(other.m_fd, -1);
+    }
+    return *this;
+}
+
+auto SysfsFile::ensure_open() noexcept -> bool {
+    if (m_fd >= 0) {
+        return true;
+    }
+    m_fd = ::open(m_path.c_str(), O_RDONLY | O_CLOEXEC);  // NOLINT
+    return m_fd >= 0;
+}
+
+void SysfsFile::close() noexcept {
+    if (m_fd >= 0) {
+        ::close(m_fd);
+        m_fd = -1;
+    }
+}
+
+auto SysfsFile::read(std::span<char> buffer) noexcept -> std::string_view {
+    if (buffer.empty() || !ensure_open()) {
+        return {};
+    }
+
+    auto bytes_read = ::pread(m_fd, buffer.data(), buffer.size(), 0);
+    if (bytes_read < 0 && (errno == ENODEV || errno == ENOENT)) {
+        // the attribute was removed and possibly recreated, retry on a fresh descriptor
+        close();
+        if (!ensure_open()) {
+            return {};
+        }
+        bytes_read = ::pread(m_fd, buffer.data(), buffer.size(), 0);
+    }
+    if (bytes_read <= 0) {
+        return {};
+    }
+
+    std::string_view content{buffer.data(), static_cast<std::size_t>(bytes_read)};
+    while (!content.empty() && (content.back() == '\n' || content.back() == '\0')) {
+        content.remove_suffix(1);
+    }
+    return content;
+}
+
+}  // namespace scx
@@ -0,0 +1,73 @@
+// Copyright (C) 2024-2025 Vladislav Nepogodin
+//
+// This file is part of CachyOS kernel manager.
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+#ifndef SCX_SYSFS_HPP
+#define SCX_SYSFS_HPP
+
+#include <span>
+#include <string>
+#include <string_view>
+
+namespace scx {
+
+/// @brief Kernel attribute file, which is kept open between reads.
+///
+/// Reads are done with pread from offset 0 into caller-provided buffer,
+/// so reading the value doesn't allocate. The file is reopened lazily,
+/// if it didn't exist yet or the attribute was removed by the kernel.
+class SysfsFile final {
+ public:
+    explicit SysfsFile(std::string_view file_path) noexcept;
+    ~SysfsFile() noexcept;
+
+    SysfsFile(const SysfsFile&)                    = delete;
+    auto operator=(const SysfsFile&) -> SysfsFile& = delete;
+    SysfsFile(SysfsFile&& other) noexcept;
+    auto operator=(SysfsFile&& other) noexcept -> SysfsFile&;
+
+    /// @brief Reads the whole file into the buffer.
+    ///
+    /// Returns the content with trailing newline stripped, or an empty view on failure.
+    auto read(std::span<char> buffer) noexcept -> std::string_view;
+
+    /// @brief Returns the file descriptor, which can be polled for POLLPRI.
+    ///
+    /// Kernel raises POLLPRI on attributes it notifies about with sysfs_notify.
+    /// Returns -1 if the file isn't open.
+    [[nodiscard]] auto fd() const noexcept -> int { return m_fd; }
+
+    [[nodiscard]] auto path() const noexcept -> const std::string& { return m_path; }
+
+ private:
+    auto ensure_open() noexcept -> bool;
+    void close() noexcept;
+
+    std::string m_path;
+    int m_fd{-1};
+};
+
+namespace sched_ext {
+    inline constexpr std::string_view kStatePath{"/sys/kernel/sched_ext/state"};
+    inline constexpr std::string_view kRootOpsPath{"/sys/kernel/sched_ext/root/ops"};
+    // bumped on each attach, missing on older kernels
+    inline constexpr std::string_view kEnableSeqPath{"/sys/kernel/sched_ext/enable_seq"};
+}  // namespace sched_ext
+
+}  // namespace scx
+
+#endif  // SCX_SYSFS_HPP
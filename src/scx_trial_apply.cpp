@@ -0,0 +1,421 @@
+// Copyright (C) 2024-2025 Vladislav Nepogodin
+//
+// This file is part of CachyOS kernel manager.
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+#include "scx_trial_apply.hpp"
+
+#include <algorithm>     // for max, min
+#include <charconv>      // for from_chars
+#include <system_error>  // for errc
+
+#include <fmt/core.h>
+
+#if defined(__clang__)
+#pragma clang diagnostic push
+#pragma clang diagnostic ignored "-Wold-style-cast"
+#elif defined(__GNUC__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wnull-dereference"
+#pragma GCC diagnostic ignored "-Wuseless-cast"
+#pragma GCC diagnostic ignored "-Wold-style-cast"
+#pragma GCC diagnostic ignored "-Wsuggest-final-types"
+#pragma GCC diagnostic ignored "-Wsuggest-attribute=pure"
+#pragma GCC diagnostic ignored "-Wconversion"
+#endif
+
+#include <QTimer>
+
+#if defined(__clang__)
+#pragma clang diagnostic pop
+#elif defined(__GNUC__)
+#pragma GCC diagnostic pop
+#endif
+
+namespace {
+
+using scx::trial::monotonic_clock;
+
+constexpr std::size_t kReadBufSize = 256 * 1024;
+
+// Floors of the baseline for the ratio checks, below them the difference is noise
+constexpr double kRunDelayFloorUs        = 50.;
+constexpr double kContextSwitchRateFloor = 1000.;
+
+// Fields of the cpu lines in /proc/schedstat, after the cpu name
+constexpr std::size_t kSchedstatRunDelayField = 7;
+constexpr std::size_t kSchedstatPcountField   = 8;
+
+auto parse_u64(std::string_view str, std::uint64_t& value) noexcept -> bool {
+    const auto* str_end = str.data() + str.size();
+    auto [ptr, ec]      = std::from_chars(str.data(), str_end, value);
+    return ec == std::errc{} && ptr == str_end;
+}
+
+/// @brief Returns the next line of the content, and removes it from there.
+auto next_line(std::string_view& content) noexcept -> std::string_view {
+    const auto line_end = content.find('\n');
+    const auto line     = content.substr(0, line_end);
+    content.remove_prefix(line_end == std::string_view::npos ? content.size() : line_end + 1);
+    return line;
+}
+
+/// @brief Returns the next space separated field of the line, and removes it from there.
+auto next_field(std::string_view& line) noexcept -> std::string_view {
+    const auto field_start = line.find_first_not_of(' ');
+    if (field_start == std::string_view::npos) {
+        line = {};
+        return {};
+    }
+    line.remove_prefix(field_start);
+    const auto field_end = line.find(' ');
+    const auto field     = line.substr(0, field_end);
+    line.remove_prefix(field_end == std::string_view::npos ? line.size() : field_end);
+    return field;
+}
+
+/// @brief Rate of the counter per second, nullopt if it wasn't read or went backwards.
+auto counter_rate(const std::optional<std::uint64_t>& prev, const std::optional<std::uint64_t>& curr, double seconds) noexcept -> std::optional<double> {
+    if (!prev || !curr || *curr < *prev || seconds <= 0.) {
+        return std::nullopt;
+    }
+    return static_cast<double>(*curr - *prev) / seconds;
+}
+
+auto format_metric(const std::optional<double>& value) -> std::string {
+    return value ? fmt::format("{:.2f}", *value) : std::string{"n/a"};
+}
+
+}  // namespace
+
+namespace scx::trial {
+
+auto parse_cpu_stall_total(std::string_view content) noexcept -> std::optional<std::uint64_t> {
+    // "some avg10=0.00 avg60=0.00 avg300=0.00 total=12345"
+    while (!content.empty()) {
+        auto line = next_line(content);
+        if (next_field(line) != "some") {
+            continue;
+        }
+        for (auto field = next_field(line); !field.empty(); field = next_field(line)) {
+            std::uint64_t total{};
+            if (field.starts_with("total=") && parse_u64(field.substr(6), total)) {
+                return total;
+            }
+        }
+    }
+    return std::nullopt;
+}
+
+auto parse_schedstat(std::string_view content, std::uint64_t& run_delay_ns, std::uint64_t& timeslices) noexcept -> bool {
+    // "cpu0 yld_count legacy sched_count sched_goidle ttwu_count ttwu_local rq_cpu_time run_delay pcount"
+    run_delay_ns = 0;
+    timeslices   = 0;
+    bool has_cpus{};
+    while (!content.empty()) {
+        auto line = next_line(content);
+        if (!next_field(line).starts_with("cpu")) {
+            continue;
+        }
+        std::uint64_t cpu_run_delay{};
+        std::uint64_t cpu_timeslices{};
+        bool is_valid{true};
+        for (std::size_t field_idx = 0; field_idx <= kSchedstatPcountField && is_valid; ++field_idx) {
+            const auto field = next_field(line);
+            if (field_idx == kSchedstatRunDelayField) {
+                is_valid = parse_u64(field, cpu_run_delay);
+            } else if (field_idx == kSchedstatPcountField) {
+                is_valid = parse_u64(field, cpu_timeslices);
+            } else {
+                is_valid = !field.empty();
+            }
+        }
+        if (!is_valid) {
+            return false;
+        }
+        run_delay_ns += cpu_run_delay;
+        timeslices += cpu_timeslices;
+        has_cpus = true;
+    }
+    return has_cpus;
+}
+
+auto parse_context_switches(std::string_view content) noexcept -> std::optional<std::uint64_t> {
+    while (!content.empty()) {
+        auto line = next_line(content);
+        if (next_field(line) != "ctxt") {
+            continue;
+        }
+        std::uint64_t context_switches{};
+        if (parse_u64(next_field(line), context_switches)) {
+            return context_switches;
+        }
+        break;
+    }
+    return std::nullopt;
+}
+
+SystemSampler::SystemSampler()
+  : m_read_buf(kReadBufSize) { }
+
+auto SystemSampler::sample() noexcept -> SystemSample {
+    SystemSample sample{.timestamp = monotonic_clock::now()};
+    sample.cpu_stall_us = parse_cpu_stall_total(m_pressure_file.read(m_read_buf));
+
+    std::uint64_t run_delay_ns{};
+    std::uint64_t timeslices{};
+    // needs CONFIG_SCHEDSTATS, and the sysctl to be enabled for the values to move
+    if (parse_schedstat(m_schedstat_file.read(m_read_buf), run_delay_ns, timeslices)) {
+        sample.run_delay_ns = run_delay_ns;
+        sample.timeslices   = timeslices;
+    }
+    sample.context_switches = parse_context_switches(m_stat_file.read(m_read_buf));
+    return sample;
+}
+
+auto compute_trial_metrics(const SystemSample& prev, const SystemSample& curr) noexcept -> TrialMetrics {
+    const double seconds = std::chrono::duration<double>(curr.timestamp - prev.timestamp).count();
+
+    TrialMetrics metrics{};
+    if (auto stall_rate = counter_rate(prev.cpu_stall_us, curr.cpu_stall_us, seconds); stall_rate.has_value()) {
+        // microseconds of stall per second of wall time
+        metrics.cpu_pressure_pct = std::min(*stall_rate / 1e4, 100.);
+    }
+    if (prev.run_delay_ns && curr.run_delay_ns && prev.timeslices && curr.timeslices && *curr.timeslices > *prev.timeslices
+        && *curr.run_delay_ns >= *prev.run_delay_ns) {
+        const auto run_delay_ns = static_cast<double>(*curr.run_delay_ns - *prev.run_delay_ns);
+        metrics.run_delay_us    = run_delay_ns / 1e3 / static_cast<double>(*curr.timeslices - *prev.timeslices);
+    }
+    metrics.context_switch_rate = counter_rate(prev.context_switches, curr.context_switches, seconds);
+    return metrics;
+}
+
+auto find_regression(const TrialMetrics& baseline, const TrialMetrics& trial, const TrialConfig& config) -> std::optional<std::string> {
+    if (config.max_pressure_increase && baseline.cpu_pressure_pct && trial.cpu_pressure_pct
+        && *trial.cpu_pressure_pct > *baseline.cpu_pressure_pct + *config.max_pressure_increase) {
+        return fmt::format("CPU pressure {:.2f}% exceeds baseline {:.2f}% by more than {:.2f}pp", *trial.cpu_pressure_pct, *baseline.cpu_pressure_pct, *config.max_pressure_increase);
+    }
+    if (config.max_run_delay_ratio && baseline.run_delay_us && trial.run_delay_us
+        && *trial.run_delay_us > std::max(*baseline.run_delay_us, kRunDelayFloorUs) * *config.max_run_delay_ratio) {
+        return fmt::format("run queue delay {:.2f}us exceeds {:.2f}x baseline {:.2f}us", *trial.run_delay_us, *config.max_run_delay_ratio, *baseline.run_delay_us);
+    }
+    if (config.max_context_switch_ratio && baseline.context_switch_rate && trial.context_switch_rate
+        && *trial.context_switch_rate > std::max(*baseline.context_switch_rate, kContextSwitchRateFloor) * *config.max_context_switch_ratio) {
+        return fmt::format("context switch rate {:.0f}/s exceeds {:.2f}x baseline {:.0f}/s", *trial.context_switch_rate, *config.max_context_switch_ratio, *baseline.context_switch_rate);
+    }
+    return std::nullopt;
+}
+
+auto trial_phase_name(TrialPhase phase) noexcept -> std::string_view {
+    switch (phase) {
+    case TrialPhase::Idle:
+        return "idle";
+    case TrialPhase::Baseline:
+        return "baseline";
+    case TrialPhase::Switching:
+        return "switching";
+    case TrialPhase::Settling:
+        return "settling";
+    case TrialPhase::Observing:
+        return "observing";
+    case TrialPhase::RollingBack:
+        return "rolling back";
+    case TrialPhase::Committing:
+        return "committing";
+    }
+    return "unknown";
+}
+
+TrialApply::TrialApply(loader::Config& config, loader::ApplyExecutor& executor, TrialConfig trial_config, QObject* parent)
+  : QObject(parent), m_config(config), m_executor(executor), m_trial_config(std::move(trial_config)), m_timer(new QTimer(this)) {
+    m_timer->setSingleShot(true);
+    connect(m_timer, &QTimer::timeout, this, &TrialApply::on_timer);
+    connect(&m_executor, &loader::ApplyExecutor::finished, this, &TrialApply::on_executor_finished);
+}
+
+TrialApply::~TrialApply() = default;
+
+auto TrialApply::start(const loader::ApplyRequest& request) noexcept -> bool {
+    if (is_running() || m_executor.is_running() || request.kind != loader::ApplyRequest::Kind::Apply) {
+        return false;
+    }
+
+    m_candidate         = request;
+    m_candidate.persist = false;
+    if (auto default_sched = m_config.get_default_sched(); default_sched.has_value()) {
+        m_last_known_good = loader::ApplyRequest{
+            .kind       = loader::ApplyRequest::Kind::Apply,
+            .scx_sched  = std::move(default_sched->scx_sched),
+            .sched_mode = default_sched->sched_mode,
+            .extra_args = std::move(default_sched->extra_args),
+            .persist    = false,
+        };
+    } else {
+        m_last_known_good = loader::ApplyRequest{.kind = loader::ApplyRequest::Kind::Disable, .persist = false};
+    }
+    m_result    = TrialResult{};
+    m_reference = m_sampler.sample();
+
+    set_phase(TrialPhase::Baseline);
+    m_timer->start(m_trial_config.baseline);
+    return true;
+}
+
+void TrialApply::cancel() noexcept {
+    switch (m_phase) {
+    case TrialPhase::Idle:
+    case TrialPhase::RollingBack:
+    case TrialPhase::Committing:
+        // already on the way out
+        break;
+    case TrialPhase::Baseline:
+        m_timer->stop();
+        finish(TrialOutcome::Canceled, "canceled before the switch");
+        break;
+    case TrialPhase::Switching:
+    case TrialPhase::Settling:
+    case TrialPhase::Observing:
+        roll_back(TrialOutcome::Canceled, "canceled");
+        break;
+    }
+}
+
+void TrialApply::set_phase(TrialPhase phase) noexcept {
+    m_phase = phase;
+    emit phase_changed(phase);
+}
+
+void TrialApply::submit(loader::ApplyRequest request) noexcept {
+    m_submitted = request;
+    m_executor.submit(std::move(request));
+}
+
+void TrialApply::on_timer() noexcept {
+    switch (m_phase) {
+    case TrialPhase::Baseline:
+        m_result.baseline = compute_trial_metrics(m_reference, m_sampler.sample());
+        set_phase(TrialPhase::Switching);
+        submit(m_candidate);
+        break;
+    case TrialPhase::Settling:
+        // the trial metrics are measured from here on
+        m_reference = m_sampler.sample();
+        set_phase(TrialPhase::Observing);
+        m_timer->start(m_trial_config.check_interval);
+        break;
+    case TrialPhase::Observing:
+        observe();
+        break;
+    default:
+        break;
+    }
+}
+
+void TrialApply::observe() noexcept {
+    const auto sample = m_sampler.sample();
+    // judge once the trial was measured at least as long as the baseline, so the noise is comparable
+    if (sample.timestamp - m_reference.timestamp >= m_trial_config.baseline) {
+        m_result.trial = compute_trial_metrics(m_reference, sample);
+        if (auto regression = find_regression(m_result.baseline, m_result.trial, m_trial_config); regression.has_value()) {
+            roll_back(TrialOutcome::RolledBack, std::move(*regression));
+            return;
+        }
+    }
+
+    if (sample.timestamp - m_switched_at < m_trial_config.window) {
+        m_timer->start(m_trial_config.check_interval);
+        return;
+    }
+    set_phase(TrialPhase::Committing);
+    auto persist_request = m_candidate;
+    persist_request.kind = loader::ApplyRequest::Kind::Persist;
+    submit(std::move(persist_request));
+}
+
+void TrialApply::roll_back(TrialOutcome outcome, std::string reason) noexcept {
+    m_timer->stop();
+    m_result.outcome = outcome;
+    m_result.reason  = std::move(reason);
+    if (m_phase == TrialPhase::Switching) {
+        // the candidate may still be queued, the rollback replaces it
+        m_executor.cancel();
+    }
+    set_phase(TrialPhase::RollingBack);
+    submit(m_last_known_good);
+}
+
+void TrialApply::finish(TrialOutcome outcome, std::string reason) noexcept {
+    m_submitted.reset();
+    m_result.outcome = outcome;
+    m_result.reason  = std::move(reason);
+    set_phase(TrialPhase::Idle);
+    emit finished(m_result);
+}
+
+void TrialApply::on_executor_finished(const loader::ApplyRequest& request, bool succeeded, bool canceled) noexcept {
+    if (!m_submitted || request != *m_submitted) {
+        return;
+    }
+    m_submitted.reset();
+
+    switch (m_phase) {
+    case TrialPhase::Switching:
+        if (!succeeded || canceled) {
+            roll_back(TrialOutcome::Failed, fmt::format("{} didn't start", m_candidate.scx_sched));
+            return;
+        }
+        // scx_loader failing to start the scheduler doesn't fail the request
+        m_executor.loader_snapshot().then(this, [this](std::optional<loader::LoaderSnapshot> snapshot) {
+            if (m_phase != TrialPhase::Switching) {
+                // canceled meanwhile
+                return;
+            }
+            if (!snapshot || snapshot->current_sched != m_candidate.scx_sched) {
+                roll_back(TrialOutcome::Failed, fmt::format("{} didn't start", m_candidate.scx_sched));
+                return;
+            }
+            m_switched_at = monotonic_clock::now();
+            set_phase(TrialPhase::Settling);
+            m_timer->start(m_trial_config.settle);
+        });
+        break;
+    case TrialPhase::RollingBack: {
+        auto reason = std::move(m_result.reason);
+        if (!succeeded) {
+            reason += "; failed to restore the previous scheduler";
+            fmt::print(stderr, "trial: failed to restore {}\n", m_last_known_good.scx_sched.empty() ? std::string{"disabled state"} : m_last_known_good.scx_sched);
+        }
+        finish(m_result.outcome, std::move(reason));
+        break;
+    }
+    case TrialPhase::Committing:
+        if (succeeded) {
+            finish(TrialOutcome::Committed, {});
+        } else {
+            // the new scheduler keeps running, only it won't be started on boot
+            finish(TrialOutcome::Failed, "failed to write the config");
+        }
+        break;
+    default:
+        break;
+    }
+}
+
+auto format_trial_metrics(const TrialMetrics& metrics) -> std::string {
+    return fmt::format("cpu_pressure={}% run_delay={}us context_switches={}/s", format_metric(metrics.cpu_pressure_pct), format_metric(metrics.run_delay_us), format_metric(metrics.context_switch_rate));
+}
+
+}  // namespace scx::trial
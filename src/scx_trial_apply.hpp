@@ -0,0 +1,224 @@
+// Copyright (C) 2024-2025 Vladislav Nepogodin
+//
+// This file is part of CachyOS kernel manager.
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+#ifndef SCX_TRIAL_APPLY_HPP
+#define SCX_TRIAL_APPLY_HPP
+
+#include "scx_apply_executor.hpp"
+#include "scx_sysfs.hpp"
+#include "scx_utils.hpp"
+
+#include <chrono>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#if defined(__clang__)
+#pragma clang diagnostic push
+#pragma clang diagnostic ignored "-Wsign-conversion"
+#pragma clang diagnostic ignored "-Wshorten-64-to-32"
+#elif defined(__GNUC__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wuseless-cast"
+#pragma GCC diagnostic ignored "-Wsign-conversion"
+#pragma GCC diagnostic ignored "-Wconversion"
+#pragma GCC diagnostic ignored "-Wsuggest-final-methods"
+#pragma GCC diagnostic ignored "-Wsuggest-attribute=pure"
+#endif
+
+#include <QObject>
+
+#if defined(__clang__)
+#pragma clang diagnostic pop
+#elif defined(__GNUC__)
+#pragma GCC diagnostic pop
+#endif
+
+class QTimer;
+
+namespace scx::trial {
+
+using monotonic_clock = std::chrono::steady_clock;
+
+/// @brief Cumulative system counters, read at one point in time.
+///
+/// Counters which couldn't be read, e.g kernel without PSI, are nullopt.
+struct SystemSample {
+    monotonic_clock::time_point timestamp{};
+    /// Total time some task was stalled waiting for CPU, in microseconds
+    std::optional<std::uint64_t> cpu_stall_us{};
+    /// Time tasks spent waiting on the run queues of all CPUs, in nanoseconds
+    std::optional<std::uint64_t> run_delay_ns{};
+    /// Number of timeslices run on all CPUs
+    std::optional<std::uint64_t> timeslices{};
+    std::optional<std::uint64_t> context_switches{};
+};
+
+/// @brief Parses "some total" out of /proc/pressure/cpu content.
+auto parse_cpu_stall_total(std::string_view content) noexcept -> std::optional<std::uint64_t>;
+
+/// @brief Sums run delay and timeslices of all CPUs out of /proc/schedstat content.
+auto parse_schedstat(std::string_view content, std::uint64_t& run_delay_ns, std::uint64_t& timeslices) noexcept -> bool;
+
+/// @brief Parses "ctxt" out of /proc/stat content.
+auto parse_context_switches(std::string_view content) noexcept -> std::optional<std::uint64_t>;
+
+/// @brief Reads the system counters, keeping the files open between samples.
+class SystemSampler final {
+ public:
+    SystemSampler();
+
+    auto sample() noexcept -> SystemSample;
+
+ private:
+    SysfsFile m_pressure_file{"/proc/pressure/cpu"};
+    SysfsFile m_schedstat_file{"/proc/schedstat"};
+    SysfsFile m_stat_file{"/proc/stat"};
+    /// /proc/stat and /proc/schedstat grow with the number of CPUs and interrupts
+    std::vector<char> m_read_buf;
+};
+
+/// @brief Metrics of the scheduler over a period between two samples.
+struct TrialMetrics {
+    /// Share of the time some task was stalled waiting for CPU, in percents
+    std::optional<double> cpu_pressure_pct{};
+    /// Mean time a task waited on the run queue per timeslice, in microseconds
+    std::optional<double> run_delay_us{};
+    /// Context switches per second
+    std::optional<double> context_switch_rate{};
+};
+
+auto compute_trial_metrics(const SystemSample& prev, const SystemSample& curr) noexcept -> TrialMetrics;
+
+/// @brief Formats the metrics for logs, e.g "cpu_pressure=1.20% run_delay=n/a context_switches=5321.00/s".
+auto format_trial_metrics(const TrialMetrics& metrics) -> std::string;
+
+struct TrialConfig {
+    /// Time the new scheduler runs on trial before it is committed
+    std::chrono::seconds window{120};
+    /// Time the metrics are measured for, before the switch
+    std::chrono::seconds baseline{10};
+    /// Time after the switch the metrics aren't measured, while the scheduler warms up
+    std::chrono::seconds settle{5};
+    std::chrono::milliseconds check_interval{1000};
+    /// Regressions against the baseline which roll the trial back, nullopt disables the check.
+    /// Increase of the CPU pressure, in percentage points
+    std::optional<double> max_pressure_increase{10.};
+    std::optional<double> max_run_delay_ratio{1.5};
+    std::optional<double> max_context_switch_ratio{3.};
+};
+
+/// @brief Returns the description of the first regressed metric, or nullopt.
+///
+/// Ratios are taken against small floors, so an idle baseline doesn't make noise a regression.
+auto find_regression(const TrialMetrics& baseline, const TrialMetrics& trial, const TrialConfig& config) -> std::optional<std::string>;
+
+enum class TrialPhase : std::uint8_t {
+    Idle,
+    /// Measuring the metrics of the running scheduler
+    Baseline,
+    Switching,
+    Settling,
+    /// New scheduler is running, its metrics are compared to the baseline
+    Observing,
+    RollingBack,
+    /// Writing the config for the new scheduler
+    Committing,
+};
+
+auto trial_phase_name(TrialPhase phase) noexcept -> std::string_view;
+
+enum class TrialOutcome : std::uint8_t {
+    Committed,
+    /// Metrics regressed, the last-known-good scheduler was restored
+    RolledBack,
+    /// Switch or commit failed
+    Failed,
+    Canceled,
+};
+
+struct TrialResult {
+    TrialOutcome outcome{};
+    /// Regression, or the failure, empty if committed
+    std::string reason;
+    TrialMetrics baseline{};
+    /// Metrics since the scheduler settled, until the trial ended
+    TrialMetrics trial{};
+};
+
+/// @brief Applies the scheduler on trial, and rolls it back if the metrics regress.
+///
+/// The last-known-good scheduler is the default one of the scx_loader config.
+/// The new scheduler only replaces the running one, the units and the config are
+/// set up once the trial window passes without a regression. On regression, failure
+/// or cancel the last-known-good scheduler is switched back to, or the scheduler is
+/// stopped if the config has none, so the units never have to be restored.
+class TrialApply final : public QObject {
+    Q_OBJECT
+    Q_DISABLE_COPY_MOVE(TrialApply)
+ public:
+    /// @brief Config and executor must outlive the trial.
+    TrialApply(loader::Config& config, loader::ApplyExecutor& executor, TrialConfig trial_config, QObject* parent = nullptr);
+    ~TrialApply() override;
+
+    /// @brief Starts the trial of the scheduler.
+    ///
+    /// Returns false if a trial or another request is in progress.
+    auto start(const loader::ApplyRequest& request) noexcept -> bool;
+
+    /// @brief Ends the trial in progress, rolling back the new scheduler.
+    void cancel() noexcept;
+
+    [[nodiscard]] auto is_running() const noexcept -> bool { return m_phase != TrialPhase::Idle; }
+    [[nodiscard]] auto phase() const noexcept -> TrialPhase { return m_phase; }
+    [[nodiscard]] auto config() const noexcept -> const TrialConfig& { return m_trial_config; }
+
+ signals:
+    void phase_changed(scx::trial::TrialPhase phase);
+    void finished(const scx::trial::TrialResult& result);
+
+ private:
+    void set_phase(TrialPhase phase) noexcept;
+    void on_timer() noexcept;
+    void on_executor_finished(const loader::ApplyRequest& request, bool succeeded, bool canceled) noexcept;
+    void observe() noexcept;
+    void roll_back(TrialOutcome outcome, std::string reason) noexcept;
+    void finish(TrialOutcome outcome, std::string reason) noexcept;
+    void submit(loader::ApplyRequest request) noexcept;
+
+    loader::Config& m_config;
+    loader::ApplyExecutor& m_executor;
+    TrialConfig m_trial_config;
+    SystemSampler m_sampler;
+    TrialPhase m_phase{TrialPhase::Idle};
+
+    loader::ApplyRequest m_candidate{};
+    loader::ApplyRequest m_last_known_good{};
+    /// Request submitted to the executor, whose result is awaited
+    std::optional<loader::ApplyRequest> m_submitted{};
+    SystemSample m_reference{};
+    monotonic_clock::time_point m_switched_at{};
+    TrialResult m_result{};
+    QTimer* m_timer{};
+};
+
+}  // namespace scx::trial
+
+#endif  // SCX_TRIAL_APPLY_HPP
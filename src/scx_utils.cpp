@@ -18,24 +18,28 @@
 
 #include "scx_utils.hpp"
 
+#include <algorithm>  // for ranges::equal, ranges::find_if
+#include <array>      // for array
+#include <cctype>     // for tolower
+#include <cerrno>     // for errno
+#include <cstring>    // for strcmp, strerror
+
+#include <sys/inotify.h>  // for inotify_init1, inotify_add_watch
+#include <unistd.h>       // for read, close
+
+#include <fmt/core.h>
+
 #if defined(__clang__)
 #pragma clang diagnostic push
 #pragma clang diagnostic ignored "-Wold-style-cast"
-#pragma clang diagnostic ignored "-Wdollar-in-identifier-extension"
-#pragma clang diagnostic ignored "-Wsign-conversion"
-#pragma clang diagnostic ignored "-Wdeprecated-this-capture"
 #elif defined(__GNUC__)
 #pragma GCC diagnostic push
-#pragma GCC diagnostic ignored "-Wnull-dereference"
 #pragma GCC diagnostic ignored "-Wuseless-cast"
 #pragma GCC diagnostic ignored "-Wold-style-cast"
-#pragma GCC diagnostic ignored "-Wsuggest-final-types"
-#pragma GCC diagnostic ignored "-Wsuggest-attribute=pure"
 #pragma GCC diagnostic ignored "-Wconversion"
-#pragma GCC diagnostic ignored "-Wsign-conversion"
 #endif
 
-#include "scx-lib-cxxbridge/lib.h"
+#include <QProcess>
 
 #if defined(__clang__)
 #pragma clang diagnostic pop
@@ -43,66 +47,176 @@
 #pragma GCC diagnostic pop
 #endif
 
-#include <fmt/core.h>
-
 namespace {
 
-auto convert_rust_vec_string(auto&& rust_vec) -> std::vector<std::string> {
-    std::vector<std::string> res_vec{};
-    res_vec.reserve(rust_vec.size());
-    for (auto&& rust_vec_el : rust_vec) {
-        res_vec.emplace_back(std::string{rust_vec_el});
-    }
-    return res_vec;
+// Strings are decoded straight from the Rust buffers, one allocation per string
+auto to_qstring(::rust::Str str) -> QString {
+    return QString::fromUtf8(str.data(), static_cast<qsizetype>(str.size()));
 }
 
-auto convert_std_vec_into_stringlist(std::vector<std::string>&& std_vec) -> QStringList {
-    QStringList flags;
-    flags.reserve(static_cast<qsizetype>(std_vec.size()));
-    for (auto&& vec_el : std_vec) {
-        flags << QString::fromStdString(vec_el);
+auto to_string_list(::rust::Slice<const ::rust::String> strings) -> QStringList {
+    QStringList string_list;
+    string_list.reserve(static_cast<qsizetype>(strings.size()));
+    for (auto&& str : strings) {
+        string_list << to_qstring(str);
     }
-    return flags;
+    return string_list;
+}
+
+auto to_string_list(const ::rust::Vec<::rust::String>& strings) -> QStringList {
+    return to_string_list(::rust::Slice<const ::rust::String>{strings.data(), strings.size()});
 }
 
-auto get_scx_mode_from_raw(std::uint8_t raw_mode) noexcept -> scx::SchedMode {
-    switch (raw_mode) {
-    case 0:
-        return scx::SchedMode::Auto;
-    case 1:
-        return scx::SchedMode::Gaming;
-    case 2:
-        return scx::SchedMode::PowerSave;
-    case 3:
-        return scx::SchedMode::LowLatency;
-    case 4:
-        return scx::SchedMode::Server;
-    default:
-        fmt::print(stderr, "SchedMode with such value doesn't exist: {}\n", raw_mode);
-        break;
+auto to_rust_args(const QStringList& args) -> ::rust::Vec<::rust::String> {
+    ::rust::Vec<::rust::String> rust_args;
+    rust_args.reserve(static_cast<std::size_t>(args.size()));
+    for (auto&& arg : args) {
+        // transcoded from UTF-16 by Rust, without intermediate std::string
+        rust_args.emplace_back(reinterpret_cast<const char16_t*>(arg.utf16()), static_cast<std::size_t>(arg.size()));
     }
-    return scx::SchedMode::Auto;
+    return rust_args;
 }
 
+auto to_change_plan(const ::scx_loader::ChangePlan& rust_plan) -> scx::loader::ChangePlan {
+    return scx::loader::ChangePlan{
+        .stop_scx_service      = rust_plan.stop_scx_service,
+        .switch_scheduler      = rust_plan.switch_scheduler,
+        .enable_loader_service = rust_plan.enable_loader_service,
+        .stop_scheduler        = rust_plan.stop_scheduler,
+        .write_config          = rust_plan.write_config,
+        .reasons               = to_string_list(rust_plan.reasons),
+    };
+}
+
+constexpr std::array kSchedModeNames{
+    std::string_view{"auto"},
+    std::string_view{"gaming"},
+    std::string_view{"powersave"},
+    std::string_view{"lowlatency"},
+    std::string_view{"server"},
+};
+
+constexpr std::size_t kSchedModeCount = kSchedModeNames.size();
+static_assert(static_cast<std::size_t>(scx::SchedMode::Server) + 1 == kSchedModeCount);
+
 }  // namespace
 
-namespace scx::loader {
+namespace scx {
 
-auto get_supported_scheds() noexcept -> std::optional<QStringList> {
-    try {
-        auto rust_vec  = ::scx_loader::get_supported_scheds();
-        auto flags_vec = convert_rust_vec_string(std::move(rust_vec));
-        return convert_std_vec_into_stringlist(std::move(flags_vec));
-    } catch (const std::exception& e) {
-        fmt::print(stderr, "Failed to get supported schedulers: {}\n", e.what());
+auto sched_mode_name(SchedMode sched_mode) noexcept -> std::string_view {
+    const auto mode_idx = static_cast<std::size_t>(sched_mode);
+    if (mode_idx >= kSchedModeNames.size()) {
+        return kSchedModeNames[0];
+    }
+    return kSchedModeNames[mode_idx];
+}
+
+auto sched_mode_from_name(std::string_view mode_name) noexcept -> std::optional<SchedMode> {
+    const auto equals_ignore_case = [](std::string_view lhs, std::string_view rhs) {
+        return std::ranges::equal(lhs, rhs, [](char lhs_ch, char rhs_ch) { return std::tolower(static_cast<unsigned char>(lhs_ch)) == std::tolower(static_cast<unsigned char>(rhs_ch)); });
+    };
+    for (std::size_t mode_idx = 0; mode_idx < kSchedModeNames.size(); ++mode_idx) {
+        if (equals_ignore_case(mode_name, kSchedModeNames[mode_idx])) {
+            return static_cast<SchedMode>(mode_idx);
+        }
     }
     return std::nullopt;
 }
 
+auto split_sched_args(const QString& args_text) -> QStringList {
+    return QProcess::splitCommand(args_text);
+}
+
+auto join_sched_args(const QStringList& args) -> QString {
+    QStringList quoted_args;
+    quoted_args.reserve(args.size());
+    for (auto&& arg : args) {
+        if (arg.isEmpty() || arg.contains(QLatin1Char(' ')) || arg.contains(QLatin1Char('"'))) {
+            // splitCommand treats triple quotes as a literal quote
+            auto escaped_arg = arg;
+            quoted_args << QLatin1Char('"') + escaped_arg.replace(QLatin1Char('"'), QStringLiteral("\"\"\"")) + QLatin1Char('"');
+        } else {
+            quoted_args << arg;
+        }
+    }
+    return quoted_args.join(QLatin1Char(' '));
+}
+
+}  // namespace scx
+
+namespace scx::loader {
+
+/// @brief Flags of all modes for the supported schedulers, and inotify watch of the config file.
+///
+/// The directory is watched rather than the file itself, as editors and cp replace the file.
+struct Config::FlagsCache {
+    struct SchedFlags {
+        std::string scx_sched;
+        std::array<QStringList, kSchedModeCount> mode_flags{};
+    };
+
+    explicit FlagsCache(std::string_view config_file_path) : config_path(config_file_path) {
+        const auto sep_pos = config_path.rfind('/');
+        const auto dir     = (sep_pos == std::string::npos) ? std::string{"."} : config_path.substr(0, sep_pos);
+        config_file_name   = (sep_pos == std::string::npos) ? config_path : config_path.substr(sep_pos + 1);
+
+        inotify_fd = ::inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+        if (inotify_fd >= 0 && ::inotify_add_watch(inotify_fd, dir.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE | IN_DELETE) < 0) {
+            // without the watch the cache is never invalidated
+            fmt::print(stderr, "Failed to watch {} for config changes: {}\n", dir, std::strerror(errno));
+        }
+    }
+    ~FlagsCache() noexcept {
+        if (inotify_fd >= 0) {
+            ::close(inotify_fd);
+        }
+    }
+
+    FlagsCache(const FlagsCache&)                    = delete;
+    auto operator=(const FlagsCache&) -> FlagsCache& = delete;
+
+    /// @brief Drains pending events, returns whether any of them touched the config file.
+    auto config_file_changed() const noexcept -> bool {
+        if (inotify_fd < 0) {
+            return false;
+        }
+        bool is_changed{};
+        alignas(inotify_event) std::array<char, 4096> events_buf;
+        while (true) {
+            const auto read_len = ::read(inotify_fd, events_buf.data(), events_buf.size());
+            if (read_len <= 0) {
+                // EAGAIN, nothing happened since the last check
+                break;
+            }
+            for (std::size_t offset = 0; offset < static_cast<std::size_t>(read_len);) {
+                const auto* event = reinterpret_cast<const inotify_event*>(events_buf.data() + offset);
+                if ((event->mask & IN_Q_OVERFLOW) != 0 || (event->len > 0 && std::strcmp(event->name, config_file_name.c_str()) == 0)) {
+                    is_changed = true;
+                }
+                offset += sizeof(inotify_event) + event->len;
+            }
+        }
+        return is_changed;
+    }
+
+    std::string config_path;
+    std::string config_file_name;
+    QStringList scx_scheds;
+    std::vector<SchedFlags> rows;
+    int inotify_fd{-1};
+};
+
+Config::Config(::rust::Box<::scx_loader::Config>&& config, std::unique_ptr<FlagsCache>&& flags_cache) noexcept
+  : m_config(std::move(config)), m_flags_cache(std::move(flags_cache)) { }
+
+Config::Config(Config&&) noexcept                    = default;
+auto Config::operator=(Config&&) noexcept -> Config& = default;
+Config::~Config()                                    = default;
+
 auto Config::init_config(std::string_view filepath) noexcept -> std::optional<Config> {
     try {
         const ::rust::Str filepath_rust(filepath.data(), filepath.size());
-        auto&& config = Config(scx_loader::init_config_file(filepath_rust));
+        auto&& config = Config(scx_loader::init_config_file(filepath_rust), std::make_unique<FlagsCache>(filepath));
         return std::make_optional<Config>(std::move(config));
     } catch (const std::exception& e) {
         fmt::print(stderr, "Failed to parse init config: {}\n", e.what());
@@ -110,24 +224,91 @@ auto Config::init_config(std::string_view filepath) noexcept -> std::optional<Co
     return std::nullopt;
 }
 
+void Config::prime_flags_cache(const QStringList& scx_scheds) noexcept {
+    if (!m_flags_cache) {
+        return;
+    }
+    m_flags_cache->scx_scheds = scx_scheds;
+    m_flags_cache->rows.clear();
+    try {
+        // one call for the whole matrix, instead of one per combo box change
+        const auto flags_matrix = m_config->get_scx_flags_matrix(to_rust_args(scx_scheds));
+        for (auto&& entry : flags_matrix) {
+            const auto mode_idx = static_cast<std::size_t>(entry.mode);
+            if (mode_idx >= kSchedModeCount) {
+                continue;
+            }
+            const std::string_view entry_sched{entry.sched.data(), entry.sched.size()};
+            auto row_it = std::ranges::find_if(m_flags_cache->rows, [entry_sched](auto&& row) { return row.scx_sched == entry_sched; });
+            if (row_it == m_flags_cache->rows.end()) {
+                row_it = m_flags_cache->rows.insert(row_it, FlagsCache::SchedFlags{.scx_sched = std::string{entry_sched}});
+            }
+            row_it->mode_flags[mode_idx] = to_string_list(entry.flags);
+        }
+    } catch (const std::exception& e) {
+        fmt::print(stderr, "Failed to compute scx flags: {}\n", e.what());
+        m_flags_cache->rows.clear();
+    }
+}
+
+void Config::refresh_flags_cache() noexcept {
+    if (!m_flags_cache || !m_flags_cache->config_file_changed()) {
+        return;
+    }
+    try {
+        const ::rust::Str filepath_rust(m_flags_cache->config_path.data(), m_flags_cache->config_path.size());
+        m_config->reload_config(filepath_rust);
+    } catch (const std::exception& e) {
+        // e.g the file is being rewritten right now, next change will reload it again
+        fmt::print(stderr, "Failed to reload config: {}\n", e.what());
+    }
+    prime_flags_cache(QStringList{m_flags_cache->scx_scheds});
+}
+
 auto Config::scx_flags_for_mode(std::string_view scx_sched, SchedMode sched_mode) noexcept -> std::optional<QStringList> {
+    refresh_flags_cache();
+    if (m_flags_cache) {
+        const auto mode_idx = static_cast<std::size_t>(sched_mode);
+        const auto row_it   = std::ranges::find_if(m_flags_cache->rows, [scx_sched](auto&& row) { return row.scx_sched == scx_sched; });
+        if (row_it != m_flags_cache->rows.end() && mode_idx < kSchedModeCount) {
+            // QStringList is implicitly shared, copying it doesn't allocate
+            return row_it->mode_flags[mode_idx];
+        }
+    }
+
     try {
         const ::rust::Str scx_sched_rust(scx_sched.data(), scx_sched.size());
-        auto rust_vec  = m_config->get_scx_flags_for_mode(scx_sched_rust, static_cast<std::uint32_t>(sched_mode));
-        auto flags_vec = convert_rust_vec_string(std::move(rust_vec));
-        return convert_std_vec_into_stringlist(std::move(flags_vec));
+        return to_string_list(m_config->get_scx_flags_for_mode(scx_sched_rust, sched_mode));
     } catch (const std::exception& e) {
         fmt::print(stderr, "Failed to get scx flag for the mode: {}\n", e.what());
     }
     return std::nullopt;
 }
 
-auto Config::apply_scheduler_change(std::string_view scx_sched, SchedMode sched_mode, std::string_view extra_flags, std::string_view filepath) noexcept -> bool {
+auto Config::get_default_sched() noexcept -> std::optional<DefaultSched> {
+    // pick up the changes done by other tools
+    refresh_flags_cache();
+    try {
+        const auto rust_default_sched = m_config->get_default_sched();
+        if (rust_default_sched.sched.empty()) {
+            return std::nullopt;
+        }
+        return DefaultSched{
+            .scx_sched  = std::string{rust_default_sched.sched},
+            .sched_mode = rust_default_sched.mode,
+            .extra_args = to_string_list(rust_default_sched.args),
+        };
+    } catch (const std::exception& e) {
+        fmt::print(stderr, "Failed to get default scheduler: {}\n", e.what());
+    }
+    return std::nullopt;
+}
+
+auto Config::apply_scheduler_change(std::string_view scx_sched, SchedMode sched_mode, const QStringList& extra_args, std::string_view filepath) noexcept -> bool {
     try {
         const ::rust::Str scx_sched_rust(scx_sched.data(), scx_sched.size());
-        const ::rust::Str extra_flags_rust(extra_flags.data(), extra_flags.size());
         const ::rust::Str filepath_rust(filepath.data(), filepath.size());
-        m_config->apply_scheduler_change(scx_sched_rust, static_cast<std::uint32_t>(sched_mode), extra_flags_rust, filepath_rust);
+        m_config->apply_scheduler_change(scx_sched_rust, sched_mode, to_rust_args(extra_args), filepath_rust);
         return true;
     } catch (const std::exception& e) {
         fmt::print(stderr, "Failed to apply scx scheduler change: {}\n", e.what());
@@ -146,6 +327,94 @@ auto Config::disable_scheduler(std::string_view filepath) noexcept -> bool {
     return false;
 }
 
+auto Config::plan_scheduler_change(std::string_view scx_sched, SchedMode sched_mode, const QStringList& extra_args, bool persist, std::string_view filepath) noexcept -> std::optional<ChangePlan> {
+    try {
+        const ::rust::Str scx_sched_rust(scx_sched.data(), scx_sched.size());
+        const ::rust::Str filepath_rust(filepath.data(), filepath.size());
+        return to_change_plan(m_config->plan_scheduler_change(scx_sched_rust, sched_mode, to_rust_args(extra_args), persist, filepath_rust));
+    } catch (const std::exception& e) {
+        fmt::print(stderr, "Failed to plan scx scheduler change: {}\n", e.what());
+    }
+    return std::nullopt;
+}
+
+auto Config::plan_disable(bool persist, std::string_view filepath) noexcept -> std::optional<ChangePlan> {
+    try {
+        const ::rust::Str filepath_rust(filepath.data(), filepath.size());
+        return to_change_plan(m_config->plan_disable(persist, filepath_rust));
+    } catch (const std::exception& e) {
+        fmt::print(stderr, "Failed to plan scx scheduler disable: {}\n", e.what());
+    }
+    return std::nullopt;
+}
+
+auto Config::stop_scx_service() noexcept -> ScxServiceAction {
+    return m_config->stop_scx_service();
+}
+
+auto Config::restore_scx_service(ScxServiceAction action) noexcept -> bool {
+    try {
+        m_config->restore_scx_service(action);
+        return true;
+    } catch (const std::exception& e) {
+        fmt::print(stderr, "Failed to restore scx service: {}\n", e.what());
+    }
+    return false;
+}
+
+auto Config::switch_scheduler(std::string_view scx_sched, SchedMode sched_mode, const QStringList& extra_args) noexcept -> bool {
+    try {
+        const ::rust::Str scx_sched_rust(scx_sched.data(), scx_sched.size());
+        m_config->switch_scheduler(scx_sched_rust, sched_mode, to_rust_args(extra_args));
+        return true;
+    } catch (const std::exception& e) {
+        fmt::print(stderr, "Failed to switch scx scheduler: {}\n", e.what());
+    }
+    return false;
+}
+
+auto Config::switch_mode(std::string_view scx_sched, SchedMode sched_mode) noexcept -> bool {
+    // empty args aren't the default ones, the flags of the mode have to be passed explicitly
+    return switch_scheduler(scx_sched, sched_mode, scx_flags_for_mode(scx_sched, sched_mode).value_or(QStringList{}));
+}
+
+void Config::enable_loader_service() noexcept {
+    m_config->enable_loader_service();
+}
+
+auto Config::write_scheduler_config(std::string_view scx_sched, SchedMode sched_mode, const QStringList& extra_args, std::string_view filepath) noexcept -> bool {
+    try {
+        const ::rust::Str scx_sched_rust(scx_sched.data(), scx_sched.size());
+        const ::rust::Str filepath_rust(filepath.data(), filepath.size());
+        m_config->write_scheduler_config(scx_sched_rust, sched_mode, to_rust_args(extra_args), filepath_rust);
+        return true;
+    } catch (const std::exception& e) {
+        fmt::print(stderr, "Failed to write scx scheduler config: {}\n", e.what());
+    }
+    return false;
+}
+
+auto Config::stop_scheduler() noexcept -> bool {
+    try {
+        m_config->stop_scheduler();
+        return true;
+    } catch (const std::exception& e) {
+        fmt::print(stderr, "Failed to stop scx scheduler: {}\n", e.what());
+    }
+    return false;
+}
+
+auto Config::write_disabled_config(std::string_view filepath) noexcept -> bool {
+    try {
+        const ::rust::Str filepath_rust(filepath.data(), filepath.size());
+        m_config->write_disabled_config(filepath_rust);
+        return true;
+    } catch (const std::exception& e) {
+        fmt::print(stderr, "Failed to write disabled scx_loader config: {}\n", e.what());
+    }
+    return false;
+}
+
 auto Config::get_current_sched() noexcept -> std::optional<std::string> {
     try {
         auto current_sched = m_config->get_current_sched();
@@ -158,12 +427,64 @@ auto Config::get_current_sched() noexcept -> std::optional<std::string> {
 
 auto Config::get_current_mode() noexcept -> std::optional<SchedMode> {
     try {
-        auto raw_mode = m_config->get_current_mode();
-        return get_scx_mode_from_raw(raw_mode);
+        return m_config->get_current_mode();
     } catch (const std::exception& e) {
         fmt::print(stderr, "Failed to get currently running scx mode: {}\n", e.what());
     }
     return std::nullopt;
 }
 
+auto Config::get_supported_scheds() noexcept -> std::optional<QStringList> {
+    try {
+        return to_string_list(m_config->get_supported_scheds());
+    } catch (const std::exception& e) {
+        fmt::print(stderr, "Failed to get supported schedulers: {}\n", e.what());
+    }
+    return std::nullopt;
+}
+
+auto Config::get_loader_snapshot() noexcept -> std::optional<LoaderSnapshot> {
+    try {
+        const auto rust_snapshot = m_config->get_loader_snapshot();
+        return LoaderSnapshot{
+            .supported_scheds = to_string_list(rust_snapshot.supported_scheds),
+            .current_sched    = std::string{rust_snapshot.current_sched},
+            .current_mode     = rust_snapshot.current_mode,
+        };
+    } catch (const std::exception& e) {
+        fmt::print(stderr, "Failed to get scx_loader state: {}\n", e.what());
+    }
+    return std::nullopt;
+}
+
+auto Config::watch_loader_state() noexcept -> std::optional<int> {
+    try {
+        return m_config->watch_loader_state();
+    } catch (const std::exception& e) {
+        fmt::print(stderr, "Failed to watch scx_loader state: {}\n", e.what());
+    }
+    return std::nullopt;
+}
+
+auto Config::call_stats() noexcept -> std::vector<LoaderCallStats> {
+    std::vector<LoaderCallStats> call_stats{};
+    try {
+        auto rust_vec = m_config->get_call_stats();
+        call_stats.reserve(rust_vec.size());
+        for (auto&& rust_stats : rust_vec) {
+            call_stats.emplace_back(LoaderCallStats{
+                .method     = std::string{rust_stats.method},
+                .calls      = rust_stats.calls,
+                .failures   = rust_stats.failures,
+                .reconnects = rust_stats.reconnects,
+                .total      = std::chrono::nanoseconds(rust_stats.total_ns),
+                .max        = std::chrono::nanoseconds(rust_stats.max_ns),
+            });
+        }
+    } catch (const std::exception& e) {
+        fmt::print(stderr, "Failed to get scx_loader call stats: {}\n", e.what());
+    }
+    return call_stats;
+}
+
 }  // namespace scx::loader
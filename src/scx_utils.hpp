@@ -19,9 +19,13 @@
 #ifndef SCX_UTILS_HPP
 #define SCX_UTILS_HPP
 
+#include <chrono>
+#include <cstdint>
+#include <memory>
 #include <optional>
 #include <string>
 #include <string_view>
+#include <vector>
 
 #if defined(__clang__)
 #pragma clang diagnostic push
@@ -42,7 +46,7 @@
 
 #include <QStringList>
 
-#include "rust/cxx.h"
+#include "scx-lib-cxxbridge/lib.h"
 
 #if defined(__clang__)
 #pragma clang diagnostic pop
@@ -50,36 +54,77 @@
 #pragma GCC diagnostic pop
 #endif
 
-namespace scx_loader {
-struct Config;
-}
-
 namespace scx {
 
-enum class SchedMode : std::uint8_t {
-    /// Default values for the scheduler
-    Auto = 0,
-    /// Applies flags for better gaming experience
-    Gaming = 1,
-    /// Applies flags for lower power usage
-    PowerSave = 2,
-    /// Starts scheduler in low latency mode
-    LowLatency = 3,
-    /// Starts scheduler in server-oriented mode
-    Server = 4,
-};
+/// @brief Mode of the scheduler, shared with the Rust side of the bridge.
+using SchedMode = ::scx_loader::SchedMode;
+
+/// @brief What was done to 'scx.service' to get it out of the way of scx_loader.
+using ScxServiceAction = ::scx_loader::ScxServiceAction;
+
+/// @brief Returns lowercase name of the mode, e.g "lowlatency".
+auto sched_mode_name(SchedMode sched_mode) noexcept -> std::string_view;
+
+/// @brief Parses the mode from its name, case-insensitive.
+auto sched_mode_from_name(std::string_view mode_name) noexcept -> std::optional<SchedMode>;
+
+/// @brief Splits scheduler arguments typed by the user, honoring quotes.
+auto split_sched_args(const QString& args_text) -> QStringList;
+
+/// @brief Joins scheduler arguments for display, quoting the ones which contain spaces.
+///
+/// The result is split back into the same arguments by split_sched_args.
+auto join_sched_args(const QStringList& args) -> QString;
 
 }  // namespace scx
 
 namespace scx::loader {
 
-// Gets supported schedulers by scx_loader
-auto get_supported_scheds() noexcept -> std::optional<QStringList>;
+/// @brief Latency counters of a single scx_loader method.
+struct LoaderCallStats {
+    std::string method;
+    std::uint64_t calls{};
+    std::uint64_t failures{};
+    std::uint64_t reconnects{};
+    std::chrono::nanoseconds total{};
+    std::chrono::nanoseconds max{};
+};
+
+/// @brief State of scx_loader, read at once.
+struct LoaderSnapshot {
+    QStringList supported_scheds;
+    std::string current_sched;
+    SchedMode current_mode{};
+};
+
+/// @brief Scheduler started by scx_loader on boot, as written in the config.
+struct DefaultSched {
+    std::string scx_sched;
+    SchedMode sched_mode{};
+    QStringList extra_args;
+};
+
+/// @brief Steps of the scheduler change which are needed to reach the requested state.
+struct ChangePlan {
+    bool stop_scx_service{};
+    bool switch_scheduler{};
+    bool enable_loader_service{};
+    bool stop_scheduler{};
+    bool write_config{};
+    /// Why the steps are needed, or why they are skipped
+    QStringList reasons;
+
+    /// @brief Whether the requested state is reached already.
+    [[nodiscard]] auto is_noop() const noexcept -> bool {
+        return !stop_scx_service && !switch_scheduler && !enable_loader_service && !stop_scheduler && !write_config;
+    }
+};
 
 /// @brief Manages configuration of scx_loader.
 ///
 /// This structure holds pointer to object from Rust code, which represents
-/// the actual Config structure.
+/// the actual Config structure. It also owns the session to scx_loader,
+/// which is reused by all calls for the lifetime of the object.
 class Config {
  public:
     /// @brief Initializes config from config path, if the file
@@ -87,28 +132,110 @@ class Config {
     static auto init_config(std::string_view filepath) noexcept -> std::optional<Config>;
 
     /// @brief Returns the scx flags for the given sched mode.
+    ///
+    /// Served from the flags cache, if the scheduler is in there.
     auto scx_flags_for_mode(std::string_view scx_sched, SchedMode sched_mode) noexcept -> std::optional<QStringList>;
 
+    /// @brief Returns the default scheduler of the config, with args of its mode.
+    ///
+    /// Returns nullopt if no scheduler is started on boot.
+    auto get_default_sched() noexcept -> std::optional<DefaultSched>;
+
+    /// @brief Computes flags of all modes for the schedulers into the cache.
+    ///
+    /// The cache is recomputed whenever the config file is changed on disk.
+    /// It is not synchronized, flags should be queried from a single thread.
+    void prime_flags_cache(const QStringList& scx_scheds) noexcept;
+
     /// @brief Applies the scx scheduler with arguments/mode.
-    auto apply_scheduler_change(std::string_view scx_sched, SchedMode sched_mode, std::string_view extra_flags, std::string_view filepath) noexcept -> bool;
+    ///
+    /// Each of the extra args is passed to the scheduler as is, without splitting.
+    /// Fails without persisting the scheduler, if scx_loader didn't switch to it.
+    auto apply_scheduler_change(std::string_view scx_sched, SchedMode sched_mode, const QStringList& extra_args, std::string_view filepath) noexcept -> bool;
 
     /// @brief Disables auto start of scheduler, and stops current scheduler.
     auto disable_scheduler(std::string_view filepath) noexcept -> bool;
 
+    /// @brief Plans the apply against the state of scx_loader, the units and the config on disk.
+    ///
+    /// Only the steps which change something are planned, e.g none if the scheduler
+    /// already runs in the mode and is persisted. The plan is made against a copy of
+    /// the config read from disk, which is what the following write changes too.
+    auto plan_scheduler_change(std::string_view scx_sched, SchedMode sched_mode, const QStringList& extra_args, bool persist, std::string_view filepath) noexcept -> std::optional<ChangePlan>;
+
+    /// @brief Plans the disable the same way as the apply.
+    auto plan_disable(bool persist, std::string_view filepath) noexcept -> std::optional<ChangePlan>;
+
+    /// @brief Stops/disables 'scx.service' if it's running/enabled.
+    /// First stage of the apply. Returns what was done, to be undone with restore_scx_service.
+    auto stop_scx_service() noexcept -> ScxServiceAction;
+
+    /// @brief Brings 'scx.service' back to the state it was in before stop_scx_service.
+    auto restore_scx_service(ScxServiceAction action) noexcept -> bool;
+
+    /// @brief Switches the running scheduler with arguments/mode.
+    /// Second stage of the apply.
+    auto switch_scheduler(std::string_view scx_sched, SchedMode sched_mode, const QStringList& extra_args) noexcept -> bool;
+
+    /// @brief Switches the running scheduler to the mode, with the flags of the mode.
+    auto switch_mode(std::string_view scx_sched, SchedMode sched_mode) noexcept -> bool;
+
+    /// @brief Enables scx_loader service if not enabled yet.
+    /// Third stage of the apply.
+    void enable_loader_service() noexcept;
+
+    /// @brief Persists the scheduler with arguments/mode as default.
+    /// Last stage of the apply, which requires root permissions.
+    auto write_scheduler_config(std::string_view scx_sched, SchedMode sched_mode, const QStringList& extra_args, std::string_view filepath) noexcept -> bool;
+
+    /// @brief Stops current scheduler.
+    /// First stage of the disable.
+    auto stop_scheduler() noexcept -> bool;
+
+    /// @brief Persists the config without default scheduler.
+    /// Last stage of the disable, which requires root permissions.
+    auto write_disabled_config(std::string_view filepath) noexcept -> bool;
+
     /// @brief Returns currently running scheduler.
     auto get_current_sched() noexcept -> std::optional<std::string>;
 
     /// @brief Returns currently running scheduler mode.
     auto get_current_mode() noexcept -> std::optional<SchedMode>;
 
+    /// @brief Returns supported schedulers by scx_loader.
+    auto get_supported_scheds() noexcept -> std::optional<QStringList>;
+
+    /// @brief Returns supported schedulers, current scheduler and mode with a single request.
+    ///
+    /// The first call returns the state prefetched while the config was parsed.
+    auto get_loader_snapshot() noexcept -> std::optional<LoaderSnapshot>;
+
+    /// @brief Returns latency counters of the calls made to scx_loader.
+    auto call_stats() noexcept -> std::vector<LoaderCallStats>;
+
+    /// @brief Subscribes to scheduler/mode changes reported by scx_loader.
+    ///
+    /// Returns eventfd owned by the caller, which becomes readable on each change.
+    auto watch_loader_state() noexcept -> std::optional<int>;
+
     // explicitly deleted
     Config() = delete;
 
+    Config(Config&&) noexcept;
+    auto operator=(Config&&) noexcept -> Config&;
+    ~Config();
+
  private:
-    explicit Config(::rust::Box<::scx_loader::Config>&& config) : m_config(std::move(config)) { }
+    struct FlagsCache;
+
+    Config(::rust::Box<::scx_loader::Config>&& config, std::unique_ptr<FlagsCache>&& flags_cache) noexcept;
+
+    /// @brief Reloads the config and recomputes the cache, if config file was changed.
+    void refresh_flags_cache() noexcept;
 
     /// @brief A pointer to the Config structure from Rust code.
     ::rust::Box<::scx_loader::Config> m_config;
+    std::unique_ptr<FlagsCache> m_flags_cache;
 };
 
 /// @brief A unique pointer to a Config object.
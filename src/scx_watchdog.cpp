@@ -0,0 +1,465 @@
+// Copyright (C) 2024-2025 Vladislav Nepogodin
+//
+// This file is part of CachyOS kernel manager.
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+#include "scx_watchdog.hpp"
+#include "scx_state_watcher.hpp"
+
+#include <algorithm>     // for min
+#include <array>         // for array
+#include <cerrno>        // for errno
+#include <charconv>      // for from_chars
+#include <system_error>  // for errc
+
+#include <fcntl.h>   // for open
+#include <unistd.h>  // for read, lseek, close
+
+#include <fmt/core.h>
+
+#if defined(__clang__)
+#pragma clang diagnostic push
+#pragma clang diagnostic ignored "-Wold-style-cast"
+#elif defined(__GNUC__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wnull-dereference"
+#pragma GCC diagnostic ignored "-Wuseless-cast"
+#pragma GCC diagnostic ignored "-Wold-style-cast"
+#pragma GCC diagnostic ignored "-Wsuggest-final-types"
+#pragma GCC diagnostic ignored "-Wsuggest-attribute=pure"
+#pragma GCC diagnostic ignored "-Wconversion"
+#endif
+
+#include <QSocketNotifier>
+#include <QTimer>
+
+#if defined(__clang__)
+#pragma clang diagnostic pop
+#elif defined(__GNUC__)
+#pragma GCC diagnostic pop
+#endif
+
+namespace {
+
+using scx::watchdog::KernelEvent;
+using scx::watchdog::monotonic_clock;
+
+/// @brief Returns the next comma separated field of the record header.
+auto next_field(std::string_view& header) noexcept -> std::string_view {
+    const auto sep_pos = header.find(',');
+    const auto field   = header.substr(0, sep_pos);
+    header.remove_prefix(sep_pos == std::string_view::npos ? header.size() : sep_pos + 1);
+    return field;
+}
+
+auto parse_scheduler_message(std::string_view message) noexcept -> std::optional<KernelEvent> {
+    // BPF scheduler "lavd" enabled
+    // BPF scheduler "lavd" disabled (runtime error)
+    constexpr std::string_view kSchedulerPrefix{"BPF scheduler \""};
+    message.remove_prefix(kSchedulerPrefix.size());
+    const auto ops_end = message.find('"');
+    if (ops_end == std::string_view::npos) {
+        return std::nullopt;
+    }
+    KernelEvent event{.kind = KernelEvent::Kind::Enabled, .timestamp = {}, .ops = std::string{message.substr(0, ops_end)}, .text = {}};
+    message.remove_prefix(ops_end + 1);
+
+    if (message.starts_with(" enabled")) {
+        return event;
+    }
+    if (!message.starts_with(" disabled")) {
+        return std::nullopt;
+    }
+    event.kind            = KernelEvent::Kind::Disabled;
+    const auto reason_pos = message.find('(');
+    const auto reason_end = message.rfind(')');
+    if (reason_pos != std::string_view::npos && reason_end != std::string_view::npos && reason_end > reason_pos) {
+        event.text = message.substr(reason_pos + 1, reason_end - reason_pos - 1);
+    }
+    return event;
+}
+
+}  // namespace
+
+namespace scx::watchdog {
+
+auto parse_kmsg_record(std::string_view record, monotonic_clock::time_point received_at) noexcept -> std::optional<KernelEvent> {
+    // "6,1234,5140900,-;sched_ext: BPF scheduler "lavd" enabled\n"
+    const auto header_end = record.find(';');
+    if (header_end == std::string_view::npos) {
+        return std::nullopt;
+    }
+    auto header  = record.substr(0, header_end);
+    auto message = record.substr(header_end + 1);
+    message      = message.substr(0, message.find('\n'));
+
+    constexpr std::string_view kSchedExtPrefix{"sched_ext: "};
+    if (!message.starts_with(kSchedExtPrefix)) {
+        return std::nullopt;
+    }
+    message.remove_prefix(kSchedExtPrefix.size());
+
+    next_field(header);  // priority
+    next_field(header);  // sequence number
+    // the time of the record is only checked, it isn't CLOCK_MONOTONIC
+    const auto timestamp_str = next_field(header);
+    std::uint64_t timestamp_us{};
+    const auto* timestamp_end = timestamp_str.data() + timestamp_str.size();
+    auto [ptr, ec]            = std::from_chars(timestamp_str.data(), timestamp_end, timestamp_us);
+    if (ec != std::errc{} || ptr != timestamp_end) {
+        return std::nullopt;
+    }
+
+    std::optional<KernelEvent> event{};
+    if (message.starts_with("BPF scheduler \"")) {
+        event = parse_scheduler_message(message);
+    } else if (const auto sep_pos = message.find(": "); sep_pos != std::string_view::npos && message.substr(0, sep_pos).find(' ') == std::string_view::npos) {
+        // "lavd: runnable task stall (kworker/0:1[42] failed to run for 30.5s)"
+        event = KernelEvent{.kind = KernelEvent::Kind::ExitMessage, .timestamp = {}, .ops = std::string{message.substr(0, sep_pos)}, .text = std::string{message.substr(sep_pos + 2)}};
+    }
+    if (event) {
+        event->timestamp = received_at;
+    }
+    return event;
+}
+
+auto is_error_exit(std::string_view reason) noexcept -> bool {
+    // SCX_EXIT_UNREG*, SCX_EXIT_SYSRQ and SCX_EXIT_NONE aren't errors
+    return !reason.empty() && !reason.starts_with("unregistered") && !reason.starts_with("disabled by sysrq") && reason != "none";
+}
+
+auto backoff_delay(const WatchdogConfig& config, std::size_t attempt_idx) noexcept -> std::chrono::milliseconds {
+    if (attempt_idx == 0) {
+        return std::chrono::milliseconds::zero();
+    }
+    auto delay = config.backoff_initial;
+    for (std::size_t idx = 1; idx < attempt_idx && delay < config.backoff_max; ++idx) {
+        delay *= 2;
+    }
+    return std::min(delay, config.backoff_max);
+}
+
+Watchdog::Watchdog(loader::Config& config, loader::ApplyExecutor& executor, StateWatcher& state_watcher, WatchdogConfig watchdog_config, QObject* parent)
+  : QObject(parent), m_config(config), m_executor(executor), m_state_watcher(state_watcher), m_watchdog_config(std::move(watchdog_config)),
+    m_grace_timer(new QTimer(this)), m_attempt_timer(new QTimer(this)), m_attach_timer(new QTimer(this)) {
+    m_grace_timer->setSingleShot(true);
+    connect(m_grace_timer, &QTimer::timeout, this, &Watchdog::on_grace_timeout);
+    m_attempt_timer->setSingleShot(true);
+    connect(m_attempt_timer, &QTimer::timeout, this, &Watchdog::run_attempt);
+    m_attach_timer->setSingleShot(true);
+    m_attach_timer->setInterval(m_watchdog_config.attach_timeout);
+    connect(m_attach_timer, &QTimer::timeout, this, &Watchdog::on_attach_timeout);
+
+    // reading the log needs CAP_SYSLOG, if dmesg is restricted
+    m_kmsg_fd = ::open("/dev/kmsg", O_RDONLY | O_NONBLOCK | O_CLOEXEC);  // NOLINT
+    if (m_kmsg_fd >= 0) {
+        // only the new records are of interest
+        ::lseek(m_kmsg_fd, 0, SEEK_END);
+        m_kmsg_notifier = new QSocketNotifier(m_kmsg_fd, QSocketNotifier::Read, this);
+        connect(m_kmsg_notifier, &QSocketNotifier::activated, this, &Watchdog::on_kmsg);
+    }
+    connect(&m_state_watcher, &StateWatcher::scheduler_changed, this, &Watchdog::on_scheduler_changed);
+    connect(&m_state_watcher, &StateWatcher::loader_state_changed, this, &Watchdog::on_loader_state_changed);
+    connect(&m_executor, &loader::ApplyExecutor::finished, this, &Watchdog::on_apply_finished);
+
+    m_is_enabled = m_state_watcher.is_enabled();
+    if (m_is_enabled) {
+        m_state = State::Running;
+        m_ops   = m_state_watcher.current_scheduler().toStdString();
+        update_target();
+    }
+}
+
+Watchdog::~Watchdog() {
+    if (m_kmsg_fd >= 0) {
+        ::close(m_kmsg_fd);
+    }
+}
+
+void Watchdog::on_kmsg() noexcept {
+    // each read returns a single record
+    std::array<char, 2048> record_buf{};
+    while (true) {
+        const auto read_len = ::read(m_kmsg_fd, record_buf.data(), record_buf.size());
+        if (read_len < 0 && errno == EPIPE) {
+            // records were overwritten before we read them
+            continue;
+        }
+        if (read_len <= 0) {
+            break;
+        }
+
+        // records are read as they come, so the events are ordered by their arrival
+        auto event = parse_kmsg_record({record_buf.data(), static_cast<std::size_t>(read_len)}, monotonic_clock::now());
+        if (!event) {
+            continue;
+        }
+        switch (event->kind) {
+        case KernelEvent::Kind::Enabled:
+            m_ops = std::move(event->ops);
+            if (!m_is_enabled) {
+                m_is_enabled = true;
+                on_enabled(event->timestamp);
+            }
+            break;
+        case KernelEvent::Kind::Disabled:
+            if (m_is_enabled) {
+                m_is_enabled = false;
+                on_disabled(event->timestamp, std::move(event->ops), std::move(event->text));
+            }
+            break;
+        case KernelEvent::Kind::ExitMessage:
+            if (m_incident && m_incident->ops == event->ops && m_incident->message.empty()) {
+                m_incident->message = std::move(event->text);
+            }
+            break;
+        }
+    }
+}
+
+void Watchdog::on_scheduler_changed() noexcept {
+    // the kernel log, if readable, has reported it already
+    const bool is_enabled = m_state_watcher.is_enabled();
+    if (is_enabled == m_is_enabled) {
+        return;
+    }
+    m_is_enabled = is_enabled;
+    if (is_enabled) {
+        m_ops = m_state_watcher.current_scheduler().toStdString();
+        on_enabled(monotonic_clock::now());
+    } else {
+        on_disabled(monotonic_clock::now(), m_ops, {});
+    }
+}
+
+void Watchdog::on_loader_state_changed() noexcept {
+    switch (m_state) {
+    case State::Running:
+        update_target();
+        break;
+    case State::Grace:
+        m_loader_changed_in_grace = true;
+        break;
+    case State::Recovering:
+    case State::Stopped:
+        // our own attempts are reported as well
+        break;
+    }
+}
+
+void Watchdog::on_enabled(monotonic_clock::time_point timestamp) noexcept {
+    switch (m_state) {
+    case State::Grace:
+        // came back on its own, e.g the scheduler was switched or restarted itself
+        m_grace_timer->stop();
+        m_incident.reset();
+        break;
+    case State::Recovering:
+        m_attempt_timer->stop();
+        m_attach_timer->stop();
+        m_incident->recovered_at   = timestamp;
+        m_incident->recovered_with = m_attempt_target;
+        ++m_stats.recoveries;
+        m_stats.recovery_time += *m_incident->time_to_recovery();
+        emit recovered(*m_incident);
+        m_incident.reset();
+        break;
+    case State::Running:
+    case State::Stopped:
+        break;
+    }
+    m_state = State::Running;
+    update_target();
+}
+
+void Watchdog::on_disabled(monotonic_clock::time_point timestamp, std::string ops, std::string reason) noexcept {
+    if (m_state != State::Running) {
+        return;
+    }
+    const bool is_sysrq = reason.starts_with("disabled by sysrq");
+    const bool is_error = is_error_exit(reason);
+    if (is_sysrq) {
+        // deliberately stopped by the admin
+        m_state = State::Stopped;
+        return;
+    }
+
+    m_incident.emplace(Incident{
+        .ops             = std::move(ops),
+        .reason          = std::move(reason),
+        .message         = {},
+        .ejected_at_wall = std::chrono::system_clock::now(),
+        .ejected_at      = timestamp,
+        .recovered_at    = std::nullopt,
+        .attempts        = 0,
+        .recovered_with  = std::nullopt,
+    });
+    m_state                   = State::Grace;
+    m_loader_changed_in_grace = false;
+    // errors are recovered right away, once the error message which follows is read
+    m_grace_timer->start(is_error ? std::chrono::milliseconds::zero() : m_watchdog_config.grace_period);
+}
+
+void Watchdog::on_grace_timeout() noexcept {
+    if (m_state != State::Grace) {
+        return;
+    }
+    if (m_loader_changed_in_grace && !is_error_exit(m_incident->reason)) {
+        // stopped through scx_loader
+        m_incident.reset();
+        m_state = State::Stopped;
+        return;
+    }
+    start_incident();
+}
+
+void Watchdog::start_incident() noexcept {
+    m_state = State::Recovering;
+    ++m_stats.ejections;
+    emit ejected(*m_incident);
+
+    const auto now = m_incident->ejected_at;
+    while (!m_recent_ejections.empty() && now - m_recent_ejections.front() > m_watchdog_config.crash_loop_window) {
+        m_recent_ejections.pop_front();
+    }
+    m_recent_ejections.push_back(now);
+
+    const auto& fallback     = m_watchdog_config.fallback;
+    const bool is_crash_loop = m_recent_ejections.size() >= m_watchdog_config.crash_loop_limit;
+    if (is_crash_loop || !m_target) {
+        // re-applying the same scheduler won't help
+        if (!fallback || fallback == m_target) {
+            give_up();
+            return;
+        }
+        m_attempt_target = fallback;
+    } else {
+        m_attempt_target = m_target;
+    }
+    m_target_attempts = 0;
+    schedule_attempt();
+}
+
+void Watchdog::schedule_attempt() noexcept {
+    m_attempt_timer->start(backoff_delay(m_watchdog_config, m_incident->attempts));
+}
+
+void Watchdog::run_attempt() noexcept {
+    if (m_state != State::Recovering) {
+        return;
+    }
+    ++m_incident->attempts;
+    ++m_target_attempts;
+    fmt::print(stderr, "watchdog: applying {} ({}), attempt {}\n", m_attempt_target->scx_sched, sched_mode_name(m_attempt_target->mode), m_incident->attempts);
+
+    // empty args aren't the default ones, the flags of the mode have to be passed explicitly
+    const bool is_applied_target = m_attempt_target == m_target && m_target_args;
+    auto extra_args = is_applied_target ? *m_target_args : m_config.scx_flags_for_mode(m_attempt_target->scx_sched, m_attempt_target->mode).value_or(QStringList{});
+    m_attempt_request = loader::ApplyRequest{
+        .kind       = loader::ApplyRequest::Kind::Apply,
+        .scx_sched  = m_attempt_target->scx_sched,
+        .sched_mode = m_attempt_target->mode,
+        .extra_args = std::move(extra_args),
+        .persist    = false,
+    };
+    // also covers the time the attempt is queued behind the request in flight
+    m_attach_timer->start();
+    m_executor.submit(*m_attempt_request);
+}
+
+void Watchdog::on_attach_timeout() noexcept {
+    if (m_state != State::Recovering) {
+        return;
+    }
+    if (m_target_attempts >= m_watchdog_config.max_attempts) {
+        const auto& fallback = m_watchdog_config.fallback;
+        if (!fallback || m_attempt_target == fallback) {
+            give_up();
+            return;
+        }
+        m_attempt_target  = fallback;
+        m_target_attempts = 0;
+    }
+    schedule_attempt();
+}
+
+void Watchdog::on_apply_finished(const loader::ApplyRequest& request, bool succeeded) noexcept {
+    if (is_recovery(request)) {
+        m_attempt_request.reset();
+        if (!succeeded && m_state == State::Recovering && m_attach_timer->isActive()) {
+            // scx_loader refused it, no need to wait for the scheduler to attach
+            m_attach_timer->stop();
+            on_attach_timeout();
+        }
+        return;
+    }
+    if (!succeeded) {
+        return;
+    }
+    switch (request.kind) {
+    case loader::ApplyRequest::Kind::Apply:
+        m_target      = Target{.scx_sched = request.scx_sched, .mode = request.sched_mode};
+        m_target_args = request.extra_args;
+        break;
+    case loader::ApplyRequest::Kind::Disable:
+        m_target.reset();
+        m_target_args.reset();
+        if (m_state == State::Grace || m_state == State::Recovering) {
+            // stopped by the user, while waiting for it to come back
+            m_grace_timer->stop();
+            m_attempt_timer->stop();
+            m_attach_timer->stop();
+            m_incident.reset();
+            m_state = State::Stopped;
+        }
+        break;
+    case loader::ApplyRequest::Kind::Persist:
+        break;
+    }
+}
+
+void Watchdog::give_up() noexcept {
+    m_attempt_timer->stop();
+    m_attach_timer->stop();
+    m_state = State::Stopped;
+    ++m_stats.give_ups;
+    emit gave_up(*m_incident);
+    m_incident.reset();
+}
+
+void Watchdog::update_target() noexcept {
+    // blocks on D-Bus, read on the worker thread
+    m_executor.loader_snapshot().then(this, [this](std::optional<loader::LoaderSnapshot> snapshot) {
+        if (m_state != State::Running) {
+            // the target is kept from before the ejection
+            return;
+        }
+        if (!snapshot || snapshot->current_sched.empty() || snapshot->current_sched == "unknown") {
+            // not started through scx_loader, it cannot be applied again
+            m_target.reset();
+            m_target_args.reset();
+            return;
+        }
+        Target target{.scx_sched = std::move(snapshot->current_sched), .mode = snapshot->current_mode};
+        if (target != m_target) {
+            // started elsewhere, the args it runs with are unknown
+            m_target = std::move(target);
+            m_target_args.reset();
+        }
+    });
+}
+
+}  // namespace scx::watchdog
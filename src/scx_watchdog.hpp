@@ -0,0 +1,244 @@
+// Copyright (C) 2024-2025 Vladislav Nepogodin
+//
+// This file is part of CachyOS kernel manager.
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+#ifndef SCX_WATCHDOG_HPP
+#define SCX_WATCHDOG_HPP
+
+#include "scx_apply_executor.hpp"
+#include "scx_utils.hpp"
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#if defined(__clang__)
+#pragma clang diagnostic push
+#pragma clang diagnostic ignored "-Wsign-conversion"
+#pragma clang diagnostic ignored "-Wshorten-64-to-32"
+#elif defined(__GNUC__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wuseless-cast"
+#pragma GCC diagnostic ignored "-Wsign-conversion"
+#pragma GCC diagnostic ignored "-Wconversion"
+#pragma GCC diagnostic ignored "-Wsuggest-final-methods"
+#pragma GCC diagnostic ignored "-Wsuggest-attribute=pure"
+#endif
+
+#include <QObject>
+
+#if defined(__clang__)
+#pragma clang diagnostic pop
+#elif defined(__GNUC__)
+#pragma GCC diagnostic pop
+#endif
+
+class QSocketNotifier;
+class QTimer;
+
+namespace scx {
+class StateWatcher;
+}  // namespace scx
+
+namespace scx::watchdog {
+
+using monotonic_clock = std::chrono::steady_clock;
+
+/// @brief sched_ext transition logged by the kernel.
+struct KernelEvent {
+    enum class Kind : std::uint8_t {
+        Enabled,
+        Disabled,
+        /// Details of the preceding exit, e.g the error message
+        ExitMessage,
+    };
+
+    Kind kind{};
+    /// CLOCK_MONOTONIC time the record was read at. The time in the record comes from
+    /// the kernel's local_clock, which drifts from CLOCK_MONOTONIC and stops in suspend.
+    monotonic_clock::time_point timestamp{};
+    /// Name of the BPF ops, e.g "lavd"
+    std::string ops;
+    /// Exit reason for Disabled, e.g "runtime error", or the message for ExitMessage
+    std::string text;
+};
+
+/// @brief Parses a /dev/kmsg record read at received_at, returns nullopt if it isn't about sched_ext.
+auto parse_kmsg_record(std::string_view record, monotonic_clock::time_point received_at) noexcept -> std::optional<KernelEvent>;
+
+/// @brief Whether the exit reason means the kernel ejected the scheduler.
+///
+/// Unregistration from user space may be a crash as well as a deliberate stop.
+auto is_error_exit(std::string_view reason) noexcept -> bool;
+
+struct Target {
+    std::string scx_sched;
+    SchedMode mode{SchedMode::Auto};
+
+    auto operator==(const Target&) const -> bool = default;
+};
+
+struct WatchdogConfig {
+    /// Applied once re-applying the ejected scheduler failed, or it keeps being ejected
+    std::optional<Target> fallback{};
+    /// Attempts for each of the targets
+    std::size_t max_attempts{3};
+    std::chrono::milliseconds backoff_initial{1000};
+    std::chrono::milliseconds backoff_max{60'000};
+    /// Time for the scheduler to attach, before the attempt is considered failed
+    std::chrono::milliseconds attach_timeout{10'000};
+    /// Ejections within the window, which make it a crash loop
+    std::size_t crash_loop_limit{5};
+    std::chrono::seconds crash_loop_window{600};
+    /// Time for a scheduler stopped without an error to come back on its own,
+    /// e.g when switching schedulers
+    std::chrono::milliseconds grace_period{2000};
+};
+
+/// @brief Delay before the attempt, the first one is made right away.
+auto backoff_delay(const WatchdogConfig& config, std::size_t attempt_idx) noexcept -> std::chrono::milliseconds;
+
+/// @brief Single ejection of the scheduler, and its recovery.
+struct Incident {
+    std::string ops;
+    /// Exit reason and the message logged by the kernel, empty if unknown
+    std::string reason;
+    std::string message;
+    std::chrono::system_clock::time_point ejected_at_wall{};
+    monotonic_clock::time_point ejected_at{};
+    std::optional<monotonic_clock::time_point> recovered_at{};
+    std::size_t attempts{};
+    std::optional<Target> recovered_with{};
+
+    [[nodiscard]] auto time_to_recovery() const noexcept -> std::optional<monotonic_clock::duration> {
+        if (!recovered_at) {
+            return std::nullopt;
+        }
+        return *recovered_at - ejected_at;
+    }
+};
+
+struct WatchdogStats {
+    std::size_t ejections{};
+    std::size_t recoveries{};
+    std::size_t give_ups{};
+    /// Sum of the time to recovery of all recovered incidents
+    monotonic_clock::duration recovery_time{};
+
+    [[nodiscard]] auto mean_time_to_recovery() const noexcept -> std::optional<std::chrono::duration<double>> {
+        if (recoveries == 0) {
+            return std::nullopt;
+        }
+        return std::chrono::duration<double>(recovery_time) / static_cast<double>(recoveries);
+    }
+};
+
+/// @brief Detects ejections of the sched_ext scheduler, and applies it again through scx_loader.
+///
+/// Transitions are read from /dev/kmsg as soon as the kernel logs them, together
+/// with the exit reason. If the log is restricted, the state reported by the
+/// StateWatcher is used instead, without the reason. Schedulers stopped without
+/// an error are given the grace period to come back, and aren't recovered if
+/// scx_loader reported the change, i.e the user has stopped or switched them.
+///
+/// Recoveries are submitted to the ApplyExecutor without persisting, so they
+/// never run concurrently with the other requests. The scheduler to recover is
+/// the one of the last finished request, or read from scx_loader on the worker
+/// thread if it was started elsewhere.
+class Watchdog final : public QObject {
+    Q_OBJECT
+    Q_DISABLE_COPY_MOVE(Watchdog)
+ public:
+    /// @brief Config, executor and state watcher must outlive the watchdog.
+    Watchdog(loader::Config& config, loader::ApplyExecutor& executor, StateWatcher& state_watcher, WatchdogConfig watchdog_config, QObject* parent = nullptr);
+    ~Watchdog() override;
+
+    [[nodiscard]] auto stats() const noexcept -> const WatchdogStats& { return m_stats; }
+    [[nodiscard]] auto current_incident() const noexcept -> const std::optional<Incident>& { return m_incident; }
+    /// @brief Whether exit reasons and kernel timestamps are available.
+    [[nodiscard]] auto reads_kernel_log() const noexcept -> bool { return m_kmsg_fd >= 0; }
+    /// @brief Whether the request was submitted by the watchdog, valid until it has finished.
+    [[nodiscard]] auto is_recovery(const loader::ApplyRequest& request) const noexcept -> bool { return m_attempt_request == request; }
+
+ signals:
+    void ejected(const scx::watchdog::Incident& incident);
+    void recovered(const scx::watchdog::Incident& incident);
+    /// @brief Emitted when all attempts failed, or the fallback is crash looping too.
+    void gave_up(const scx::watchdog::Incident& incident);
+
+ private:
+    enum class State : std::uint8_t {
+        Running,
+        /// Stopped without an error, waiting whether it comes back
+        Grace,
+        Recovering,
+        /// Stopped by the user, or recovery gave up
+        Stopped,
+    };
+
+    void on_kmsg() noexcept;
+    void on_scheduler_changed() noexcept;
+    void on_loader_state_changed() noexcept;
+    void on_enabled(monotonic_clock::time_point timestamp) noexcept;
+    void on_disabled(monotonic_clock::time_point timestamp, std::string ops, std::string reason) noexcept;
+    void on_grace_timeout() noexcept;
+    void start_incident() noexcept;
+    void schedule_attempt() noexcept;
+    void run_attempt() noexcept;
+    void on_attach_timeout() noexcept;
+    void on_apply_finished(const loader::ApplyRequest& request, bool succeeded) noexcept;
+    void give_up() noexcept;
+    void update_target() noexcept;
+
+    loader::Config& m_config;
+    loader::ApplyExecutor& m_executor;
+    StateWatcher& m_state_watcher;
+    WatchdogConfig m_watchdog_config;
+    State m_state{State::Stopped};
+    bool m_is_enabled{};
+    /// Name of the attached ops, as the kernel reports them
+    std::string m_ops{};
+
+    /// Scheduler which was running before the ejection
+    std::optional<Target> m_target{};
+    /// Args the target was applied with, the flags of its mode if unknown
+    std::optional<QStringList> m_target_args{};
+    std::optional<Incident> m_incident{};
+    /// Target being tried, and the number of attempts made with it
+    std::optional<Target> m_attempt_target{};
+    std::size_t m_target_attempts{};
+    /// Request of the attempt, until it has finished
+    std::optional<loader::ApplyRequest> m_attempt_request{};
+    bool m_loader_changed_in_grace{};
+    std::deque<monotonic_clock::time_point> m_recent_ejections{};
+    WatchdogStats m_stats{};
+
+    int m_kmsg_fd{-1};
+    QSocketNotifier* m_kmsg_notifier{};
+    QTimer* m_grace_timer{};
+    QTimer* m_attempt_timer{};
+    QTimer* m_attach_timer{};
+};
+
+}  // namespace scx::watchdog
+
+#endif  // SCX_WATCHDOG_HPP
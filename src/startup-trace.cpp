@@ -0,0 +1,50 @@
+// Copyright (C) 2024-2025 Vladislav Nepogodin
+//
+// This file is part of CachyOS kernel manager.
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+#include "startup-trace.hpp"
+
+#include <atomic>  // for atomic
+#include <chrono>  // for steady_clock
+#include <cstdio>  // for stderr
+
+#include <fmt/core.h>
+
+namespace {
+
+std::atomic<bool> g_trace_enabled{false};
+std::chrono::steady_clock::time_point g_trace_origin{};
+
+}  // namespace
+
+namespace scxctl::detail {
+
+void enable_startup_trace() noexcept {
+    g_trace_origin = std::chrono::steady_clock::now();
+    g_trace_enabled.store(true, std::memory_order_release);
+}
+
+void trace_startup(const char* phase) noexcept {
+    if (!g_trace_enabled.load(std::memory_order_acquire)) {
+        return;
+    }
+    // phases are marked from the worker threads too
+    const auto elapsed = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - g_trace_origin);
+    fmt::print(stderr, "startup: {:8.2f}ms {}\n", elapsed.count(), phase);
+}
+
+}  // namespace scxctl::detail
@@ -0,0 +1,36 @@
+// Copyright (C) 2024-2025 Vladislav Nepogodin
+//
+// This file is part of CachyOS kernel manager.
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+
+#ifndef STARTUP_TRACE_HPP_
+#define STARTUP_TRACE_HPP_
+
+#include "schedext-export.hpp"
+
+// Not a part of the installed headers: only scx-manager itself traces its startup.
+namespace scxctl::detail {
+
+/// Enables printing of startup phases with timestamps relative to this call into stderr
+SCHEDEXT_EXPORT void enable_startup_trace() noexcept;
+
+/// Marks the startup phase as done, does nothing unless tracing is enabled
+SCHEDEXT_EXPORT void trace_startup(const char* phase) noexcept;
+
+}  // namespace scxctl::detail
+
+#endif  // STARTUP_TRACE_HPP_
@@ -0,0 +1,167 @@
+// Copyright (C) 2024-2025 Vladislav Nepogodin
+//
+// This file is part of CachyOS kernel manager.
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+// NOLINTBEGIN(bugprone-unhandled-exception-at-new)
+
+#include "switch-latency-panel.hpp"
+
+#include <array>   // for array
+#include <chrono>  // for duration
+
+#if defined(__clang__)
+#pragma clang diagnostic push
+#pragma clang diagnostic ignored "-Wold-style-cast"
+#pragma clang diagnostic ignored "-Wfloat-conversion"
+#pragma clang diagnostic ignored "-Wdouble-promotion"
+#elif defined(__GNUC__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wnull-dereference"
+#pragma GCC diagnostic ignored "-Wuseless-cast"
+#pragma GCC diagnostic ignored "-Wold-style-cast"
+#pragma GCC diagnostic ignored "-Wsuggest-final-types"
+#pragma GCC diagnostic ignored "-Wsuggest-attribute=pure"
+#pragma GCC diagnostic ignored "-Wconversion"
+#endif
+
+#include <QFile>
+#include <QFileDialog>
+#include <QHBoxLayout>
+#include <QHeaderView>
+#include <QLabel>
+#include <QMessageBox>
+#include <QPushButton>
+#include <QTableWidget>
+#include <QVBoxLayout>
+
+#if defined(__clang__)
+#pragma clang diagnostic pop
+#elif defined(__GNUC__)
+#pragma GCC diagnostic pop
+#endif
+
+namespace {
+
+auto format_millis(std::chrono::nanoseconds duration) noexcept -> QString {
+    return QString::number(std::chrono::duration<double, std::milli>(duration).count(), 'f', 1);
+}
+
+auto format_trace(const scx::loader::ApplyRequest& request, const scx::loader::ApplyTrace& trace) noexcept -> QString {
+    QStringList parts;
+    for (auto&& span : trace.spans) {
+        const auto stage_name = scx::loader::apply_stage_name(span.stage);
+        parts << QStringLiteral("%1 %2 ms").arg(QString::fromUtf8(stage_name.data(), static_cast<qsizetype>(stage_name.size())), format_millis(span.duration));
+    }
+    const auto& transition = trace.transition;
+    if (transition.detached_at) {
+        parts << QObject::tr("detached at +%1 ms").arg(format_millis(*transition.detached_at));
+    }
+    if (transition.attached_at) {
+        parts << QObject::tr("attached at +%1 ms").arg(format_millis(*transition.attached_at));
+    } else {
+        parts << QObject::tr("not seen attaching");
+    }
+    return QObject::tr("Last switch to %1: %2").arg(QString::fromStdString(request.scx_sched), parts.join(QStringLiteral(", ")));
+}
+
+}  // namespace
+
+namespace scxctl::impl {
+
+SwitchLatencyPanel::SwitchLatencyPanel(QWidget* parent)
+  : QWidget(parent) {
+    auto* main_layout = new QVBoxLayout(this);
+    main_layout->setContentsMargins(0, 0, 0, 0);
+
+    m_table = new QTableWidget(0, 6, this);
+    m_table->setHorizontalHeaderLabels({tr("Scheduler"), tr("Switches"), tr("Last gap, ms"), tr("p50 gap, ms"), tr("Max gap, ms"), tr("p50 attach, ms")});
+    m_table->horizontalHeader()->setSectionResizeMode(QHeaderView::Stretch);
+    m_table->verticalHeader()->setVisible(false);
+    m_table->setEditTriggers(QAbstractItemView::NoEditTriggers);
+    main_layout->addWidget(m_table);
+
+    auto* bottom_layout = new QHBoxLayout();
+    m_last_switch_label = new QLabel(tr("No switches yet"), this);
+    m_last_switch_label->setWordWrap(true);
+    bottom_layout->addWidget(m_last_switch_label, 1);
+    m_export_button = new QPushButton(tr("Export..."), this);
+    m_export_button->setEnabled(false);
+    bottom_layout->addWidget(m_export_button);
+    main_layout->addLayout(bottom_layout);
+
+    connect(m_export_button, &QPushButton::clicked, this, &SwitchLatencyPanel::on_export);
+}
+
+SwitchLatencyPanel::~SwitchLatencyPanel() = default;
+
+void SwitchLatencyPanel::record_trace(const scx::loader::ApplyRequest& request, const scx::loader::ApplyTrace& trace) noexcept {
+    if (request.kind != scx::loader::ApplyRequest::Kind::Apply || trace.spans.empty()) {
+        return;
+    }
+    m_stats.record(request.scx_sched, trace.transition);
+    m_last_switch_label->setText(format_trace(request, trace));
+    m_export_button->setEnabled(true);
+    update_table();
+}
+
+void SwitchLatencyPanel::on_export() noexcept {
+    const auto file_path = QFileDialog::getSaveFileName(this, tr("Export switch latencies"), QStringLiteral("switch-latency.csv"), tr("CSV files (*.csv)"));
+    if (file_path.isEmpty()) {
+        return;
+    }
+
+    const auto summaries = m_stats.summaries();
+    const auto csv       = scx::switch_latency_summaries_to_csv(summaries);
+
+    QFile file(file_path);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        QMessageBox::critical(this, "CachyOS Kernel Manager", tr("Cannot write %1: %2").arg(file_path, file.errorString()));
+        return;
+    }
+    file.write(csv.data(), static_cast<qint64>(csv.size()));
+}
+
+void SwitchLatencyPanel::update_table() noexcept {
+    const auto summaries = m_stats.summaries();
+    m_table->setRowCount(static_cast<int>(summaries.size()));
+    for (std::size_t idx = 0; idx < summaries.size(); ++idx) {
+        const auto& summary = summaries[idx];
+        const auto row      = static_cast<int>(idx);
+
+        const std::array columns{
+            QString::fromStdString(summary.scx_sched),
+            QString::number(summary.count),
+            summary.last_gap ? format_millis(*summary.last_gap) : QStringLiteral("-"),
+            format_millis(summary.gap_p50),
+            format_millis(summary.gap_max),
+            format_millis(summary.attach_p50),
+        };
+        for (std::size_t column = 0; column < columns.size(); ++column) {
+            auto* item = m_table->item(row, static_cast<int>(column));
+            if (item == nullptr) {
+                item = new QTableWidgetItem();
+                item->setTextAlignment(Qt::AlignRight | Qt::AlignVCenter);
+                m_table->setItem(row, static_cast<int>(column), item);
+            }
+            item->setText(columns[column]);
+        }
+    }
+}
+
+}  // namespace scxctl::impl
+
+// NOLINTEND(bugprone-unhandled-exception-at-new)
@@ -0,0 +1,83 @@
+// Copyright (C) 2024-2025 Vladislav Nepogodin
+//
+// This file is part of CachyOS kernel manager.
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+#ifndef SWITCH_LATENCY_PANEL_HPP_
+#define SWITCH_LATENCY_PANEL_HPP_
+
+#include "scx_apply_executor.hpp"
+#include "scx_switch_trace.hpp"
+
+#if defined(__clang__)
+#pragma clang diagnostic push
+#pragma clang diagnostic ignored "-Wsign-conversion"
+#pragma clang diagnostic ignored "-Wfloat-conversion"
+#pragma clang diagnostic ignored "-Wdouble-promotion"
+#pragma clang diagnostic ignored "-Wimplicit-int-float-conversion"
+#pragma clang diagnostic ignored "-Wshorten-64-to-32"
+#elif defined(__GNUC__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wuseless-cast"
+#pragma GCC diagnostic ignored "-Wsign-conversion"
+#pragma GCC diagnostic ignored "-Wconversion"
+#pragma GCC diagnostic ignored "-Wsuggest-final-methods"
+#pragma GCC diagnostic ignored "-Wsuggest-attribute=pure"
+#endif
+
+#include <QWidget>
+
+#if defined(__clang__)
+#pragma clang diagnostic pop
+#elif defined(__GNUC__)
+#pragma GCC diagnostic pop
+#endif
+
+class QLabel;
+class QPushButton;
+class QTableWidget;
+
+namespace scxctl::impl {
+
+/// @brief Shows how long the scheduler switches took, per scheduler switched to.
+///
+/// The gap is the time tasks ran on the fair class between the old scheduler
+/// detaching and the new one attaching, attach is the time since the switch
+/// was requested. The timeline of the last switch is shown below the table.
+class SwitchLatencyPanel final : public QWidget {
+    Q_OBJECT
+    Q_DISABLE_COPY_MOVE(SwitchLatencyPanel)
+ public:
+    explicit SwitchLatencyPanel(QWidget* parent = nullptr);
+    ~SwitchLatencyPanel() override;
+
+    /// @brief Records the finished request, only the scheduler switches are kept.
+    void record_trace(const scx::loader::ApplyRequest& request, const scx::loader::ApplyTrace& trace) noexcept;
+
+ private:
+    void on_export() noexcept;
+    void update_table() noexcept;
+
+    scx::SwitchLatencyStats m_stats{};
+
+    QPushButton* m_export_button{};
+    QTableWidget* m_table{};
+    QLabel* m_last_switch_label{};
+};
+
+}  // namespace scxctl::impl
+
+#endif  // SWITCH_LATENCY_PANEL_HPP_